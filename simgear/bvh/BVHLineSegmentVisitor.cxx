@@ -21,6 +21,8 @@
 
 #include "BVHLineSegmentVisitor.hxx"
 
+#include <typeinfo>
+
 #include <simgear/math/SGGeometry.hxx>
 
 #include "BVHVisitor.hxx"
@@ -128,7 +130,21 @@ BVHLineSegmentVisitor::apply(BVHStaticGeometry& node)
 {
     if (!intersects(_lineSegment, node.getBoundingSphere()))
         return;
-    node.traverse(*this);
+    const BVHStaticFlatTree* flatTree = node.getFlatTree();
+    if (!flatTree || typeid(*this) != typeid(BVHLineSegmentVisitor)) {
+        node.traverse(*this);
+        return;
+    }
+
+    unsigned i;
+    if (!flatTree->lineSegmentIntersection(_lineSegment, i))
+        return;
+    _normal = SGVec3d(flatTree->getTriangle(i).getNormal());
+    _linearVelocity = SGVec3d::zeros();
+    _angularVelocity = SGVec3d::zeros();
+    _material = node.getStaticData()->getMaterial(flatTree->getMaterialIndex(i));
+    _id = 0;
+    _haveHit = true;
 }
 
 void
@@ -65,6 +65,9 @@ public:
     virtual void apply(BVHTransform& transform);
     virtual void apply(BVHMotionTransform& transform);
     virtual void apply(BVHLineGeometry&);
+    // Static geometry with a flat tree is queried through the flat tree,
+    // unless this is a subclass, which may override the static node apply
+    // methods below.
     virtual void apply(BVHStaticGeometry& node);
     
     virtual void apply(const BVHStaticBinary&, const BVHStaticData&);
@@ -18,6 +18,8 @@
 #ifndef BVHNearestPointVisitor_hxx
 #define BVHNearestPointVisitor_hxx
 
+#include <typeinfo>
+
 #include <simgear/math/SGGeometry.hxx>
 
 #include "BVHVisitor.hxx"
@@ -107,11 +109,28 @@ public:
     }
     virtual void apply(BVHLineGeometry& node)
     { }
+    // Static geometry with a flat tree is queried through the flat tree,
+    // unless this is a subclass, which may override the static node apply
+    // methods below.
     virtual void apply(BVHStaticGeometry& node)
     {
         if (!intersects(_sphere, node.getBoundingSphere()))
             return;
-        node.traverse(*this);
+        const BVHStaticFlatTree* flatTree = node.getFlatTree();
+        if (!flatTree || typeid(*this) != typeid(BVHNearestPointVisitor)) {
+            node.traverse(*this);
+            return;
+        }
+
+        unsigned i;
+        if (!flatTree->nearestPoint(_sphere, _point, i))
+            return;
+        _linearVelocity = SGVec3d::zeros();
+        _angularVelocity = SGVec3d::zeros();
+        unsigned material = flatTree->getMaterialIndex(i);
+        _material = node.getStaticData()->getMaterial(material);
+        _havePoint = true;
+        _id = 0;
     }
     
     virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
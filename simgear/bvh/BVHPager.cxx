@@ -19,17 +19,22 @@
 
 #include "BVHPager.hxx"
 
+#include <algorithm>
 #include <list>
+#include <map>
+#include <queue>
+#include <vector>
 
 #include <simgear/threads/SGThread.hxx>
 #include <simgear/threads/SGGuard.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "BVHPageNode.hxx"
 #include "BVHPageRequest.hxx"
 
 namespace simgear {
 
-struct BVHPager::_PrivateData : protected SGThread {
+struct BVHPager::_PrivateData {
     typedef SGSharedPtr<BVHPageRequest> _Request;
     typedef std::list<_Request> _RequestList;
     typedef std::list<SGSharedPtr<BVHPageNode> > _PageNodeList;
@@ -55,84 +60,196 @@ struct BVHPager::_PrivateData : protected SGThread {
         _RequestList _requestList;
     };
     
+    // The requests waiting for a pager thread, nearest first.
+    // Moving a request forward or cancelling it leaves its old entry in
+    // the heap, such entries are skipped once they come to the top.
     struct _WorkQueue {
+        _WorkQueue() :
+            _serial(0),
+            _stopping(false),
+            _maxDepth(0)
+        {
+        }
+        void _start()
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            _stopping = false;
+        }
         void _stop()
         {
-            _push(_Request());
+            SGGuard<SGMutex> scopeLock(_mutex);
+            _stopping = true;
+            _waitCondition.broadcast();
+        }
+        void _push(const _Request& request, double distance)
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            _pending[request.get()] = distance;
+            _maxDepth = std::max(_maxDepth, unsigned(_pending.size()));
+            _queue.push(_Entry(distance, _serial++, request));
+            _waitCondition.signal();
         }
-        void _push(const _Request& request)
+        void _moveForward(const _Request& request, double distance)
         {
             SGGuard<SGMutex> scopeLock(_mutex);
-            bool needSignal = _requestList.empty();
-            _requestList.push_back(request);
-            if (needSignal)
-                _waitCondition.signal();
+            _Pending::iterator i = _pending.find(request.get());
+            if (i == _pending.end() || i->second <= distance)
+                return;
+            i->second = distance;
+            _queue.push(_Entry(distance, _serial++, request));
+            _waitCondition.signal();
+        }
+        bool _cancel(const _Request& request)
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            if (!_pending.erase(request.get()))
+                return false;
+            if (_pending.empty())
+                _queue = _Queue();
+            return true;
         }
         _Request _pop()
         {
             SGGuard<SGMutex> scopeLock(_mutex);
-            while (_requestList.empty())
-                _waitCondition.wait(_mutex);
-            _Request request;
-            request.swap(_requestList.front());
-            _requestList.pop_front();
-            return request;
+            for (;;) {
+                while (_queue.empty() && !_stopping)
+                    _waitCondition.wait(_mutex);
+                // This means stop working
+                if (_stopping)
+                    return _Request();
+                _Request request = _queue.top()._request;
+                _queue.pop();
+                if (_pending.erase(request.get()))
+                    return request;
+            }
+        }
+        unsigned _depth()
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            return _pending.size();
+        }
+        unsigned _getMaxDepth()
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            return _maxDepth;
+        }
+        void _resetMaxDepth()
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            _maxDepth = _pending.size();
         }
     private:
+        struct _Entry {
+            _Entry(double distance, unsigned long serial,
+                   const _Request& request) :
+                _distance(distance),
+                _serial(serial),
+                _request(request)
+            { }
+            // Reversed, the top of the heap is the nearest, oldest entry
+            bool operator<(const _Entry& entry) const
+            {
+                if (_distance != entry._distance)
+                    return entry._distance < _distance;
+                return entry._serial < _serial;
+            }
+            double _distance;
+            unsigned long _serial;
+            _Request _request;
+        };
+        typedef std::priority_queue<_Entry> _Queue;
+        // The distances of the requests not yet taken by a pager thread
+        typedef std::map<BVHPageRequest*, double> _Pending;
+
         SGMutex _mutex;
         SGWaitCondition _waitCondition;
-        _RequestList _requestList;
+        _Queue _queue;
+        _Pending _pending;
+        unsigned long _serial;
+        bool _stopping;
+        unsigned _maxDepth;
+    };
+
+    struct _Thread : public SGThread {
+        _Thread(_PrivateData& privateData) :
+            _privateData(privateData)
+        {
+        }
+        virtual ~_Thread()
+        {
+        }
+        virtual void run()
+        {
+            for (;;) {
+                _Request request = _privateData._pendingRequests._pop();
+                if (!request.valid())
+                    return;
+                request->load();
+                _privateData._processedRequests._push(request);
+            }
+        }
+    private:
+        _PrivateData& _privateData;
+    };
+
+    // A request scheduled for a page node, until it is inserted
+    struct _Scheduled {
+        _Request _request;
+        SGTimeStamp _useTime;
     };
+    typedef std::map<BVHPageNode*, _Scheduled> _ScheduledMap;
 
     _PrivateData() :
-        _started(false),
         _useStamp(0)
     {
+        _resetStatistics();
     }
-    virtual ~_PrivateData()
+    ~_PrivateData()
     {
         _stop();
     }
 
-    virtual void run()
+    bool _start(unsigned numThreads)
     {
-        for (;;) {
-            _Request request = _pendingRequests._pop();
-            // This means stop working
-            if (!request.valid())
-                return;
-            request->load();
-            _processedRequests._push(request);
-        }
-    }
-
-    bool _start()
-    {
-        if (_started)
+        if (!_threads.empty())
             return true;
-        if (!start())
-            return false;
-        _started = true;
+        _pendingRequests._start();
+        for (unsigned i = 0; i < std::max(numThreads, 1u); ++i) {
+            _Thread* thread = new _Thread(*this);
+            if (!thread->start()) {
+                delete thread;
+                _stop();
+                return false;
+            }
+            _threads.push_back(thread);
+        }
         return true;
     }
     
     void _stop()
     {
-        if (!_started)
+        if (_threads.empty())
             return;
         // send a stop request ...
         _pendingRequests._stop();
-        // ... and wait for the thread to finish
-        join();
-        _started = false;
+        // ... and wait for the threads to finish
+        for (unsigned i = 0; i < _threads.size(); ++i) {
+            _threads[i]->join();
+            delete _threads[i];
+        }
+        _threads.clear();
     }
 
-    void _use(BVHPageNode& pageNode)
+    void _use(BVHPageNode& pageNode, double distance)
     {
         if (pageNode._requested) {
             // move it forward in the lru list
             _pageNodeList.splice(_pageNodeList.end(), _pageNodeList,
                                  pageNode._iterator);
+            // and in the work queue if it is not yet loading
+            _ScheduledMap::iterator i = _scheduled.find(&pageNode);
+            if (i != _scheduled.end())
+                _pendingRequests._moveForward(i->second._request, distance);
         } else {
             _Request request = pageNode.newRequest();
             if (!request.valid())
@@ -142,8 +259,11 @@ struct BVHPager::_PrivateData : protected SGThread {
                                                       &pageNode);
             pageNode._requested = true;
 
-            if (_started) {
-                _pendingRequests._push(request);
+            if (!_threads.empty()) {
+                _Scheduled& scheduled = _scheduled[&pageNode];
+                scheduled._request = request;
+                scheduled._useTime = SGTimeStamp::now();
+                _pendingRequests._push(request, distance);
             } else {
                 request->load();
                 request->insert();
@@ -154,13 +274,25 @@ struct BVHPager::_PrivateData : protected SGThread {
 
     void _update(unsigned expiry)
     {
-        // Insert all processed requests
+        // Insert all processed requests, unless their page node expired
+        // while they were loading
         for (;;) {
             SGSharedPtr<BVHPageRequest> request;
             request = _processedRequests._pop();
             if (!request.valid())
                 break;
+            _ScheduledMap::iterator i;
+            i = _scheduled.find(request->getPageNode());
+            if (i == _scheduled.end() || i->second._request != request) {
+                ++_numCancelled;
+                continue;
+            }
             request->insert();
+            double latency = (SGTimeStamp::now() - i->second._useTime).toSecs();
+            _scheduled.erase(i);
+            ++_numInserted;
+            _latencySum += latency;
+            _maxLatency = std::max(_maxLatency, latency);
         }
 
         // ... and throw away stuff that is not used for a long time
@@ -174,18 +306,41 @@ struct BVHPager::_PrivateData : protected SGThread {
             // test the sign bit of the difference
             if (!(diff & (~((~0u) >> 1))))
                 break;
+            // Drop the request of the page node if it is not yet inserted
+            _ScheduledMap::iterator j = _scheduled.find(i->get());
+            if (j != _scheduled.end()) {
+                if (_pendingRequests._cancel(j->second._request))
+                    ++_numCancelled;
+                _scheduled.erase(j);
+            }
             (*i)->clear();
             (*i)->_requested = false;
             i = _pageNodeList.erase(i);
         }
     }
 
-    bool _started;
+    void _resetStatistics()
+    {
+        _pendingRequests._resetMaxDepth();
+        _numInserted = 0;
+        _numCancelled = 0;
+        _latencySum = 0;
+        _maxLatency = 0;
+    }
+
     unsigned _useStamp;
+    std::vector<_Thread*> _threads;
     _WorkQueue _pendingRequests;
     _LockedQueue _processedRequests;
+    // The requests of the page nodes that are not yet inserted
+    _ScheduledMap _scheduled;
     // Store the rcu list of loaded nodes so that they can expire
     _PageNodeList _pageNodeList;
+
+    unsigned _numInserted;
+    unsigned _numCancelled;
+    double _latencySum;
+    double _maxLatency;
 };
 
 BVHPager::BVHPager() :
@@ -200,9 +355,9 @@ BVHPager::~BVHPager()
 }
 
 bool
-BVHPager::start()
+BVHPager::start(unsigned numThreads)
 {
-    return _privateData->_start();
+    return _privateData->_start(numThreads);
 }
 
 void
@@ -214,7 +369,18 @@ BVHPager::stop()
 void
 BVHPager::use(BVHPageNode& pageNode)
 {
-    _privateData->_use(pageNode);
+    _privateData->_use(pageNode, 0);
+}
+
+void
+BVHPager::use(BVHPageNode& pageNode, const SGVec3d& position)
+{
+    const SGSphered& sphere = pageNode.getBoundingSphere();
+    double distance = 0;
+    if (!sphere.empty())
+        distance = std::max(dist(position, sphere.getCenter())
+                            - sphere.getRadius(), 0.0);
+    _privateData->_use(pageNode, distance);
 }
 
 void
@@ -235,4 +401,48 @@ BVHPager::getUseStamp() const
     return _privateData->_useStamp;
 }
 
+unsigned
+BVHPager::getQueueDepth() const
+{
+    return _privateData->_pendingRequests._depth();
+}
+
+unsigned
+BVHPager::getMaxQueueDepth() const
+{
+    return _privateData->_pendingRequests._getMaxDepth();
+}
+
+unsigned
+BVHPager::getNumInserted() const
+{
+    return _privateData->_numInserted;
+}
+
+unsigned
+BVHPager::getNumCancelled() const
+{
+    return _privateData->_numCancelled;
+}
+
+double
+BVHPager::getMeanLatency() const
+{
+    if (!_privateData->_numInserted)
+        return 0;
+    return _privateData->_latencySum/_privateData->_numInserted;
+}
+
+double
+BVHPager::getMaxLatency() const
+{
+    return _privateData->_maxLatency;
+}
+
+void
+BVHPager::resetStatistics()
+{
+    _privateData->_resetStatistics();
+}
+
 }
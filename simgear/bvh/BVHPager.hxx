@@ -18,6 +18,7 @@
 #ifndef BVHPager_hxx
 #define BVHPager_hxx
 
+#include <simgear/math/SGMath.hxx>
 #include <simgear/structure/SGSharedPtr.hxx>
 
 namespace simgear {
@@ -30,14 +31,19 @@ public:
     BVHPager();
     ~BVHPager();
 
-    /// Starts the pager thread
-    bool start();
+    /// Starts the pager threads
+    bool start(unsigned numThreads = 1);
 
-    /// Stops the pager thread
+    /// Stops the pager threads, requests not yet loaded are kept
     void stop();
 
     /// Use this page node, if loaded make it as used, if not loaded schedule
     void use(BVHPageNode& pageNode);
+    /// The same, the pager threads load the page nodes nearest to their
+    /// requesters first. A page node used again from a nearer position
+    /// moves forward if it is not yet loading. Page nodes used without a
+    /// position are loaded first, in the order of their use.
+    void use(BVHPageNode& pageNode, const SGVec3d& position);
 
     /// Call this from the main thread to incorporate the processed page
     /// requests into the bounding volume tree
@@ -47,6 +53,21 @@ public:
     void setUseStamp(unsigned stamp);
     unsigned getUseStamp() const;
 
+    /// The number of requests waiting for a pager thread
+    unsigned getQueueDepth() const;
+    /// The maximum queue depth since the last resetStatistics()
+    unsigned getMaxQueueDepth() const;
+    /// The number of requests inserted since the last resetStatistics()
+    unsigned getNumInserted() const;
+    /// The number of requests dropped since the last resetStatistics(),
+    /// because their page nodes expired before they were inserted
+    unsigned getNumCancelled() const;
+    /// The mean and maximum time in seconds from the use of a page node to
+    /// the insertion of its request, since the last resetStatistics()
+    double getMeanLatency() const;
+    double getMaxLatency() const;
+    void resetStatistics();
+
 private:
     BVHPager(const BVHPager&);
     BVHPager& operator=(const BVHPager&);
@@ -0,0 +1,512 @@
+// Copyright (C) 2008 - 2009  Mathias Froehlich - Mathias.Froehlich@web.de
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include "BVHStaticFlatTree.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BVHVisitor.hxx"
+#include "BVHStaticData.hxx"
+#include "BVHStaticNode.hxx"
+#include "BVHStaticBinary.hxx"
+#include "BVHStaticTriangle.hxx"
+
+namespace simgear {
+
+static_assert(sizeof(BVHStaticFlatTree::Node) == 32,
+              "BVHStaticFlatTree::Node should fill half a cache line");
+
+class BVHStaticFlatTree::FlattenVisitor : public BVHVisitor {
+public:
+    FlattenVisitor(BVHStaticFlatTree& tree) :
+        _tree(tree),
+        _depth(0)
+    { }
+
+    virtual void apply(BVHGroup&) { }
+    virtual void apply(BVHPageNode&) { }
+    virtual void apply(BVHTransform&) { }
+    virtual void apply(BVHMotionTransform&) { }
+    virtual void apply(BVHLineGeometry&) { }
+    virtual void apply(BVHStaticGeometry&) { }
+
+    virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
+    {
+        unsigned index = addNode(node.getBoundingBox());
+        unsigned firstTriangle = _tree.getNumTriangles();
+
+        ++_depth;
+        _tree._depth = std::max(_tree._depth, _depth);
+        node.getLeftChild()->accept(*this, data);
+        _tree._nodes[index]._index = _tree.getNumNodes();
+        node.getRightChild()->accept(*this, data);
+        --_depth;
+
+        unsigned count = _tree.getNumTriangles() - firstTriangle;
+        Node& flatNode = _tree._nodes[index];
+        if (count <= maxLeafTriangles) {
+            // Small enough, drop the nodes below and make it a leaf
+            _tree._nodes.resize(index + 1);
+            flatNode._index = firstTriangle;
+            flatNode._count = count;
+        } else {
+            flatNode._splitAxis = node.getSplitAxis();
+        }
+    }
+    virtual void apply(const BVHStaticTriangle& node, const BVHStaticData& data)
+    {
+        unsigned index = addNode(node.computeBoundingBox(data));
+        _tree._nodes[index]._index = _tree.getNumTriangles();
+        _tree._nodes[index]._count = 1;
+        _tree._triangles.push_back(node.getTriangle(data));
+        _tree._materials.push_back(node.getMaterialIndex());
+    }
+
+private:
+    unsigned addNode(const SGBoxf& box)
+    {
+        Node node;
+        for (unsigned i = 0; i < 3; ++i) {
+            node._min[i] = box.getMin()[i];
+            node._max[i] = box.getMax()[i];
+        }
+        node._index = 0;
+        node._count = 0;
+        node._splitAxis = 0;
+        _tree._nodes.push_back(node);
+        return _tree.getNumNodes() - 1;
+    }
+
+    BVHStaticFlatTree& _tree;
+    unsigned _depth;
+};
+
+namespace {
+
+// The traversal stack, on the call stack for all but degenerate trees
+template<typename T>
+class NodeStack {
+public:
+    NodeStack(unsigned depth) :
+        _stack(_localStack),
+        _size(0)
+    {
+        if (maxLocalDepth < depth) {
+            _heapStack.resize(depth);
+            _stack = &_heapStack.front();
+        }
+    }
+    bool empty() const
+    { return !_size; }
+    void push(const T& entry)
+    { _stack[_size++] = entry; }
+    T pop()
+    { return _stack[--_size]; }
+
+private:
+    enum { maxLocalDepth = 64 };
+    T _localStack[maxLocalDepth];
+    std::vector<T> _heapStack;
+    T* _stack;
+    unsigned _size;
+};
+
+// Same separating axis test as intersects(SGBoxf, SGLineSegmentf),
+// with the line segment terms computed once for all boxes
+class LineSegmentBoxTest {
+public:
+    LineSegmentBoxTest(const SGLineSegmentf& lineSegment)
+    { set(lineSegment); }
+    void set(const SGLineSegmentf& lineSegment)
+    {
+        SGVec3f center = lineSegment.getCenter();
+        SGVec3f direction = lineSegment.getDirection();
+        for (unsigned i = 0; i < 3; ++i) {
+            _c[i] = center[i];
+            _w[i] = 0.5f*direction[i];
+            _v[i] = std::fabs(_w[i]);
+        }
+    }
+    bool intersects(const BVHStaticFlatTree::Node& node) const
+    {
+        float c[3], h[3];
+        for (unsigned i = 0; i < 3; ++i) {
+            c[i] = _c[i] - 0.5f*(node._min[i] + node._max[i]);
+            h[i] = 0.5f*(node._max[i] - node._min[i]);
+        }
+        if (std::fabs(c[0]) > _v[0] + h[0])
+            return false;
+        if (std::fabs(c[1]) > _v[1] + h[1])
+            return false;
+        if (std::fabs(c[2]) > _v[2] + h[2])
+            return false;
+
+        if (std::fabs(c[1]*_w[2] - c[2]*_w[1]) > h[1]*_v[2] + h[2]*_v[1])
+            return false;
+        if (std::fabs(c[0]*_w[2] - c[2]*_w[0]) > h[0]*_v[2] + h[2]*_v[0])
+            return false;
+        if (std::fabs(c[0]*_w[1] - c[1]*_w[0]) > h[0]*_v[1] + h[1]*_v[0])
+            return false;
+        return true;
+    }
+
+private:
+    float _c[3];
+    float _w[3];
+    float _v[3];
+};
+
+typedef simd4_t<float,4> float4;
+
+// Four line segments in the lanes of simd registers, for the box test
+// above and the triangle test of intersects(SGVec3f&, SGTrianglef,
+// SGLineSegmentf) on all of them at once.  The tests return bit masks
+// of the lanes passing.
+class LineSegmentPacket {
+public:
+    LineSegmentPacket() :
+        _mask(0)
+    { }
+
+    unsigned getMask() const
+    { return _mask; }
+    const SGLineSegmentf& getLineSegment(unsigned k) const
+    { return _lineSegments[k]; }
+
+    void set(unsigned k, const SGLineSegmentf& lineSegment)
+    {
+        _lineSegments[k] = lineSegment;
+        SGVec3f center = lineSegment.getCenter();
+        SGVec3f direction = lineSegment.getDirection();
+        for (unsigned i = 0; i < 3; ++i) {
+            _start[i][k] = lineSegment.getStart()[i];
+            _direction[i][k] = direction[i];
+            _c[i][k] = center[i];
+            _w[i][k] = 0.5f*direction[i];
+            _v[i][k] = std::fabs(_w[i][k]);
+        }
+        _mask |= 1u << k;
+    }
+
+    unsigned intersects(const BVHStaticFlatTree::Node& node) const
+    {
+        float4 c[3];
+        float h[3];
+        for (unsigned i = 0; i < 3; ++i) {
+            c[i] = _c[i] - 0.5f*(node._min[i] + node._max[i]);
+            h[i] = 0.5f*(node._max[i] - node._min[i]);
+        }
+        // The least margin of the separating axis tests, negative if
+        // one of the axes separates
+        float4 margin = _v[0] + h[0] - simd4::abs(c[0]);
+        margin = simd4::min(margin, _v[1] + h[1] - simd4::abs(c[1]));
+        margin = simd4::min(margin, _v[2] + h[2] - simd4::abs(c[2]));
+        margin = simd4::min(margin, h[1]*_v[2] + h[2]*_v[1]
+                            - simd4::abs(c[1]*_w[2] - c[2]*_w[1]));
+        margin = simd4::min(margin, h[0]*_v[2] + h[2]*_v[0]
+                            - simd4::abs(c[0]*_w[2] - c[2]*_w[0]));
+        margin = simd4::min(margin, h[0]*_v[1] + h[1]*_v[0]
+                            - simd4::abs(c[0]*_w[1] - c[1]*_w[0]));
+        unsigned mask = 0;
+        for (unsigned k = 0; k < 4; ++k)
+            mask |= unsigned(0 <= margin[k]) << k;
+        return mask & _mask;
+    }
+
+    // Returns the lanes intersecting the triangle in mask, with the
+    // intersection points in points
+    unsigned intersects(SGVec3f points[4], const SGTrianglef& tri,
+                        unsigned mask, float eps) const
+    {
+        const SGVec3f& e0 = tri.getEdge(0);
+        const SGVec3f& e1 = tri.getEdge(1);
+        const SGVec3f& v0 = tri.getBaseVertex();
+        const float4* d = _direction;
+
+        float4 p[3] = {
+            d[1]*e1[2] - d[2]*e1[1],
+            d[2]*e1[0] - d[0]*e1[2],
+            d[0]*e1[1] - d[1]*e1[0]
+        };
+        float4 denom = p[0]*e0[0] + p[1]*e0[1] + p[2]*e0[2];
+        float4 s[3] = { _start[0] - v0[0], _start[1] - v0[1],
+                        _start[2] - v0[2] };
+        float4 q[3] = {
+            s[1]*e0[2] - s[2]*e0[1],
+            s[2]*e0[0] - s[0]*e0[2],
+            s[0]*e0[1] - s[1]*e0[0]
+        };
+        float4 t = q[0]*e1[0] + q[1]*e1[1] + q[2]*e1[2];
+        float4 u = p[0]*s[0] + p[1]*s[1] + p[2]*s[2];
+        float4 v = q[0]*d[0] + q[1]*d[1] + q[2]*d[2];
+
+        unsigned hits = 0;
+        for (unsigned k = 0; k < 4; ++k) {
+            if (!(mask & (1u << k)))
+                continue;
+            float signDenom = copysign(1.0f, denom[k]);
+            float tDenom = signDenom*t[k];
+            if (tDenom < 0)
+                continue;
+            float absDenom = std::fabs(denom[k]);
+            if (absDenom < tDenom)
+                continue;
+            float absDenomEps = absDenom*eps;
+            float uDenom = signDenom*u[k];
+            if (uDenom < -absDenomEps)
+                continue;
+            float vDenom = signDenom*v[k];
+            if (vDenom < -absDenomEps)
+                continue;
+            if (uDenom + vDenom > absDenom + absDenomEps)
+                continue;
+            if (absDenom <= SGLimitsf::min())
+                continue;
+            points[k] = _lineSegments[k].getStart();
+            points[k] += (tDenom/absDenom)*_lineSegments[k].getDirection();
+            hits |= 1u << k;
+        }
+        return hits;
+    }
+
+private:
+    float4 _start[3];
+    float4 _direction[3];
+    float4 _c[3];
+    float4 _w[3];
+    float4 _v[3];
+    SGLineSegmentf _lineSegments[4];
+    unsigned _mask;
+};
+
+// Same as intersects(SGBoxf, SGSphered)
+inline bool
+intersects(const SGSphered& sphere, const SGVec3f& center,
+           const BVHStaticFlatTree::Node& node)
+{
+    float d2 = 0;
+    for (unsigned i = 0; i < 3; ++i) {
+        float closest = std::min(std::max(center[i], node._min[i]),
+                                 node._max[i]);
+        d2 += (closest - center[i])*(closest - center[i]);
+    }
+    return d2 <= sphere.getRadius2();
+}
+
+}
+
+BVHStaticFlatTree::BVHStaticFlatTree(const BVHStaticNode& staticNode,
+                                     const BVHStaticData& staticData) :
+    _depth(0)
+{
+    FlattenVisitor flattenVisitor(*this);
+    staticNode.accept(flattenVisitor, staticData);
+    std::vector<Node>(_nodes).swap(_nodes);
+}
+
+BVHStaticFlatTree::~BVHStaticFlatTree()
+{
+}
+
+bool
+BVHStaticFlatTree::lineSegmentIntersection(SGLineSegmentd& lineSegment,
+                                           unsigned& triangle) const
+{
+    if (_nodes.empty())
+        return false;
+
+    SGLineSegmentf lineSegmentf(lineSegment);
+    LineSegmentBoxTest boxTest(lineSegmentf);
+    bool haveHit = false;
+    NodeStack<unsigned> stack(_depth);
+    unsigned i = 0;
+    for (;;) {
+        const Node& node = _nodes[i];
+        if (boxTest.intersects(node)) {
+            if (!node._count) {
+                // The first box to enter is the one the start point is in,
+                // see BVHLineSegmentVisitor
+                unsigned axis = node._splitAxis;
+                float center = 0.5f*(node._min[axis] + node._max[axis]);
+                if (lineSegment.getStart()[axis] < center) {
+                    stack.push(node._index);
+                    i = i + 1;
+                } else {
+                    stack.push(i + 1);
+                    i = node._index;
+                }
+                continue;
+            }
+            for (unsigned j = node._index; j < node._index + node._count; ++j) {
+                SGVec3f point;
+                if (!intersects(point, _triangles[j], lineSegmentf, 1e-4f))
+                    continue;
+                lineSegment.set(lineSegment.getStart(), SGVec3d(point));
+                lineSegmentf = SGLineSegmentf(lineSegment);
+                boxTest.set(lineSegmentf);
+                triangle = j;
+                haveHit = true;
+            }
+        }
+        if (stack.empty())
+            break;
+        i = stack.pop();
+    }
+    return haveHit;
+}
+
+void
+BVHStaticFlatTree::lineSegmentIntersections(SGLineSegmentd* lineSegments,
+                                            unsigned* triangles,
+                                            size_t n) const
+{
+    for (size_t i = 0; i < n; ++i)
+        triangles[i] = ~0u;
+    if (_nodes.empty())
+        return;
+
+    struct Entry {
+        unsigned _index;
+        unsigned _mask;
+    };
+    for (size_t first = 0; first < n; first += 4) {
+        SGLineSegmentd* packetSegments = lineSegments + first;
+        unsigned* packetTriangles = triangles + first;
+        LineSegmentPacket packet;
+        for (unsigned k = 0; k < 4 && first + k < n; ++k)
+            packet.set(k, SGLineSegmentf(packetSegments[k]));
+
+        NodeStack<Entry> stack(_depth);
+        Entry entry = { 0, packet.getMask() };
+        for (;;) {
+            const Node& node = _nodes[entry._index];
+            unsigned mask = entry._mask & packet.intersects(node);
+            if (mask && !node._count) {
+                // Enter first the child with the start point of the first
+                // segment still in the packet
+                unsigned k = 0;
+                while (!(mask & (1u << k)))
+                    ++k;
+                unsigned axis = node._splitAxis;
+                float center = 0.5f*(node._min[axis] + node._max[axis]);
+                Entry left = { entry._index + 1, mask };
+                Entry right = { node._index, mask };
+                if (packetSegments[k].getStart()[axis] < center) {
+                    stack.push(right);
+                    entry = left;
+                } else {
+                    stack.push(left);
+                    entry = right;
+                }
+                continue;
+            }
+            unsigned end = mask ? node._index + node._count : 0;
+            for (unsigned j = node._index; j < end; ++j) {
+                SGVec3f points[4];
+                unsigned hits = packet.intersects(points, _triangles[j],
+                                                  mask, 1e-4f);
+                for (unsigned k = 0; hits; ++k, hits >>= 1) {
+                    if (!(hits & 1))
+                        continue;
+                    SGLineSegmentd& lineSegment = packetSegments[k];
+                    lineSegment.set(lineSegment.getStart(),
+                                    SGVec3d(points[k]));
+                    packet.set(k, SGLineSegmentf(lineSegment));
+                    packetTriangles[k] = j;
+                }
+            }
+            if (stack.empty())
+                break;
+            entry = stack.pop();
+        }
+    }
+}
+
+bool
+BVHStaticFlatTree::nearestPoint(SGSphered& sphere, SGVec3d& point,
+                                unsigned& triangle) const
+{
+    if (_nodes.empty() || sphere.empty())
+        return false;
+
+    SGVec3f center(sphere.getCenter());
+    bool havePoint = false;
+    NodeStack<unsigned> stack(_depth);
+    unsigned i = 0;
+    for (;;) {
+        const Node& node = _nodes[i];
+        if (intersects(sphere, center, node)) {
+            if (!node._count) {
+                unsigned axis = node._splitAxis;
+                float split = 0.5f*(node._min[axis] + node._max[axis]);
+                if (sphere.getCenter()[axis] < split) {
+                    stack.push(node._index);
+                    i = i + 1;
+                } else {
+                    stack.push(i + 1);
+                    i = node._index;
+                }
+                continue;
+            }
+            for (unsigned j = node._index; j < node._index + node._count; ++j) {
+                SGVec3d closest(closestPoint(_triangles[j], center));
+                if (!intersects(closest, sphere))
+                    continue;
+                point = closest;
+                sphere.setRadius(length(closest - sphere.getCenter()));
+                triangle = j;
+                havePoint = true;
+            }
+        }
+        if (stack.empty())
+            break;
+        i = stack.pop();
+    }
+    return havePoint;
+}
+
+void
+BVHStaticFlatTree::sphereIntersection(const SGSphered& sphere,
+                                      std::vector<unsigned>& triangles) const
+{
+    if (_nodes.empty() || sphere.empty())
+        return;
+
+    SGVec3f center(sphere.getCenter());
+    NodeStack<unsigned> stack(_depth);
+    unsigned i = 0;
+    for (;;) {
+        const Node& node = _nodes[i];
+        if (intersects(sphere, center, node)) {
+            if (!node._count) {
+                stack.push(node._index);
+                i = i + 1;
+                continue;
+            }
+            for (unsigned j = node._index; j < node._index + node._count; ++j) {
+                if (intersects(_triangles[j], sphere))
+                    triangles.push_back(j);
+            }
+        }
+        if (stack.empty())
+            break;
+        i = stack.pop();
+    }
+}
+
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2008 - 2009  Mathias Froehlich - Mathias.Froehlich@web.de
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#ifndef BVHStaticFlatTree_hxx
+#define BVHStaticFlatTree_hxx
+
+#include <cstddef>
+#include <vector>
+#include <simgear/math/SGGeometry.hxx>
+#include <simgear/structure/SGReferenced.hxx>
+
+namespace simgear {
+
+class BVHStaticData;
+class BVHStaticNode;
+
+/// A compact copy of a static tree for the queries of the fdm.
+/// The nodes are stored in depth first order in a single array of 32 byte
+/// nodes: the left child of an inner node directly follows its parent, the
+/// parent stores the index of the right child, that is the index to skip
+/// to past the left subtree. Small subtrees are collapsed into leafs
+/// referencing a contiguous range of triangles, which are stored with
+/// their vertices in the same depth first order.
+/// The queries walk the array with an explicit stack, without any virtual
+/// calls, and touch the vertex array of the static data not at all.
+
+class BVHStaticFlatTree : public SGReferenced {
+public:
+    BVHStaticFlatTree(const BVHStaticNode& staticNode,
+                      const BVHStaticData& staticData);
+    virtual ~BVHStaticFlatTree();
+
+    /// Shortens the line segment to the nearest intersection with a
+    /// triangle, returns false if there is none.
+    bool lineSegmentIntersection(SGLineSegmentd& lineSegment,
+                                 unsigned& triangle) const;
+    /// The same for n line segments, traversed in packets of four segments
+    /// sharing the node visits and box and triangle tests, so segments near
+    /// each other, as from the gear of an aircraft, should be adjacent.
+    /// The triangle is ~0u for the segments without an intersection.
+    void lineSegmentIntersections(SGLineSegmentd* lineSegments,
+                                  unsigned* triangles, size_t n) const;
+    /// Finds the point nearest to the sphere center within the sphere,
+    /// the radius of the sphere is decreased to the distance of that point.
+    /// Returns false if there is no triangle intersecting the sphere.
+    bool nearestPoint(SGSphered& sphere, SGVec3d& point,
+                      unsigned& triangle) const;
+    /// Appends the indices of the triangles intersecting the sphere.
+    void sphereIntersection(const SGSphered& sphere,
+                            std::vector<unsigned>& triangles) const;
+
+    const SGTrianglef& getTriangle(unsigned i) const
+    { return _triangles[i]; }
+    unsigned getMaterialIndex(unsigned i) const
+    { return _materials[i]; }
+
+    unsigned getNumNodes() const
+    { return static_cast<unsigned>(_nodes.size()); }
+    unsigned getNumTriangles() const
+    { return static_cast<unsigned>(_triangles.size()); }
+
+    // Subtrees with at most that many triangles are stored as a leaf
+    static const unsigned maxLeafTriangles = 4;
+
+    struct Node {
+        float _min[3];
+        float _max[3];
+        // inner nodes: the index of the right child,
+        // leafs: the index of the first triangle
+        unsigned _index;
+        // number of triangles, zero for inner nodes
+        unsigned _count : 30;
+        unsigned _splitAxis : 2;
+    };
+
+private:
+    class FlattenVisitor;
+
+    std::vector<Node> _nodes;
+    std::vector<SGTrianglef> _triangles;
+    std::vector<unsigned> _materials;
+    // The maximum number of inner nodes on a path from the root
+    unsigned _depth;
+};
+
+}
+
+#endif
@@ -22,10 +22,13 @@
 namespace simgear {
 
 BVHStaticGeometry::BVHStaticGeometry(const BVHStaticNode* staticNode,
-                                     const BVHStaticData* staticData) :
+                                     const BVHStaticData* staticData,
+                                     bool flatten) :
     _staticNode(staticNode),
     _staticData(staticData)
 {
+    if (flatten)
+        _flatTree = new BVHStaticFlatTree(*staticNode, *staticData);
 }
 
 BVHStaticGeometry::~BVHStaticGeometry()
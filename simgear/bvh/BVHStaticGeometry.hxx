@@ -24,14 +24,19 @@
 #include "BVHVisitor.hxx"
 #include "BVHNode.hxx"
 #include "BVHStaticData.hxx"
+#include "BVHStaticFlatTree.hxx"
 #include "BVHStaticNode.hxx"
 
 namespace simgear {
 
 class BVHStaticGeometry : public BVHNode {
 public:
+    // If flatten is given, a compact copy of the tree is built for the
+    // line segment and nearest point visitors, see BVHStaticFlatTree.
+    // The node tree is kept for all other visitors.
     BVHStaticGeometry(const BVHStaticNode* staticNode,
-                      const BVHStaticData* staticData);
+                      const BVHStaticData* staticData,
+                      bool flatten = false);
     virtual ~BVHStaticGeometry();
     
     virtual void accept(BVHVisitor& visitor);
@@ -43,12 +48,15 @@ public:
     { return _staticData; }
     const BVHStaticNode* getStaticNode() const
     { return _staticNode; }
+    const BVHStaticFlatTree* getFlatTree() const
+    { return _flatTree; }
     
     virtual SGSphered computeBoundingSphere() const;
     
 private:
     SGSharedPtr<const BVHStaticNode> _staticNode;
     SGSharedPtr<const BVHStaticData> _staticData;
+    SGSharedPtr<const BVHStaticFlatTree> _flatTree;
 };
 
 }
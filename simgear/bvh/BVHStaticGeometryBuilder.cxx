@@ -0,0 +1,401 @@
+// Copyright (C) 2008 - 2009  Mathias Froehlich - Mathias.Froehlich@web.de
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//
+
+#include "BVHStaticGeometryBuilder.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/threads/SGThread.hxx>
+
+namespace simgear {
+
+// The surface area heuristic builder: the leafs are kept in a flat array
+// which is partitioned in place.  The split planes are chosen among the
+// boundaries of a fixed number of bins over the leaf centers, such that
+// the sum of the surface areas of the child boxes weighted with their
+// number of leafs is minimal.
+//
+// Large trees are built in two passes: the top levels are partitioned
+// serially until the ranges are small enough, then the subtrees of these
+// ranges are built by the calling thread together with a small pool of
+// threads shared by all builders, and finally the top level nodes are put
+// on top of them.
+
+namespace {
+
+struct BuildRef {
+    SGBoxf box;
+    SGVec3f center;
+    const BVHStaticLeaf* leaf;
+};
+typedef std::vector<BuildRef>::iterator BuildRefIterator;
+
+// Number of split candidates per axis, plus one
+const unsigned numBins = 16;
+// Trees with fewer leafs are built without threads
+const size_t minParallelLeafs = 16384;
+// The most pool threads, whatever the number of concurrent builds.  Trees
+// are mostly built on the pager or loader threads, which keep the cores
+// busy already.
+const unsigned maxPoolThreads = 3;
+
+float
+halfArea(const SGBoxf& box)
+{
+    SGVec3f size = box.getSize();
+    return size[0]*size[1] + size[1]*size[2] + size[2]*size[0];
+}
+
+class Binning {
+public:
+    Binning(unsigned axis, const SGBoxf& centers) :
+        _axis(axis),
+        _min(centers.getMin()[axis]),
+        _scale(numBins/(centers.getMax()[axis] - centers.getMin()[axis]))
+    { }
+    unsigned operator()(const BuildRef& ref) const
+    {
+        unsigned bin = unsigned(_scale*(ref.center[_axis] - _min));
+        return bin < numBins ? bin : numBins - 1;
+    }
+private:
+    unsigned _axis;
+    float _min;
+    float _scale;
+};
+
+class BinLess {
+public:
+    BinLess(const Binning& binning, unsigned bin) :
+        _binning(binning),
+        _bin(bin)
+    { }
+    bool operator()(const BuildRef& ref) const
+    { return _binning(ref) <= _bin; }
+private:
+    Binning _binning;
+    unsigned _bin;
+};
+
+// Partitions [begin, end) at the split with the least cost and returns
+// the start of the second part
+BuildRefIterator
+splitLeafs(BuildRefIterator begin, BuildRefIterator end, unsigned& splitAxis)
+{
+    SGBoxf centers;
+    for (BuildRefIterator i = begin; i != end; ++i)
+        centers.expandBy(i->center);
+
+    float bestCost = std::numeric_limits<float>::max();
+    unsigned bestBin = 0;
+    for (unsigned axis = 0; axis < 3; ++axis) {
+        if (!(centers.getMin()[axis] < centers.getMax()[axis]))
+            continue;
+
+        Binning binning(axis, centers);
+        unsigned counts[numBins] = { 0 };
+        SGBoxf boxes[numBins];
+        for (BuildRefIterator i = begin; i != end; ++i) {
+            unsigned bin = binning(*i);
+            ++counts[bin];
+            boxes[bin].expandBy(i->box);
+        }
+
+        // Sweep from the right, then from the left over the bins
+        float rightArea[numBins];
+        unsigned rightCount[numBins];
+        SGBoxf box;
+        unsigned count = 0;
+        for (unsigned bin = numBins - 1; 0 < bin; --bin) {
+            box.expandBy(boxes[bin]);
+            count += counts[bin];
+            rightArea[bin] = count ? halfArea(box) : 0;
+            rightCount[bin] = count;
+        }
+        box = SGBoxf();
+        count = 0;
+        for (unsigned bin = 0; bin < numBins - 1; ++bin) {
+            box.expandBy(boxes[bin]);
+            count += counts[bin];
+            if (!count || !rightCount[bin + 1])
+                continue;
+            float cost = count*halfArea(box)
+                + rightCount[bin + 1]*rightArea[bin + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestBin = bin;
+                splitAxis = axis;
+            }
+        }
+    }
+
+    // All centers are the same, split into equal halves
+    if (bestCost == std::numeric_limits<float>::max()) {
+        splitAxis = 0;
+        return begin + (end - begin)/2;
+    }
+
+    return std::partition(begin, end,
+                          BinLess(Binning(splitAxis, centers), bestBin));
+}
+
+SGBoxf
+boundingBox(BuildRefIterator begin, BuildRefIterator end)
+{
+    SGBoxf box;
+    for (BuildRefIterator i = begin; i != end; ++i)
+        box.expandBy(i->box);
+    return box;
+}
+
+const BVHStaticNode*
+buildSubtree(BuildRefIterator begin, BuildRefIterator end)
+{
+    if (begin == end)
+        return 0;
+    if (begin + 1 == end)
+        return begin->leaf;
+
+    SGBoxf box = boundingBox(begin, end);
+    if (box.empty())
+        return 0;
+
+    unsigned splitAxis;
+    BuildRefIterator split = splitLeafs(begin, end, splitAxis);
+    const BVHStaticNode* child0 = buildSubtree(begin, split);
+    const BVHStaticNode* child1 = buildSubtree(split, end);
+    if (!child0)
+        return child1;
+    if (!child1)
+        return child0;
+
+    return new BVHStaticBinary(splitAxis, child0, child1, box);
+}
+
+struct BuildBatch;
+
+struct BuildTask {
+    BuildTask(BuildRefIterator begin, BuildRefIterator end) :
+        _begin(begin),
+        _end(end),
+        _batch(0)
+    { }
+    void run()
+    { _node = buildSubtree(_begin, _end); }
+
+    BuildRefIterator _begin;
+    BuildRefIterator _end;
+    SGSharedPtr<const BVHStaticNode> _node;
+    BuildBatch* _batch;
+};
+
+// The tasks of one build not yet finished
+struct BuildBatch {
+    size_t _pending;
+};
+
+// The subtree tasks of all running builds and the threads working on them.
+// The threads are started with the first large build and wait for tasks
+// until the program exits.
+class BuildPool {
+public:
+    static BuildPool& instance()
+    {
+        // Never destroyed, the threads still wait on it at exit
+        static BuildPool* pool = new BuildPool;
+        return *pool;
+    }
+
+    unsigned getNumThreads() const
+    { return _threads.size(); }
+
+    // Runs the tasks on the pool threads and on the calling thread, returns
+    // when all of them are done
+    void run(std::vector<BuildTask>& tasks)
+    {
+        BuildBatch batch = { tasks.size() };
+        {
+            SGGuard<SGMutex> scopeLock(_mutex);
+            for (size_t i = 0; i < tasks.size(); ++i) {
+                tasks[i]._batch = &batch;
+                _tasks.push_back(&tasks[i]);
+            }
+            _waitCondition.broadcast();
+        }
+        // Help with the queued tasks, then wait for those still running
+        while (BuildTask* task = pop(false))
+            finish(task);
+        SGGuard<SGMutex> scopeLock(_mutex);
+        while (batch._pending)
+            _doneCondition.wait(_mutex);
+    }
+
+private:
+    class Thread : public SGThread {
+    public:
+        Thread(BuildPool& pool) :
+            _pool(pool)
+        { }
+        virtual ~Thread()
+        { }
+    protected:
+        virtual void run()
+        {
+            for (;;)
+                _pool.finish(_pool.pop(true));
+        }
+    private:
+        BuildPool& _pool;
+    };
+
+    BuildPool()
+    {
+        unsigned numCores = std::thread::hardware_concurrency();
+        unsigned numThreads = std::min(numCores ? numCores - 1 : 0,
+                                       maxPoolThreads);
+        for (unsigned i = 0; i < numThreads; ++i) {
+            Thread* thread = new Thread(*this);
+            if (!thread->start()) {
+                delete thread;
+                break;
+            }
+            _threads.push_back(thread);
+        }
+    }
+
+    BuildTask* pop(bool wait)
+    {
+        SGGuard<SGMutex> scopeLock(_mutex);
+        while (_tasks.empty()) {
+            if (!wait)
+                return 0;
+            _waitCondition.wait(_mutex);
+        }
+        BuildTask* task = _tasks.front();
+        _tasks.pop_front();
+        return task;
+    }
+
+    void finish(BuildTask* task)
+    {
+        task->run();
+        SGGuard<SGMutex> scopeLock(_mutex);
+        if (!--task->_batch->_pending)
+            _doneCondition.broadcast();
+    }
+
+    SGMutex _mutex;
+    SGWaitCondition _waitCondition;
+    SGWaitCondition _doneCondition;
+    std::deque<BuildTask*> _tasks;
+    std::vector<Thread*> _threads;
+};
+
+class ParallelBuild {
+public:
+    ParallelBuild(std::vector<BuildRef>& refs, unsigned numThreads) :
+        _refs(refs),
+        // several tasks per thread to even out the load
+        _maxTaskLeafs(std::max<size_t>(refs.size()/(4*numThreads), 1024))
+    { }
+
+    SGSharedPtr<const BVHStaticNode> build(BuildPool& pool)
+    {
+        partition(_refs.begin(), _refs.end());
+        pool.run(_tasks);
+
+        _nextSplit = 0;
+        _nextTask = 0;
+        return assemble(_refs.begin(), _refs.end());
+    }
+
+private:
+    struct Split {
+        BuildRefIterator _split;
+        unsigned _splitAxis;
+        SGBoxf _box;
+    };
+
+    // First pass: split the top levels, queueing the subtrees
+    void partition(BuildRefIterator begin, BuildRefIterator end)
+    {
+        if (size_t(end - begin) <= _maxTaskLeafs) {
+            _tasks.push_back(BuildTask(begin, end));
+            return;
+        }
+        Split split;
+        split._box = boundingBox(begin, end);
+        split._split = splitLeafs(begin, end, split._splitAxis);
+        _splits.push_back(split);
+        partition(begin, split._split);
+        partition(split._split, end);
+    }
+
+    // Last pass: the top level nodes, in the order of the first pass
+    const BVHStaticNode* assemble(BuildRefIterator begin, BuildRefIterator end)
+    {
+        if (size_t(end - begin) <= _maxTaskLeafs)
+            return _tasks[_nextTask++]._node;
+
+        const Split& split = _splits[_nextSplit++];
+        const BVHStaticNode* child0 = assemble(begin, split._split);
+        const BVHStaticNode* child1 = assemble(split._split, end);
+        if (!child0)
+            return child1;
+        if (!child1)
+            return child0;
+        return new BVHStaticBinary(split._splitAxis, child0, child1,
+                                   split._box);
+    }
+
+    std::vector<BuildRef>& _refs;
+    size_t _maxTaskLeafs;
+
+    std::vector<Split> _splits;
+    std::vector<BuildTask> _tasks;
+    size_t _nextSplit;
+    size_t _nextTask;
+};
+
+} // anonymous namespace
+
+SGSharedPtr<const BVHStaticNode>
+BVHStaticGeometryBuilder::buildTreeSAH(const LeafRefList& leafs)
+{
+    std::vector<BuildRef> refs;
+    for (LeafRefList::const_iterator i = leafs.begin(); i != leafs.end(); ++i) {
+        BuildRef ref = { i->_box, i->_center, i->_leaf.get() };
+        refs.push_back(ref);
+    }
+
+    if (refs.size() < minParallelLeafs)
+        return buildSubtree(refs.begin(), refs.end());
+    BuildPool& pool = BuildPool::instance();
+    if (!pool.getNumThreads())
+        return buildSubtree(refs.begin(), refs.end());
+
+    // the calling thread works on the tasks as well
+    ParallelBuild build(refs, pool.getNumThreads() + 1);
+    return build.build(pool);
+}
+
+}
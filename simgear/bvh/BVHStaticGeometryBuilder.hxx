@@ -19,6 +19,7 @@
 #define BVHStaticGeometryBuilder_hxx
 
 #include <algorithm>
+#include <list>
 #include <map>
 #include <set>
 
@@ -124,16 +125,37 @@ public:
         return index;
     }
 
-    BVHStaticGeometry* buildTree()
+    enum SplitMethod {
+        // Split at the center of the broadest axis of the bounding box
+        CenterSplit,
+        // Split at the plane with the least surface area heuristic cost,
+        // building large trees on several threads
+        SAHSplit
+    };
+
+    // If flatten is given, the line segment and nearest point queries
+    // walk a compact copy of the tree, see BVHStaticFlatTree.  The copy
+    // is kept in addition to the node tree.
+    BVHStaticGeometry* buildTree(SplitMethod splitMethod = SAHSplit,
+                                 bool flatten = false)
     {
-        const BVHStaticNode* tree = buildTreeRecursive(_leafRefList);
+        SGSharedPtr<const BVHStaticNode> tree;
+        if (splitMethod == CenterSplit)
+            tree = buildTreeRecursive(_leafRefList);
+        else {
+            tree = buildTreeSAH(_leafRefList);
+            _leafRefList.clear();
+        }
         if (!tree)
             return 0;
         _staticData->trim();
-        return new BVHStaticGeometry(tree, _staticData);
+        return new BVHStaticGeometry(tree.get(), _staticData, flatten);
     }
 
 private:
+    static SGSharedPtr<const BVHStaticNode>
+    buildTreeSAH(const LeafRefList& leafs);
+
     static void
     centerSplitLeafs(unsigned splitAxis, const double& splitValue,
                      LeafRefList& leafs, LeafRefList split[2])
@@ -16,12 +16,22 @@
 //
 
 #include <simgear_config.h>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <vector>
+#include <simgear/math/sg_random.h>
 #include <simgear/structure/SGSharedPtr.hxx>
+#include <simgear/threads/SGGuard.hxx>
+#include <simgear/threads/SGThread.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "BVHNode.hxx"
 #include "BVHGroup.hxx"
 #include "BVHTransform.hxx"
+#include "BVHPageNode.hxx"
+#include "BVHPageRequest.hxx"
+#include "BVHPager.hxx"
 
 #include "BVHStaticData.hxx"
 
@@ -30,6 +40,8 @@
 #include "BVHStaticTriangle.hxx"
 #include "BVHStaticBinary.hxx"
 #include "BVHStaticGeometry.hxx"
+#include "BVHStaticGeometryBuilder.hxx"
+#include "BVHStaticFlatTree.hxx"
 
 #include "BVHBoundingBoxVisitor.hxx"
 #include "BVHSubTreeCollector.hxx"
@@ -132,12 +144,461 @@ testNearestPoint()
     return true;
 }
 
+// A line segment visitor counting the static nodes it visits
+class CountingLineSegmentVisitor : public BVHLineSegmentVisitor {
+public:
+    CountingLineSegmentVisitor(const SGLineSegmentd& lineSegment) :
+        BVHLineSegmentVisitor(lineSegment),
+        _numNodes(0)
+    { }
+    virtual void apply(const BVHStaticBinary& node, const BVHStaticData& data)
+    {
+        ++_numNodes;
+        BVHLineSegmentVisitor::apply(node, data);
+    }
+    virtual void apply(const BVHStaticTriangle& node, const BVHStaticData& data)
+    {
+        ++_numNodes;
+        BVHLineSegmentVisitor::apply(node, data);
+    }
+    unsigned _numNodes;
+};
+
+// Terrain like triangle mesh: a height field of n x n cells of 100m, with
+// random hills and a denser (smaller triangles) patch as from an airport
+BVHStaticGeometryBuilder*
+buildTerrain(unsigned n)
+{
+    BVHStaticGeometryBuilder* builder = new BVHStaticGeometryBuilder;
+    std::vector<float> heights((n + 1)*(n + 1));
+    for (unsigned i = 0; i <= n; ++i)
+        for (unsigned j = 0; j <= n; ++j)
+            heights[i*(n + 1) + j] = 300*sin(0.05*i)*cos(0.07*j)
+                + 20*sg_random();
+    for (unsigned i = 0; i < n; ++i) {
+        for (unsigned j = 0; j < n; ++j) {
+            SGVec3f v00(100*i, 100*j, heights[i*(n + 1) + j]);
+            SGVec3f v10(100*(i + 1), 100*j, heights[(i + 1)*(n + 1) + j]);
+            SGVec3f v01(100*i, 100*(j + 1), heights[i*(n + 1) + j + 1]);
+            SGVec3f v11(100*(i + 1), 100*(j + 1),
+                        heights[(i + 1)*(n + 1) + j + 1]);
+            if (i < n/8 && j < n/8) {
+                // airport: flat, with 10x10 smaller quads per cell
+                for (unsigned k = 0; k < 10; ++k) {
+                    for (unsigned l = 0; l < 10; ++l) {
+                        SGVec3f w(100*i + 10*k, 100*j + 10*l, 0);
+                        builder->addTriangle(w, w + SGVec3f(10, 0, 0),
+                                             w + SGVec3f(0, 10, 0));
+                        builder->addTriangle(w + SGVec3f(10, 0, 0),
+                                             w + SGVec3f(10, 10, 0),
+                                             w + SGVec3f(0, 10, 0));
+                    }
+                }
+                continue;
+            }
+            builder->addTriangle(v00, v10, v01);
+            builder->addTriangle(v10, v11, v01);
+        }
+    }
+    return builder;
+}
+
+// Compares the trees of the two split methods: the average number of
+// nodes visited by vertical ground probes and by slanted segments, as from
+// gear contacts and the line of sight, and with bench the build and query
+// times
+bool
+testTreeQuality(unsigned n, bool bench)
+{
+    SGSharedPtr<BVHNode> trees[2];
+    const char* names[2] = { "center split", "SAH split" };
+    BVHStaticGeometryBuilder::SplitMethod methods[2] = {
+        BVHStaticGeometryBuilder::CenterSplit,
+        BVHStaticGeometryBuilder::SAHSplit
+    };
+    double buildMs[2];
+    for (unsigned k = 0; k < 2; ++k) {
+        sg_srandom(5);
+        SGSharedPtr<BVHStaticGeometryBuilder> builder = buildTerrain(n);
+        SGTimeStamp start = SGTimeStamp::now();
+        trees[k] = builder->buildTree(methods[k]);
+        buildMs[k] = (SGTimeStamp::now() - start).toMSecs();
+    }
+
+    const unsigned numQueries = bench ? 20000 : 2000;
+    std::vector<SGLineSegmentd> segments;
+    for (unsigned i = 0; i < numQueries; ++i) {
+        SGVec3d p(100*n*sg_random(), 100*n*sg_random(), 0);
+        if (i % 2)
+            segments.push_back(SGLineSegmentd(p + SGVec3d(0, 0, 1000),
+                                              p - SGVec3d(0, 0, 1000)));
+        else
+            segments.push_back(SGLineSegmentd(p + SGVec3d(0, 0, 500),
+                                              p + SGVec3d(300, 200, -500)));
+    }
+
+    double avgNodes[2];
+    for (unsigned k = 0; k < 2; ++k) {
+        unsigned long numNodes = 0;
+        SGTimeStamp start = SGTimeStamp::now();
+        for (unsigned i = 0; i < numQueries; ++i) {
+            CountingLineSegmentVisitor visitor(segments[i]);
+            trees[k]->accept(visitor);
+            numNodes += visitor._numNodes;
+        }
+        double queryMs = (SGTimeStamp::now() - start).toMSecs();
+        avgNodes[k] = double(numNodes)/numQueries;
+        if (bench)
+            std::cout << n << "x" << n << " terrain, " << names[k]
+                      << ": build " << buildMs[k] << "ms, " << avgNodes[k]
+                      << " nodes visited per query, "
+                      << 1e3*queryMs/numQueries << "us per query"
+                      << std::endl;
+    }
+
+    // Same hits with both trees, up to the float precision of the vertices
+    // when hitting an edge shared by two triangles
+    for (unsigned i = 0; i < numQueries; ++i) {
+        BVHLineSegmentVisitor visitor0(segments[i]);
+        trees[0]->accept(visitor0);
+        BVHLineSegmentVisitor visitor1(segments[i]);
+        trees[1]->accept(visitor1);
+        if (visitor0.empty() != visitor1.empty())
+            return false;
+        if (!visitor0.empty() &&
+            1e-2 < dist(visitor0.getPoint(), visitor1.getPoint()))
+            return false;
+    }
+
+    // Fewer nodes visited in the SAH tree, on terrain large enough to tell
+    return !bench || avgNodes[1] < avgNodes[0];
+}
+
+// Compares the queries on the flat copy of a static tree with those
+// through the visitor calls on the static nodes
+bool
+testFlatTree(unsigned n, bool bench)
+{
+    sg_srandom(7);
+    SGSharedPtr<BVHStaticGeometryBuilder> builder = buildTerrain(n);
+    SGSharedPtr<BVHStaticGeometry> tree;
+    tree = builder->buildTree(BVHStaticGeometryBuilder::SAHSplit, true);
+    if (!tree->getFlatTree())
+        return false;
+    SGSharedPtr<BVHStaticGeometry> nodeTree;
+    nodeTree = new BVHStaticGeometry(tree->getStaticNode(),
+                                     tree->getStaticData());
+
+    const unsigned numQueries = bench ? 20000 : 2000;
+    std::vector<SGLineSegmentd> segments;
+    std::vector<SGSphered> spheres;
+    for (unsigned i = 0; i < numQueries; ++i) {
+        SGVec3d p(100*n*sg_random(), 100*n*sg_random(), 0);
+        segments.push_back(SGLineSegmentd(p + SGVec3d(0, 0, 1000),
+                                          p - SGVec3d(0, 0, 1000)));
+        spheres.push_back(SGSphered(p + SGVec3d(0, 0, 300*sg_random()), 200));
+    }
+
+    // The same hits, up to the order triangles sharing an edge are tested
+    for (unsigned i = 0; i < numQueries; ++i) {
+        BVHLineSegmentVisitor visitor0(segments[i]);
+        nodeTree->accept(visitor0);
+        BVHLineSegmentVisitor visitor1(segments[i]);
+        tree->accept(visitor1);
+        if (visitor0.empty() != visitor1.empty())
+            return false;
+        if (!visitor0.empty() &&
+            1e-2 < dist(visitor0.getPoint(), visitor1.getPoint()))
+            return false;
+
+        BVHNearestPointVisitor nearest0(spheres[i], 0);
+        nodeTree->accept(nearest0);
+        BVHNearestPointVisitor nearest1(spheres[i], 0);
+        tree->accept(nearest1);
+        if (nearest0.empty() != nearest1.empty())
+            return false;
+        if (!nearest0.empty() &&
+            1e-2 < dist(nearest0.getPoint(), nearest1.getPoint()))
+            return false;
+
+        // Subclasses see the static nodes, with or without the flat tree
+        CountingLineSegmentVisitor counting0(segments[i]);
+        nodeTree->accept(counting0);
+        CountingLineSegmentVisitor counting1(segments[i]);
+        tree->accept(counting1);
+        if (!counting1._numNodes || counting0._numNodes != counting1._numNodes)
+            return false;
+    }
+
+    // The triangles within a sphere, against all triangles
+    const BVHStaticFlatTree* flatTree = tree->getFlatTree();
+    for (unsigned i = 0; i < 10; ++i) {
+        std::vector<unsigned> triangles;
+        flatTree->sphereIntersection(spheres[i], triangles);
+        unsigned count = 0;
+        for (unsigned j = 0; j < flatTree->getNumTriangles(); ++j)
+            count += intersects(flatTree->getTriangle(j), spheres[i]);
+        if (triangles.size() != count)
+            return false;
+    }
+
+    if (!bench)
+        return true;
+
+    double lineMs[2], nearestMs[2];
+    BVHNode* trees[2] = { nodeTree, tree };
+    for (unsigned k = 0; k < 2; ++k) {
+        SGTimeStamp start = SGTimeStamp::now();
+        for (unsigned i = 0; i < numQueries; ++i) {
+            BVHLineSegmentVisitor visitor(segments[i]);
+            trees[k]->accept(visitor);
+        }
+        lineMs[k] = (SGTimeStamp::now() - start).toMSecs();
+        start = SGTimeStamp::now();
+        for (unsigned i = 0; i < numQueries; ++i) {
+            BVHNearestPointVisitor visitor(spheres[i], 0);
+            trees[k]->accept(visitor);
+        }
+        nearestMs[k] = (SGTimeStamp::now() - start).toMSecs();
+    }
+    std::cout << "line segment query: nodes " << 1e3*lineMs[0]/numQueries
+              << "us, flat " << 1e3*lineMs[1]/numQueries << "us" << std::endl;
+    std::cout << "nearest point query: nodes "
+              << 1e3*nearestMs[0]/numQueries << "us, flat "
+              << 1e3*nearestMs[1]/numQueries << "us" << std::endl;
+
+    return true;
+}
+
+// Compares the packet line segment queries with single segment queries,
+// for groups of four segments as from the gear of an aircraft and for
+// unrelated segments
+bool
+testPacketQueries(unsigned n, bool bench)
+{
+    sg_srandom(11);
+    SGSharedPtr<BVHStaticGeometryBuilder> builder = buildTerrain(n);
+    SGSharedPtr<BVHStaticGeometry> tree;
+    tree = builder->buildTree(BVHStaticGeometryBuilder::SAHSplit, true);
+    const BVHStaticFlatTree* flatTree = tree->getFlatTree();
+
+    const unsigned numQueries = bench ? 40000 : 4000;
+    for (unsigned coherent = 0; coherent < 2; ++coherent) {
+        std::vector<SGLineSegmentd> segments;
+        for (unsigned i = 0; i < numQueries; i += 4) {
+            SGVec3d p(100*n*sg_random(), 100*n*sg_random(), 0);
+            for (unsigned k = 0; k < 4; ++k) {
+                if (coherent)
+                    p += SGVec3d(10*sg_random() - 5, 10*sg_random() - 5, 0);
+                else
+                    p = SGVec3d(100*n*sg_random(), 100*n*sg_random(), 0);
+                segments.push_back(SGLineSegmentd(p + SGVec3d(0, 0, 1000),
+                                                  p - SGVec3d(0, 0, 1000)));
+            }
+        }
+
+        std::vector<SGLineSegmentd> single(segments);
+        std::vector<unsigned> singleTriangles(numQueries, ~0u);
+        SGTimeStamp start = SGTimeStamp::now();
+        for (unsigned i = 0; i < numQueries; ++i)
+            flatTree->lineSegmentIntersection(single[i], singleTriangles[i]);
+        double singleMs = (SGTimeStamp::now() - start).toMSecs();
+
+        std::vector<SGLineSegmentd> packet(segments);
+        std::vector<unsigned> packetTriangles(numQueries);
+        start = SGTimeStamp::now();
+        flatTree->lineSegmentIntersections(&packet.front(),
+                                           &packetTriangles.front(),
+                                           numQueries);
+        double packetMs = (SGTimeStamp::now() - start).toMSecs();
+
+        // Same hits, up to the order triangles sharing an edge are tested
+        for (unsigned i = 0; i < numQueries; ++i) {
+            if ((singleTriangles[i] == ~0u) != (packetTriangles[i] == ~0u))
+                return false;
+            if (1e-2 < dist(single[i].getEnd(), packet[i].getEnd()))
+                return false;
+        }
+
+        // A packet with less than four segments
+        SGLineSegmentd rest[3] = { segments[0], segments[1], segments[2] };
+        unsigned restTriangles[3];
+        flatTree->lineSegmentIntersections(rest, restTriangles, 3);
+        for (unsigned i = 0; i < 3; ++i)
+            if (restTriangles[i] != packetTriangles[i])
+                return false;
+
+        if (bench)
+            std::cout << (coherent ? "gear like" : "unrelated")
+                      << " line segments: single "
+                      << 1e-3*numQueries/singleMs << " Msegments/s, packets "
+                      << 1e-3*numQueries/packetMs << " Msegments/s"
+                      << std::endl;
+    }
+    return true;
+}
+
+// Page nodes whose requests record the order they are loaded in, the
+// first load waits until the gate is opened
+class TestPageNode : public BVHPageNode {
+public:
+    struct Loads {
+        Loads() : _open(false) { }
+        SGMutex _mutex;
+        SGWaitCondition _waitCondition;
+        bool _open;
+        std::vector<unsigned> _order;
+    };
+
+    TestPageNode(unsigned id, const SGVec3d& center, Loads& loads) :
+        _id(id),
+        _center(center),
+        _loads(loads),
+        _numInserted(0)
+    { }
+    virtual SGSphered computeBoundingSphere() const
+    { return SGSphered(_center, 100); }
+    virtual BVHPageRequest* newRequest()
+    { return new Request(this); }
+
+    unsigned _id;
+    SGVec3d _center;
+    Loads& _loads;
+    unsigned _numInserted;
+
+protected:
+    virtual void invalidateBound()
+    { }
+
+private:
+    class Request : public BVHPageRequest {
+    public:
+        Request(TestPageNode* pageNode) : _pageNode(pageNode) { }
+        virtual void load()
+        {
+            Loads& loads = _pageNode->_loads;
+            SGGuard<SGMutex> scopeLock(loads._mutex);
+            loads._order.push_back(_pageNode->_id);
+            loads._waitCondition.broadcast();
+            while (!loads._open)
+                loads._waitCondition.wait(loads._mutex);
+        }
+        virtual void insert()
+        { ++_pageNode->_numInserted; }
+        virtual BVHPageNode* getPageNode()
+        { return _pageNode; }
+    private:
+        SGSharedPtr<TestPageNode> _pageNode;
+    };
+};
+
+bool
+testPager()
+{
+    TestPageNode::Loads loads;
+    std::vector<SGSharedPtr<TestPageNode> > nodes;
+    for (unsigned i = 0; i < 7; ++i)
+        nodes.push_back(new TestPageNode(i, SGVec3d(1000*i, 0, 0), loads));
+
+    BVHPager pager;
+    if (!pager.start(1))
+        return false;
+
+    // Wait for the pager thread to block in loading node 0 ...
+    pager.setUseStamp(1);
+    pager.use(*nodes[0]);
+    {
+        SGGuard<SGMutex> scopeLock(loads._mutex);
+        while (loads._order.empty())
+            loads._waitCondition.wait(loads._mutex);
+    }
+    // ... queue the others, the farthest first ...
+    SGVec3d position(10000, 0, 0);
+    for (unsigned i = 1; i < 7; ++i)
+        pager.use(*nodes[i], position);
+    // ... move node 1 to the front ...
+    pager.setUseStamp(3);
+    pager.use(*nodes[1], SGVec3d(1000, 50, 0));
+    for (unsigned i = 3; i < 7; ++i)
+        pager.use(*nodes[i], position);
+    if (pager.getQueueDepth() != 6)
+        return false;
+    // ... and let the nodes 0 and 2 expire
+    pager.update(1);
+    if (pager.getQueueDepth() != 5 || pager.getNumCancelled() != 1)
+        return false;
+
+    {
+        SGGuard<SGMutex> scopeLock(loads._mutex);
+        loads._open = true;
+        loads._waitCondition.broadcast();
+    }
+    SGTimeStamp start = SGTimeStamp::now();
+    while (pager.getNumInserted() < 5) {
+        if (10 < (SGTimeStamp::now() - start).toSecs())
+            return false;
+        SGTimeStamp::sleepForMSec(1);
+        pager.update(100);
+    }
+    pager.stop();
+
+    // Node 0 was loaded but expired, node 2 never loaded
+    unsigned order[6] = { 0, 1, 6, 5, 4, 3 };
+    if (loads._order != std::vector<unsigned>(order, order + 6))
+        return false;
+    if (nodes[0]->_numInserted || nodes[2]->_numInserted)
+        return false;
+    for (unsigned i = 3; i < 7; ++i)
+        if (nodes[i]->_numInserted != 1)
+            return false;
+    if (pager.getNumCancelled() != 2 || pager.getMaxQueueDepth() != 6)
+        return false;
+    if (pager.getMaxLatency() < pager.getMeanLatency() ||
+        pager.getMeanLatency() <= 0)
+        return false;
+
+    // A burst of page ins on several threads
+    nodes.clear();
+    for (unsigned i = 0; i < 100; ++i)
+        nodes.push_back(new TestPageNode(i, SGVec3d(100*i, 0, 0), loads));
+    pager.resetStatistics();
+    if (!pager.start(4))
+        return false;
+    for (unsigned i = 0; i < 100; ++i)
+        pager.use(*nodes[i], SGVec3d::zeros());
+    start = SGTimeStamp::now();
+    while (pager.getNumInserted() < 100) {
+        if (10 < (SGTimeStamp::now() - start).toSecs())
+            return false;
+        SGTimeStamp::sleepForMSec(1);
+        pager.update(100);
+    }
+    pager.stop();
+    return pager.getNumCancelled() == 0;
+}
+
 int
 main(int argc, char** argv)
 {
+    // Build and query timings on a terrain tile of 200x200 cells
+    if ((argc > 1) && !strcmp(argv[1], "--bench")) {
+        if (!testTreeQuality(200, true) || !testFlatTree(200, true) ||
+            !testPacketQueries(200, true))
+            return EXIT_FAILURE;
+        return EXIT_SUCCESS;
+    }
+
     if (!testLineIntersections())
         return EXIT_FAILURE;
     if (!testNearestPoint())
         return EXIT_FAILURE;
+    if (!testTreeQuality(64, false))
+        return EXIT_FAILURE;
+    if (!testFlatTree(64, false))
+        return EXIT_FAILURE;
+    if (!testPacketQueries(64, false))
+        return EXIT_FAILURE;
+    if (!testPager())
+        return EXIT_FAILURE;
     return EXIT_SUCCESS;
 }
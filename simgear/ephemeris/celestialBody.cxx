@@ -26,6 +26,7 @@
 #include <simgear/debug/logstream.hxx>
 
 #include <math.h>
+#include <algorithm>
 
 #include "celestialBody.hxx"
 #include "star.hxx"
@@ -52,16 +53,12 @@
  *************************************************************************/
 void CelestialBody::updatePosition(double mjd, Star *ourSun)
 {
-  double eccAnom, v, ecl, actTime, 
+  double eccAnom, v,
     xv, yv, xh, yh, zh, xg, yg, zg, xe, ye, ze,
-    cosN, sinN, cosvw, sinvw, sinvw_cosi, cosecl, sinecl;
+    cosvw, sinvw, sinvw_cosi;
 
   updateOrbElements(mjd);
-  actTime = sgCalcActTime(mjd);
 
-  // calcualate the angle bewteen ecliptic and equatorial coordinate system
-  ecl = SGD_DEGREES_TO_RADIANS * (23.4393 - 3.563E-7 *actTime);
-  
   eccAnom = sgCalcEccAnom(M, e);  //calculate the eccentric anomaly
   xv = a * (cos(eccAnom) - e);
   yv = a * (sqrt (1.0 - e*e) * sin(eccAnom));
@@ -69,18 +66,14 @@ void CelestialBody::updatePosition(double mjd, Star *ourSun)
   r = sqrt (xv*xv + yv*yv);    // the planet's distance
   
   // repetitive calculations, minimised for speed
-  cosN = cos(N);
-  sinN = sin(N);
   cosvw = cos(v+w);
   sinvw = sin(v+w);
-  sinvw_cosi = sinvw * cos(i);
-  cosecl = cos(ecl);
-  sinecl = sin(ecl);
+  sinvw_cosi = sinvw * cosi;
 
   // calculate the planet's position in 3D space
   xh = r * (cosN * cosvw - sinN * sinvw_cosi);
   yh = r * (sinN * cosvw + cosN * sinvw_cosi);
-  zh = r * (sinvw * sin(i));
+  zh = r * (sinvw * sini);
 
   // calculate the ecliptic longitude and latitude
   xg = xh + ourSun->getxs();
@@ -198,6 +191,8 @@ CelestialBody::CelestialBody(double Nf, double Ns,
   aFirst = af;     aSec = as;
   eFirst = ef;     eSec = es;
   MFirst = Mf;     MSec = Ms;
+  elementsMjd = -HUGE_VAL;
+  elementsInterval = 0.0;
   updateOrbElements(mjd);
 }
 
@@ -214,12 +209,16 @@ CelestialBody::CelestialBody(double Nf, double Ns,
   aFirst = af;     aSec = as;
   eFirst = ef;     eSec = es;
   MFirst = Mf;     MSec = Ms;
+  elementsMjd = -HUGE_VAL;
+  elementsInterval = 0.0;
 }
 
 /****************************************************************************
  * inline void CelestialBody::updateOrbElements(double mjd)
  * given the current time, this private member calculates the actual 
- * orbital elements
+ * orbital elements. The mean anomaly is always updated, the other
+ * elements, the obliquity of the ecliptic and the sines and cosines of
+ * these only once the date moved past the interval set by setTolerance().
  *
  * Arguments: double mjd: the current modified julian date:
  *
@@ -229,11 +228,45 @@ void CelestialBody::updateOrbElements(double mjd)
 {
   double actTime = sgCalcActTime(mjd);
    M = SGD_DEGREES_TO_RADIANS * (MFirst + (MSec * actTime));
+   if (fabs(mjd - elementsMjd) <= elementsInterval)
+     return;
+   elementsMjd = mjd;
    w = SGD_DEGREES_TO_RADIANS * (wFirst + (wSec * actTime));
    N = SGD_DEGREES_TO_RADIANS * (NFirst + (NSec * actTime));
    i = SGD_DEGREES_TO_RADIANS * (iFirst + (iSec * actTime));
    e = eFirst + (eSec * actTime);
    a = aFirst + (aSec * actTime);
+   ecl = SGD_DEGREES_TO_RADIANS * (23.4393 - 3.563E-7 * actTime);
+   cosN = cos(N);
+   sinN = sin(N);
+   cosi = cos(i);
+   sini = sin(i);
+   cosecl = cos(ecl);
+   sinecl = sin(ecl);
+}
+
+/****************************************************************************
+ * void CelestialBody::setTolerance(double tolerance)
+ * sets the interval for which the slowly changing orbital elements are
+ * reused, such that they change by at most tolerance degrees in it. The
+ * changes of the eccentricity and semimajor axis are converted to the
+ * angles they displace the body by.
+ *
+ * Arguments: double tolerance: the tolerance in degrees
+ *
+ * return value: none
+ ***************************************************************************/
+void CelestialBody::setTolerance(double tolerance)
+{
+  double rate = 3.563E-7; // the obliquity of the ecliptic
+  rate = std::max(rate, fabs(NSec));
+  rate = std::max(rate, fabs(iSec));
+  rate = std::max(rate, fabs(wSec));
+  rate = std::max(rate, 2 * SGD_RADIANS_TO_DEGREES * fabs(eSec));
+  rate = std::max(rate, SGD_RADIANS_TO_DEGREES * fabs(aSec / aFirst));
+  elementsInterval = tolerance / rate;
+  // force the next update to recompute them
+  elementsMjd = -HUGE_VAL;
 }
 
 /*****************************************************************************
@@ -53,6 +53,15 @@ protected:              // make the data protected, in order to give the
   double MSec;		/* Mean anomaly second part */
 
   double N, i, w, a, e, M; /* the resulting orbital elements, obtained from the former */
+  double ecl;		/* angle between the ecliptic and the equator */
+
+  /* All but the mean anomaly change by far less than a degree per day,
+     so these are only recomputed when the date moved more than
+     elementsInterval days from elementsMjd, along with their sines and
+     cosines. */
+  double elementsMjd;
+  double elementsInterval;
+  double cosN, sinN, cosi, sini, cosecl, sinecl;
 
   double rightAscension, declination;
   double r, R, s, FV;
@@ -84,6 +93,11 @@ public:
   double getLon() const;
   double getLat() const; 
   void updatePosition(double mjd, Star *ourSun);
+
+  /* Let the slowly changing orbital elements lag behind by up to
+     tolerance degrees, zero (the default) recomputes them on every
+     update */
+  void setTolerance(double tolerance);
 };
 
 inline double CelestialBody::getRightAscension() { return rightAscension; }
@@ -88,3 +88,15 @@ void SGEphemeris::update( double mjd, double lst, double lat ) {
     neptune->getPos( &planets[6][0], &planets[6][1], &planets[6][2] );
 }
 
+
+void SGEphemeris::setTolerance( double tolerance ) {
+    our_sun->setTolerance( tolerance );
+    moon->setTolerance( tolerance );
+    mercury->setTolerance( tolerance );
+    venus->setTolerance( tolerance );
+    mars->setTolerance( tolerance );
+    jupiter->setTolerance( tolerance );
+    saturn->setTolerance( tolerance );
+    uranus->setTolerance( tolerance );
+    neptune->setTolerance( tolerance );
+}
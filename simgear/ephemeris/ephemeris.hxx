@@ -114,6 +114,18 @@ public:
      */
     void update(double mjd, double lst, double lat);
 
+    /**
+     * Let update() reuse the slowly changing orbital elements of the sun,
+     * moon and planets, as long as they change by less than the given
+     * tolerance. The mean anomalies are still computed on every update,
+     * so the positions are off by about that tolerance at most. Each body
+     * reuses its elements for its own interval, from some ten minutes for
+     * the moon to years for the outer planets at a tolerance of 0.001
+     * degrees. The default, zero, recomputes everything on each update.
+     * @param tolerance tolerance in degrees
+     */
+    void setTolerance(double tolerance);
+
     /**
      * @return a pointer to a Star class containing all the positional
      * information for Earth's Sun.
@@ -172,6 +184,9 @@ public:
      */
     inline SGVec3d *getStars() { return stars->getStars(); }
     inline const SGVec3d *getStars() const { return stars->getStars(); }
+
+    /** @return the star database, with the stars packed for SIMD */
+    inline const SGStarData *getStarData() const { return stars; }
 };
 
 
@@ -78,22 +78,17 @@ MoonPos::~MoonPos()
 void MoonPos::updatePosition(double mjd, double lst, double lat, Star *ourSun)
 {
   double 
-    eccAnom, ecl, actTime,
+    eccAnom,
     xv, yv, v, r, xh, yh, zh, zg, xe,
     Ls, Lm, D, F, mpar, gclat, rho, HA, g,
     geoRa, geoDec,
-    cosN, sinN, cosvw, sinvw, sinvw_cosi, cosecl, sinecl, rcoslatEcl,
+    cosvw, sinvw, sinvw_cosi, rcoslatEcl,
     FlesstwoD, MlesstwoD, twoD, twoM, twolat, alpha;
   
   double max_loglux = -0.504030345621;
   double min_loglux = -4.39964634562;
   double conv = 1.0319696543787917;    // The log foot-candle to log lux conversion factor.
   updateOrbElements(mjd);
-  actTime = sgCalcActTime(mjd);
-
-  // calculate the angle between ecliptic and equatorial coordinate system
-  // in Radians
-  ecl = SGD_DEGREES_TO_RADIANS * (23.4393 - 3.563E-7 * actTime);
   eccAnom = sgCalcEccAnom(M, e);  // Calculate the eccentric anomaly
   xv = a * (cos(eccAnom) - e);
   yv = a * (sqrt(1.0 - e*e) * sin(eccAnom));
@@ -101,18 +96,14 @@ void MoonPos::updatePosition(double mjd, double lst, double lat, Star *ourSun)
   r = sqrt (xv*xv + yv*yv);       // and its distance
   
   // repetitive calculations, minimised for speed
-  cosN = cos(N);
-  sinN = sin(N);
   cosvw = cos(v+w);
   sinvw = sin(v+w);
-  sinvw_cosi = sinvw * cos(i);
-  cosecl = cos(ecl);
-  sinecl = sin(ecl);
+  sinvw_cosi = sinvw * cosi;
 
   // estimate the geocentric rectangular coordinates here
   xh = r * (cosN * cosvw - sinN * sinvw_cosi);
   yh = r * (sinN * cosvw + cosN * sinvw_cosi);
-  zh = r * (sinvw * sin(i));
+  zh = r * (sinvw * sini);
 
   // calculate the ecliptic latitude and longitude here
   lonEcl = atan2 (yh, xh);
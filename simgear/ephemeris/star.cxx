@@ -74,14 +74,12 @@ Star::~Star()
 void Star::updatePosition(double mjd)
 {
   double 
-    actTime, eccAnom, 
+    eccAnom, 
     xv, yv, v, r,
-    xe, ecl;
+    xe;
 
   updateOrbElements(mjd);
   
-  actTime = sgCalcActTime(mjd);
-  ecl = SGD_DEGREES_TO_RADIANS * (23.4393 - 3.563E-7 * actTime); // Angle in Radians
   eccAnom = sgCalcEccAnom(M, e);  // Calculate the eccentric Anomaly (also known as solving Kepler's equation)
   
   xv = cos(eccAnom) - e;
@@ -101,8 +99,8 @@ void Star::updatePosition(double mjd)
   // geocentric coordinates
 
   xe = xs;
-  ye = ys * cos (ecl);
-  ze = ys * sin (ecl);
+  ye = ys * cosecl;
+  ze = ys * sinecl;
 
   // And finally, calculate right ascension and declination
   rightAscension = atan2 (ye, xe);
@@ -24,6 +24,8 @@
 #  include <simgear_config.h>
 #endif
 
+#include <cstring>
+
 #include <simgear/debug/logstream.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/io/iostreams/sgstream.hxx>
@@ -37,7 +39,8 @@
 using std::string;
 
 // Constructor
-SGStarData::SGStarData( const SGPath& path )
+SGStarData::SGStarData( const SGPath& path ) :
+    _numPacked(0)
 {
     load(path);
 }
@@ -51,6 +54,7 @@ SGStarData::~SGStarData() {
 bool SGStarData::load( const SGPath& path ) {
 
     _stars.clear();
+    pack();
 
     // build the full path name to the stars data base file
     SGPath tmp = path;
@@ -112,6 +116,48 @@ bool SGStarData::load( const SGPath& path ) {
     }
 
     SG_LOG( SG_ASTRO, SG_INFO, "  Loaded " << _stars.size() << " stars" );
+    pack();
 
     return true;
 }
+
+
+void SGStarData::pack() {
+    _numPacked = (getNumStars() + 3) & ~3;
+    _packed.assign(4 * _numPacked, 0.0f);
+
+    float *x = &_packed[0];
+    float *y = x + _numPacked;
+    float *z = y + _numPacked;
+    float *mag = z + _numPacked;
+    for ( int i = 0; i < getNumStars(); ++i ) {
+        double ra = _stars[i][0], dec = _stars[i][1];
+        x[i] = cos( ra ) * cos( dec );
+        y[i] = sin( ra ) * cos( dec );
+        z[i] = sin( dec );
+        mag[i] = _stars[i][2];
+    }
+}
+
+
+void SGStarData::transform( const SGMatrixf& rotation,
+                            float *x, float *y, float *z ) const {
+    typedef simd4_t<float,4> float4;
+    float4 m[3][3];
+    for ( int i = 0; i < 3; ++i )
+        for ( int j = 0; j < 3; ++j )
+            m[i][j] = float4( rotation(i, j) );
+
+    const float *px = getPackedX();
+    const float *py = getPackedY();
+    const float *pz = getPackedZ();
+    for ( int k = 0; k < _numPacked; k += 4 ) {
+        float4 vx( px + k ), vy( py + k ), vz( pz + k );
+        float4 tx = m[0][0]*vx + m[0][1]*vy + m[0][2]*vz;
+        float4 ty = m[1][0]*vx + m[1][1]*vy + m[1][2]*vz;
+        float4 tz = m[2][0]*vx + m[2][1]*vy + m[2][2]*vz;
+        memcpy( x + k, tx.ptr(), sizeof(tx.ptr()) );
+        memcpy( y + k, ty.ptr(), sizeof(ty.ptr()) );
+        memcpy( z + k, tz.ptr(), sizeof(tz.ptr()) );
+    }
+}
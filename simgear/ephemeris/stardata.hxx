@@ -44,8 +44,29 @@ public:
     inline int getNumStars() const { return static_cast<int>(_stars.size()); }
     inline SGVec3d *getStars() { return &(_stars[0]); }
 
+    // The stars packed as structure of arrays for SIMD processing: the
+    // unit vectors towards the stars in the equatorial frame and the
+    // magnitudes, each array with getNumPackedStars() entries, a multiple
+    // of four, padded with zeros.
+    inline int getNumPackedStars() const { return _numPacked; }
+    inline const float *getPackedX() const { return getPacked(0); }
+    inline const float *getPackedY() const { return getPacked(1); }
+    inline const float *getPackedZ() const { return getPacked(2); }
+    inline const float *getPackedMagnitudes() const { return getPacked(3); }
+
+    // rotate the unit vectors of all stars, as into the horizontal frame
+    // of an observer, writing getNumPackedStars() entries to x, y and z
+    void transform( const SGMatrixf& rotation,
+                    float *x, float *y, float *z ) const;
+
 private:
+    void pack();
+    inline const float *getPacked(int i) const
+    { return _packed.empty() ? 0 : &_packed[i * _numPacked]; }
+
     std::vector<SGVec3d> _stars;
+    std::vector<float> _packed;
+    int _numPacked;
 };
 
 
@@ -0,0 +1,177 @@
+/**************************************************************************
+ * test_ephemeris.cxx -- unit-tests for SGEphemeris
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************/
+
+#include <simgear/compiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <simgear/ephemeris/ephemeris.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::endl;
+
+static SGVec3d direction(double ra, double dec)
+{
+    return SGVec3d(cos(ra)*cos(dec), sin(ra)*cos(dec), sin(dec));
+}
+
+// the angle between two positions in degrees
+static double separation(double ra0, double dec0, double ra1, double dec1)
+{
+    SGVec3d d = direction(ra0, dec0) - direction(ra1, dec1);
+    return SGMiscd::rad2deg(2*asin(SGMiscd::min(1.0, 0.5*norm(d))));
+}
+
+static double maxSeparation(const SGEphemeris& exact,
+                            const SGEphemeris& cached)
+{
+    double sep = separation(exact.getSunRightAscension(),
+                            exact.getSunDeclination(),
+                            cached.getSunRightAscension(),
+                            cached.getSunDeclination());
+    sep = SGMiscd::max(sep, separation(exact.getMoonRightAscension(),
+                                       exact.getMoonDeclination(),
+                                       cached.getMoonRightAscension(),
+                                       cached.getMoonDeclination()));
+    for (int i = 0; i < exact.getNumPlanets(); ++i) {
+        const SGVec3d& p0 = exact.getPlanets()[i];
+        const SGVec3d& p1 = cached.getPlanets()[i];
+        sep = SGMiscd::max(sep, separation(p0[0], p0[1], p1[0], p1[1]));
+        SG_CHECK_EQUAL_EP2(p0[2], p1[2], 0.01);
+    }
+    return sep;
+}
+
+void testIncremental(const SGPath& dir)
+{
+    SGEphemeris exact(dir.utf8Str());
+    SGEphemeris cached(dir.utf8Str());
+    const double tolerance = 0.001;
+    cached.setTolerance(tolerance);
+
+    // three days at ten seconds per update, from Oct 18, 2026
+    const double mjd0 = 36523.5 + 9787;
+    const int n = 3*24*360;
+    double maxSep = 0;
+    for (int i = 0; i < n; ++i) {
+        double mjd = mjd0 + i*10/86400.0;
+        double lst = fmod(6 + i*10/3600.0, 24);
+        exact.update(mjd, lst, 0.8);
+        cached.update(mjd, lst, 0.8);
+        maxSep = SGMiscd::max(maxSep, maxSeparation(exact, cached));
+    }
+    SG_CHECK_LT(maxSep, 2*tolerance);
+
+    // jumping back in time recomputes the elements as well
+    exact.update(mjd0 - 400, 3, 0.8);
+    cached.update(mjd0 - 400, 3, 0.8);
+    SG_CHECK_LT(maxSeparation(exact, cached), 2*tolerance);
+}
+
+void benchmark(const SGPath& dir)
+{
+    SGEphemeris exact(dir.utf8Str());
+    SGEphemeris cached(dir.utf8Str());
+    cached.setTolerance(0.001);
+
+    // three days at ten seconds per update
+    const double mjd0 = 36523.5 + 9787;
+    const int n = 3*24*360;
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < n; ++i)
+        exact.update(mjd0 + i*10/86400.0, 6, 0.8);
+    double exactUs = (SGTimeStamp::now() - start).toUSecs();
+    start = SGTimeStamp::now();
+    for (int i = 0; i < n; ++i)
+        cached.update(mjd0 + i*10/86400.0, 6, 0.8);
+    double cachedUs = (SGTimeStamp::now() - start).toUSecs();
+    cout << "per update: exact " << exactUs / n << "us, cached elements "
+         << cachedUs / n << "us" << endl;
+}
+
+void testPackedStars(const SGPath& dir)
+{
+    SGEphemeris eph(dir.utf8Str());
+    const SGStarData* stars = eph.getStarData();
+    int n = eph.getNumStars();
+    int numPacked = stars->getNumPackedStars();
+    SG_CHECK_GE(n, 7);
+    SG_CHECK_EQUAL(numPacked % 4, 0);
+    SG_CHECK_LT(numPacked - n, 4);
+
+    const SGVec3d* s = eph.getStars();
+    for (int i = 0; i < n; ++i) {
+        SGVec3d d = direction(s[i][0], s[i][1]);
+        SG_CHECK_EQUAL_EP2(stars->getPackedX()[i], d[0], 1e-6);
+        SG_CHECK_EQUAL_EP2(stars->getPackedY()[i], d[1], 1e-6);
+        SG_CHECK_EQUAL_EP2(stars->getPackedZ()[i], d[2], 1e-6);
+        SG_CHECK_EQUAL_EP2(stars->getPackedMagnitudes()[i], s[i][2], 1e-6);
+    }
+    for (int i = n; i < numPacked; ++i) {
+        SG_CHECK_EQUAL(stars->getPackedX()[i], 0.0f);
+        SG_CHECK_EQUAL(stars->getPackedMagnitudes()[i], 0.0f);
+    }
+
+    // into the horizontal frame of an observer at 48 deg north
+    SGMatrixf rotation(SGQuatf::fromLonLatDeg(30, 48));
+    std::vector<float> x(numPacked), y(numPacked), z(numPacked);
+    stars->transform(rotation, &x[0], &y[0], &z[0]);
+    for (int i = 0; i < n; ++i) {
+        SGVec3f d = toVec3f(direction(s[i][0], s[i][1]));
+        SGVec3f t = rotation.xformVec(d);
+        SG_CHECK_EQUAL_EP2(x[i], t[0], 1e-6);
+        SG_CHECK_EQUAL_EP2(y[i], t[1], 1e-6);
+        SG_CHECK_EQUAL_EP2(z[i], t[2], 1e-6);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    simgear::Dir temp = simgear::Dir::tempDir("ephemeris");
+    temp.setRemoveOnDestroy();
+    FILE* file = fopen(temp.file("stars").local8BitStr().c_str(), "w");
+    SG_VERIFY(file);
+    fputs("# name, ra, dec, magnitude\n"
+          "Sirius, 1.767791, -0.291751, -1.46\n"
+          "Canopus, 1.675306, -0.919713, -0.72\n"
+          "Arcturus, 3.733528, 0.334798, -0.04\n"
+          "Vega, 4.873565, 0.676903, 0.03\n"
+          "Capella, 1.381818, 0.802817, 0.08\n"
+          "Rigel, 1.372430, -0.143146, 0.12\n"
+          "Polaris, 0.662404, 1.557952, 1.97\n", file);
+    fclose(file);
+
+    if ((argc > 1) && !strcmp(argv[1], "--bench")) {
+        benchmark(temp.path());
+        return EXIT_SUCCESS;
+    }
+
+    testIncremental(temp.path());
+    testPackedStars(temp.path());
+
+    cout << "all tests passed OK" << endl;
+    return 0; // passed
+}
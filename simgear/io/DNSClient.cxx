@@ -24,12 +24,14 @@
 #include <simgear_config.h>
 
 #include <algorithm>
+#include <map>
 
 #include "DNSClient.hxx"
 #include <udns.h>
 #include <ctime>
 
 #include <simgear/debug/logstream.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 namespace simgear {
 
@@ -59,18 +61,130 @@ public:
             dns_close(NULL);
     }
 
+    struct CacheEntry
+    {
+        CacheEntry() : lifetime(0.0), negative(false), used(false) {}
+
+        Request_ptr result;     // last completed lookup, if any
+        Request_ptr inflight;   // lookup currently running, if any
+        std::vector<Request_ptr> waiters;
+        SGTimeStamp fetched;
+        double lifetime;        // seconds, from the TTL
+        bool negative;
+        bool used;              // served from since it was fetched
+
+        double remaining(const SGTimeStamp& now) const
+        {
+            return lifetime - (now - fetched).toSecs();
+        }
+    };
+
+    typedef std::map<std::string, CacheEntry> CacheMap;
+
+    void startLookup(Client* client, CacheEntry& entry, const Request& from)
+    {
+        Request* query = from.clone();
+        query->_timeout_secs = from._timeout_secs;
+        entry.inflight = query;
+        query->submit(client);
+    }
+
+    // udns keeps a pointer to the request until its callback ran, so it
+    // must not be released while the query is still active
+    void cancelLookup(CacheEntry& entry)
+    {
+        Request* query = entry.inflight;
+        if (query->_query && !query->isComplete()) {
+            dns_cancel(ctx, query->_query);
+            free(query->_query);
+        }
+        query->_query = NULL;
+    }
+
+    void completeLookup(CacheEntry& entry, const SGTimeStamp& now)
+    {
+        entry.result = entry.inflight;
+        entry.inflight.clear();
+        entry.fetched = now;
+        entry.negative = entry.result->isFailed();
+        if (!entry.negative) {
+            entry.lifetime = entry.result->ttl;
+        } else if (entry.result->isComplete()) {
+            entry.lifetime = negativeTTL;
+        } else {
+            // timed out: don't resend at once, but retry soon
+            entry.lifetime = std::min(negativeTTL, timeoutTTL);
+            entry.result->setComplete();
+        }
+        entry.used = false;
+
+        for (const Request_ptr& w : entry.waiters) {
+            w->copyResults(*entry.result);
+            w->setComplete();
+        }
+        entry.waiters.clear();
+    }
+
+    void updateCache(Client* client)
+    {
+        SGTimeStamp now = SGTimeStamp::now();
+        CacheMap::iterator it = cache.begin();
+        while (it != cache.end()) {
+            CacheEntry& entry = it->second;
+            if (entry.inflight) {
+                if (entry.inflight->isComplete()) {
+                    completeLookup(entry, now);
+                } else if (entry.inflight->isTimeout()) {
+                    ++stats.timeouts;
+                    cancelLookup(entry);
+                    if (entry.waiters.empty() && entry.result) {
+                        // a refresh: keep the answer until it expires
+                        entry.inflight.clear();
+                    } else {
+                        entry.inflight->setFailed();
+                        completeLookup(entry, now);
+                    }
+                }
+            } else if (entry.result) {
+                double remaining = entry.remaining(now);
+                if (remaining <= 0.0) {
+                    entry.result.clear();
+                } else if (entry.used && !entry.negative &&
+                           (remaining < entry.lifetime * 0.25)) {
+                    // refresh before expiry, so users never see a miss
+                    ++stats.prefetches;
+                    startLookup(client, entry, *entry.result);
+                }
+            }
+
+            if (!entry.result && !entry.inflight) {
+                cache.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
     struct dns_ctx * ctx;
     static size_t instanceCounter;
+
+    CacheMap cache;
+    unsigned negativeTTL = 60;
+    unsigned timeoutTTL = 5;
+    Client::CacheStats stats = Client::CacheStats();
 };
 
 size_t Client::ClientPrivate::instanceCounter = 0;
 
 Request::Request( const std::string & dn ) :
+        ttl(0),
         _dn(dn),
         _type(DNS_T_ANY),
         _complete(false),
+        _failed(false),
         _timeout_secs(5),
-        _start(0)
+        _start(0),
+        _query(NULL)
 {
 }
 
@@ -83,6 +197,19 @@ bool Request::isTimeout() const
     return (time(NULL) - _start) > _timeout_secs;
 }
 
+std::string Request::cacheKey() const
+{
+    return std::to_string(_type) + ":" + _dn;
+}
+
+void Request::copyResults( const Request& other )
+{
+    cname = other.cname;
+    qname = other.qname;
+    ttl = other.ttl;
+    _failed = other._failed;
+}
+
 NAPTRRequest::NAPTRRequest( const std::string & dn ) :
         Request(dn)
 {
@@ -103,6 +230,22 @@ SRVRequest::SRVRequest( const std::string & dn, const string & service, const st
     _type = DNS_T_SRV;
 }
 
+std::string SRVRequest::cacheKey() const
+{
+    return Request::cacheKey() + ":" + _service + ":" + _protocol;
+}
+
+Request* SRVRequest::clone() const
+{
+    return new SRVRequest(_dn, _service, _protocol);
+}
+
+void SRVRequest::copyResults( const Request& other )
+{
+    Request::copyResults(other);
+    entries = static_cast<const SRVRequest&>(other).entries;
+}
+
 static bool sortSRV( const SRVRequest::SRV_ptr a, const SRVRequest::SRV_ptr b )
 {
     if( a->priority > b->priority ) return false;
@@ -127,6 +270,8 @@ static void dnscbSRV(struct dns_ctx *ctx, struct dns_rr_srv *result, void *data)
         }
         std::sort( r->entries.begin(), r->entries.end(), sortSRV );
         free(result);
+    } else {
+        r->setFailed();
     }
     r->setComplete();
 }
@@ -134,7 +279,8 @@ static void dnscbSRV(struct dns_ctx *ctx, struct dns_rr_srv *result, void *data)
 void SRVRequest::submit( Client * client )
 {
     // if service is defined, pass service and protocol
-    if (!dns_submit_srv(client->d->ctx, getDn().c_str(), _service.empty() ? NULL : _service.c_str(), _service.empty() ? NULL : _protocol.c_str(), 0, dnscbSRV, this )) {
+    _query = dns_submit_srv(client->d->ctx, getDn().c_str(), _service.empty() ? NULL : _service.c_str(), _service.empty() ? NULL : _protocol.c_str(), 0, dnscbSRV, this );
+    if (!_query) {
         SG_LOG(SG_IO, SG_ALERT, "Can't submit dns request for " << getDn());
         return;
     }
@@ -147,6 +293,19 @@ TXTRequest::TXTRequest( const std::string & dn ) :
     _type = DNS_T_TXT;
 }
 
+Request* TXTRequest::clone() const
+{
+    return new TXTRequest(_dn);
+}
+
+void TXTRequest::copyResults( const Request& other )
+{
+    Request::copyResults(other);
+    const TXTRequest& txt = static_cast<const TXTRequest&>(other);
+    entries = txt.entries;
+    attributes = txt.attributes;
+}
+
 static void dnscbTXT(struct dns_ctx *ctx, struct dns_rr_txt *result, void *data)
 {
     TXTRequest * r = static_cast<TXTRequest*>(data);
@@ -164,6 +323,8 @@ static void dnscbTXT(struct dns_ctx *ctx, struct dns_rr_txt *result, void *data)
           }
         }
         free(result);
+    } else {
+        r->setFailed();
     }
     r->setComplete();
 }
@@ -171,7 +332,8 @@ static void dnscbTXT(struct dns_ctx *ctx, struct dns_rr_txt *result, void *data)
 void TXTRequest::submit( Client * client )
 {
     // protocol and service an already encoded in DN so pass in NULL for both
-    if (!dns_submit_txt(client->d->ctx, getDn().c_str(), DNS_C_IN, 0, dnscbTXT, this )) {
+    _query = dns_submit_txt(client->d->ctx, getDn().c_str(), DNS_C_IN, 0, dnscbTXT, this );
+    if (!_query) {
         SG_LOG(SG_IO, SG_ALERT, "Can't submit dns request for " << getDn());
         return;
     }
@@ -179,6 +341,26 @@ void TXTRequest::submit( Client * client )
 }
 
 
+std::string NAPTRRequest::cacheKey() const
+{
+    // entries are filtered by service and flags when the answer arrives
+    return Request::cacheKey() + ":" + qservice + ":" + qflags;
+}
+
+Request* NAPTRRequest::clone() const
+{
+    NAPTRRequest* r = new NAPTRRequest(_dn);
+    r->qservice = qservice;
+    r->qflags = qflags;
+    return r;
+}
+
+void NAPTRRequest::copyResults( const Request& other )
+{
+    Request::copyResults(other);
+    entries = static_cast<const NAPTRRequest&>(other).entries;
+}
+
 static bool sortNAPTR( const NAPTRRequest::NAPTR_ptr a, const NAPTRRequest::NAPTR_ptr b )
 {
     if( a->order > b->order ) return false;
@@ -212,13 +394,16 @@ static void dnscbNAPTR(struct dns_ctx *ctx, struct dns_rr_naptr *result, void *d
         }
         std::sort( r->entries.begin(), r->entries.end(), sortNAPTR );
         free(result);
+    } else {
+        r->setFailed();
     }
     r->setComplete();
 }
 
 void NAPTRRequest::submit( Client * client )
 {
-    if (!dns_submit_naptr(client->d->ctx, getDn().c_str(), 0, dnscbNAPTR, this )) {
+    _query = dns_submit_naptr(client->d->ctx, getDn().c_str(), 0, dnscbNAPTR, this );
+    if (!_query) {
         SG_LOG(SG_IO, SG_ALERT, "Can't submit dns request for " << getDn());
         return;
     }
@@ -237,16 +422,94 @@ Client::Client() :
 
 void Client::makeRequest(const Request_ptr& r)
 {
-    r->submit(this);
+    r->_start = time(NULL);
+
+    ClientPrivate::CacheEntry& entry = d->cache[r->cacheKey()];
+    if (entry.result && (entry.remaining(SGTimeStamp::now()) > 0.0)) {
+        if (entry.negative) {
+            ++d->stats.negativeHits;
+        } else {
+            ++d->stats.hits;
+        }
+        entry.used = true;
+        r->copyResults(*entry.result);
+        r->setComplete();
+        return;
+    }
+
+    entry.waiters.push_back(r);
+    if (entry.inflight) {
+        ++d->stats.coalesced;
+        return;
+    }
+
+    ++d->stats.misses;
+    d->startLookup(this, entry, *r);
 }
 
 void Client::update(int waitTimeout)
 {
     time_t now = time(NULL);
-    if( dns_timeouts( d->ctx, -1, now ) < 0 )
-        return;
+    if( dns_timeouts( d->ctx, -1, now ) >= 0 )
+        dns_ioevent(d->ctx, now);
+
+    d->updateCache(this);
+}
 
-    dns_ioevent(d->ctx, now);
+void Client::setNameServer(const std::string& address, int port)
+{
+    // cached answers came from the old server; lookups in flight are
+    // cancelled and sent again below, so their waiters still complete
+    ClientPrivate::CacheMap::iterator it = d->cache.begin();
+    while (it != d->cache.end()) {
+        if (it->second.inflight) {
+            d->cancelLookup(it->second);
+            it->second.result.clear();
+            ++it;
+        } else {
+            d->cache.erase(it++);
+        }
+    }
+
+    dns_close(d->ctx);
+    dns_add_serv(d->ctx, NULL);
+    if (dns_add_serv(d->ctx, address.c_str()) < 0)
+        SG_LOG(SG_IO, SG_ALERT, "Invalid DNS server address " << address );
+    dns_set_opt(d->ctx, DNS_OPT_PORT, port);
+
+    if( dns_open(d->ctx) < 0 )
+        SG_LOG(SG_IO, SG_ALERT, "Can't open udns context" );
+
+    for (it = d->cache.begin(); it != d->cache.end(); ++it) {
+        Request_ptr pending = it->second.inflight;
+        d->startLookup(this, it->second, *pending);
+    }
+}
+
+void Client::setNegativeTTL(unsigned seconds)
+{
+    d->negativeTTL = seconds;
+}
+
+Client::CacheStats Client::getCacheStats() const
+{
+    CacheStats result = d->stats;
+    result.entries = d->cache.size();
+    return result;
+}
+
+void Client::clearCache()
+{
+    // keep lookups in flight, their waiters still need completing
+    ClientPrivate::CacheMap::iterator it = d->cache.begin();
+    while (it != d->cache.end()) {
+        if (it->second.inflight) {
+            it->second.result.clear();
+            ++it;
+        } else {
+            d->cache.erase(it++);
+        }
+    }
 }
 
 } // of namespace DNS
@@ -33,6 +33,8 @@
 #include <simgear/structure/SGSharedPtr.hxx>
 #include <simgear/structure/event_mgr.hxx>
 
+struct dns_query;
+
 namespace simgear
 {
 
@@ -49,10 +51,26 @@ public:
     int getType() const { return _type; }
     bool isComplete() const { return _complete; }
     bool isTimeout() const;
+    void setTimeout( time_t secs ) { _timeout_secs = secs; }
     void setComplete( bool b = true ) { _complete = b; }
+    // the lookup finished without an answer (e.g. NXDOMAIN)
+    bool isFailed() const { return _failed; }
+    void setFailed( bool b = true ) { _failed = b; }
 
     virtual void submit( Client * client) = 0;
 
+    /**
+     * Identify requests which produce the same answer, so the Client can
+     * share one lookup (and its cached result) between them.
+     */
+    virtual std::string cacheKey() const;
+
+    /** create a new, unsubmitted request for the same query */
+    virtual Request* clone() const = 0;
+
+    /** take over the answer of a completed request for the same query */
+    virtual void copyResults( const Request& other );
+
     std::string cname;
     std::string qname;
     unsigned ttl;
@@ -60,8 +78,12 @@ protected:
     std::string _dn;
     int _type;
     bool _complete;
+    bool _failed;
     time_t _timeout_secs;
     time_t _start;
+    struct dns_query* _query; // udns query, while submitted
+
+    friend class Client;
 };
 typedef SGSharedPtr<Request> Request_ptr;
 
@@ -70,6 +92,9 @@ class NAPTRRequest : public Request
 public:
     NAPTRRequest( const std::string & dn );
     virtual void submit( Client * client );
+    virtual std::string cacheKey() const;
+    virtual Request* clone() const;
+    virtual void copyResults( const Request& other );
 
     struct NAPTR : SGReferenced {
         int order;
@@ -93,6 +118,9 @@ public:
     SRVRequest( const std::string & dn );
     SRVRequest( const std::string & dn, const string & service, const string & protocol );
     virtual void submit( Client * client );
+    virtual std::string cacheKey() const;
+    virtual Request* clone() const;
+    virtual void copyResults( const Request& other );
 
     struct SRV : SGReferenced {
       int priority;
@@ -113,6 +141,8 @@ class TXTRequest : public Request
 public:
     TXTRequest( const std::string & dn );
     virtual void submit( Client * client );
+    virtual Request* clone() const;
+    virtual void copyResults( const Request& other );
 
     typedef std::vector<string> TXT_list;
     typedef std::map<std::string,std::string> TXT_Attribute_map;
@@ -120,16 +150,55 @@ public:
     TXT_Attribute_map attributes;
 };
 
+/**
+ * Asynchronous resolver. Answers are cached for their TTL, failed lookups
+ * for the negative TTL, and lookups which timed out for a few seconds at
+ * most. Requests for a query which is already in flight
+ * wait for that lookup instead of sending another one, and entries which
+ * are in use are refreshed in the background shortly before they expire.
+ */
 class Client
 {
 public:
     Client();
     ~Client();
 
+    /**
+     * process replies and timeouts, complete waiting requests and start
+     * background refreshes. Call regularly while requests are pending.
+     */
     void update(int waitTimeout = 0);
 
+    /**
+     * Start a lookup. A request answered from the cache is complete when
+     * this returns, otherwise it completes during a later update().
+     */
     void makeRequest(const Request_ptr& r);
 
+    /**
+     * use a specific name server instead of the system configuration,
+     * e.g. a local resolver for testing. Pending lookups are sent again
+     * to the new server.
+     */
+    void setNameServer(const std::string& address, int port = 53);
+
+    /** how long failed lookups are remembered, in seconds */
+    void setNegativeTTL(unsigned seconds);
+
+    struct CacheStats
+    {
+        unsigned hits;          ///< answered from a cached answer
+        unsigned negativeHits;  ///< answered from a cached failure
+        unsigned misses;        ///< required a new lookup
+        unsigned coalesced;     ///< joined a lookup already in flight
+        unsigned prefetches;    ///< background refreshes started
+        unsigned timeouts;      ///< lookups which got no answer in time
+        size_t entries;
+    };
+
+    CacheStats getCacheStats() const;
+    void clearCache();
+
 //    void cancelRequest(const Request_ptr& r, std::string reason = std::string());
 
     class ClientPrivate;
@@ -45,6 +45,7 @@
 #else
 #  include <sys/types.h>
 #  include <sys/socket.h>
+#  include <sys/uio.h>
 #  include <netinet/in.h>
 #  include <arpa/inet.h>
 #  include <sys/time.h>
@@ -412,6 +413,82 @@ bool IPAddress::isValid() const
     return (addr != NULL);
 }
 
+class DatagramBatchPrivate
+{
+public:
+#if !defined(WINSOCK)
+  std::vector<struct iovec> iovs ;
+#endif
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+  std::vector<struct mmsghdr> msgs ;
+#endif
+} ;
+
+DatagramBatch::DatagramBatch ( int capacity, int maxPacketSize ) :
+  _capacity (capacity),
+  _maxPacketSize (maxPacketSize),
+  _count (0),
+  _sent (0),
+  _storage (capacity * maxPacketSize),
+  _sizes (capacity, 0),
+  _addresses (capacity),
+  _hasAddress (capacity, false),
+  d (new DatagramBatchPrivate)
+{
+  for (int i = 0; i < capacity; ++i) {
+    _addresses[i].getAddr() ; // allocate now, not per packet
+  }
+
+#if !defined(WINSOCK)
+  d->iovs.resize(capacity) ;
+  for (int i = 0; i < capacity; ++i) {
+    d->iovs[i].iov_base = &_storage[i * maxPacketSize] ;
+    d->iovs[i].iov_len = maxPacketSize ;
+  }
+#endif
+
+#if defined(HAVE_SENDMMSG) || defined(HAVE_RECVMMSG)
+  d->msgs.resize(capacity) ;
+  memset(d->msgs.data(), 0, capacity * sizeof(struct mmsghdr)) ;
+  for (int i = 0; i < capacity; ++i) {
+    d->msgs[i].msg_hdr.msg_iov = &d->iovs[i] ;
+    d->msgs[i].msg_hdr.msg_iovlen = 1 ;
+  }
+#endif
+}
+
+DatagramBatch::~DatagramBatch ()
+{
+}
+
+void DatagramBatch::clear ()
+{
+  _count = 0 ;
+  _sent = 0 ;
+}
+
+bool DatagramBatch::add ( const void* data, int size, const IPAddress* to )
+{
+  if ((_count == _capacity) || (size > _maxPacketSize)) {
+    return false ;
+  }
+
+  memcpy(&_storage[_count * _maxPacketSize], data, size) ;
+  _sizes[_count] = size ;
+  _hasAddress[_count] = (to != NULL) ;
+  if (to) {
+    memcpy(_addresses[_count].getAddr(), to->getAddr(), sizeof(struct sockaddr_in)) ;
+  }
+
+  ++_count ;
+  return true ;
+}
+
+const char* DatagramBatch::packetData ( int i ) const
+{
+  return &_storage[i * _maxPacketSize] ;
+}
+
 Socket::Socket ()
 {
   handle = -1 ;
@@ -496,6 +573,17 @@ void Socket::setBlocking ( bool blocking )
 }
 
 
+bool Socket::setReusePort ( bool reuse )
+{
+  assert ( handle != -1 ) ;
+#if defined(SO_REUSEPORT)
+  int opt = reuse ? 1 : 0 ;
+  return (::setsockopt( handle, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt) ) == 0) ;
+#else
+  return !reuse ;
+#endif
+}
+
 void Socket::setBroadcast ( bool broadcast )
 {
   assert ( handle != -1 ) ;
@@ -613,6 +701,146 @@ int Socket::send (const void * buffer, int size, int flags)
 }
 
 
+int Socket::sendv (const char* const* buffers, const int* sizes, int count, int flags)
+{
+  assert ( handle != -1 ) ;
+  assert ( count <= MAX_SEND_SEGMENTS ) ;
+
+#if defined(WINSOCK)
+  WSABUF bufs[MAX_SEND_SEGMENTS] ;
+  for (int i = 0; i < count; ++i) {
+    bufs[i].buf = const_cast<char*>(buffers[i]) ;
+    bufs[i].len = sizes[i] ;
+  }
+
+  DWORD sent = 0 ;
+  if (WSASend(handle, bufs, count, &sent, flags, NULL, NULL) != 0) {
+    return -1 ;
+  }
+  return (int) sent ;
+#else
+  struct iovec iov[MAX_SEND_SEGMENTS] ;
+  for (int i = 0; i < count; ++i) {
+    iov[i].iov_base = const_cast<char*>(buffers[i]) ;
+    iov[i].iov_len = sizes[i] ;
+  }
+
+  struct msghdr msg ;
+  memset(&msg, 0, sizeof(msg)) ;
+  msg.msg_iov = iov ;
+  msg.msg_iovlen = count ;
+  return ::sendmsg (handle, &msg, flags | MSG_NOSIGNAL);
+#endif
+}
+
+int Socket::sendBatch ( DatagramBatch& batch, int flags )
+{
+  assert ( handle != -1 ) ;
+  const int first = batch._sent ;
+  const int n = batch.pending() ;
+  if (n == 0) {
+    return 0 ;
+  }
+
+  int sent = 0 ;
+#if defined(HAVE_SENDMMSG)
+  for (int i = first; i < batch._count; ++i) {
+    struct msghdr& hdr = batch.d->msgs[i].msg_hdr ;
+    hdr.msg_iov->iov_len = batch._sizes[i] ;
+    if (batch._hasAddress[i]) {
+      hdr.msg_name = batch._addresses[i].getAddr() ;
+      hdr.msg_namelen = batch._addresses[i].getAddrLen() ;
+    } else {
+      hdr.msg_name = NULL ;
+      hdr.msg_namelen = 0 ;
+    }
+  }
+
+  sent = ::sendmmsg (handle, &batch.d->msgs[first], n, flags | MSG_NOSIGNAL) ;
+  if (sent < 0) {
+    return -1 ;
+  }
+#else
+  // one system call per packet, stopping at the first which fails
+  for (int i = first; i < batch._count; ++i) {
+    int result ;
+    if (batch._hasAddress[i]) {
+      result = sendto (batch.packetData(i), batch._sizes[i], flags, &batch._addresses[i]) ;
+    } else {
+      result = send (batch.packetData(i), batch._sizes[i], flags) ;
+    }
+
+    if (result < 0) {
+      if (sent == 0) {
+        return -1 ;
+      }
+      break ;
+    }
+    ++sent ;
+  }
+#endif
+
+  batch._sent += sent ;
+  if (batch._sent == batch._count) {
+    batch.clear() ;
+  }
+
+  return sent ;
+}
+
+int Socket::recvBatch ( DatagramBatch& batch, int flags )
+{
+  assert ( handle != -1 ) ;
+  batch.clear() ;
+
+#if defined(HAVE_RECVMMSG)
+  for (int i = 0; i < batch._capacity; ++i) {
+    struct msghdr& hdr = batch.d->msgs[i].msg_hdr ;
+    hdr.msg_iov->iov_len = batch._maxPacketSize ;
+    hdr.msg_name = batch._addresses[i].getAddr() ;
+    hdr.msg_namelen = batch._addresses[i].getAddrLen() ;
+  }
+
+  int received = ::recvmmsg (handle, batch.d->msgs.data(), batch._capacity,
+                             flags | MSG_WAITFORONE, NULL) ;
+  if (received < 0) {
+    return -1 ;
+  }
+
+  for (int i = 0; i < received; ++i) {
+    batch._sizes[i] = batch.d->msgs[i].msg_len ;
+    batch._hasAddress[i] = true ;
+  }
+  batch._count = received ;
+#else
+  for (int i = 0; i < batch._capacity; ++i) {
+    int f = flags ;
+    if (i > 0) {
+#if defined(MSG_DONTWAIT)
+      f |= MSG_DONTWAIT ; // only wait for the first packet
+#else
+      break ;
+#endif
+    }
+
+    int result = recvfrom (&batch._storage[i * batch._maxPacketSize],
+                           batch._maxPacketSize, f, &batch._addresses[i]) ;
+    if (result < 0) {
+      if (i == 0) {
+        return -1 ;
+      }
+      break ;
+    }
+
+    batch._sizes[i] = result ;
+    batch._hasAddress[i] = true ;
+    ++batch._count ;
+  }
+#endif
+
+  return batch._count ;
+}
+
 int Socket::sendto ( const void * buffer, int size,
                         int flags, const IPAddress* to )
 {
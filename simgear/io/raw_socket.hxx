@@ -29,6 +29,9 @@
 //#  include <netinet/in.h>
 //#endif
 
+#include <memory>
+#include <vector>
+
 struct sockaddr_in;
 struct sockaddr;
      
@@ -68,6 +71,59 @@ public:
 };
 
 
+class DatagramBatchPrivate;
+
+/*
+ * A preallocated ring of datagram slots, for sending or receiving many
+ * UDP packets with one system call (sendmmsg / recvmmsg where available).
+ * Packet storage, addresses and the system-call descriptors are all
+ * allocated once, up front.
+ */
+class DatagramBatch
+{
+public:
+  DatagramBatch ( int capacity, int maxPacketSize = 1500 ) ;
+  ~DatagramBatch () ;
+
+  int capacity () const { return _capacity ; }
+  int maxPacketSize () const { return _maxPacketSize ; }
+
+  /** number of packets in the batch: queued for sending, or received */
+  int count () const { return _count ; }
+
+  /** number of queued packets not yet sent by Socket::sendBatch() */
+  int pending () const { return _count - _sent ; }
+
+  void clear () ;
+
+  /**
+   * queue a copy of a packet for sending. 'to' may be NULL when the
+   * socket is connected. Returns false if the batch is full or the
+   * packet is larger than maxPacketSize().
+   */
+  bool add ( const void* data, int size, const IPAddress* to = NULL ) ;
+
+  const char* packetData ( int i ) const ;
+  int packetSize ( int i ) const { return _sizes[i] ; }
+  const IPAddress& packetAddress ( int i ) const { return _addresses[i] ; }
+
+private:
+  friend class Socket ;
+
+  DatagramBatch ( const DatagramBatch& ) ; // = delete;
+  DatagramBatch& operator= ( const DatagramBatch& ) ; // = delete;
+
+  int _capacity ;
+  int _maxPacketSize ;
+  int _count ;
+  int _sent ;
+  std::vector<char> _storage ;
+  std::vector<int> _sizes ;
+  std::vector<IPAddress> _addresses ;
+  std::vector<bool> _hasAddress ;
+  std::unique_ptr<DatagramBatchPrivate> d ;
+} ;
+
 /*
  * Socket type
  */
@@ -93,13 +149,42 @@ public:
   int   connect     ( const char* host, int port ) ;
   int   connect     ( IPAddress* addr ) ;
   int   send	    ( const void * buffer, int size, int flags = 0 ) ;
+  /**
+   * gathering send: transmit 'count' separate buffers with a single
+   * system call (sendmsg / WSASend), without first copying them together.
+   * At most MAX_SEND_SEGMENTS buffers are sent per call.
+   */
+  enum { MAX_SEND_SEGMENTS = 16 } ;
+  int   sendv       ( const char* const* buffers, const int* sizes, int count, int flags = 0 ) ;
   int   sendto      ( const void * buffer, int size, int flags, const IPAddress* to ) ;
   int   recv	    ( void * buffer, int size, int flags = 0 ) ;
   int   recvfrom    ( void * buffer, int size, int flags, IPAddress* from ) ;
 
+  /**
+   * send the pending packets of a batch, in order. Returns the number of
+   * packets sent (which may be fewer than pending(), e.g. if the socket
+   * would block), or -1 on error. Once everything is sent the batch is
+   * cleared for re-use.
+   */
+  int   sendBatch   ( DatagramBatch& batch, int flags = 0 ) ;
+
+  /**
+   * receive up to batch.capacity() packets, replacing the contents of the
+   * batch. Waits (on a blocking socket) only for the first packet. Returns
+   * the number of packets received, or -1 on error.
+   */
+  int   recvBatch   ( DatagramBatch& batch, int flags = 0 ) ;
+
   void setBlocking ( bool blocking ) ;
   void setBroadcast ( bool broadcast ) ;
 
+  /**
+   * allow several sockets to bind the same address and port, with the
+   * kernel spreading incoming datagrams between them (SO_REUSEPORT).
+   * Must be called before bind(). Returns false where unsupported.
+   */
+  bool setReusePort ( bool reuse ) ;
+
   static bool isNonBlockingError () ;
   static int errorNumber();
 
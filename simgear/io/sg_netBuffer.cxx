@@ -26,6 +26,7 @@
 #include <simgear_config.h>
 #include "sg_netBuffer.hxx"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -36,6 +37,7 @@ namespace simgear {
 NetBuffer::NetBuffer( int _max_length )
 {
   length = 0 ;
+  start = 0 ;
   max_length = _max_length ;
   data = new char [ max_length+1 ] ;  //for null terminator
 }
@@ -45,26 +47,51 @@ NetBuffer::~NetBuffer ()
   delete[] data ;
 }
 
+void NetBuffer::compact ()
+{
+  if (start > 0)
+  {
+    memmove(data, &data[start], length) ;
+    start = 0 ;
+  }
+}
+
+char* NetBuffer::getSpace ()
+{
+  compact () ;
+  return &data[length] ;
+}
+
 void NetBuffer::remove ()
 {
   length = 0 ;
+  start = 0 ;
 }
 
 void NetBuffer::remove (int pos, int n)
 {
   assert (pos>=0 && pos<length && (pos+n)<=length) ;
-  //if (pos>=0 && pos<length && (pos+n)<=length)
+  if (pos == 0)
   {
-    memmove(&data[pos],&data[pos+n],length-(pos+n)) ;
+    // consuming from the front is just an offset change
+    start += n ;
     length -= n ;
+    if (length == 0)
+      start = 0 ;
+    return ;
   }
+
+  memmove(&data[start+pos],&data[start+pos+n],length-(pos+n)) ;
+  length -= n ;
 }
 
 bool NetBuffer::append (const char* s, int n)
 {
   if ((length+n)<=max_length)
   {
-    memcpy(&data[length],s,n) ;
+    if (n > getTailLength())
+      compact () ;
+    memcpy(&data[start+length],s,n) ;
     length += n ;
     return true ;
   }
@@ -73,6 +100,7 @@ bool NetBuffer::append (const char* s, int n)
 
 bool NetBuffer::append (int n)
 {
+  // the caller has written n bytes at getSpace() or getData()+getLength()
   if ((length+n)<=max_length)
   {
     length += n ;
@@ -81,6 +109,95 @@ bool NetBuffer::append (int n)
   return false ;
 }
 
+NetBufferChain::NetBufferChain( int _max_length, int _block_size ) :
+  length (0),
+  max_length (_max_length),
+  block_size (_block_size)
+{
+}
+
+NetBufferChain::~NetBufferChain ()
+{
+  remove () ;
+  for (size_t i = 0; i < spare.size(); ++i)
+    delete[] spare[i] ;
+}
+
+int NetBufferChain::getSegments (const char** buffers, int* sizes, int max_count) const
+{
+  int count = 0 ;
+  std::deque<Block>::const_iterator it = blocks.begin() ;
+  for (; (it != blocks.end()) && (count < max_count); ++it)
+  {
+    buffers[count] = it->data + it->begin ;
+    sizes[count] = it->end - it->begin ;
+    ++count ;
+  }
+  return count ;
+}
+
+void NetBufferChain::remove ()
+{
+  while (!blocks.empty())
+  {
+    spare.push_back (blocks.front().data) ;
+    blocks.pop_front () ;
+  }
+  length = 0 ;
+}
+
+void NetBufferChain::consume (int n)
+{
+  assert (n>=0 && n<=length) ;
+  length -= n ;
+  while (n > 0)
+  {
+    Block& b = blocks.front() ;
+    int avail = b.end - b.begin ;
+    if (n < avail)
+    {
+      b.begin += n ;
+      return ;
+    }
+
+    n -= avail ;
+    spare.push_back (b.data) ;
+    blocks.pop_front () ;
+  }
+}
+
+bool NetBufferChain::append (const char* s, int n)
+{
+  if ((length+n) > max_length)
+    return false ;
+
+  length += n ;
+  while (n > 0)
+  {
+    if (blocks.empty() || (blocks.back().end == block_size))
+    {
+      // recycle a released block if we have one
+      Block b ;
+      if (spare.empty()) {
+        b.data = new char [ block_size ] ;
+      } else {
+        b.data = spare.back() ;
+        spare.pop_back() ;
+      }
+      b.begin = b.end = 0 ;
+      blocks.push_back (b) ;
+    }
+
+    Block& tail = blocks.back() ;
+    int count = std::min (n, block_size - tail.end) ;
+    memcpy (&tail.data[tail.end], s, count) ;
+    tail.end += count ;
+    s += count ;
+    n -= count ;
+  }
+  return true ;
+}
+
 NetBufferChannel::NetBufferChannel (int in_buffer_size, int out_buffer_size) :
     in_buffer (in_buffer_size),
     out_buffer (out_buffer_size),
@@ -118,7 +235,16 @@ NetBufferChannel::handleRead (void)
   int max_read = in_buffer.getMaxLength() - in_buffer.getLength() ;
   if (max_read)
   {
-    char* data = in_buffer.getData() + in_buffer.getLength() ;
+    // read into the free bytes after the data, the data is only moved to
+    // the front once these run out
+    char* data ;
+    if (in_buffer.getTailLength() > 0)
+    {
+      data = in_buffer.getData() + in_buffer.getLength() ;
+      max_read = in_buffer.getTailLength() ;
+    }
+    else
+      data = in_buffer.getSpace() ;
     int num_read = recv (data, max_read) ;
     if (num_read > 0)
     {
@@ -139,14 +265,14 @@ NetBufferChannel::handleWrite (void)
   {
     if (isConnected())
     {
-      int length = out_buffer.getLength() ;
-      if (length>512)
-        length=512;
-      int num_sent = NetChannel::send (
-        out_buffer.getData(), length);
+      // send as much as the socket will take, straight from the blocks
+      const char* buffers[MAX_SEND_SEGMENTS] ;
+      int sizes[MAX_SEND_SEGMENTS] ;
+      int count = out_buffer.getSegments (buffers, sizes, MAX_SEND_SEGMENTS) ;
+      int num_sent = NetChannel::sendv (buffers, sizes, count) ;
       if (num_sent > 0)
       {
-        out_buffer.remove (0, num_sent);
+        out_buffer.consume (num_sent);
         //ulSetError ( UL_DEBUG, "netBufferChannel: %d sent", num_sent ) ;
       }
     }
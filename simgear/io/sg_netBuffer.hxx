@@ -80,6 +80,9 @@
 
 #include <simgear/io/sg_netChannel.hxx>
 
+#include <deque>
+#include <vector>
+
 namespace simgear
 {
 
@@ -93,6 +96,11 @@ protected:
   int length ;
   int max_length ;
   char* data ;
+  // offset of the first valid byte: consumed data is skipped, and only
+  // moved to the front when the free bytes at the end run out
+  int start ;
+
+  void compact () ;
 
 public:
   NetBuffer( int _max_length );
@@ -105,8 +113,21 @@ public:
   **  Note: a zero (0) byte is appended for convenience
   **  but the data may have internal zero (0) bytes already
   */
-  char* getData() { data [length] = 0 ; return data ; }
-  const char* getData() const { ((char*)data) [length] = 0 ; return data ; }
+  char* getData() { data [start+length] = 0 ; return data + start ; }
+  const char* getData() const { ((char*)data) [start+length] = 0 ; return data + start ; }
+
+  /*
+  **  getSpace() moves the data to the front if needed and returns a pointer
+  **  to getMaxLength()-getLength() writeable bytes following the data, the
+  **  same as getData()+getLength() afterwards, for use with append(int n)
+  */
+  char* getSpace() ;
+
+  /*
+  **  getTailLength() returns the number of writeable bytes at
+  **  getData()+getLength() without moving the data
+  */
+  int getTailLength() const { return max_length - start - length ; }
 
   void remove ();
   void remove (int pos, int n);
@@ -114,14 +135,64 @@ public:
   bool append (int n);
 };
 
+// ===========================================================================
+// NetBufferChain
+// ===========================================================================
+
+/*
+**  A queue of fixed-size blocks, used for output: data is copied in once,
+**  handed to a gathering send directly from the blocks, and consumed by
+**  releasing or advancing past blocks - never by moving the remainder.
+*/
+class NetBufferChain
+{
+  struct Block
+  {
+    char* data ;
+    int begin ; // first unsent byte
+    int end ;   // one past the last valid byte
+  } ;
+
+  std::deque<Block> blocks ;
+  std::vector<char*> spare ;
+  int length ;
+  int max_length ;
+  int block_size ;
+
+  NetBufferChain(const NetBufferChain&); // = delete;
+  NetBufferChain& operator=(const NetBufferChain&); // = delete;
+public:
+  NetBufferChain( int _max_length, int _block_size = 4096 );
+  ~NetBufferChain ();
+
+  int getLength() const { return length ; }
+  int getMaxLength() const { return max_length ; }
+
+  /*
+  **  getSegments() fills in up to max_count pointers and sizes describing
+  **  the queued data in order, and returns the number filled in
+  */
+  int getSegments (const char** buffers, int* sizes, int max_count) const ;
+
+  void remove ();
+  void consume (int n);
+  bool append (const char* s, int n);
+};
+
 // ===========================================================================
 // NetBufferChannel
 // ===========================================================================
 
+/*
+**  Input is read with a single recv() into the contiguous in_buffer rather
+**  than scattered with readv(): handleBufferRead() and the NetChat
+**  terminator search need the data contiguous, so a scattered read would
+**  only move the copy to a later point. Only output is gathered.
+*/
 class NetBufferChannel : public NetChannel
 {
   NetBuffer in_buffer;
-  NetBuffer out_buffer;
+  NetBufferChain out_buffer;
   int should_close ;
   
   virtual bool readable (void)
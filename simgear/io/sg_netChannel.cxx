@@ -37,6 +37,18 @@
 #include <cstring>
 #include <errno.h>
 
+#if defined(HAVE_POLL_H)
+#  include <poll.h>
+#  define SG_NETCHANNEL_POLL 1
+#endif
+
+#if defined(HAVE_SYS_EPOLL_H)
+#  include <sys/epoll.h>
+#  include <unistd.h>
+#  define SG_NETCHANNEL_EPOLL 1
+#endif
+
+#include <simgear/sg_inlines.h>
 #include <simgear/debug/logstream.hxx>
 
 
@@ -51,6 +63,10 @@ NetChannel::NetChannel ()
   write_blocked = false ;
   should_delete = false ;
   poller = NULL;
+  registeredHandle = -1;
+  registeredAccepting = false;
+  readReady = false;
+  writeReady = false;
 }
   
 NetChannel::~NetChannel ()
@@ -101,8 +117,23 @@ NetChannel::connect ( const char* h, int p )
 int
 NetChannel::send (const void * buffer, int size, int flags)
 {
-  int result = Socket::send (buffer, size, flags);
-  
+  return handleSendResult (Socket::send (buffer, size, flags), size);
+}
+
+int
+NetChannel::sendv (const char* const* buffers, const int* sizes, int count, int flags)
+{
+  int size = 0 ;
+  for (int i = 0; i < count; ++i) {
+    size += sizes[i] ;
+  }
+
+  return handleSendResult (Socket::sendv (buffers, sizes, count, flags), size);
+}
+
+int
+NetChannel::handleSendResult (int result, int size)
+{
   if (result == (int)size) {
     // everything was sent
     write_blocked = false ;
@@ -110,16 +141,17 @@ NetChannel::send (const void * buffer, int size, int flags)
   } else if (result >= 0) {
     // not all of it was sent, but no error
     write_blocked = true ;
+    writeReady = false ;
     return result;
   } else if (isNonBlockingError ()) {
     write_blocked = true ;
+    writeReady = false ;
     return 0;
   } else {
     this->handleError (errorNumber());
     close();
     return -1;
   }
-  
 }
 
 int
@@ -128,11 +160,17 @@ NetChannel::recv (void * buffer, int size, int flags)
   int result = Socket::recv (buffer, size, flags);
   
   if (result > 0) {
+    // a short read means the socket was drained; any further data
+    // will generate a new edge
+    if (result < size) {
+      readReady = false ;
+    }
     return result;
   } else if (result == 0) {
     close();
     return 0;
   } else if (isNonBlockingError ()) {
+    readReady = false ;
     return 0;
   } else {
     this->handleError (errorNumber());
@@ -154,6 +192,14 @@ NetChannel::close (void)
     write_blocked = false ;
   }
 
+  // must happen while the handle is still valid, otherwise a new socket
+  // re-using the descriptor number could be unregistered by mistake
+  if (poller) {
+    poller->unregisterChannel(this);
+  }
+
+  readReady = false ;
+  writeReady = false ;
   Socket::close () ;
 }
 
@@ -242,6 +288,31 @@ void NetChannel::handleError (int error)
     }
 }
 
+NetChannelPoller::NetChannelPoller() :
+    pollerHandle(-1)
+{
+#if defined(SG_NETCHANNEL_EPOLL)
+    pollerHandle = epoll_create1(EPOLL_CLOEXEC);
+    if (pollerHandle < 0) {
+        SG_LOG(SG_IO, SG_WARN, "NetChannelPoller: epoll_create1 failed, using poll(): " << strerror(errno));
+    }
+#endif
+}
+
+NetChannelPoller::~NetChannelPoller()
+{
+    for (ChannelList::iterator it = channels.begin(); it != channels.end(); ++it) {
+        (*it)->poller = NULL;
+        (*it)->registeredHandle = -1;
+    }
+
+#if defined(SG_NETCHANNEL_EPOLL)
+    if (pollerHandle >= 0) {
+        ::close(pollerHandle);
+    }
+#endif
+}
+
 void
 NetChannelPoller::addChannel(NetChannel* channel)
 {
@@ -249,6 +320,9 @@ NetChannelPoller::addChannel(NetChannel* channel)
     assert(channel->poller == NULL);
         
     channel->poller = this;
+    channel->registeredHandle = -1;
+    channel->readReady = false;
+    channel->writeReady = false;
     channels.push_back(channel);
 }
 
@@ -257,6 +331,7 @@ NetChannelPoller::removeChannel(NetChannel* channel)
 {
     assert(channel);
     assert(channel->poller == this);
+    unregisterChannel(channel);
     channel->poller = NULL;
     
     // portability: MSVC throws assertion failure when empty
@@ -273,6 +348,61 @@ NetChannelPoller::removeChannel(NetChannel* channel)
     }
 }
 
+void
+NetChannelPoller::updateRegistration(NetChannel* channel)
+{
+#if defined(SG_NETCHANNEL_EPOLL)
+    if (pollerHandle < 0) {
+        return;
+    }
+
+    int handle = channel->getHandle();
+    if ((handle == channel->registeredHandle) &&
+        (channel->accepting == channel->registeredAccepting))
+    {
+        return; // nothing changed since last time
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.ptr = channel;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+
+    // listening sockets stay level-triggered: handleAccept() may only
+    // accept one pending connection per event
+    if (!channel->accepting) {
+        ev.events |= EPOLLET;
+    }
+
+    int op = (handle == channel->registeredHandle) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(pollerHandle, op, handle, &ev) < 0) {
+        SG_LOG(SG_IO, SG_WARN, "NetChannelPoller: epoll_ctl failed for:" << handle << ": " << strerror(errno));
+        return;
+    }
+
+    channel->registeredHandle = handle;
+    channel->registeredAccepting = channel->accepting;
+    channel->readReady = false;
+    channel->writeReady = false;
+#else
+    SG_UNUSED(channel);
+#endif
+}
+
+void
+NetChannelPoller::unregisterChannel(NetChannel* channel)
+{
+#if defined(SG_NETCHANNEL_EPOLL)
+    if ((pollerHandle >= 0) && (channel->registeredHandle >= 0)) {
+        // may fail harmlessly if the descriptor was already closed
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(pollerHandle, EPOLL_CTL_DEL, channel->registeredHandle, &ev);
+    }
+#endif
+    channel->registeredHandle = -1;
+}
+
 bool
 NetChannelPoller::poll(unsigned int timeout)
 {
@@ -280,12 +410,11 @@ NetChannelPoller::poll(unsigned int timeout)
         return false;
     }
     
-    enum { MAX_SOCKETS = 256 } ;
-    Socket* reads [ MAX_SOCKETS+1 ] ;
-    Socket* writes [ MAX_SOCKETS+1 ] ;
-    int nreads = 0 ;
-    int nwrites = 0 ;
+    reads.clear();
+    writes.clear();
     int nopen = 0 ;
+    bool interested = false;
+    const bool persistent = (pollerHandle >= 0);
     
     ChannelList::iterator it = channels.begin();
     while( it != channels.end() )
@@ -295,6 +424,7 @@ NetChannelPoller::poll(unsigned int timeout)
         {
             // avoid the channel trying to remove itself from us, or we get
             // bug http://code.google.com/p/flightgear-bugs/issues/detail?id=1144
+            unregisterChannel(ch);
             ch->poller = NULL;
             delete ch;
             it = channels.erase(it);
@@ -313,36 +443,48 @@ NetChannelPoller::poll(unsigned int timeout)
         }
       
         nopen++ ;
+        if (persistent) {
+            updateRegistration(ch);
+        }
+
+        // with a persistent backend, only channels whose readiness is
+        // already known are collected here; the rest come from the kernel
         if (ch -> readable()) {
-          assert(nreads<MAX_SOCKETS);
-          reads[nreads++] = ch ;
+          interested = true;
+          if (!persistent || ch->readReady) {
+            reads.push_back(ch);
+          }
         }
         if (ch -> writable()) {
-          assert(nwrites<MAX_SOCKETS);
-          writes[nwrites++] = ch ;
+          interested = true;
+          if (!persistent || ch->writeReady) {
+            writes.push_back(ch);
+          }
         }
-    } // of array-filling pass
-    
-    reads[nreads] = NULL ;
-    writes[nwrites] = NULL ;
+    } // of channel pass
 
     if (!nopen)
       return false ;
-    if (!nreads && !nwrites)
+    if (!interested)
       return true ; //hmmm- should we shutdown?
 
-    Socket::select (reads, writes, timeout) ;
+    waitForEvents(timeout);
 
-    for ( int i=0; reads[i]; i++ )
+    for ( size_t i=0; i < reads.size(); i++ )
     {
-      NetChannel* ch = (NetChannel*)reads[i];
-      if ( ! ch -> closed )
+      NetChannel* ch = reads[i];
+      if ( ! ch -> closed ) {
+        if (ch->accepting) {
+          // level-triggered, will be reported again while pending
+          ch->readReady = false;
+        }
         ch -> handleReadEvent();
+      }
     }
 
-    for ( int i=0; writes[i]; i++ )
+    for ( size_t i=0; i < writes.size(); i++ )
     {
-      NetChannel* ch = (NetChannel*)writes[i];
+      NetChannel* ch = writes[i];
       if ( ! ch -> closed )
         ch -> handleWriteEvent();
     }
@@ -350,6 +492,93 @@ NetChannelPoller::poll(unsigned int timeout)
     return true ;
 }
 
+void
+NetChannelPoller::waitForEvents(unsigned int timeout)
+{
+#if defined(SG_NETCHANNEL_EPOLL)
+    if (pollerHandle >= 0) {
+        enum { MAX_EVENTS = 256 };
+        struct epoll_event events[MAX_EVENTS];
+
+        // don't block if some channels are already known to be ready
+        int waitTime = (reads.empty() && writes.empty()) ? (int) timeout : 0;
+        int n = epoll_wait(pollerHandle, events, MAX_EVENTS, waitTime);
+        for (int i = 0; i < n; ++i) {
+            NetChannel* ch = static_cast<NetChannel*>(events[i].data.ptr);
+            const uint32_t e = events[i].events;
+            if ((e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && !ch->readReady) {
+                ch->readReady = true;
+                if (ch->readable()) {
+                    reads.push_back(ch);
+                }
+            }
+
+            if ((e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) && !ch->writeReady) {
+                ch->writeReady = true;
+                if (ch->writable()) {
+                    writes.push_back(ch);
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+#if defined(SG_NETCHANNEL_POLL)
+    std::vector<struct pollfd> fds;
+    fds.reserve(reads.size() + writes.size());
+    for (size_t i = 0; i < reads.size(); ++i) {
+        struct pollfd p = { reads[i]->getHandle(), POLLIN, 0 };
+        fds.push_back(p);
+    }
+    for (size_t i = 0; i < writes.size(); ++i) {
+        struct pollfd p = { writes[i]->getHandle(), POLLOUT, 0 };
+        fds.push_back(p);
+    }
+
+    int result = ::poll(fds.data(), fds.size(), timeout);
+    if (result <= 0) {
+        reads.clear();
+        writes.clear();
+        return;
+    }
+
+    // remove channels that had no activity
+    size_t k = 0;
+    for (size_t i = 0; i < reads.size(); ++i) {
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            reads[k++] = reads[i];
+        }
+    }
+    const size_t nreads = reads.size();
+    reads.resize(k);
+
+    k = 0;
+    for (size_t i = 0; i < writes.size(); ++i) {
+        if (fds[nreads + i].revents & (POLLOUT | POLLHUP | POLLERR)) {
+            writes[k++] = writes[i];
+        }
+    }
+    writes.resize(k);
+#else
+    // select() wants NULL-terminated arrays
+    std::vector<Socket*> r(reads.begin(), reads.end()), w(writes.begin(), writes.end());
+    r.push_back(NULL);
+    w.push_back(NULL);
+    Socket::select (r.data(), w.data(), timeout) ;
+
+    reads.clear();
+    for (size_t i = 0; r[i]; ++i) {
+        reads.push_back(static_cast<NetChannel*>(r[i]));
+    }
+
+    writes.clear();
+    for (size_t i = 0; w[i]; ++i) {
+        writes.push_back(static_cast<NetChannel*>(w[i]));
+    }
+#endif
+}
+
 void
 NetChannelPoller::loop (unsigned int timeout)
 {
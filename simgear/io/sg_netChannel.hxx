@@ -71,6 +71,11 @@ class NetChannel : public Socket
   
     friend class NetChannelPoller;
     NetChannelPoller* poller;
+
+    // readiness bookkeeping for the poller's persistent (epoll) backend
+    int registeredHandle;
+    bool registeredAccepting;
+    bool readReady, writeReady;
 public:
 
   NetChannel () ;
@@ -90,8 +95,13 @@ public:
   int   listen  ( int backlog ) ;
   int   connect ( const char* host, int port ) ;
   int   send    ( const void * buf, int size, int flags = 0 ) ;
+  int   sendv   ( const char* const* buffers, const int* sizes, int count, int flags = 0 ) ;
   int   recv    ( void * buf, int size, int flags = 0 ) ;
 
+private:
+  int   handleSendResult ( int result, int size ) ;
+public:
+
   // poll() eligibility predicates
   virtual bool readable (void) { return (connected || accepting); }
   virtual bool writable (void) { return (!connected || write_blocked); }
@@ -115,11 +125,33 @@ public:
 
 };
 
+/**
+ * Dispatches read/write events to a set of channels.
+ *
+ * On Linux, channels are registered once with an edge-triggered epoll
+ * instance, and readiness is remembered per channel until a recv()/send()
+ * would block, so each poll only touches the channels which are actually
+ * active. Elsewhere poll() (or select() on Windows) is used, without the
+ * FD_SETSIZE limit of the latter where possible.
+ */
 class NetChannelPoller
 {
     typedef std::vector<NetChannel*> ChannelList;
     ChannelList channels;
+    ChannelList reads, writes; // scratch lists, reused between polls
+    int pollerHandle; ///< epoll instance, or -1 if not in use
+
+    friend class NetChannel;
+    void updateRegistration(NetChannel* channel);
+    void unregisterChannel(NetChannel* channel);
+    void waitForEvents(unsigned int timeout);
+
+    NetChannelPoller(const NetChannelPoller&); // = delete;
+    NetChannelPoller& operator=(const NetChannelPoller&); // = delete;
 public:
+    NetChannelPoller();
+    ~NetChannelPoller();
+
     void addChannel(NetChannel* channel);
     void removeChannel(NetChannel* channel);
     
@@ -73,15 +73,25 @@ find_prefix_at_end(const NetBuffer& haystack, const std::string& needle)
   return 0;
 }
 
+// binary-safe search for needle, skipping quickly between occurrences
+// of its first character
 static int
 find_terminator(const NetBuffer& haystack, const std::string& needle)
 {
   if( !needle.empty() )
   {
     const char* data = haystack.getData();
-    const char* ptr = strstr(data,needle.c_str());
-    if (ptr != NULL)
-      return(ptr-data);
+    const char* end = data + haystack.getLength();
+    const int nl = needle.length();
+    const char* p = data;
+    while ((end - p) >= nl) {
+      p = static_cast<const char*>(memchr(p, needle[0], (end - p) - nl + 1));
+      if (p == NULL)
+        break;
+      if (memcmp(p, needle.c_str(), nl) == 0)
+        return(p-data);
+      ++p;
+    }
   }
   return -1;
 }
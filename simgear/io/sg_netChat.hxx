@@ -66,6 +66,12 @@
 namespace simgear
 {
 
+/*
+**  Incoming data is passed to collectIncomingData() as soon as it is known
+**  not to be part of a terminator, so only a partial terminator at the end
+**  of a read stays in the buffer and is searched again: no separate search
+**  state is needed for the terminator search to be incremental.
+*/
 class NetChat : public NetBufferChannel
 {
   std::string terminator;
@@ -39,7 +39,8 @@ using std::string;
 SGSocketUDP::SGSocketUDP( const string& host, const string& port ) :
     hostname(host),
     port_str(port),
-    save_len(0)
+    save_len(0),
+    reuse_port(false)
 {
     set_valid( false );
 }
@@ -60,6 +61,10 @@ bool SGSocketUDP::open( const SGProtocolDir d ) {
 	return false;
     }
 
+    if ( reuse_port && ! sock.setReusePort( true ) ) {
+	SG_LOG( SG_IO, SG_WARN, "SO_REUSEPORT not available for port " << port_str );
+    }
+
     if ( port_str == "" || port_str == "any" ) {
 	port = 0; 
     } else {
@@ -185,6 +190,36 @@ int SGSocketUDP::write( const char *buf, const int length ) {
 }
 
 
+// read queued datagrams into a batch (server)
+int SGSocketUDP::readBatch( simgear::DatagramBatch& batch ) {
+    if ( ! isvalid() ) {
+	return -1;
+    }
+
+    return sock.recvBatch( batch );
+}
+
+
+// write a batch of datagrams to socket (client)
+int SGSocketUDP::writeBatch( simgear::DatagramBatch& batch ) {
+    if ( ! isvalid() ) {
+	return -1;
+    }
+
+    int result = sock.sendBatch( batch );
+    if ( result < 0 ) {
+	if ( simgear::Socket::isNonBlockingError() ) {
+	    // send buffer full; the datagrams stay pending in the batch
+	    return 0;
+	}
+	SG_LOG( SG_IO, SG_WARN, "Error writing to socket: " << port );
+	return -1;
+    }
+
+    return result;
+}
+
+
 // write null terminated string to socket (server)
 int SGSocketUDP::writestring( const char *str ) {
     if ( !isvalid() ) {
@@ -52,6 +52,7 @@ private:
     int save_len;
 
     short unsigned int port;
+    bool reuse_port;
 
 public:
 
@@ -111,6 +112,20 @@ public:
     // write null terminated string to a socket
     int writestring( const char *str );
 
+    /**
+     * Read as many queued datagrams as fit in the batch, with a single
+     * system call where the platform allows it.
+     * @return number of datagrams read, or -1 on error
+     */
+    int readBatch( simgear::DatagramBatch& batch );
+
+    /**
+     * Write the pending datagrams of the batch to the connected peer.
+     * @return number of datagrams written, 0 if the socket would block,
+     * or -1 on error
+     */
+    int writeBatch( simgear::DatagramBatch& batch );
+
     // close file
     bool close();
 
@@ -120,6 +135,12 @@ public:
      */
     bool setBlocking( bool value );
 
+    /**
+     * Allow several sockets to bind the same port, so receiving can be
+     * spread over threads. Must be called before open().
+     */
+    void setReusePort( bool value ) { reuse_port = value; }
+
     /** @return the remote host name */
     inline std::string get_hostname() const { return hostname; }
 
@@ -0,0 +1,264 @@
+////////////////////////////////////////////////////////////////////////
+// Test harness for the DNS::Client cache, using a local stub resolver.
+////////////////////////////////////////////////////////////////////////
+
+#include <simgear_config.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+
+#include "DNSClient.hxx"
+#include "raw_socket.hxx"
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using namespace simgear;
+
+static const char* KNOWN_NAME = "terrasync.test";
+static const unsigned TTL = 2;
+
+/**
+ * Minimal DNS server: answers NAPTR queries for KNOWN_NAME with two
+ * records, names in 'silent' not at all, and everything else with
+ * NXDOMAIN. Counts queries per name.
+ */
+class StubResolver
+{
+public:
+    std::map<std::string, int> queries;
+    std::set<std::string> silent;
+    int port;
+
+    StubResolver()
+    {
+        _socket.open(false);
+        for (port = 47400; port < 47500; ++port) {
+            if (_socket.bind("127.0.0.1", port) == 0) {
+                break;
+            }
+        }
+        _socket.setBlocking(false);
+    }
+
+    void poll()
+    {
+        unsigned char buf[512];
+        IPAddress from;
+        int len;
+        while ((len = _socket.recvfrom(buf, sizeof(buf), 0, &from)) > 12) {
+            std::string name;
+            int pos = 12;
+            while ((pos < len) && buf[pos]) {
+                if (!name.empty()) name += ".";
+                name.append((const char*) buf + pos + 1, buf[pos]);
+                pos += buf[pos] + 1;
+            }
+            pos += 5; // root label, type and class
+            queries[name]++;
+            if (silent.count(name)) {
+                continue;
+            }
+
+            std::string reply((const char*) buf, pos);
+            reply[2] = (char) 0x81; // response, recursion desired
+            reply[3] = (char) 0x80; // recursion available
+            reply[10] = reply[11] = 0; // no additional records
+            reply[6] = reply[7] = 0;
+
+            if (name == KNOWN_NAME) {
+                reply[7] = 2;
+                addNAPTR(reply, 10, 50, "!^.*$!http://b.test/!");
+                addNAPTR(reply, 10, 20, "!^.*$!http://a.test/!");
+            } else {
+                reply[3] |= 3; // NXDOMAIN
+            }
+
+            _socket.sendto(reply.data(), reply.size(), 0, &from);
+        }
+    }
+
+private:
+    static void add16(std::string& s, int v)
+    {
+        s += (char) (v >> 8);
+        s += (char) (v & 0xff);
+    }
+
+    static void addString(std::string& s, const std::string& str)
+    {
+        s += (char) str.size();
+        s += str;
+    }
+
+    static void addNAPTR(std::string& s, int order, int preference, const std::string& regexp)
+    {
+        std::string rdata;
+        add16(rdata, order);
+        add16(rdata, preference);
+        addString(rdata, "U");
+        addString(rdata, "ws20");
+        addString(rdata, regexp);
+        rdata += (char) 0; // empty replacement
+
+        add16(s, 0xc00c); // name: pointer to the question
+        add16(s, 35); // NAPTR
+        add16(s, 1); // IN
+        add16(s, 0);
+        add16(s, TTL);
+        add16(s, rdata.size());
+        s += rdata;
+    }
+
+    Socket _socket;
+};
+
+static void pump(DNS::Client& client, StubResolver& stub, int msec)
+{
+    SGTimeStamp start = SGTimeStamp::now();
+    do {
+        stub.poll();
+        client.update(0);
+        SGTimeStamp::sleepForMSec(10);
+    } while ((SGTimeStamp::now() - start).toMSecs() < msec);
+}
+
+static DNS::NAPTRRequest* makeNAPTR(const char* dn)
+{
+    DNS::NAPTRRequest* r = new DNS::NAPTRRequest(dn);
+    r->qservice = "ws20";
+    r->qflags = "U";
+    return r;
+}
+
+static void waitFor(DNS::Client& client, StubResolver& stub, const DNS::Request_ptr& r)
+{
+    for (int i = 0; (i < 200) && !r->isComplete(); ++i) {
+        pump(client, stub, 10);
+    }
+    SG_VERIFY(r->isComplete());
+}
+
+int main(int argc, char* argv[])
+{
+    Socket::initSockets();
+
+    StubResolver stub;
+    DNS::Client client;
+    client.setNameServer("127.0.0.1", stub.port);
+
+    // concurrent requests for the same query share one lookup
+    DNS::NAPTRRequest* first = makeNAPTR(KNOWN_NAME);
+    DNS::Request_ptr r1(first), r2(makeNAPTR(KNOWN_NAME)), r3(makeNAPTR(KNOWN_NAME));
+    client.makeRequest(r1);
+    client.makeRequest(r2);
+    client.makeRequest(r3);
+    waitFor(client, stub, r1);
+    SG_VERIFY(r2->isComplete() && r3->isComplete());
+    SG_CHECK_EQUAL(stub.queries[KNOWN_NAME], 1);
+    SG_CHECK_EQUAL(first->entries.size(), 2u);
+    SG_CHECK_EQUAL(first->entries[0]->preference, 20);
+    SG_CHECK_EQUAL(first->ttl, TTL);
+    SG_CHECK_EQUAL(static_cast<DNS::NAPTRRequest*>(r3.get())->entries.size(), 2u);
+
+    DNS::Client::CacheStats stats = client.getCacheStats();
+    SG_CHECK_EQUAL(stats.misses, 1u);
+    SG_CHECK_EQUAL(stats.coalesced, 2u);
+
+    // answered from the cache, without waiting for update()
+    DNS::NAPTRRequest* cached = makeNAPTR(KNOWN_NAME);
+    DNS::Request_ptr r4(cached);
+    client.makeRequest(r4);
+    SG_VERIFY(r4->isComplete());
+    SG_CHECK_EQUAL(cached->entries.size(), 2u);
+    SG_CHECK_EQUAL(client.getCacheStats().hits, 1u);
+
+    // a different service filter is a different query
+    DNS::NAPTRRequest* other = new DNS::NAPTRRequest(KNOWN_NAME);
+    other->qservice = "ws30";
+    DNS::Request_ptr r5(other);
+    client.makeRequest(r5);
+    waitFor(client, stub, r5);
+    SG_VERIFY(other->entries.empty());
+    SG_CHECK_EQUAL(stub.queries[KNOWN_NAME], 2);
+
+    // failures are cached too
+    DNS::Request_ptr missing(makeNAPTR("missing.test"));
+    client.makeRequest(missing);
+    waitFor(client, stub, missing);
+    SG_VERIFY(missing->isFailed());
+    int missingQueries = stub.queries["missing.test"];
+    SG_VERIFY(missingQueries >= 1);
+
+    DNS::Request_ptr missingAgain(makeNAPTR("missing.test"));
+    client.makeRequest(missingAgain);
+    SG_VERIFY(missingAgain->isComplete() && missingAgain->isFailed());
+    SG_CHECK_EQUAL(client.getCacheStats().negativeHits, 1u);
+    SG_CHECK_EQUAL(stub.queries["missing.test"], missingQueries);
+
+    // the entry in use is refreshed in the background before it expires,
+    // so a request after the original TTL is still a hit
+    pump(client, stub, (TTL * 1000) + 300);
+    SG_CHECK_EQUAL(stub.queries[KNOWN_NAME], 3);
+    SG_CHECK_EQUAL(client.getCacheStats().prefetches, 1u);
+
+    DNS::Request_ptr r6(makeNAPTR(KNOWN_NAME));
+    client.makeRequest(r6);
+    SG_VERIFY(r6->isComplete());
+    SG_CHECK_EQUAL(client.getCacheStats().hits, 2u);
+    SG_CHECK_EQUAL(client.getCacheStats().misses, 3u);
+
+    // unused entries expire and need a new lookup
+    client.setNegativeTTL(0);
+    client.clearCache();
+    SG_CHECK_EQUAL(client.getCacheStats().entries, 0u);
+    DNS::Request_ptr r7(makeNAPTR(KNOWN_NAME));
+    client.makeRequest(r7);
+    SG_VERIFY(!r7->isComplete());
+    waitFor(client, stub, r7);
+    SG_CHECK_EQUAL(client.getCacheStats().misses, 4u);
+
+    pump(client, stub, (TTL * 1000) + 300);
+    SG_CHECK_EQUAL(client.getCacheStats().entries, 0u);
+    SG_CHECK_EQUAL(client.getCacheStats().prefetches, 1u);
+
+    // a lookup which gets no answer fails its waiters and is remembered
+    // for a short time only
+    client.setNegativeTTL(60);
+    stub.silent.insert("silent.test");
+    DNS::Request_ptr quiet(makeNAPTR("silent.test"));
+    quiet->setTimeout(1);
+    client.makeRequest(quiet);
+    waitFor(client, stub, quiet);
+    SG_VERIFY(quiet->isFailed());
+    SG_CHECK_EQUAL(client.getCacheStats().timeouts, 1u);
+    int silentQueries = stub.queries["silent.test"];
+
+    DNS::Request_ptr quietAgain(makeNAPTR("silent.test"));
+    client.makeRequest(quietAgain);
+    SG_VERIFY(quietAgain->isComplete() && quietAgain->isFailed());
+    SG_CHECK_EQUAL(stub.queries["silent.test"], silentQueries);
+
+    // changing the server while a lookup is in flight sends it again;
+    // its waiters complete from the new lookup
+    stub.silent.clear();
+    DNS::Request_ptr moved(makeNAPTR(KNOWN_NAME));
+    client.makeRequest(moved);
+    SG_VERIFY(!moved->isComplete());
+    client.setNameServer("127.0.0.1", stub.port);
+    SG_CHECK_EQUAL(client.getCacheStats().entries, 1u);
+    waitFor(client, stub, moved);
+    SG_VERIFY(!moved->isFailed());
+    SG_CHECK_EQUAL(static_cast<DNS::NAPTRRequest*>(moved.get())->entries.size(), 2u);
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////
+// Test harness (and benchmark) for NetChannelPoller.
+////////////////////////////////////////////////////////////////////////
+
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "sg_netBuffer.hxx"
+#include "sg_netChat.hxx"
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using namespace simgear;
+
+class CountingChannel : public NetBufferChannel
+{
+public:
+    size_t received = 0;
+
+    virtual void handleBufferRead(NetBuffer& buffer)
+    {
+        received += buffer.getLength();
+        buffer.remove();
+    }
+};
+
+struct ChannelPair
+{
+    CountingChannel* channel; // our end, owned by the poller
+    int peer; // the other end of the socket pair
+};
+
+static std::vector<ChannelPair> createPairs(NetChannelPoller& poller, int count)
+{
+    std::vector<ChannelPair> result;
+    for (int i = 0; i < count; ++i) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            cerr << "socketpair failed: " << strerror(errno) << endl;
+            exit(1);
+        }
+
+        ChannelPair p;
+        p.channel = new CountingChannel;
+        p.channel->setHandle(fds[0]);
+        p.channel->setBlocking(false);
+        p.peer = fds[1];
+        poller.addChannel(p.channel);
+        result.push_back(p);
+    }
+
+    return result;
+}
+
+static void destroyPairs(NetChannelPoller& poller, std::vector<ChannelPair>& pairs)
+{
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        ::close(pairs[i].peer);
+        pairs[i].channel->shouldDelete();
+    }
+
+    poller.poll(0);
+    pairs.clear();
+}
+
+// more channels than the old select()-based poller could handle, most of
+// them idle, with data arriving on a few
+void testManyChannels()
+{
+    NetChannelPoller poller;
+    std::vector<ChannelPair> pairs = createPairs(poller, 300);
+
+    const char msg[] = "hello";
+    for (size_t i = 0; i < pairs.size(); i += 30) {
+        SG_VERIFY(::write(pairs[i].peer, msg, 5) == 5);
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        poller.poll(10);
+    }
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        SG_CHECK_EQUAL(pairs[i].channel->received, (i % 30) ? 0u : 5u);
+    }
+
+    // data arriving again on an already-ready channel
+    SG_VERIFY(::write(pairs[30].peer, msg, 5) == 5);
+    for (int i = 0; i < 5; ++i) {
+        poller.poll(10);
+    }
+    SG_CHECK_EQUAL(pairs[30].channel->received, 10u);
+
+    destroyPairs(poller, pairs);
+    SG_VERIFY(!poller.hasChannels());
+}
+
+// more data than a single read consumes: readiness must persist until
+// the socket is drained, even with edge-triggered notification
+void testLargeReadAndWrite()
+{
+    NetChannelPoller poller;
+    std::vector<ChannelPair> pairs = createPairs(poller, 2);
+
+    std::vector<char> data(20000, 'x');
+    SG_VERIFY(::write(pairs[0].peer, data.data(), data.size()) == (ssize_t) data.size());
+
+    // output is flushed in pieces by handleWrite()
+    SG_VERIFY(pairs[1].channel->bufferSend(data.data(), 10000));
+
+    size_t peerReceived = 0;
+    char buf[4096];
+    for (int i = 0; i < 200; ++i) {
+        poller.poll(1);
+        ssize_t n;
+        while ((n = ::recv(pairs[1].peer, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            peerReceived += n;
+        }
+    }
+
+    SG_CHECK_EQUAL(pairs[0].channel->received, data.size());
+    SG_CHECK_EQUAL(peerReceived, 10000u);
+
+    // closing the peer is seen as end-of-file
+    ::close(pairs[0].peer);
+    pairs[0].peer = -1;
+    for (int i = 0; i < 5; ++i) {
+        poller.poll(1);
+    }
+    SG_VERIFY(pairs[0].channel->isClosed());
+
+    destroyPairs(poller, pairs);
+}
+
+class LineChannel : public NetChat
+{
+public:
+    std::string current;
+    std::vector<std::string> lines;
+
+    LineChannel() { setTerminator("\r\n"); }
+
+    virtual void collectIncomingData(const char* s, int n)
+    {
+        current.append(s, n);
+    }
+
+    virtual void foundTerminator()
+    {
+        lines.push_back(current);
+        current.clear();
+    }
+};
+
+// terminators split across reads, several per read, and binary payloads
+void testChatTerminators()
+{
+    NetChannelPoller poller;
+    int fds[2];
+    SG_VERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    LineChannel* chat = new LineChannel;
+    chat->setHandle(fds[0]);
+    chat->setBlocking(false);
+    poller.addChannel(chat);
+
+    const char* pieces[] = { "one\r", "\ntwo\r\nthr", "ee\r\n\r", "\n" };
+    for (int i = 0; i < 4; ++i) {
+        SG_VERIFY(::write(fds[1], pieces[i], strlen(pieces[i])) == (ssize_t) strlen(pieces[i]));
+        poller.poll(10);
+    }
+
+    const char binary[] = { 'a', 0, 'b', '\r', '\n' };
+    SG_VERIFY(::write(fds[1], binary, sizeof(binary)) == sizeof(binary));
+    poller.poll(10);
+
+    SG_CHECK_EQUAL(chat->lines.size(), 5u);
+    SG_CHECK_EQUAL(chat->lines[0], "one");
+    SG_CHECK_EQUAL(chat->lines[1], "two");
+    SG_CHECK_EQUAL(chat->lines[2], "three");
+    SG_CHECK_EQUAL(chat->lines[3], "");
+    SG_CHECK_EQUAL(chat->lines[4], std::string(binary, 3));
+
+    // output larger than a single block is queued and flushed in order
+    std::string out;
+    for (int i = 0; i < 2000; ++i) {
+        out += std::to_string(i) + "\r\n";
+    }
+    SG_VERIFY(chat->push(out.c_str()));
+
+    std::string received;
+    char buf[4096];
+    for (int i = 0; (i < 100) && (received.size() < out.size()); ++i) {
+        poller.poll(1);
+        ssize_t n;
+        while ((n = ::recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            received.append(buf, n);
+        }
+    }
+    SG_VERIFY(received == out);
+
+    ::close(fds[1]);
+    chat->shouldDelete();
+    poller.poll(0);
+}
+
+// callers filling the free space after getData()+getLength() themselves,
+// as the original NetBuffer allowed, must stay within the buffer after
+// data was consumed from the front
+void testBufferSpace()
+{
+    NetBuffer buffer(16);
+    SG_VERIFY(buffer.append("0123456789", 10));
+    buffer.remove(0, 7);
+    SG_CHECK_EQUAL(buffer.getLength(), 3);
+
+    // consumed bytes are skipped until the free bytes at the end run out
+    SG_CHECK_EQUAL(buffer.getTailLength(), 6);
+    SG_VERIFY(std::string(buffer.getData(), 3) == "789");
+
+    int space = buffer.getMaxLength() - buffer.getLength();
+    char* end = buffer.getSpace();
+    SG_VERIFY(end == buffer.getData() + buffer.getLength());
+    SG_CHECK_EQUAL(buffer.getTailLength(), space);
+    memset(buffer.getData() + buffer.getLength(), 'x', space);
+    SG_VERIFY(buffer.append(space));
+    SG_CHECK_EQUAL(buffer.getLength(), 16);
+    SG_VERIFY(!buffer.append(1));
+    SG_VERIFY(std::string(buffer.getData(), 4) == "789x");
+
+    // consuming one byte at a time keeps the data intact
+    std::string expected(buffer.getData(), buffer.getLength());
+    for (int i = 0; i < 40; ++i) {
+        buffer.remove(0, 1);
+        expected.erase(0, 1);
+        SG_VERIFY(buffer.append("y", 1));
+        expected += "y";
+        SG_VERIFY(std::string(buffer.getData(), buffer.getLength()) == expected);
+        end = buffer.getSpace();
+        SG_VERIFY(end == buffer.getData() + buffer.getLength());
+    }
+}
+
+void benchmark(int idle, int active, int iterations)
+{
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    NetChannelPoller poller;
+    std::vector<ChannelPair> idlePairs = createPairs(poller, idle);
+    std::vector<ChannelPair> activePairs = createPairs(poller, active);
+
+    // settle initial readiness notifications
+    for (int i = 0; i < 5; ++i) {
+        poller.poll(0);
+    }
+
+    const char msg[64] = {0};
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (size_t a = 0; a < activePairs.size(); ++a) {
+            if (::write(activePairs[a].peer, msg, sizeof(msg)) < 0) {
+                cerr << "write failed: " << strerror(errno) << endl;
+                exit(1);
+            }
+        }
+
+        poller.poll(0);
+    }
+
+    double usec = (SGTimeStamp::now() - start).toUSecs();
+    cout << idle << " idle + " << active << " active channels: "
+         << (usec / iterations) << " usec per poll" << endl;
+
+    destroyPairs(poller, idlePairs);
+    destroyPairs(poller, activePairs);
+}
+
+int main(int argc, char* argv[])
+{
+    Socket::initSockets();
+
+    if ((argc > 1) && !strcmp(argv[1], "--bench")) {
+        int idle = (argc > 2) ? atoi(argv[2]) : 10000;
+        int active = (argc > 3) ? atoi(argv[3]) : 100;
+        benchmark(idle, active, 1000);
+        return EXIT_SUCCESS;
+    }
+
+    testManyChannels();
+    testLargeReadAndWrite();
+    testChatTerminators();
+    testBufferSpace();
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////
+// Test harness (and benchmark) for batched UDP send / receive.
+////////////////////////////////////////////////////////////////////////
+
+#include <simgear_config.h>
+#include <simgear/compiler.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#include "raw_socket.hxx"
+#include "sg_socket_udp.hxx"
+
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using namespace simgear;
+
+static const int BATCH_SIZE = 32;
+static const int PACKET_SIZE = 200;
+
+static int bindLoopback(Socket& sock)
+{
+    for (int port = 47300; port < 47400; ++port) {
+        if (sock.bind("127.0.0.1", port) == 0) {
+            return port;
+        }
+    }
+
+    cerr << "unable to bind a loopback UDP port" << endl;
+    exit(1);
+}
+
+static void fillPacket(char* buf, int seq)
+{
+    memset(buf, 'a' + (seq % 26), PACKET_SIZE);
+    memcpy(buf, &seq, sizeof(seq));
+}
+
+// receive 'count' packets, checking contents and ordering
+static int receiveAll(Socket& server, DatagramBatch& batch, int first, int count)
+{
+    int expected = first;
+    for (int tries = 0; (expected < first + count) && (tries < 1000); ++tries) {
+        int n = server.recvBatch(batch);
+        SG_VERIFY(n > 0);
+        SG_CHECK_EQUAL(batch.count(), n);
+        for (int i = 0; i < n; ++i) {
+            char buf[PACKET_SIZE];
+            fillPacket(buf, expected);
+            SG_CHECK_EQUAL(batch.packetSize(i), PACKET_SIZE);
+            SG_VERIFY(memcmp(batch.packetData(i), buf, PACKET_SIZE) == 0);
+            ++expected;
+        }
+    }
+
+    return expected - first;
+}
+
+void testBatch()
+{
+    Socket server, client;
+    SG_VERIFY(server.open(false));
+    SG_VERIFY(client.open(false));
+    int port = bindLoopback(server);
+    SG_VERIFY(client.connect("127.0.0.1", port) == 0);
+
+    DatagramBatch out(BATCH_SIZE, PACKET_SIZE);
+    DatagramBatch in(BATCH_SIZE, 1500);
+    SG_CHECK_EQUAL(out.capacity(), BATCH_SIZE);
+    SG_CHECK_EQUAL(out.count(), 0);
+
+    char buf[PACKET_SIZE + 1];
+    SG_VERIFY(!out.add(buf, PACKET_SIZE + 1)); // too large
+
+    int seq = 0;
+    for (int round = 0; round < 8; ++round) {
+        int first = seq;
+        while (out.count() < out.capacity()) {
+            fillPacket(buf, seq++);
+            SG_VERIFY(out.add(buf, PACKET_SIZE));
+        }
+        SG_VERIFY(!out.add(buf, PACKET_SIZE)); // full
+
+        int sent = 0;
+        while (out.pending() > 0) {
+            int n = client.sendBatch(out);
+            SG_VERIFY(n > 0);
+            sent += n;
+        }
+        SG_CHECK_EQUAL(sent, BATCH_SIZE);
+        SG_CHECK_EQUAL(out.count(), 0); // cleared once fully sent
+
+        SG_CHECK_EQUAL(receiveAll(server, in, first, BATCH_SIZE), BATCH_SIZE);
+    }
+
+    // explicit destinations on an unconnected socket
+    Socket sender;
+    SG_VERIFY(sender.open(false));
+    IPAddress dest("127.0.0.1", port);
+    for (int i = 0; i < 4; ++i) {
+        fillPacket(buf, seq + i);
+        SG_VERIFY(out.add(buf, PACKET_SIZE, &dest));
+    }
+    SG_CHECK_EQUAL(sender.sendBatch(out), 4);
+    SG_CHECK_EQUAL(receiveAll(server, in, seq, 4), 4);
+    SG_CHECK_EQUAL(in.packetAddress(0).getHost(), std::string("127.0.0.1"));
+}
+
+void testSocketUDP()
+{
+    Socket server;
+    SG_VERIFY(server.open(false));
+    int port = bindLoopback(server);
+
+    DatagramBatch out(BATCH_SIZE, PACKET_SIZE);
+    DatagramBatch in(BATCH_SIZE, 1500);
+    char buf[PACKET_SIZE];
+    for (int i = 0; i < 4; ++i) {
+        fillPacket(buf, i);
+        SG_VERIFY(out.add(buf, PACKET_SIZE));
+    }
+
+    char portStr[16];
+    snprintf(portStr, sizeof(portStr), "%d", port);
+    SGSocketUDP client("127.0.0.1", portStr);
+    SG_CHECK_EQUAL(client.writeBatch(out), -1); // not open yet
+    SG_CHECK_EQUAL(out.pending(), 4);
+
+    SG_VERIFY(client.open(SG_IO_OUT));
+    SG_CHECK_EQUAL(client.writeBatch(out), 4);
+    SG_CHECK_EQUAL(receiveAll(server, in, 0, 4), 4);
+    client.close();
+}
+
+void benchmark(int packets)
+{
+    Socket server, client;
+    server.open(false);
+    client.open(false);
+    int port = bindLoopback(server);
+    client.connect("127.0.0.1", port);
+
+    DatagramBatch out(BATCH_SIZE, PACKET_SIZE);
+    DatagramBatch in(BATCH_SIZE, 1500);
+    char buf[1500];
+    memset(buf, 'x', sizeof(buf));
+
+    SGTimeStamp start = SGTimeStamp::now();
+    for (int i = 0; i < packets; i += BATCH_SIZE) {
+        for (int j = 0; j < BATCH_SIZE; ++j) {
+            client.send(buf, PACKET_SIZE);
+        }
+        for (int j = 0; j < BATCH_SIZE; ++j) {
+            server.recv(buf, sizeof(buf));
+        }
+    }
+    double single = (SGTimeStamp::now() - start).toUSecs();
+
+    start = SGTimeStamp::now();
+    for (int i = 0; i < packets; i += BATCH_SIZE) {
+        while (out.add(buf, PACKET_SIZE)) {}
+        while (out.pending() > 0) {
+            client.sendBatch(out);
+        }
+        for (int received = 0; received < BATCH_SIZE; ) {
+            received += server.recvBatch(in);
+        }
+    }
+    double batched = (SGTimeStamp::now() - start).toUSecs();
+
+    cout << packets << " packets: single " << (single / packets)
+         << " usec/packet, batched " << (batched / packets) << " usec/packet" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    Socket::initSockets();
+
+    if ((argc > 1) && !strcmp(argv[1], "--bench")) {
+        benchmark((argc > 2) ? atoi(argv[2]) : 100000);
+        return EXIT_SUCCESS;
+    }
+
+    testBatch();
+    testSocketUDP();
+
+    cout << "all tests passed" << endl;
+    return EXIT_SUCCESS;
+}
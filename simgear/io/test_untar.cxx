@@ -8,10 +8,12 @@
 #include <iostream>
 
 #include "untar.hxx"
+#include "test_zip.hxx"
 
 #include <simgear/misc/test_macros.hxx>
 #include <simgear/misc/sg_path.hxx>
 #include <simgear/io/sg_file.hxx>
+#include <simgear/misc/sg_dir.hxx>
 
 
 using std::cout;
@@ -50,10 +52,124 @@ void testPlainTar()
 
 }
 
+void testStreamingZip()
+{
+    SGPath p = SGPath(SRC_DIR);
+    p.append("test.zip");
+
+    SGBinaryFile f(p);
+    f.open(SG_IO_IN);
+
+    SGPath extractPath = simgear::Dir::current().path() / "test_zip_extract";
+    simgear::Dir extractDir(extractPath);
+    if (extractDir.exists()) {
+        extractDir.remove(true);
+    }
+    extractDir.create(0755);
+
+    ZipExtractor zx(extractPath);
+
+    // feed the archive in small, odd-sized pieces, so records and
+    // compressed data are split across calls as with an HTTP download
+    char buf[7];
+    bool first = true;
+    for (;;) {
+        int count = f.read(buf, sizeof(buf));
+        if (count <= 0) {
+            break;
+        }
+
+        if (first) {
+            SG_VERIFY(ZipExtractor::isZipData((const uint8_t*) buf, count));
+            first = false;
+        }
+
+        zx.extractBytes(buf, count);
+    }
+
+    SG_VERIFY(!zx.hasError());
+    SG_VERIFY(zx.isAtEndOfArchive());
+
+    SG_VERIFY((extractPath / "zipdir/deflated.txt").exists());
+    SG_CHECK_EQUAL((extractPath / "zipdir/deflated.txt").sizeInBytes(), 2800);
+    SG_CHECK_EQUAL((extractPath / "zipdir/short.txt").sizeInBytes(), 14);
+    SG_VERIFY((extractPath / "zipdir/sub/nested.txt").exists());
+
+    extractDir.remove(true);
+}
+
+void testZip64Descriptors()
+{
+    std::string text;
+    for (int i = 0; i < 2000; ++i) {
+        text += "line " + std::to_string(i) + " of a streamed zip64 entry\n";
+    }
+
+    std::vector<TestZipWriter::Entry> entries;
+    entries.push_back(TestZipWriter::Entry("z64/", ""));
+    entries.push_back(TestZipWriter::Entry("z64/big.txt", text));
+    entries.push_back(TestZipWriter::Entry("z64/foo..bar.xml", "<PropertyList/>"));
+
+    for (int zip64 = 0; zip64 < 2; ++zip64) {
+        std::string zip = TestZipWriter::streamed(entries, zip64 != 0);
+        SGPath extractPath = simgear::Dir::current().path() / "test_zip64_extract";
+        simgear::Dir extractDir(extractPath);
+        if (extractDir.exists()) {
+            extractDir.remove(true);
+        }
+        extractDir.create(0755);
+
+        ZipExtractor zx(extractPath);
+        for (size_t i = 0; i < zip.size(); i += 5) {
+            zx.extractBytes(zip.data() + i, std::min<size_t>(5, zip.size() - i));
+        }
+
+        SG_VERIFY(!zx.hasError());
+        SG_VERIFY(zx.isAtEndOfArchive());
+        SG_CHECK_EQUAL((extractPath / "z64/big.txt").sizeInBytes(), text.size());
+        SG_VERIFY((extractPath / "z64/foo..bar.xml").exists());
+        extractDir.remove(true);
+    }
+
+    // an entry escaping the root is rejected before anything is written
+    entries.push_back(TestZipWriter::Entry("z64/../../escaped.txt", "x"));
+    std::string zip = TestZipWriter::streamed(entries, true);
+    SGPath extractPath = simgear::Dir::current().path() / "test_zip64_extract";
+    simgear::Dir(extractPath).create(0755);
+    ZipExtractor zx(extractPath);
+    zx.extractBytes(zip.data(), zip.size());
+    SG_VERIFY(zx.hasError());
+    SG_VERIFY(!(simgear::Dir::current().path() / "escaped.txt").exists());
+    simgear::Dir(extractPath).remove(true);
+}
+
+void testSafePaths()
+{
+    SG_VERIFY(ArchiveExtractor::isSafePath("foo/bar.xml"));
+    SG_VERIFY(ArchiveExtractor::isSafePath("foo..bar.xml"));
+    SG_VERIFY(ArchiveExtractor::isSafePath("dir/.../x"));
+    SG_VERIFY(ArchiveExtractor::isSafePath("dir/..hidden"));
+    SG_VERIFY(ArchiveExtractor::isSafePath("dir/"));
+
+    SG_VERIFY(!ArchiveExtractor::isSafePath(""));
+    SG_VERIFY(!ArchiveExtractor::isSafePath(".."));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("../x"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("dir/../../x"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("dir/.."));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("dir\\..\\..\\x"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("/etc/passwd"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("\\windows\\x"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("C:\\windows\\x"));
+    SG_VERIFY(!ArchiveExtractor::isSafePath("c:x"));
+}
+
 int main (int ac, char ** av)
 {
     testTarGz();
     testPlainTar();
+    testStreamingZip();
+    testZip64Descriptors();
+    testSafePaths();
 
 	return 0;
 }
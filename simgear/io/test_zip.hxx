@@ -0,0 +1,138 @@
+#ifndef SIMGEAR_IO_TEST_ZIP_HXX
+#define SIMGEAR_IO_TEST_ZIP_HXX
+
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+namespace simgear
+{
+
+// Writes zip archives the way streaming zip tools do: the sizes and CRC of
+// each deflated entry are unknown in the local header and follow the data
+// in a descriptor. With zip64, the local header carries a Zip64 extra field
+// and the descriptor 64-bit sizes, as from 'zip -fz'.
+class TestZipWriter
+{
+public:
+    typedef std::pair<std::string, std::string> Entry;
+
+    static std::string streamed(const std::vector<Entry>& entries, bool zip64)
+    {
+        std::string zip, central;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const std::string& name = entries[i].first;
+            const std::string& data = entries[i].second;
+            const bool isDir = (name.back() == '/');
+            std::string deflated = isDir ? std::string() : deflate(data);
+            uint32_t crc = crc32(0L, Z_NULL, 0);
+            crc = crc32(crc, (const Bytef*) data.data(), data.size());
+            uint32_t offset = zip.size();
+
+            le32(zip, 0x04034b50);
+            le16(zip, zip64 ? 45 : 20);
+            le16(zip, isDir ? 0 : 1 << 3);
+            le16(zip, isDir ? 0 : 8);
+            le32(zip, 0); // time and date
+            le32(zip, 0); // crc
+            le32(zip, zip64 ? 0xffffffff : 0);
+            le32(zip, zip64 ? 0xffffffff : 0);
+            le16(zip, name.size());
+            le16(zip, zip64 ? 20 : 0);
+            zip += name;
+            if (zip64) {
+                le16(zip, 0x0001);
+                le16(zip, 16);
+                le64(zip, 0);
+                le64(zip, 0);
+            }
+            zip += deflated;
+            if (!isDir) {
+                le32(zip, 0x08074b50);
+                le32(zip, crc);
+                if (zip64) {
+                    le64(zip, deflated.size());
+                    le64(zip, data.size());
+                } else {
+                    le32(zip, deflated.size());
+                    le32(zip, data.size());
+                }
+            }
+
+            le32(central, 0x02014b50);
+            le16(central, 20);
+            le16(central, 20);
+            le16(central, isDir ? 0 : 1 << 3);
+            le16(central, isDir ? 0 : 8);
+            le32(central, 0);
+            le32(central, isDir ? 0 : crc);
+            le32(central, deflated.size());
+            le32(central, data.size());
+            le16(central, name.size());
+            le16(central, 0);
+            le16(central, 0);
+            le16(central, 0);
+            le16(central, 0);
+            le32(central, 0);
+            le32(central, offset);
+            central += name;
+        }
+
+        uint32_t centralOffset = zip.size();
+        zip += central;
+        le32(zip, 0x06054b50);
+        le16(zip, 0);
+        le16(zip, 0);
+        le16(zip, entries.size());
+        le16(zip, entries.size());
+        le32(zip, central.size());
+        le32(zip, centralOffset);
+        le16(zip, 0);
+        return zip;
+    }
+
+private:
+    static std::string deflate(const std::string& data)
+    {
+        z_stream z;
+        memset(&z, 0, sizeof(z));
+        // raw deflate data, without zlib header, as in zip files
+        deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY);
+        std::string out(deflateBound(&z, data.size()), '\0');
+        z.next_in = (Bytef*) data.data();
+        z.avail_in = data.size();
+        z.next_out = (Bytef*) &out[0];
+        z.avail_out = out.size();
+        ::deflate(&z, Z_FINISH);
+        out.resize(z.total_out);
+        deflateEnd(&z);
+        return out;
+    }
+
+    static void le16(std::string& s, uint32_t v)
+    {
+        s += char(v & 0xff);
+        s += char((v >> 8) & 0xff);
+    }
+
+    static void le32(std::string& s, uint32_t v)
+    {
+        le16(s, v & 0xffff);
+        le16(s, v >> 16);
+    }
+
+    static void le64(std::string& s, uint64_t v)
+    {
+        le32(s, v & 0xffffffff);
+        le32(s, v >> 32);
+    }
+};
+
+} // of namespace simgear
+
+#endif // of SIMGEAR_IO_TEST_ZIP_HXX
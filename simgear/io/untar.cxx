@@ -21,10 +21,12 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <cctype>
 #include <stdint.h>
 #include <cstring>
 #include <cstddef>
 #include <algorithm>
+#include <vector>
 
 #include <zlib.h>
 
@@ -263,25 +265,45 @@ public:
 
     bool isSafePath(const std::string& p) const
     {
-        if (p.empty()) {
-            return false;
-        }
+        return ArchiveExtractor::isSafePath(p);
+    }
+};
 
-        // reject absolute paths
-        if (p.at(0) == '/') {
-            return false;
-        }
+ArchiveExtractor::~ArchiveExtractor()
+{
+}
+
+bool ArchiveExtractor::isSafePath(const std::string& p)
+{
+    if (p.empty()) {
+        return false;
+    }
+
+    // reject absolute paths, including Windows drive letters
+    if ((p.at(0) == '/') || (p.at(0) == '\\')) {
+        return false;
+    }
+
+    if ((p.size() >= 2) && (p.at(1) == ':') && isalpha((unsigned char) p.at(0))) {
+        return false;
+    }
 
-        // reject paths containing '..'
-        size_t doubleDot = p.find("..");
-        if (doubleDot != std::string::npos) {
+    // reject 'up' traversals, with either kind of separator; names
+    // merely containing two dots, such as 'foo..bar.xml', are fine
+    size_t begin = 0;
+    for (;;) {
+        size_t end = p.find_first_of("/\\", begin);
+        size_t len = (end == std::string::npos) ? std::string::npos : end - begin;
+        if (p.compare(begin, len, "..") == 0) {
             return false;
         }
 
-        // on POSIX could use realpath to sanity check
-        return true;
+        if (end == std::string::npos) {
+            return true;
+        }
+        begin = end + 1;
     }
-};
+}
 
 TarExtractor::TarExtractor(const SGPath& rootPath) :
     d(new TarExtractorPrivate(this))
@@ -444,4 +466,483 @@ auto TarExtractor::filterPath(std::string& pathToExtract)
     return Accepted;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+
+/* zip record signatures and fields, from the PKWARE APPNOTE */
+
+const uint32_t ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+const uint32_t ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+const uint32_t ZIP_END_OF_CENTRAL_DIR_SIG = 0x06054b50;
+const uint32_t ZIP_DATA_DESCRIPTOR_SIG = 0x08074b50;
+
+const size_t ZIP_LOCAL_HEADER_SIZE = 30;
+const size_t ZIP_SIGNATURE_SIZE = 4;
+const size_t ZIP_DATA_DESCRIPTOR_SIZE = 12; // without the optional signature
+const size_t ZIP64_DATA_DESCRIPTOR_SIZE = 20; // with 64-bit sizes
+
+const uint16_t ZIP_FLAG_ENCRYPTED = 1 << 0;
+const uint16_t ZIP_FLAG_DATA_DESCRIPTOR = 1 << 3;
+
+const uint16_t ZIP_METHOD_STORED = 0;
+const uint16_t ZIP_METHOD_DEFLATED = 8;
+
+const uint32_t ZIP64_SIZE_MARKER = 0xffffffff;
+const uint16_t ZIP64_EXTRA_FIELD_ID = 0x0001;
+
+static uint16_t readLE16(const uint8_t* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+        (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t readLE64(const uint8_t* p)
+{
+    return static_cast<uint64_t>(readLE32(p)) |
+        (static_cast<uint64_t>(readLE32(p + 4)) << 32);
+}
+
+class ZipExtractorPrivate
+{
+public:
+    typedef enum {
+        READING_HEADER = 0,
+        READING_NAME,
+        READING_DATA,
+        READING_DESCRIPTOR,
+        END_OF_ARCHIVE,
+        ERROR_STATE, ///< states above this are error conditions
+        BAD_ARCHIVE,
+        BAD_DATA,
+        IO_ERROR
+    } State;
+
+    SGPath path;
+    State state = READING_HEADER;
+
+    // fixed-size records (local header, name + extra field, data descriptor)
+    // are accumulated here, since they may be split across calls
+    std::vector<uint8_t> record;
+    size_t recordSize = ZIP_LOCAL_HEADER_SIZE;
+
+    // current entry, from its local header
+    uint16_t flags = 0;
+    uint16_t method = 0;
+    uint32_t expectedCrc = 0;
+    uint64_t compressedSize = 0;
+    uint64_t uncompressedSize = 0;
+    uint16_t nameLength = 0;
+    uint16_t extraLength = 0;
+    bool zip64 = false; ///< the entry has a Zip64 extra field
+    std::string entryName;
+
+    bool sizeKnown = true; ///< false for deflated entries with a data descriptor
+    uint64_t bytesRemaining = 0;
+    uLong crc = 0;
+    uint64_t bytesWritten = 0;
+    std::unique_ptr<SGFile> currentFile;
+
+    z_stream zlibStream;
+    uint8_t* zlibOutput;
+    bool haveInitedZLib = false;
+
+    ZipExtractorPrivate(const SGPath& rootPath) :
+        path(rootPath)
+    {
+        memset(&zlibStream, 0, sizeof(z_stream));
+        zlibOutput = (uint8_t*) malloc(ZLIB_DECOMPRESS_BUFFER_SIZE);
+        record.reserve(ZIP_LOCAL_HEADER_SIZE);
+    }
+
+    ~ZipExtractorPrivate()
+    {
+        if (haveInitedZLib) {
+            inflateEnd(&zlibStream);
+        }
+        free(zlibOutput);
+    }
+
+    void processBytes(const char* bytes, size_t count)
+    {
+        while ((count > 0) && (state < END_OF_ARCHIVE)) {
+            size_t used = 0;
+            switch (state) {
+            case READING_HEADER:
+                used = accumulate(bytes, count);
+                if (!checkSignature()) {
+                    break;
+                }
+
+                if (record.size() == recordSize) {
+                    processLocalHeader();
+                }
+                break;
+
+            case READING_NAME:
+                used = accumulate(bytes, count);
+                if (record.size() == recordSize) {
+                    beginEntry();
+                }
+                break;
+
+            case READING_DATA:
+                used = processEntryData(bytes, count);
+                break;
+
+            case READING_DESCRIPTOR:
+                used = accumulate(bytes, count);
+            {
+                // entries with a Zip64 extra field have 64-bit sizes here
+                const size_t descriptorSize = zip64 ? ZIP64_DATA_DESCRIPTOR_SIZE
+                                                    : ZIP_DATA_DESCRIPTOR_SIZE;
+                if (record.size() == ZIP_SIGNATURE_SIZE) {
+                    // the descriptor signature is optional
+                    if (readLE32(record.data()) == ZIP_DATA_DESCRIPTOR_SIG) {
+                        recordSize = ZIP_SIGNATURE_SIZE + descriptorSize;
+                    } else {
+                        recordSize = descriptorSize;
+                    }
+                }
+
+                if (record.size() == recordSize) {
+                    const uint8_t* desc = record.data() + (recordSize - descriptorSize);
+                    finishEntry(readLE32(desc),
+                                zip64 ? readLE64(desc + 12) : readLE32(desc + 8));
+                }
+                break;
+            }
+
+            default:
+                break;
+            }
+
+            bytes += used;
+            count -= used;
+        }
+    }
+
+    size_t accumulate(const char* bytes, size_t count)
+    {
+        size_t n = std::min(recordSize - record.size(), count);
+        record.insert(record.end(), bytes, bytes + n);
+        return n;
+    }
+
+    void expectRecord(State newState, size_t size)
+    {
+        record.clear();
+        recordSize = size;
+        state = newState;
+    }
+
+    bool checkSignature()
+    {
+        if (record.size() < ZIP_SIGNATURE_SIZE) {
+            return false;
+        }
+
+        uint32_t sig = readLE32(record.data());
+        if (sig == ZIP_LOCAL_HEADER_SIG) {
+            return true;
+        }
+
+        // local entries are followed by the central directory, which
+        // duplicates information we already have, so we're done
+        if ((sig == ZIP_CENTRAL_HEADER_SIG) || (sig == ZIP_END_OF_CENTRAL_DIR_SIG)) {
+            state = END_OF_ARCHIVE;
+        } else {
+            SG_LOG(SG_IO, SG_WARN, "bad zip local header signature");
+            state = BAD_ARCHIVE;
+        }
+
+        return false;
+    }
+
+    void processLocalHeader()
+    {
+        const uint8_t* h = record.data();
+        flags = readLE16(h + 6);
+        method = readLE16(h + 8);
+        expectedCrc = readLE32(h + 14);
+        compressedSize = readLE32(h + 18);
+        uncompressedSize = readLE32(h + 22);
+        nameLength = readLE16(h + 26);
+        extraLength = readLE16(h + 28);
+
+        if (flags & ZIP_FLAG_ENCRYPTED) {
+            SG_LOG(SG_IO, SG_WARN, "encrypted zip entries are not supported");
+            state = BAD_DATA;
+            return;
+        }
+
+        if ((method != ZIP_METHOD_STORED) && (method != ZIP_METHOD_DEFLATED)) {
+            SG_LOG(SG_IO, SG_WARN, "unsupported zip compression method:" << method);
+            state = BAD_DATA;
+            return;
+        }
+
+        if (nameLength == 0) {
+            SG_LOG(SG_IO, SG_WARN, "zip entry without a name");
+            state = BAD_ARCHIVE;
+            return;
+        }
+
+        expectRecord(READING_NAME, nameLength + extraLength);
+    }
+
+    void beginEntry()
+    {
+        entryName = std::string(record.begin(), record.begin() + nameLength);
+        const bool isDirectory = (entryName.back() == '/');
+
+        if (!readZip64Sizes(record.data() + nameLength)) {
+            SG_LOG(SG_IO, SG_WARN, "bad Zip64 sizes for zip entry:" << entryName);
+            state = BAD_ARCHIVE;
+            return;
+        }
+
+        // with a data descriptor, the sizes in the local header are zero;
+        // deflated data is self-terminating but stored data is not
+        sizeKnown = !(flags & ZIP_FLAG_DATA_DESCRIPTOR) || (method == ZIP_METHOD_STORED);
+        if ((flags & ZIP_FLAG_DATA_DESCRIPTOR) && (method == ZIP_METHOD_STORED) &&
+            (compressedSize == 0) && !isDirectory)
+        {
+            SG_LOG(SG_IO, SG_WARN, "stored zip entry of unknown size:" << entryName);
+            state = BAD_DATA;
+            return;
+        }
+
+        bytesRemaining = compressedSize;
+        crc = crc32(0L, Z_NULL, 0);
+        bytesWritten = 0;
+
+        if (!ArchiveExtractor::isSafePath(entryName)) {
+            SG_LOG(SG_IO, SG_WARN, "bad zip path:" << entryName);
+            state = BAD_ARCHIVE;
+            return;
+        }
+
+        if (isDirectory) {
+            Dir dir(path / entryName);
+            if (!dir.exists()) {
+                dir.create(0755);
+            }
+        } else {
+            SGPath p = path / entryName;
+            Dir parentDir(p.dir());
+            if (!parentDir.exists() && !parentDir.create(0755)) {
+                state = IO_ERROR;
+                return;
+            }
+
+            currentFile.reset(new SGBinaryFile(p));
+            if (!currentFile->open(SG_IO_OUT)) {
+                SG_LOG(SG_IO, SG_WARN, "failed to open output file for writing:" << p);
+                state = IO_ERROR;
+                return;
+            }
+        }
+
+        if (method == ZIP_METHOD_DEFLATED) {
+            int result;
+            if (haveInitedZLib) {
+                result = inflateReset(&zlibStream);
+            } else {
+                // negative window bits: raw deflate data, without zlib header
+                result = inflateInit2(&zlibStream, -ZLIB_INFLATE_WINDOW_BITS);
+                haveInitedZLib = (result == Z_OK);
+            }
+
+            if (result != Z_OK) {
+                SG_LOG(SG_IO, SG_WARN, "inflate init failed");
+                state = BAD_DATA;
+                return;
+            }
+        }
+
+        state = READING_DATA;
+        if (sizeKnown && (bytesRemaining == 0) && (method == ZIP_METHOD_STORED)) {
+            finishData();
+        }
+    }
+
+    // sizes too large for the local header are stored in the Zip64 extra
+    // field, which streamed archives also use to announce 64-bit sizes in
+    // the data descriptor
+    bool readZip64Sizes(const uint8_t* extra)
+    {
+        zip64 = false;
+        const uint8_t* end = extra + extraLength;
+        while (extra + 4 <= end) {
+            uint16_t id = readLE16(extra);
+            uint16_t size = readLE16(extra + 2);
+            const uint8_t* field = extra + 4;
+            extra = field + size;
+            if (extra > end) {
+                return false;
+            }
+
+            if (id != ZIP64_EXTRA_FIELD_ID) {
+                continue;
+            }
+
+            zip64 = true;
+            const uint8_t* fieldEnd = extra;
+            if (uncompressedSize == ZIP64_SIZE_MARKER) {
+                if (field + 8 > fieldEnd) {
+                    return false;
+                }
+                uncompressedSize = readLE64(field);
+                field += 8;
+            }
+
+            if (compressedSize == ZIP64_SIZE_MARKER) {
+                if (field + 8 > fieldEnd) {
+                    return false;
+                }
+                compressedSize = readLE64(field);
+            }
+        }
+
+        // without a Zip64 field, the sizes must come from the descriptor
+        return ((compressedSize != ZIP64_SIZE_MARKER) &&
+                (uncompressedSize != ZIP64_SIZE_MARKER)) ||
+            (flags & ZIP_FLAG_DATA_DESCRIPTOR);
+    }
+
+    size_t processEntryData(const char* bytes, size_t count)
+    {
+        if (method == ZIP_METHOD_STORED) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(bytesRemaining, count));
+            writeOutput(bytes, n);
+            bytesRemaining -= n;
+            if (bytesRemaining == 0) {
+                finishData();
+            }
+            return n;
+        }
+
+        size_t avail = sizeKnown ?
+            static_cast<size_t>(std::min<uint64_t>(bytesRemaining, count)) : count;
+        zlibStream.next_in = (uint8_t*) bytes;
+        zlibStream.avail_in = avail;
+
+        int result;
+        size_t writtenSize;
+        do {
+            zlibStream.next_out = zlibOutput;
+            zlibStream.avail_out = ZLIB_DECOMPRESS_BUFFER_SIZE;
+            result = inflate(&zlibStream, Z_NO_FLUSH);
+            if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR)) {
+                SG_LOG(SG_IO, SG_WARN, "Permanent ZLib error:" << zlibStream.msg);
+                state = BAD_DATA;
+                return count;
+            }
+
+            writtenSize = ZLIB_DECOMPRESS_BUFFER_SIZE - zlibStream.avail_out;
+            if (writtenSize > 0) {
+                writeOutput((const char*) zlibOutput, writtenSize);
+            }
+        } while ((result != Z_STREAM_END) && ((zlibStream.avail_in > 0) || (writtenSize > 0)));
+
+        size_t used = avail - zlibStream.avail_in;
+        if (sizeKnown) {
+            bytesRemaining -= used;
+        }
+
+        if (result == Z_STREAM_END) {
+            if (sizeKnown && (bytesRemaining > 0)) {
+                SG_LOG(SG_IO, SG_WARN, "zip entry has trailing data:" << entryName);
+                state = BAD_DATA;
+                return count;
+            }
+            finishData();
+        } else if (sizeKnown && (bytesRemaining == 0)) {
+            SG_LOG(SG_IO, SG_WARN, "truncated deflate stream in zip entry:" << entryName);
+            state = BAD_DATA;
+            return count;
+        }
+
+        return used;
+    }
+
+    void writeOutput(const char* bytes, size_t count)
+    {
+        crc = crc32(crc, (const Bytef*) bytes, count);
+        bytesWritten += count;
+        if (currentFile && (currentFile->write(bytes, count) != (int) count)) {
+            SG_LOG(SG_IO, SG_WARN, "failed writing zip entry:" << entryName);
+            state = IO_ERROR;
+        }
+    }
+
+    void finishData()
+    {
+        if (state >= ERROR_STATE) {
+            return;
+        }
+
+        if (currentFile) {
+            currentFile->close();
+            currentFile.reset();
+        }
+
+        if (flags & ZIP_FLAG_DATA_DESCRIPTOR) {
+            expectRecord(READING_DESCRIPTOR, ZIP_SIGNATURE_SIZE);
+        } else {
+            finishEntry(expectedCrc, uncompressedSize);
+        }
+    }
+
+    void finishEntry(uint32_t entryCrc, uint64_t entrySize)
+    {
+        if ((static_cast<uint32_t>(crc) != entryCrc) || (bytesWritten != entrySize)) {
+            SG_LOG(SG_IO, SG_WARN, "CRC or size mismatch for zip entry:" << entryName);
+            state = BAD_DATA;
+            return;
+        }
+
+        expectRecord(READING_HEADER, ZIP_LOCAL_HEADER_SIZE);
+    }
+
+};
+
+ZipExtractor::ZipExtractor(const SGPath& rootPath) :
+    d(new ZipExtractorPrivate(rootPath))
+{
+}
+
+ZipExtractor::~ZipExtractor()
+{
+}
+
+bool ZipExtractor::isZipData(const uint8_t* bytes, size_t count)
+{
+    if (count < ZIP_SIGNATURE_SIZE) {
+        return false;
+    }
+
+    uint32_t sig = readLE32(bytes);
+    return (sig == ZIP_LOCAL_HEADER_SIG) || (sig == ZIP_END_OF_CENTRAL_DIR_SIG);
+}
+
+void ZipExtractor::extractBytes(const char* bytes, size_t count)
+{
+    d->processBytes(bytes, count);
+}
+
+bool ZipExtractor::isAtEndOfArchive() const
+{
+    return (d->state == ZipExtractorPrivate::END_OF_ARCHIVE);
+}
+
+bool ZipExtractor::hasError() const
+{
+    return (d->state >= ZipExtractorPrivate::ERROR_STATE);
+}
+
 } // of simgear
@@ -28,8 +28,33 @@ namespace simgear
 {
 
 class TarExtractorPrivate;
+class ZipExtractorPrivate;
 
-class TarExtractor
+/**
+ * Common interface for archive extractors which consume an archive
+ * incrementally, as the bytes arrive (eg, from an HTTP download), and
+ * write the contained files beneath a root path.
+ */
+class ArchiveExtractor
+{
+public:
+    virtual ~ArchiveExtractor();
+
+    virtual void extractBytes(const char* bytes, size_t count) = 0;
+
+    virtual bool isAtEndOfArchive() const = 0;
+
+    virtual bool hasError() const = 0;
+
+    /**
+     * Check an archive member name can be extracted beneath the root path:
+     * it must be relative, without a drive letter, and must not contain a
+     * '..' component, with either '/' or '\\' as separator.
+     */
+    static bool isSafePath(const std::string& p);
+};
+
+class TarExtractor : public ArchiveExtractor
 {
 public:
     TarExtractor(const SGPath& rootPath);
@@ -37,11 +62,11 @@ public:
 
     static bool isTarData(const uint8_t* bytes, size_t count);
 
-    void extractBytes(const char* bytes, size_t count);
+    void extractBytes(const char* bytes, size_t count) override;
 
-    bool isAtEndOfArchive() const;
+    bool isAtEndOfArchive() const override;
 
-    bool hasError() const;
+    bool hasError() const override;
 
 protected:
     enum PathResult {
@@ -57,6 +82,30 @@ private:
     std::unique_ptr<TarExtractorPrivate> d;
 };
 
+/**
+ * Streaming extractor for zip archives: local file headers are parsed as
+ * bytes arrive and each entry is inflated straight to disk, so the archive
+ * never needs to be held in memory. Entries written with a trailing data
+ * descriptor (general purpose flag bit 3) are supported for deflated data,
+ * as are Zip64 sizes and descriptors; encrypted entries are rejected.
+ */
+class ZipExtractor : public ArchiveExtractor
+{
+public:
+    ZipExtractor(const SGPath& rootPath);
+    ~ZipExtractor();
+
+    static bool isZipData(const uint8_t* bytes, size_t count);
+
+    void extractBytes(const char* bytes, size_t count) override;
+
+    bool isAtEndOfArchive() const override;
+
+    bool hasError() const override;
+private:
+    std::unique_ptr<ZipExtractorPrivate> d;
+};
+
 } // of namespace simgear
 
 #endif // of SG_IO_UNTAR_HXX
@@ -26,6 +26,7 @@
 #endif
 
 
+#include <algorithm>
 #include <cmath>
 
 #include <simgear/magvar/magvar.hxx>
@@ -60,6 +61,12 @@ void SGMagVar::update( const SGGeod& geod, double jd ) {
 }
 
 
+void SGMagVar::update( SGMagVarGrid& grid, const SGGeod& geod, double jd ) {
+    grid.get(geod.getLongitudeRad(), geod.getLatitudeRad(),
+             geod.getElevationM(), jd, magvar, magdip);
+}
+
+
 double sgGetMagVar( double lon, double lat, double alt_m, double jd ) {
     // cout << "lat = " << lat << " lon = " << lon << " elev = " << alt_m
     //      << " JD = " << jd << endl;
@@ -74,3 +81,139 @@ double sgGetMagVar( const SGGeod& pos, double jd )
     pos.getElevationM(), jd);
 }
 
+
+// The grid spacing in degrees, and the number of grid cells per tile side
+static const int gridStepDeg = 1;
+static const int tileCells = 10;
+static const int tileNodes = tileCells + 1;
+static const int numLatTiles = 180 / (gridStepDeg * tileCells);
+static const int numLonTiles = 360 / (gridStepDeg * tileCells);
+
+// The altitude levels in meters, and the range interpolated in the grid
+static const double levelStepM = 5000.0;
+static const int numLevels = 9;
+static const double minGridAltM = -1000.0;
+static const double maxGridAltM = levelStepM * (numLevels - 1);
+
+// The floats of the field components at one grid node
+static const int nodeSize = 3 * numLevels;
+
+SGMagVarGrid::SGMagVarGrid()
+  : _tiles(numLatTiles * numLonTiles),
+    _numTiles(0),
+    _date(-1)
+{
+}
+
+SGMagVarGrid::~SGMagVarGrid() {
+}
+
+void SGMagVarGrid::clear() {
+    for (unsigned i = 0; i < _tiles.size(); ++i)
+        std::vector<float>().swap(_tiles[i]);
+    _numTiles = 0;
+}
+
+void SGMagVarGrid::setDate( double jd ) {
+    // The field model only uses the day
+    if ((long)jd == _date)
+        return;
+    clear();
+    _date = (long)jd;
+}
+
+const float* SGMagVarGrid::getTile( unsigned i, unsigned j ) {
+    std::vector<float>& tile = _tiles[i * numLonTiles + j];
+    if (!tile.empty())
+        return &tile.front();
+
+    tile.resize(tileNodes * tileNodes * nodeSize);
+    float* node = &tile.front();
+    double field[6];
+    for (int u = 0; u < tileNodes; ++u) {
+        int latDeg = -90 + gridStepDeg * (int(i) * tileCells + u);
+        double lat = SGMiscd::deg2rad(latDeg);
+        for (int v = 0; v < tileNodes; ++v) {
+            int lonDeg = gridStepDeg * (int(j) * tileCells + v);
+            double lon = SGMiscd::deg2rad(lonDeg);
+            for (int k = 0; k < numLevels; ++k, node += 3) {
+                calc_magvar(lat, lon, k * levelStepM / 1000.0, _date, field);
+                node[0] = field[3];
+                node[1] = field[4];
+                node[2] = field[5];
+            }
+        }
+    }
+    ++_numTiles;
+    return &tile.front();
+}
+
+void SGMagVarGrid::getField( double lon, double lat, double alt_m,
+                             float result[3] ) {
+    // grid coordinates, latitude from the south pole, longitude from the
+    // prime meridian eastwards
+    double x = (SGMiscd::rad2deg(lat) + 90) / gridStepDeg;
+    x = SGMiscd::clip(x, 0, 180 / gridStepDeg);
+    double y = SGMiscd::rad2deg(lon) / gridStepDeg;
+    y -= 360 / gridStepDeg * floor(y / (360 / gridStepDeg));
+
+    int cx = std::min(int(x), 180 / gridStepDeg - 1);
+    int cy = std::min(int(y), 360 / gridStepDeg - 1);
+    // extrapolated below the lowest level
+    int ck = std::min(int(floor(alt_m / levelStepM)), numLevels - 2);
+    ck = std::max(ck, 0);
+    float fx = float(x - cx);
+    float fy = float(y - cy);
+    float fk = float(alt_m / levelStepM - ck);
+
+    const float* tile = getTile(cx / tileCells, cy / tileCells);
+    int u = cx % tileCells;
+    int v = cy % tileCells;
+    const float* n00 = tile + (u * tileNodes + v) * nodeSize + 3 * ck;
+    const float* n01 = n00 + nodeSize;
+    const float* n10 = n00 + tileNodes * nodeSize;
+    const float* n11 = n10 + nodeSize;
+    for (int c = 0; c < 3; ++c) {
+        float b0 = (1 - fx) * ((1 - fy) * n00[c] + fy * n01[c])
+            + fx * ((1 - fy) * n10[c] + fy * n11[c]);
+        float b1 = (1 - fx) * ((1 - fy) * n00[c + 3] + fy * n01[c + 3])
+            + fx * ((1 - fy) * n10[c + 3] + fy * n11[c + 3]);
+        result[c] = b0 + fk * (b1 - b0);
+    }
+}
+
+void SGMagVarGrid::get( double lon, double lat, double alt_m, double jd,
+                        double& var, double& dip ) {
+    if (!(minGridAltM <= alt_m && alt_m <= maxGridAltM)) {
+        double field[6];
+        var = calc_magvar( lat, lon, alt_m / 1000.0, (long)jd, field );
+        dip = atan(field[5]/sqrt(field[3]*field[3]+field[4]*field[4]));
+        return;
+    }
+    setDate(jd);
+    float field[3];
+    getField(lon, lat, alt_m, field);
+    double h = sqrt(double(field[0])*field[0] + double(field[1])*field[1]);
+    var = (field[0] != 0 || field[1] != 0) ? atan2(field[1], field[0]) : 0;
+    dip = atan(field[2] / h);
+}
+
+double SGMagVarGrid::getMagVar( double lon, double lat, double alt_m,
+                                double jd ) {
+    double var, dip;
+    get(lon, lat, alt_m, jd, var, dip);
+    return var;
+}
+
+double SGMagVarGrid::getMagVar( const SGGeod& pos, double jd ) {
+    return getMagVar(pos.getLongitudeRad(), pos.getLatitudeRad(),
+                     pos.getElevationM(), jd);
+}
+
+void SGMagVarGrid::get( const SGGeod* pos, size_t n, double jd,
+                        double* var, double* dip ) {
+    double d;
+    for (size_t i = 0; i < n; ++i)
+        get(pos[i].getLongitudeRad(), pos[i].getLatitudeRad(),
+            pos[i].getElevationM(), jd, var[i], dip ? dip[i] : d);
+}
@@ -32,9 +32,13 @@
 # error This library requires C++
 #endif
 
+#include <cstddef>
+#include <vector>
+
 
 // forward decls
 class SGGeod;
+class SGMagVarGrid;
 
 /**
  * Magnetic variation wrapper class.
@@ -86,6 +90,12 @@ public:
      */
     void update( const SGGeod& geod, double jd );
 
+    /**
+     * overloaded variant interpolating in a cached grid instead of
+     * evaluating the field model
+     */
+    void update( SGMagVarGrid& grid, const SGGeod& geod, double jd );
+
     /** @return the current magnetic variation in radians. */
     double get_magvar() const { return magvar; }
 
@@ -108,4 +118,70 @@ double sgGetMagVar( double lon, double lat, double alt_m, double jd );
  */
 double sgGetMagVar( const SGGeod& pos, double jd );
 
+
+/**
+ * Cached grid of the magnetic field for fast lookups.
+ *
+ * Evaluating the field model costs some microseconds per position, too
+ * much for thousands of positions (navaids, AI traffic, multiplayer
+ * aircraft) every frame. This class samples the north, east and down
+ * field components on a grid of 1 degree in latitude and longitude and 5
+ * km in altitude, from 0 to 40 km, and interpolates them trilinearly.
+ * The variation and dip are computed from the interpolated components,
+ * so they do not suffer from the wrap around of the angles.
+ *
+ * The grid is built lazily in tiles of 10 by 10 degrees on their first
+ * lookup, and is rebuilt when the day of the julian date changes, which
+ * is also the resolution of the field model. Altitudes from -1 km to 40
+ * km are interpolated, any other altitude is passed to the field model.
+ *
+ * Away from the magnetic poles, where the horizontal field is at least
+ * 5000 nT, the variation is within 0.05 degrees of the field model. Close
+ * to the magnetic poles the variation is poorly defined anyway.
+ *
+ * The lookups build tiles with the field model, which is not reentrant
+ * either, so a grid must only be used from one thread at a time.
+ */
+class SGMagVarGrid {
+public:
+    SGMagVarGrid();
+    ~SGMagVarGrid();
+
+    /**
+     * Lookup the magnetic variation and dip in radians.
+     * @param lon longitude in radians
+     * @param lat latitude in radians
+     * @param alt_m altitude above sea level in meters
+     * @param jd julian date
+     */
+    void get( double lon, double lat, double alt_m, double jd,
+              double& var, double& dip );
+
+    /** @return the magnetic variation in radians */
+    double getMagVar( double lon, double lat, double alt_m, double jd );
+    double getMagVar( const SGGeod& pos, double jd );
+
+    /**
+     * Lookup the magnetic variation, and the dip unless dip is null,
+     * for n positions at once.
+     */
+    void get( const SGGeod* pos, size_t n, double jd,
+              double* var, double* dip = 0 );
+
+    /** Drop all the tiles built so far. */
+    void clear();
+
+    /** @return the number of tiles built for the current date */
+    unsigned getNumTiles() const { return _numTiles; }
+
+private:
+    void getField( double lon, double lat, double alt_m, float field[3] );
+    const float* getTile( unsigned i, unsigned j );
+    void setDate( double jd );
+
+    std::vector<std::vector<float> > _tiles;
+    unsigned _numTiles;
+    long _date;
+};
+
 #endif // _MAGVAR_HXX
@@ -2,11 +2,121 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cmath>
 
 #include <simgear/constants.h>
+#include <simgear/math/SGMath.hxx>
+#include <simgear/timing/timestamp.hxx>
 
 #include "coremag.hxx"
+#include "magvar.hxx"
+
+/* Random positions up to 40km above the ground */
+static SGGeod* random_positions(int n)
+{
+  SGGeod* pos = new SGGeod[n];
+  srand(17);
+  for (int i = 0; i < n; ++i) {
+    double lat = asin(2.0 * rand() / RAND_MAX - 1.0);
+    double lon = SGD_2PI * rand() / RAND_MAX - SGD_PI;
+    double alt_m = -500.0 + 40500.0 * rand() / RAND_MAX;
+    pos[i] = SGGeod::fromRadM(lon, lat, alt_m);
+  }
+  return pos;
+}
+
+/* Times the field model and the cached grid */
+static void benchmark()
+{
+  const double jd = yymmdd_to_julian_days(17, 6, 1);
+  const int n = 20000;
+  SGGeod* pos = random_positions(n);
+  double* var = new double[n];
+  double* dip = new double[n];
+
+  SGMagVarGrid grid;
+  SGTimeStamp start = SGTimeStamp::now();
+  grid.get(pos, n, jd, var, dip);
+  double build_us = (SGTimeStamp::now() - start).toUSecs();
+  start = SGTimeStamp::now();
+  grid.get(pos, n, jd, var, dip);
+  double grid_us = (SGTimeStamp::now() - start).toUSecs();
+
+  double field[6];
+  start = SGTimeStamp::now();
+  for (int i = 0; i < n; ++i)
+    calc_magvar(pos[i].getLatitudeRad(), pos[i].getLongitudeRad(),
+                pos[i].getElevationM() / 1000.0, (long)jd, field);
+  double model_us = (SGTimeStamp::now() - start).toUSecs();
+
+  fprintf(stdout, "grid: %u tiles\n", grid.getNumTiles());
+  fprintf(stdout, "per lookup: model %.3f us, grid %.3f us, "
+          "grid while building %.3f us\n",
+          model_us / n, grid_us / n, build_us / n);
+
+  delete[] pos;
+  delete[] var;
+  delete[] dip;
+}
+
+/* Compares the cached grid with the field model at random positions.
+   Returns the number of failed checks. */
+static int check_grid()
+{
+  const double jd = yymmdd_to_julian_days(17, 6, 1);
+  const int n = 2000;
+  SGGeod* pos = random_positions(n);
+  double* var = new double[n];
+  double* dip = new double[n];
+  int failures = 0;
+
+  SGMagVarGrid grid;
+  grid.get(pos, n, jd, var, dip);
+
+  double max_var = 0, max_dip = 0;
+  double field[6];
+  for (int i = 0; i < n; ++i) {
+    double v = calc_magvar(pos[i].getLatitudeRad(), pos[i].getLongitudeRad(),
+                           pos[i].getElevationM() / 1000.0, (long)jd, field);
+    double h = sqrt(field[3]*field[3] + field[4]*field[4]);
+    double d = atan(field[5] / h);
+    max_dip = SGMiscd::max(max_dip, fabs(d - dip[i]));
+    if (h < 5000)
+      continue;
+    max_var = SGMiscd::max(max_var,
+                           fabs(SGMiscd::normalizePeriodic(-SGD_PI, SGD_PI,
+                                                           v - var[i])));
+  }
+
+  max_var *= SGD_RADIANS_TO_DEGREES;
+  max_dip *= SGD_RADIANS_TO_DEGREES;
+  if (!(max_var < 0.05) || !(max_dip < 0.05)) {
+    fprintf(stdout, "FAILED: grid error too large, variation %.4f deg, "
+            "dip %.4f deg\n", max_var, max_dip);
+    ++failures;
+  }
+
+  /* outside of the grid the model is used */
+  double v = grid.getMagVar(SGGeod::fromDegM(10, 50, 100000), jd);
+  if (v != calc_magvar(50 * SGD_DEGREES_TO_RADIANS,
+                       10 * SGD_DEGREES_TO_RADIANS, 100, (long)jd, field)) {
+    fprintf(stdout, "FAILED: lookup above the grid\n");
+    ++failures;
+  }
+
+  /* the tiles are rebuilt for another day */
+  grid.getMagVar(SGGeod::fromDegM(10, 50, 0), jd + 1);
+  if (grid.getNumTiles() != 1) {
+    fprintf(stdout, "FAILED: tiles not dropped for a new date\n");
+    ++failures;
+  }
+
+  delete[] pos;
+  delete[] var;
+  delete[] dip;
+  return failures;
+}
 
 
 int main(int argc, char *argv[])
@@ -19,8 +129,19 @@ double lat_deg,lon_deg,h,var;
 int /* model,*/yy,mm,dd;
 double field[6];
 
+if (argc == 1) {
+  return check_grid() ? 1 : 0;
+}
+
+if ((argc == 2) && !strcmp(argv[1], "--bench")) {
+  benchmark();
+  return 0;
+}
+
 if ((argc != 8) && (argc !=7)) {
 fprintf(stdout,"Usage: mag lat_deg lon_deg h mm dd yy [model]\n");
+fprintf(stdout,"Without arguments the cached grid is checked against the model,\n");
+fprintf(stdout,"with --bench both are timed\n");
 fprintf(stdout,"N latitudes, E longitudes positive degrees, h in km, mm dd yy is date\n");
 fprintf(stdout,"model 1,2,3,4,5,6,7 <=> IGRF90,WMM85,WMM90,WMM95,IGRF95,WMM2000,IGRF2000\n");
 fprintf(stdout,"Default model is IGRF2000, valid 1/1/00 - 12/31/05\n");
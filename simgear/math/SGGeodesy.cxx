@@ -20,6 +20,7 @@
 #endif
 
 #include <cmath>
+#include <vector>
 
 #include <simgear/sg_inlines.h>
 #include <simgear/structure/exception.hxx>
@@ -138,6 +139,169 @@ SGGeodesy::SGGeodToCart(const SGGeod& geod, SGVec3<double>& cart)
   cart(2) = (h+n-e2*n)*sphi;
 }
 
+// The batch conversions use the same algorithms as the ones above on
+// blocks of four points, with the arithmetic and square roots done in
+// simd4_t registers.  Only the cube root and the trigonometric functions
+// are evaluated point by point (cbrt() instead of pow(): a little
+// faster and at least as accurate).
+
+typedef simd4_t<double,4> double4;
+
+static void
+cartToGeod4(const double x[4], const double y[4], const double z[4],
+            double lon[4], double lat[4], double elev[4])
+{
+  const double4 one(1.0), two(2.0);
+  double4 X(x), Y(y), Z(z);
+  double4 XXpYY = X*X+Y*Y;
+  double4 sqrtXXpYY = simd4::sqrt(XXpYY);
+  double4 p = XXpYY*ra2;
+  double4 q = Z*Z*((1-e2)*ra2);
+  double4 r = (1/6.0)*(p+q-double4(e4));
+  double4 s = e4*p*q/(4.0*r*r*r);
+  for (int i = 0; i < 4; ++i) {
+    // see above for the clamping of s
+    if( s[i] >= -2.0 && s[i] <= 0.0 )
+      s[i] = 0.0;
+  }
+  double4 t = one+s+simd4::sqrt(s*(two+s));
+  for (int i = 0; i < 4; ++i)
+    t[i] = cbrt(t[i]);
+  double4 u = r*(one+t+one/t);
+  double4 v = simd4::sqrt(u*u+e4*q);
+  double4 w = e2*(u+v-q)/(2.0*v);
+  double4 k = simd4::sqrt(u+v+w*w)-w;
+  double4 D = k*sqrtXXpYY/(k+double4(e2));
+  double4 sqrtDDpZZ = simd4::sqrt(D*D+Z*Z);
+  double4 h = (k+double4(e2-1))*sqrtDDpZZ/k;
+  double4 X2 = X+sqrtXXpYY;
+  double4 D2 = D+sqrtDDpZZ;
+
+  for (int i = 0; i < 4; ++i) {
+    if( XXpYY[i] + z[i]*z[i] < 25 ) {
+      // The geocenter special case of SGCartToGeod()
+      lon[i] = 0.0;
+      lat[i] = 0.0;
+      elev[i] = -SGGeodesy::EQURAD;
+      continue;
+    }
+    lon[i] = 2*atan2(y[i], X2[i]);
+    lat[i] = 2*atan2(z[i], D2[i]);
+    elev[i] = h[i];
+  }
+}
+
+static void
+geodToCart4(const double lon[4], const double lat[4], const double elev[4],
+            double x[4], double y[4], double z[4])
+{
+  double4 sphi, cphi, slambda, clambda;
+  for (int i = 0; i < 4; ++i) {
+    sphi[i] = sin(lat[i]);
+    cphi[i] = cos(lat[i]);
+    slambda[i] = sin(lon[i]);
+    clambda[i] = cos(lon[i]);
+  }
+  double4 n = double4(a)/simd4::sqrt(double4(1.0)-e2*sphi*sphi);
+  double4 hpn = double4(elev)+n;
+  double4 X = hpn*cphi*clambda;
+  double4 Y = hpn*cphi*slambda;
+  double4 Z = (hpn-e2*n)*sphi;
+  for (int i = 0; i < 4; ++i) {
+    x[i] = X[i];
+    y[i] = Y[i];
+    z[i] = Z[i];
+  }
+}
+
+void
+SGGeodesy::SGCartToGeod(const double* x, const double* y, const double* z,
+                        double* lon, double* lat, double* elev, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    cartToGeod4(x+i, y+i, z+i, lon+i, lat+i, elev+i);
+  if (i == n)
+    return;
+
+  // Pad the last block with copies of its first point
+  double in[3][4], out[3][4];
+  for (size_t j = 0; j < 4; ++j) {
+    size_t k = i + j < n ? i + j : i;
+    in[0][j] = x[k];
+    in[1][j] = y[k];
+    in[2][j] = z[k];
+  }
+  cartToGeod4(in[0], in[1], in[2], out[0], out[1], out[2]);
+  for (size_t j = 0; i + j < n; ++j) {
+    lon[i+j] = out[0][j];
+    lat[i+j] = out[1][j];
+    elev[i+j] = out[2][j];
+  }
+}
+
+void
+SGGeodesy::SGCartToGeod(const SGVec3<double>* cart, SGGeod* geod, size_t n)
+{
+  double in[3][4], out[3][4];
+  for (size_t i = 0; i < n; i += 4) {
+    size_t m = n - i < 4 ? n - i : 4;
+    for (size_t j = 0; j < 4; ++j) {
+      const SGVec3<double>& c = cart[i + (j < m ? j : 0)];
+      in[0][j] = c(0);
+      in[1][j] = c(1);
+      in[2][j] = c(2);
+    }
+    cartToGeod4(in[0], in[1], in[2], out[0], out[1], out[2]);
+    for (size_t j = 0; j < m; ++j)
+      geod[i+j] = SGGeod::fromRadM(out[0][j], out[1][j], out[2][j]);
+  }
+}
+
+void
+SGGeodesy::SGGeodToCart(const double* lon, const double* lat,
+                        const double* elev,
+                        double* x, double* y, double* z, size_t n)
+{
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    geodToCart4(lon+i, lat+i, elev+i, x+i, y+i, z+i);
+  if (i == n)
+    return;
+
+  double in[3][4], out[3][4];
+  for (size_t j = 0; j < 4; ++j) {
+    size_t k = i + j < n ? i + j : i;
+    in[0][j] = lon[k];
+    in[1][j] = lat[k];
+    in[2][j] = elev[k];
+  }
+  geodToCart4(in[0], in[1], in[2], out[0], out[1], out[2]);
+  for (size_t j = 0; i + j < n; ++j) {
+    x[i+j] = out[0][j];
+    y[i+j] = out[1][j];
+    z[i+j] = out[2][j];
+  }
+}
+
+void
+SGGeodesy::SGGeodToCart(const SGGeod* geod, SGVec3<double>* cart, size_t n)
+{
+  double in[3][4], out[3][4];
+  for (size_t i = 0; i < n; i += 4) {
+    size_t m = n - i < 4 ? n - i : 4;
+    for (size_t j = 0; j < 4; ++j) {
+      const SGGeod& g = geod[i + (j < m ? j : 0)];
+      in[0][j] = g.getLongitudeRad();
+      in[1][j] = g.getLatitudeRad();
+      in[2][j] = g.getElevationM();
+    }
+    geodToCart4(in[0], in[1], in[2], out[0], out[1], out[2]);
+    for (size_t j = 0; j < m; ++j)
+      cart[i+j] = SGVec3<double>(out[0][j], out[1][j], out[2][j]);
+  }
+}
+
 double
 SGGeodesy::SGGeodToSeaLevelRadius(const SGGeod& geod)
 {
@@ -500,6 +664,231 @@ SGGeodesy::distanceNm(const SGGeod& from, const SGGeod& to)
   return distanceM(from, to) * SG_METER_TO_NM;
 }
 
+// The batch version of _geo_inverse_wgs_84 for one origin and blocks of
+// four targets: the terms of the origin are computed once, the iteration
+// runs on simd4_t registers until all targets have converged, each target
+// keeping the values of its last iteration.  Targets on the special
+// cases (identical or antipodal points, polar targets) are left to
+// _geo_inverse_wgs_84.  Returns false if the iteration did not converge
+// for some target, whose course and distance are then set to -1.
+namespace {
+
+struct InverseOrigin
+{
+  InverseOrigin(double lat, double lon)
+  {
+    double phi1 = SGMiscd::deg2rad(lat);
+    double temp = (1.0-f)*sin(phi1)/cos(phi1);
+    lat1 = lat;
+    lon1 = lon;
+    lam1 = SGMiscd::deg2rad(lon);
+    cosu1 = 1.0/sqrt(1.0+temp*temp);
+    sinu1 = temp*cosu1;
+  }
+
+  static const double f;
+  static const double b;
+  static const double testv;
+
+  double lat1, lon1, lam1;
+  double cosu1, sinu1;
+};
+
+const double InverseOrigin::f = 1.0/SGGeodesy::iFLATTENING;
+const double InverseOrigin::b = SGGeodesy::EQURAD*(1.0-1.0/SGGeodesy::iFLATTENING);
+const double InverseOrigin::testv = 1.0E-10;
+
+} // anonymous namespace
+
+static bool
+inverse4(const InverseOrigin& o, const double lat2[4], const double lon2[4],
+         double az1[4], double s[4])
+{
+  const double f = InverseOrigin::f, b = InverseOrigin::b;
+  const double testv = InverseOrigin::testv;
+  const double a = SGGeodesy::EQURAD;
+  bool ok = true;
+
+  // Targets taking the scalar path are replaced by a regular one in the
+  // vector computations
+  bool scalar[4];
+  double4 dlam, cosu2, sinu2;
+  for (int i = 0; i < 4; ++i) {
+    double cosphi2 = cos(SGMiscd::deg2rad(lat2[i]));
+    scalar[i] = (fabs(o.lat1-lat2[i]) < testv && fabs(o.lon1-lon2[i]) < testv)
+             || fabs(cosphi2) < testv
+             || (fabs(fabs(o.lon1-lon2[i]) - 180) < testv
+                 && fabs(o.lat1+lat2[i]) < testv);
+    double phi2 = scalar[i] ? 0.0 : SGMiscd::deg2rad(lat2[i]);
+    double lam2 = scalar[i] ? o.lam1 + 1.0 : SGMiscd::deg2rad(lon2[i]);
+    double temp = (1.0-f)*sin(phi2)/cos(phi2);
+    dlam[i] = lam2 - o.lam1;
+    cosu2[i] = 1.0/sqrt(1.0+temp*temp);
+    sinu2[i] = temp*cosu2[i];
+  }
+
+  const double4 one(1.0), two(2.0), four(4.0);
+  const double4 cosu1(o.cosu1), sinu1(o.sinu1);
+  double4 dlams = dlam;
+  double4 sdlams, cdlams, sig, sinsig, cossig, cos2saz, c2sigm;
+  bool active[4] = { true, true, true, true };
+  int iter[4] = { 0, 0, 0, 0 };
+  for (int n = 4; n > 0;) {
+    // (the lanes of converged targets are computed but not used)
+    double4 sdl = sdlams, cdl = cdlams, sg;
+    for (int i = 0; i < 4; ++i) {
+      if (!active[i])
+        continue;
+      sdl[i] = sin(dlams[i]);
+      cdl[i] = cos(dlams[i]);
+    }
+    double4 t = cosu1*sinu2-sinu1*cosu2*cdl;
+    double4 ss = simd4::sqrt(cosu2*cosu2*sdl*sdl+t*t);
+    double4 cs = sinu1*sinu2+cosu1*cosu2*cdl;
+    for (int i = 0; i < 4; ++i)
+      if (active[i])
+        sg[i] = atan2(ss[i], cs[i]);
+    double4 sinaz = cosu1*cosu2*sdl/ss;
+    double4 c2saz = one-sinaz*sinaz;
+    double4 c2sm = cs-two*sinu1*sinu2/c2saz;
+    for (int i = 0; i < 4; ++i)
+      if (o.sinu1 == 0.0 || sinu2[i] == 0.0)
+        c2sm[i] = cs[i];
+    double4 tc = f*c2saz*(four+f*(four-3.0*c2saz))/16.0;
+    double4 next = dlam+(one-tc)*f*sinaz*
+      (sg+tc*ss*(c2sm+tc*cs*(-1.0+two*c2sm*c2sm)));
+
+    for (int i = 0; i < 4; ++i) {
+      if (!active[i])
+        continue;
+      sdlams[i] = sdl[i]; cdlams[i] = cdl[i];
+      sig[i] = sg[i]; sinsig[i] = ss[i]; cossig[i] = cs[i];
+      cos2saz[i] = c2saz[i]; c2sigm[i] = c2sm[i];
+      double temp = dlams[i];
+      dlams[i] = next[i];
+      if (fabs(dlams[i]) > SGMiscd::pi() && iter[i]++ > 50) {
+        // no convergence
+        active[i] = false; --n;
+        if (!scalar[i])
+          ok = false;
+        iter[i] = -1;
+      } else if (!(fabs(temp-dlams[i]) > testv)) {
+        active[i] = false; --n;
+      }
+    }
+  }
+
+  double4 us = cos2saz*(a*a-b*b)/(b*b);
+  double4 ta = one+us*(4096.0+us*(-768.0+us*(320.0-175.0*us)))/16384.0;
+  double4 tb = us*(256.0+us*(-128.0+us*(74.0-47.0*us)))/1024.0;
+  double4 dist = b*ta*(sig-tb*sinsig*
+                       (c2sigm+tb*(cossig*(-1.0+two*c2sigm*c2sigm)-tb*
+                                   c2sigm*(-3.0+four*sinsig*sinsig)*
+                                   (-3.0+four*c2sigm*c2sigm)/6.0)/
+                        4.0));
+  double4 rnumer = cosu2*sdlams;
+  double4 denom = cosu1*sinu2-sinu1*cosu2*cdlams;
+
+  for (int i = 0; i < 4; ++i) {
+    if (scalar[i]) {
+      double az2;
+      if (_geo_inverse_wgs_84(o.lat1, o.lon1, lat2[i], lon2[i],
+                              &az1[i], &az2, &s[i]) != 0) {
+        az1[i] = s[i] = -1;
+        ok = false;
+      }
+    } else if (iter[i] < 0) {
+      az1[i] = s[i] = -1;
+    } else {
+      // FORWARD AZIMUTH FROM NORTH
+      az1[i] = SGMiscd::rad2deg(atan2(rnumer[i],denom[i]));
+      if( fabs(az1[i]) < testv ) az1[i] = 0.0;
+      if(az1[i] < 0.0) az1[i] += 360.0;
+      s[i] = dist[i];
+    }
+  }
+  return ok;
+}
+
+bool
+SGGeodesy::inverse(const SGGeod& from, const SGGeod* to, size_t n,
+                   double* course, double* distance)
+{
+  double lat1 = from.getLatitudeDeg(), lon1 = from.getLongitudeDeg();
+  bool ok = true;
+  if (fabs(cos(from.getLatitudeRad())) < InverseOrigin::testv
+      || fabs(lat1-90.0) < InverseOrigin::testv) {
+    // polar origins go through the scalar path
+    for (size_t i = 0; i < n; ++i) {
+      double az1, az2, s;
+      if (_geo_inverse_wgs_84(lat1, lon1, to[i].getLatitudeDeg(),
+                              to[i].getLongitudeDeg(), &az1, &az2, &s) != 0) {
+        az1 = s = -1;
+        ok = false;
+      }
+      if (course) course[i] = az1;
+      if (distance) distance[i] = s;
+    }
+    return ok;
+  }
+
+  InverseOrigin origin(lat1, lon1);
+  double lat2[4], lon2[4], az1[4], s[4];
+  for (size_t i = 0; i < n; i += 4) {
+    size_t m = n - i < 4 ? n - i : 4;
+    for (size_t j = 0; j < 4; ++j) {
+      const SGGeod& p = to[i + (j < m ? j : 0)];
+      lat2[j] = p.getLatitudeDeg();
+      lon2[j] = p.getLongitudeDeg();
+    }
+    ok &= inverse4(origin, lat2, lon2, az1, s);
+    for (size_t j = 0; j < m; ++j) {
+      if (course) course[i+j] = az1[j];
+      if (distance) distance[i+j] = s[j];
+    }
+  }
+  return ok;
+}
+
+size_t
+SGGeodesy::withinRangeM(const SGGeod& from, const SGGeod* to, size_t n,
+                        double range, size_t* indices, double* distance)
+{
+  // Spherical prefilter on the geodetic coordinates, which are within
+  // 1% of the geodesic distances (see the header)
+  const double maxRad = 1.01*range/(SG_RAD_TO_NM*SG_NM_TO_METER);
+  const double maxSin = sin(0.5*SGMiscd::min(maxRad, SGMiscd::pi()));
+  double lat1 = from.getLatitudeRad(), lon1 = from.getLongitudeRad();
+  double cosLat1 = cos(lat1);
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    // the square of the haversine of the central angle, as in distanceRad()
+    double tmp1 = sin(0.5*(lat1 - to[i].getLatitudeRad()));
+    double tmp2 = sin(0.5*(lon1 - to[i].getLongitudeRad()));
+    double square = tmp1*tmp1 + cosLat1*cos(to[i].getLatitudeRad())*tmp2*tmp2;
+    if (maxRad >= SGMiscd::pi() || square <= maxSin*maxSin)
+      indices[count++] = i;
+  }
+
+  // The exact distances of the candidates, in place
+  std::vector<SGGeod> candidates(count);
+  std::vector<double> s(count);
+  for (size_t i = 0; i < count; ++i)
+    candidates[i] = to[indices[i]];
+  if (count)
+    inverse(from, &candidates[0], count, 0, &s[0]);
+
+  size_t m = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (s[i] < 0 || s[i] > range)
+      continue;
+    if (distance)
+      distance[m] = s[i];
+    indices[m++] = indices[i];
+  }
+  return m;
+}
+
 /// Geocentric routines
 
 void
@@ -584,6 +973,52 @@ SGGeodesy::distanceM(const SGGeoc& from, const SGGeoc& to)
   return distanceRad(from, to) * SG_RAD_TO_NM * SG_NM_TO_METER;
 }
 
+void
+SGGeodesy::inverse(const SGGeoc& from, const SGGeoc* to, size_t n,
+                   double* course, double* distance)
+{
+  // courseRad() and distanceM() with the terms of the origin computed
+  // once, and the arithmetic on blocks of four targets
+  double lat1 = from.getLatitudeRad(), lon1 = from.getLongitudeRad();
+  double4 sinLatFrom(sin(lat1)), cosLatFrom(cos(lat1));
+  double4 sinLatTo, cosLatTo, sinDiffLon, cosDiffLon, tmp1, tmp2;
+  for (size_t i = 0; i < n; i += 4) {
+    size_t m = n - i < 4 ? n - i : 4;
+    for (size_t j = 0; j < 4; ++j) {
+      const SGGeoc& p = to[i + (j < m ? j : 0)];
+      double lat2 = p.getLatitudeRad(), diffLon = lon1 - p.getLongitudeRad();
+      sinLatTo[j] = sin(lat2);
+      cosLatTo[j] = cos(lat2);
+      sinDiffLon[j] = sin(diffLon);
+      cosDiffLon[j] = cos(diffLon);
+      tmp1[j] = sin(0.5*(lat1 - lat2));
+      tmp2[j] = sin(0.5*diffLon);
+    }
+
+    if (distance) {
+      double4 square = tmp1*tmp1 + cosLatFrom*cosLatTo*tmp2*tmp2;
+      square = simd4::sqrt(simd4::max(square, double4(0.0)));
+      for (size_t j = 0; j < m; ++j)
+        distance[i+j] = 2 * asin(SGMiscd::min(square[j], 1))
+                          * SG_RAD_TO_NM * SG_NM_TO_METER;
+    }
+
+    if (course) {
+      double4 x = cosLatTo*sinDiffLon;
+      double4 y = cosLatFrom*sinLatTo - sinLatFrom*cosLatTo*cosDiffLon;
+      for (size_t j = 0; j < m; ++j) {
+        // guard atan2 returning NaN's
+        if (fabs(x[j]) <= SGLimitsd::min() && fabs(y[j]) <= SGLimitsd::min()) {
+          course[i+j] = 0;
+          continue;
+        }
+        double c = atan2(x[j], y[j]);
+        course[i+j] = c >= 0 ? SGMiscd::twopi() - c : -c;
+      }
+    }
+  }
+}
+
 bool 
 SGGeodesy::radialIntersection(const SGGeoc& a, double r1, 
     const SGGeoc& b, double r2, SGGeoc& result)
@@ -23,11 +23,14 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <vector>
 
 #include "SGMath.hxx"
 #include "SGRect.hxx"
 #include "sg_random.h"
 
+#include <simgear/timing/timestamp.hxx>
+
 int lineno = 0;
 
 
@@ -357,6 +360,282 @@ GeodesyTest(void)
   return true;
 }
 
+// Units in the last place of the value v
+static double
+ulp(double v)
+{
+  return SGLimits<double>::epsilon()*std::max(fabs(v), SGLimits<double>::min());
+}
+
+bool
+GeodesyBatchTest(void)
+{
+  // The bounds documented for the batch conversions.  Angles are compared
+  // in radians in [-pi, pi], where one ulp of pi bounds the one of any
+  // angle
+  double maxRad = 4*ulp(SGMisc<double>::pi());
+  double maxM = 4*ulp(SGGeodesy::EQURAD);
+
+  // not a multiple of the block size, to also test the padded last block
+  const size_t n = 1003;
+  std::vector<SGGeod> geods(n);
+  std::vector<SGVec3<double> > carts(n);
+  for (size_t i = 0; i < n; ++i) {
+    geods[i] = SGGeod::fromDegM(360*sg_random() - 180, 180*sg_random() - 90,
+                                20000*sg_random() - 1000);
+    carts[i] = SGVec3<double>::fromGeod(geods[i]);
+  }
+  // poles, the geocenter and far in space
+  geods[0] = SGGeod::fromDegM(0, 90, 0);
+  geods[1] = SGGeod::fromDegM(120, -90, 100);
+  carts[0] = SGVec3<double>::fromGeod(geods[0]);
+  carts[1] = SGVec3<double>::fromGeod(geods[1]);
+  carts[2] = SGVec3<double>(1, 2, 3);
+  carts[3] = SGVec3<double>(4e8, -3e8, 1e8);
+
+  // arrays of positions
+  std::vector<SGGeod> geods1(n);
+  std::vector<SGVec3<double> > carts1(n);
+  SGGeodesy::SGCartToGeod(&carts[0], &geods1[0], n);
+  SGGeodesy::SGGeodToCart(&geods[0], &carts1[0], n);
+
+  // one array per coordinate
+  std::vector<double> x(n), y(n), z(n), lon(n), lat(n), elev(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = carts[i](0);
+    y[i] = carts[i](1);
+    z[i] = carts[i](2);
+  }
+  SGGeodesy::SGCartToGeod(&x[0], &y[0], &z[0], &lon[0], &lat[0], &elev[0], n);
+
+  for (size_t i = 0; i < n; ++i) {
+    SGGeod geod = SGGeod::fromCart(carts[i]);
+    if (maxRad < fabs(geod.getLongitudeRad() - geods1[i].getLongitudeRad()) ||
+        maxRad < fabs(geod.getLatitudeRad() - geods1[i].getLatitudeRad()) ||
+        maxM < fabs(geod.getElevationM() - geods1[i].getElevationM()))
+      { lineno = __LINE__; return false; }
+    if (lon[i] != geods1[i].getLongitudeRad() ||
+        lat[i] != geods1[i].getLatitudeRad() ||
+        elev[i] != geods1[i].getElevationM())
+      { lineno = __LINE__; return false; }
+
+    SGVec3<double> cart = SGVec3<double>::fromGeod(geods[i]);
+    if (maxM < norm(cart - carts1[i]))
+      { lineno = __LINE__; return false; }
+  }
+
+  SGGeodesy::SGGeodToCart(&lon[0], &lat[0], &elev[0], &x[0], &y[0], &z[0], n);
+  for (size_t i = 0; i < n; ++i) {
+    SGVec3<double> cart = SGVec3<double>::fromGeod(geods1[i]);
+    if (maxM < fabs(cart(0) - x[i]) || maxM < fabs(cart(1) - y[i]) ||
+        maxM < fabs(cart(2) - z[i]))
+      { lineno = __LINE__; return false; }
+  }
+
+  return true;
+}
+
+// Throughput of the single point and batch geodetic conversions
+void
+GeodesyBenchmark(void)
+{
+  const size_t n = 100000;
+  std::vector<SGGeod> geods(n), geods1(n);
+  std::vector<SGVec3<double> > carts(n);
+  for (size_t i = 0; i < n; ++i)
+    geods[i] = SGGeod::fromDegM(360*sg_random() - 180, 180*sg_random() - 90,
+                                10000*sg_random());
+
+  SGTimeStamp start = SGTimeStamp::now();
+  for (size_t i = 0; i < n; ++i)
+    SGGeodesy::SGGeodToCart(geods[i], carts[i]);
+  double geodToCart = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  for (size_t i = 0; i < n; ++i)
+    SGGeodesy::SGCartToGeod(carts[i], geods1[i]);
+  double cartToGeod = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  SGGeodesy::SGGeodToCart(&geods[0], &carts[0], n);
+  double geodToCartBatch = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  SGGeodesy::SGCartToGeod(&carts[0], &geods1[0], n);
+  double cartToGeodBatch = (SGTimeStamp::now() - start).toUSecs();
+
+  std::vector<double> x(n), y(n), z(n), lon(n), lat(n), elev(n);
+  for (size_t i = 0; i < n; ++i) {
+    x[i] = carts[i](0);
+    y[i] = carts[i](1);
+    z[i] = carts[i](2);
+  }
+  start = SGTimeStamp::now();
+  SGGeodesy::SGCartToGeod(&x[0], &y[0], &z[0], &lon[0], &lat[0], &elev[0], n);
+  double cartToGeodSoA = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  SGGeodesy::SGGeodToCart(&lon[0], &lat[0], &elev[0], &x[0], &y[0], &z[0], n);
+  double geodToCartSoA = (SGTimeStamp::now() - start).toUSecs();
+
+  // points per microsecond = million points per second
+  std::cout << "geodetic conversions (Mpoints/s):" << std::endl
+            << "  SGGeodToCart: " << n/geodToCart
+            << ", batch " << n/geodToCartBatch
+            << ", batch per coordinate " << n/geodToCartSoA << std::endl
+            << "  SGCartToGeod: " << n/cartToGeod
+            << ", batch " << n/cartToGeodBatch
+            << ", batch per coordinate " << n/cartToGeodSoA << std::endl;
+}
+
+bool
+GeodesyBatchInverseTest(void)
+{
+  const size_t n = 1003;
+  std::vector<SGGeod> targets(n);
+  for (size_t i = 0; i < n; ++i) {
+    // half of them close by
+    double scale = i % 2 ? 1 : 0.01;
+    targets[i] = SGGeod::fromDeg(scale*(360*sg_random() - 180),
+                                 scale*(180*sg_random() - 90));
+  }
+
+  SGGeod origins[] = {
+    SGGeod::fromDeg(0.3, 0.2),
+    SGGeod::fromDeg(-120, 47),
+    SGGeod::fromDeg(10, 89.5),
+    SGGeod::fromDeg(10, -90)
+  };
+  for (unsigned k = 0; k < sizeof(origins)/sizeof(origins[0]); ++k) {
+    const SGGeod& from = origins[k];
+    // the special cases of the inverse problem
+    targets[0] = from;
+    targets[1] = SGGeod::fromDeg(from.getLongitudeDeg() + 180,
+                                 -from.getLatitudeDeg());
+    // (but not the same pole or the equator for polar origins, where
+    // inverse() recurses endlessly)
+    bool polar = fabs(from.getLatitudeDeg()) >= 90;
+    double lat = polar ? 45 : from.getLatitudeDeg();
+    targets[2] = SGGeod::fromDeg(from.getLongitudeDeg() + 180, lat);
+    targets[3] = SGGeod::fromDeg(33, 90);
+    targets[4] = SGGeod::fromDeg(from.getLongitudeDeg(), polar ? 45 : 0);
+
+    std::vector<double> course(n), distance(n);
+    if (!SGGeodesy::inverse(from, &targets[0], n, &course[0], &distance[0]))
+      { lineno = __LINE__; return false; }
+    for (size_t i = 0; i < n; ++i) {
+      double course1, course2, dist;
+      SGGeodesy::inverse(from, targets[i], course1, course2, dist);
+      if (1e-9 < fabs(course[i] - course1) || 1e-6 < fabs(distance[i] - dist))
+        { lineno = __LINE__; return false; }
+    }
+
+    // range culling against the geodesic distances, but without the
+    // special cases and polar origins, for which inverse() treats both
+    // poles alike
+    double ranges[] = { 1e4, 2e5, 5e6, 3e7 };
+    std::vector<size_t> indices(n);
+    std::vector<double> inRange(n);
+    for (unsigned r = 0; r < sizeof(ranges)/sizeof(ranges[0]) && !polar; ++r) {
+      size_t m = SGGeodesy::withinRangeM(from, &targets[5], n - 5, ranges[r],
+                                         &indices[0], &inRange[0]);
+      size_t expected = 0;
+      for (size_t i = 0; i < n - 5; ++i) {
+        if (distance[i+5] > ranges[r])
+          continue;
+        if (expected >= m || indices[expected] != i ||
+            inRange[expected] != distance[i+5])
+          { lineno = __LINE__; return false; }
+        ++expected;
+      }
+      if (expected != m)
+        { lineno = __LINE__; return false; }
+    }
+
+    // the spherical distances of the prefilter are within 1%
+    double maxRatio = 0;
+    for (size_t i = 5; i < n && !polar; ++i) {
+      SGGeoc p1 = SGGeoc::fromRadM(from.getLongitudeRad(),
+                                   from.getLatitudeRad(), 1);
+      SGGeoc p2 = SGGeoc::fromRadM(targets[i].getLongitudeRad(),
+                                   targets[i].getLatitudeRad(), 1);
+      if (distance[i] > 1)
+        maxRatio = std::max(maxRatio, fabs(SGGeodesy::distanceM(p1, p2)
+                                           / distance[i] - 1));
+    }
+    if (0.01 < maxRatio)
+      { lineno = __LINE__; return false; }
+  }
+
+  // spherical courses and distances
+  SGGeoc from = SGGeoc::fromDegM(-120, 47, 1);
+  std::vector<SGGeoc> geocs(n);
+  for (size_t i = 0; i < n; ++i)
+    geocs[i] = SGGeoc::fromGeod(targets[i]);
+  geocs[0] = from;
+  std::vector<double> course(n), distance(n);
+  SGGeodesy::inverse(from, &geocs[0], n, &course[0], &distance[0]);
+  for (size_t i = 0; i < n; ++i) {
+    if (10*SGLimitsd::epsilon() < fabs(course[i] - SGGeodesy::courseRad(from, geocs[i])) ||
+        1e-6 < fabs(distance[i] - SGGeodesy::distanceM(from, geocs[i])))
+      { lineno = __LINE__; return false; }
+  }
+
+  return true;
+}
+
+// Throughput of the pairwise and batch course/distance computations
+void
+GeodesyInverseBenchmark(void)
+{
+  const size_t n = 20000;
+  SGGeod from = SGGeod::fromDeg(9.99, 53.63);
+  std::vector<SGGeod> targets(n);
+  std::vector<SGGeoc> geocs(n);
+  for (size_t i = 0; i < n; ++i) {
+    targets[i] = SGGeod::fromDeg(360*sg_random() - 180, 180*sg_random() - 90);
+    geocs[i] = SGGeoc::fromGeod(targets[i]);
+  }
+  std::vector<double> course(n), distance(n);
+  std::vector<size_t> indices(n);
+
+  SGTimeStamp start = SGTimeStamp::now();
+  for (size_t i = 0; i < n; ++i) {
+    double course2;
+    SGGeodesy::inverse(from, targets[i], course[i], course2, distance[i]);
+  }
+  double pairwise = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  SGGeodesy::inverse(from, &targets[0], n, &course[0], &distance[0]);
+  double batch = (SGTimeStamp::now() - start).toUSecs();
+
+  SGGeoc geocFrom = SGGeoc::fromGeod(from);
+  start = SGTimeStamp::now();
+  for (size_t i = 0; i < n; ++i) {
+    course[i] = SGGeodesy::courseRad(geocFrom, geocs[i]);
+    distance[i] = SGGeodesy::distanceM(geocFrom, geocs[i]);
+  }
+  double geocPairwise = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  SGGeodesy::inverse(geocFrom, &geocs[0], n, &course[0], &distance[0]);
+  double geocBatch = (SGTimeStamp::now() - start).toUSecs();
+
+  start = SGTimeStamp::now();
+  size_t m = SGGeodesy::withinRangeM(from, &targets[0], n, 500e3, &indices[0]);
+  double culling = (SGTimeStamp::now() - start).toUSecs();
+
+  // targets per microsecond = million targets per second
+  std::cout << "course/distance to many targets (Mtargets/s):" << std::endl
+            << "  geodetic: pairwise " << n/pairwise
+            << ", batch " << n/batch << std::endl
+            << "  spherical: pairwise " << n/geocPairwise
+            << ", batch " << n/geocBatch << std::endl
+            << "  within 500km (" << m << " targets): " << n/culling
+            << std::endl;
+}
+
 int
 main(void)
 {
@@ -391,6 +670,12 @@ main(void)
   // Check geodetic/geocentric/cartesian conversions
   if (!GeodesyTest())
     { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+  if (!GeodesyBatchTest())
+    { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+  if (!GeodesyBatchInverseTest())
+    { fprintf(stderr, "Error at line: %i called from line: %i\n", lineno, __LINE__); return EXIT_FAILURE; }
+  GeodesyBenchmark();
+  GeodesyInverseBenchmark();
 
   std::cout << "Successfully passed all tests!" << std::endl;
   return EXIT_SUCCESS;
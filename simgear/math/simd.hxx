@@ -121,6 +121,14 @@ inline simd4_t<T,3> cross(const simd4_t<T,3>& v1, const simd4_t<T,3>& v2)
     return d;
 }
 
+template<typename T, int N>
+inline simd4_t<T,N> sqrt(simd4_t<T,N> v) {
+    for (int i=0; i<N; ++i) {
+        v[i] = std::sqrt(v[i]);
+    }
+    return v;
+}
+
 } /* namespace simd4 */
 
 
@@ -309,6 +317,35 @@ inline simd4_t<T,N> operator*(simd4_t<T,N> v, T f) {
     return v;
 }
 
+template<typename T, int N>
+inline simd4_t<T,N> operator+(T f, simd4_t<T,N> v) {
+    v += f;
+    return v;
+}
+
+template<typename T, int N>
+inline simd4_t<T,N> operator+(simd4_t<T,N> v, T f) {
+    v += f;
+    return v;
+}
+
+template<typename T, int N>
+inline simd4_t<T,N> operator-(T f, const simd4_t<T,N>& v) {
+    return simd4_t<T,N>(f) - v;
+}
+
+template<typename T, int N>
+inline simd4_t<T,N> operator-(simd4_t<T,N> v, T f) {
+    v -= f;
+    return v;
+}
+
+template<typename T, int N>
+inline simd4_t<T,N> operator/(simd4_t<T,N> v, T f) {
+    v /= f;
+    return v;
+}
+
 #ifdef ENABLE_SIMD
 
 # ifdef __SSE__
@@ -563,6 +600,12 @@ inline simd4_t<float,N>abs(simd4_t<float,N> v) {
     return v;
 }
 
+template<int N>
+inline simd4_t<float,N> sqrt(simd4_t<float,N> v) {
+    v = _mm_sqrt_ps(v.v4());
+    return v;
+}
+
 } /* namsepace simd4 */
 
 # endif
@@ -800,6 +843,12 @@ inline simd4_t<double,N>abs(simd4_t<double,N> v) {
     return v;
 }
 
+template<int N>
+inline simd4_t<double,N> sqrt(simd4_t<double,N> v) {
+    v = _mm256_sqrt_pd(v.v4());
+    return v;
+}
+
 } /* namespace simd4 */
 
 # elif defined __SSE2__
@@ -893,6 +942,7 @@ public:
         __m128d d4 = _mm_set1_pd(d);
         simd4[0] = _mm_sub_pd(simd4[0], d4);
         simd4[1] = _mm_sub_pd(simd4[1], d4);
+        return *this;
     }
     inline simd4_t<double,N>& operator-=(const simd4_t<double,N>& v) {
         simd4[0] = _mm_sub_pd(simd4[0], v.v4()[0]);
@@ -916,6 +966,7 @@ public:
         __m128d d4 = _mm_set1_pd(d);
         simd4[0] = _mm_div_pd(simd4[0], d4);
         simd4[1] = _mm_div_pd(simd4[1], d4);
+        return *this;
     }
     inline simd4_t<double,N>& operator/=(const simd4_t<double,N>& v) {
         simd4[0] = _mm_div_pd(simd4[0], v.v4()[0]);
@@ -1090,6 +1141,13 @@ inline simd4_t<double,N>abs(simd4_t<double,N> v) {
     return v;
 }
 
+template<int N>
+inline simd4_t<double,N> sqrt(simd4_t<double,N> v) {
+    v.v4()[0] = _mm_sqrt_pd(v.v4()[0]);
+    v.v4()[1] = _mm_sqrt_pd(v.v4()[1]);
+    return v;
+}
+
 } /* namespace simd4 */
 
 # endif
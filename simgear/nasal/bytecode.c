@@ -0,0 +1,299 @@
+#include <string.h>
+#include "nasal.h"
+#include "code.h"
+
+/* Serialized code objects are a header (magic, format version,
+ * checksum and length of the rest) followed by the top level code
+ * object.  Each code object is stored as its size fields, then its
+ * constants (nested functions recursively), then the block of shorts
+ * holding the bytecode, argument symbols, optional argument values
+ * and line table.  Everything is in native byte order, and data from
+ * a different interpreter (or machine) is rejected rather than
+ * converted.  The bytecode is checked once when it is loaded, so even
+ * a corrupt blob with a valid checksum can't make the interpreter
+ * jump or index out of bounds.
+ *
+ * CODE_VERSION must be bumped with every change to the encoding: the
+ * instruction set or the operands of any instruction, the constant
+ * types or the layout of a code object.  Adding an opcode breaks the
+ * build below as a reminder. */
+
+#define CODE_VERSION 2
+#define CODE_NUM_OPCODES 73
+#define HEADER_SZ 16
+
+typedef char codeVersionCheck[NUM_OPCODES == CODE_NUM_OPCODES ? 1 : -1];
+
+static const char MAGIC[4] = { 'N', 'a', 's', 'C' };
+
+enum { CONST_NIL, CONST_NUM, CONST_STR, CONST_SYM, CONST_CODE };
+
+struct Writer { char* buf; int len; int alloced; };
+struct Reader { const char* p; const char* end; int failed; };
+
+static unsigned int checksum(const char* buf, int len)
+{
+    unsigned int h = 2166136261u; // FNV-1a
+    int i;
+    for(i=0; i<len; i++)
+        h = (h ^ (unsigned char)buf[i]) * 16777619u;
+    return h;
+}
+
+// Size of the block of shorts following the constants
+static int nShorts(struct naCode* c)
+{
+    return c->codesz + c->nArgs + 2*c->nOptArgs + c->nLines;
+}
+
+static void put(struct Writer* w, const void* data, int len)
+{
+    if(w->len + len > w->alloced) {
+        w->alloced = 2 * (w->len + len);
+        w->buf = naRealloc(w->buf, w->alloced);
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void putByte(struct Writer* w, int v)
+{
+    unsigned char b = v;
+    put(w, &b, 1);
+}
+
+static void saveCode(struct Writer* w, struct naCode* c)
+{
+    unsigned short sizes[8];
+    int i, len;
+    naRef k, sym;
+    sizes[0] = c->nArgs;
+    sizes[1] = c->nOptArgs;
+    sizes[2] = c->needArgVector;
+    sizes[3] = c->nConstants;
+    sizes[4] = c->codesz;
+    sizes[5] = c->restArgSym;
+    sizes[6] = c->nLines;
+    sizes[7] = c->nMemberCaches;
+    put(w, sizes, sizeof(sizes));
+    for(i=0; i<c->nConstants; i++) {
+        k = c->constants[i];
+        if(IS_NUM(k)) {
+            putByte(w, CONST_NUM);
+            put(w, &k.num, sizeof(double));
+        } else if(IS_STR(k)) {
+            // Symbols must come back as the interned instance
+            int isSym = naHash_get(globals->symbols, k, &sym)
+                && IDENTICAL(sym, k);
+            putByte(w, isSym ? CONST_SYM : CONST_STR);
+            len = naStr_len(k);
+            put(w, &len, sizeof(len));
+            put(w, naStr_cdata(k), len);
+        } else if(IS_CODE(k)) {
+            putByte(w, CONST_CODE);
+            saveCode(w, PTR(k).code);
+        } else {
+            putByte(w, CONST_NIL);
+        }
+    }
+    put(w, BYTECODE(c), nShorts(c) * sizeof(unsigned short));
+}
+
+naRef naSaveCode(naContext ctx, naRef code)
+{
+    struct Writer w = { 0, 0, 0 };
+    unsigned int hdr[3];
+    naRef result;
+    if(!IS_CODE(code)) return naNil();
+    put(&w, MAGIC, sizeof(MAGIC));
+    put(&w, hdr, sizeof(hdr)); // filled in below
+    saveCode(&w, PTR(code).code);
+    hdr[0] = CODE_VERSION;
+    hdr[1] = checksum(w.buf + HEADER_SZ, w.len - HEADER_SZ);
+    hdr[2] = w.len - HEADER_SZ;
+    memcpy(w.buf + sizeof(MAGIC), hdr, sizeof(hdr));
+    result = naStr_fromdata(naNewString(ctx), w.buf, w.len);
+    naFree(w.buf);
+    return result;
+}
+
+static const char* get(struct Reader* r, int len)
+{
+    const char* p = r->p;
+    if(r->failed || len < 0 || r->end - r->p < len) {
+        r->failed = 1;
+        return 0;
+    }
+    r->p += len;
+    return p;
+}
+
+static naRef loadString(naContext ctx, struct Reader* r, int isSym)
+{
+    int len;
+    const char* p = get(r, sizeof(len));
+    naRef s;
+    if(!p) return naNil();
+    memcpy(&len, p, sizeof(len));
+    if(!(p = get(r, len))) return naNil();
+    s = naStr_fromdata(naNewString(ctx), p, len);
+    return isSym ? naInternSymbol(s) : s;
+}
+
+// Walks the instructions once, checking every operand the interpreter
+// trusts: constant and member cache indices, jump targets (which must
+// be instruction starts) and counts.  The code must end in OP_RETURN.
+static int validCode(struct naCode* c)
+{
+    unsigned short* code = BYTECODE(c);
+    unsigned char* starts;
+    int ip = 0, last = -1, i, ok = 1, nMember = 0;
+    if(c->codesz == 0) return 0;
+    starts = naAlloc(c->codesz);
+    naBZero(starts, c->codesz);
+    while(ok && ip < c->codesz) {
+        int op = code[ip], nargs = 0;
+        starts[ip] = 1;
+        last = op;
+        switch(op) {
+        case OP_PUSHCONST: case OP_LOCAL:
+            nargs = 1;
+            ok = ip+1 < c->codesz && code[ip+1] < c->nConstants;
+            break;
+        case OP_PLUSC: case OP_MINUSC: case OP_MULC: case OP_DIVC:
+        case OP_LTC: case OP_LTEC: case OP_GTC: case OP_GTEC:
+            nargs = 1;
+            ok = ip+1 < c->codesz && code[ip+1] < c->nConstants
+                && IS_NUM(c->constants[code[ip+1]]);
+            break;
+        case OP_MEMBER: case OP_LOCALMEMBER:
+            nargs = op == OP_MEMBER ? 2 : 3;
+            ok = ip+nargs < c->codesz && code[ip+nargs] < c->nMemberCaches;
+            for(i=1; ok && i<nargs; i++)
+                ok = code[ip+i] < c->nConstants;
+            nMember++;
+            break;
+        case OP_JMP: case OP_JMPLOOP: case OP_JIFEND: case OP_JIFTRUE:
+        case OP_JIFNOT: case OP_JIFNOTPOP: case OP_JIFNOTLT:
+        case OP_JIFNOTLTE: case OP_JIFNOTGT: case OP_JIFNOTGTE:
+        case OP_JIFNOTEQ: case OP_JIFNOTNEQ:
+            nargs = 1;
+            ok = ip+1 < c->codesz && code[ip+1] < c->codesz;
+            break;
+        case OP_FCALL: case OP_MCALL: case OP_UNPACK:
+            nargs = 1;
+            ok = ip+1 < c->codesz && code[ip+1] < MAX_STACK_DEPTH;
+            break;
+        default:
+            ok = op < NUM_OPCODES;
+        }
+        ip += 1 + nargs;
+    }
+    // Jump targets, now that all the instruction starts are known
+    for(ip=0; ok && ip < c->codesz; ip++) {
+        if(!starts[ip]) continue;
+        switch(code[ip]) {
+        case OP_JMP: case OP_JMPLOOP: case OP_JIFEND: case OP_JIFTRUE:
+        case OP_JIFNOT: case OP_JIFNOTPOP: case OP_JIFNOTLT:
+        case OP_JIFNOTLTE: case OP_JIFNOTGT: case OP_JIFNOTGTE:
+        case OP_JIFNOTEQ: case OP_JIFNOTNEQ:
+            ok = starts[code[ip+1]];
+        }
+    }
+    naFree(starts);
+    return ok && last == OP_RETURN && nMember == c->nMemberCaches;
+}
+
+static naRef loadCode(naContext ctx, struct Reader* r, naRef srcFile)
+{
+    unsigned short sizes[8];
+    const char* p = get(r, sizeof(sizes));
+    struct naCode* c;
+    naRef codeObj, k;
+    int i;
+    if(!p) return naNil();
+    memcpy(sizes, p, sizeof(sizes));
+    if(sizes[0] >= 32 || sizes[1] >= 32 || sizes[5] >= sizes[3])
+        return naNil();
+
+    codeObj = naNewCode(ctx);
+    c = PTR(codeObj).code;
+    c->nArgs = sizes[0];
+    c->nOptArgs = sizes[1];
+    c->needArgVector = sizes[2] != 0;
+    c->nConstants = sizes[3];
+    c->codesz = sizes[4];
+    c->restArgSym = sizes[5];
+    c->nLines = sizes[6];
+    c->nMemberCaches = sizes[7];
+    c->srcFile = srcFile;
+    c->constants = 0;
+    c->constants = naAlloc((int)(size_t)(LINEIPS(c)+c->nLines));
+    for(i=0; i<c->nConstants; i++)
+        c->constants[i] = naNil();
+    c->memberCaches = naAlloc(sizeof(struct MemberCache) * c->nMemberCaches);
+    naBZero(c->memberCaches, sizeof(struct MemberCache) * c->nMemberCaches);
+
+    for(i=0; i<c->nConstants && !r->failed; i++) {
+        k = naNil();
+        if(!(p = get(r, 1))) break;
+        switch(*p) {
+        case CONST_NIL: k = naNil(); break;
+        case CONST_NUM:
+            if((p = get(r, sizeof(double)))) {
+                double d;
+                memcpy(&d, p, sizeof(d));
+                k = naNum(d);
+            }
+            break;
+        case CONST_STR: case CONST_SYM:
+            k = loadString(ctx, r, *p == CONST_SYM);
+            break;
+        case CONST_CODE:
+            k = loadCode(ctx, r, srcFile);
+            if(IS_NIL(k)) r->failed = 1;
+            break;
+        default: r->failed = 1;
+        }
+        if(r->failed) break;
+        c->constants[i] = k;
+        GC_WRITE_BARRIER(c, k); // may be old by now
+    }
+
+    if(!(p = get(r, nShorts(c) * sizeof(unsigned short))))
+        return naNil();
+    memcpy(BYTECODE(c), p, nShorts(c) * sizeof(unsigned short));
+    for(i=0; i<c->nArgs; i++)
+        if(ARGSYMS(c)[i] >= c->nConstants) return naNil();
+    for(i=0; i<c->nOptArgs; i++)
+        if(OPTARGSYMS(c)[i] >= c->nConstants
+           || OPTARGVALS(c)[i] >= c->nConstants) return naNil();
+    if(!validCode(c)) return naNil();
+    return codeObj;
+}
+
+naRef naLoadCode(naContext ctx, naRef srcFile, const char* buf, int len)
+{
+    struct Reader r;
+    unsigned int hdr[3];
+    naRef code;
+    if(len < HEADER_SZ || memcmp(buf, MAGIC, sizeof(MAGIC)) != 0)
+        return naNil();
+    memcpy(hdr, buf + sizeof(MAGIC), sizeof(hdr));
+    if(hdr[0] != CODE_VERSION || hdr[2] != (unsigned int)(len - HEADER_SZ)
+       || hdr[1] != checksum(buf + HEADER_SZ, len - HEADER_SZ))
+        return naNil();
+
+    naTempSave(ctx, srcFile);
+    r.p = buf + HEADER_SZ;
+    r.end = buf + len;
+    r.failed = 0;
+    code = loadCode(ctx, &r, srcFile);
+    if(r.failed || r.p != r.end) return naNil();
+    return code;
+}
+
+int naCodeVersion(void)
+{
+    return CODE_VERSION;
+}
@@ -20,7 +20,8 @@ void printOpDEBUG(int ip, int op);
 void printStackDEBUG(naContext ctx);
 ////////////////////////////////////////////////////////////////////////
 
-struct Globals* globals = 0;
+struct Globals* nasal_globals = 0;
+NA_THREAD_LOCAL struct Globals* nasal_heap = 0;
 
 static naRef bindFunction(naContext ctx, struct Frame* f, naRef code);
 
@@ -105,6 +106,16 @@ static int checkStr(naContext ctx, naRef str, naRef idx)
     return i;
 }
 
+static int checkNumVec(naContext ctx, naRef nv, naRef idx)
+{
+    int i = (int)numify(ctx, idx);
+    if(i < 0) i += naNumVec_size(nv);
+    if(i < 0 || i >= naNumVec_size(nv))
+        naRuntimeError(ctx, "numvec index %d out of bounds (size: %d)",
+                       i, naNumVec_size(nv));
+    return i;
+}
+
 static naRef containerGet(naContext ctx, naRef box, naRef key)
 {
     naRef result = naNil();
@@ -114,7 +125,9 @@ static naRef containerGet(naContext ctx, naRef box, naRef key)
     else if(IS_VEC(box))
         result = naVec_get(box, checkVec(ctx, box, key));
     else if(IS_STR(box))
-        result = naNum((unsigned char)naStr_data(box)[checkStr(ctx, box, key)]);
+        result = naNum((unsigned char)naStr_cdata(box)[checkStr(ctx, box, key)]);
+    else if(naIsNumVec(box))
+        result = naNum(naNumVec_get(box, checkNumVec(ctx, box, key)));
     else
         ERR(ctx, "extract from non-container");
     return result;
@@ -129,7 +142,9 @@ static void containerSet(naContext ctx, naRef box, naRef key, naRef val)
         if(PTR(box).str->hashcode)
             ERR(ctx, "cannot change immutable string");
         naStr_data(box)[checkStr(ctx, box, key)] = (char)numify(ctx, val);
-    } else ERR(ctx, "insert into non-container");
+    } else if(naIsNumVec(box))
+        naNumVec_set(box, checkNumVec(ctx, box, key), numify(ctx, val));
+    else ERR(ctx, "insert into non-container");
 }
 
 static void initTemps(naContext c)
@@ -151,53 +166,65 @@ static void initContext(naContext c)
         initTemps(c);
     }
 
+    c->heap = globals;
     c->callParent = 0;
     c->callChild = 0;
+    c->profileTicks = 0;
     c->dieArg = naNil();
     c->error[0] = 0;
     c->userData = 0;
 }
 
-static void initGlobals()
+// Creates a heap, installed in *slot: nasal_globals for the default
+// heap, or nasal_heap for an isolate's
+static void initGlobals(struct Globals** slot)
 {
     int i;
     naContext c;
-    globals = (struct Globals*)naAlloc(sizeof(struct Globals));
-    naBZero(globals, sizeof(struct Globals));
+    struct Globals* g = (struct Globals*)naAlloc(sizeof(struct Globals));
+    naBZero(g, sizeof(struct Globals));
 
-    globals->sem = naNewSem();
-    globals->lock = naNewLock();
+    g->sem = naNewSem();
+    g->lock = naNewLock();
 
-    globals->allocCount = 256; // reasonable starting value
-    for(i=0; i<NUM_NASAL_TYPES; i++)
-        naGC_init(&(globals->pools[i]), i);
-    globals->deadsz = 256;
-    globals->ndead = 0;
-    globals->deadBlocks = naAlloc(sizeof(void*) * globals->deadsz);
+    g->allocCount = 256; // reasonable starting value
+    g->deadsz = 256;
+    g->ndead = 0;
+    g->deadBlocks = naAlloc(sizeof(void*) * g->deadsz);
+    g->stringMethods = naNil();
+    g->heapRefs = 1;
 
     // Initialize a single context
-    globals->freeContexts = 0;
-    globals->allContexts = 0;
+    g->freeContexts = 0;
+    g->allContexts = 0;
+    *slot = g;
+    for(i=0; i<NUM_NASAL_TYPES; i++)
+        naGC_init(&(g->pools[i]), i);
     c = naNewContext();
 
-    globals->symbols = naNewHash(c);
-    globals->save = naNewVector(c);
-    globals->save_hash = naNewHash(c);
-    globals->next_gc_key = 0;
+    g->symbols = naNewHash(c);
+    g->save = naNewVector(c);
+    g->save_hash = naNewHash(c);
+    g->next_gc_key = 0;
 
     // Cache pre-calculated "me", "arg" and "parents" scalars
-    globals->meRef = naInternSymbol(naStr_fromdata(naNewString(c), "me", 2));
-    globals->argRef = naInternSymbol(naStr_fromdata(naNewString(c), "arg", 3));
-    globals->parentsRef = naInternSymbol(naStr_fromdata(naNewString(c), "parents", 7));
+    g->meRef = naInternSymbol(naStr_fromdata(naNewString(c), "me", 2));
+    g->argRef = naInternSymbol(naStr_fromdata(naNewString(c), "arg", 3));
+    g->parentsRef = naInternSymbol(naStr_fromdata(naNewString(c), "parents", 7));
 
     naFreeContext(c);
 }
 
+void naiNewHeap()
+{
+    initGlobals(&nasal_heap);
+}
+
 naContext naNewContext()
 {
     naContext c;
     if(globals == 0)
-        initGlobals();
+        initGlobals(&nasal_globals);
 
     LOCK();
     c = globals->freeContexts;
@@ -274,8 +301,10 @@ static void setupArgs(naContext ctx, struct Frame* f, naRef* args, int nargs)
     if(c->needArgVector || nargs > 0) {
         naRef argv = naNewVector(ctx);
         naVec_setsize(ctx, argv, nargs > 0 ? nargs : 0);
-        for(i=0; i<nargs; i++)
+        for(i=0; i<nargs; i++) {
             PTR(argv).vec->rec->array[i] = *args++;
+            GC_WRITE_BARRIER(PTR(argv).vec, PTR(argv).vec->rec->array[i]);
+        }
         naiHash_newsym(PTR(f->locals).hash, &c->constants[c->restArgSym], &argv);
     }
 }
@@ -335,7 +364,7 @@ static struct Frame* setupFuncall(naContext ctx, int nargs, int mcall, int named
     f->ip = 0;
     f->bp = ctx->opFrame;
 
-    if(mcall) naHash_set(f->locals, globals->meRef, obj);
+    if(mcall) naHash_set(f->locals, ctx->heap->meRef, obj);
 
     if(named) checkNamedArgs(ctx, PTR(code).code, PTR(f->locals).hash);
     else      setupArgs(ctx, f, args, nargs);
@@ -451,10 +480,10 @@ static const char* getMember_r(naContext ctx, naRef obj, naRef field, naRef* out
 
     if (IS_GHOST(obj)) {
         if (ghostGetMember(ctx, obj, field, out)) return "";
-        if(!ghostGetMember(ctx, obj, globals->parentsRef, &p)) return 0;
+        if(!ghostGetMember(ctx, obj, ctx->heap->parentsRef, &p)) return 0;
     } else if (IS_HASH(obj)) {
         if(naHash_get(obj, field, out)) return "";
-        if(!naHash_get(obj, globals->parentsRef, &p)) return 0;
+        if(!naHash_get(obj, ctx->heap->parentsRef, &p)) return 0;
     } else if (IS_STR(obj) ) {
         return getMember_r(ctx, getStringMethods(ctx), field, out, count);
     } else {
@@ -478,6 +507,90 @@ static void getMember(naContext ctx, naRef obj, naRef fld,
     if(err[0]) naRuntimeError(ctx, err);
 }
 
+// Follows the first parents of a hash, the way getMember_r() searches
+// them first, recording the path into e.  Returns 1 when the member
+// was found there, 0 if not, or if the lookup can't be cached.
+static int traceMember(naContext ctx, naRef obj, naRef field,
+                       struct MemberCacheEntry* e)
+{
+    int depth;
+    naRef p;
+    struct VecRec* pv;
+    for(depth=0; depth <= MEMBER_CACHE_DEPTH; depth++) {
+        struct MemberLink* l = &e->path[depth];
+        if(!IS_HASH(obj)) return 0;
+        l->hash = PTR(obj).hash;
+        l->version = l->hash->version;
+        if(naHash_get(obj, field, &e->value)) {
+            e->depth = depth;
+            return 1;
+        }
+        if(!naHash_get(obj, ctx->heap->parentsRef, &p) || !IS_VEC(p))
+            return 0;
+        l->parents = PTR(p).vec;
+        l->pversion = l->parents->version;
+        pv = l->parents->rec;
+        if(!pv || pv->size == 0) return 0;
+        obj = pv->array[0];
+    }
+    return 0;
+}
+
+static void fillMemberCache(naContext ctx, struct naCode* cd, int i,
+                            naRef obj, naRef fld)
+{
+    struct MemberCache* mc = &cd->memberCaches[i];
+    struct MemberCacheEntry* e;
+    if(!IS_HASH(obj) || mc->misses >= MEMBER_CACHE_MISSES) return;
+    e = naAlloc(sizeof(struct MemberCacheEntry)
+                + sizeof(struct MemberLink) * (MEMBER_CACHE_DEPTH+1));
+    if(!traceMember(ctx, obj, fld, e)) { naFree(e); return; }
+    mc->misses++;
+    naiGCSetMemberCache(cd, i, e);
+}
+
+// Whether nothing on the path changed, from path[first] on
+static int memberPathValid(struct MemberCacheEntry* e, int first)
+{
+    int i;
+    for(i=first; i<e->depth; i++)
+        if(e->path[i].hash->version != e->path[i].version
+           || e->path[i].parents->version != e->path[i].pversion)
+            return 0;
+    return e->path[i].hash->version == e->path[i].version;
+}
+
+// getMember() for OP_MEMBER, going through the instruction's cache
+static void getCachedMember(naContext ctx, struct naCode* cd, int i,
+                            naRef obj, naRef fld, naRef* result)
+{
+    naRef p;
+    struct VecRec* pv;
+    struct MemberCacheEntry* e = cd->memberCaches[i].entry;
+    if(e && IS_HASH(obj)) {
+        struct naHash* h = PTR(obj).hash;
+        if(h == e->path[0].hash) {
+            if(memberPathValid(e, 0)) {
+                *result = e->value;
+                return;
+            }
+        }
+        // Another instance of the same class?
+        else if(e->depth > 0 && !naHash_get(obj, fld, result)
+                && naHash_get(obj, ctx->heap->parentsRef, &p) && IS_VEC(p)
+                && (pv = PTR(p).vec->rec) && pv->size > 0
+                && !IS_NUM(pv->array[0])
+                && PTR(pv->array[0]).hash == e->path[1].hash
+                && memberPathValid(e, 1))
+        {
+            *result = e->value;
+            return;
+        }
+    }
+    getMember(ctx, obj, fld, result, 64);
+    fillMemberCache(ctx, cd, i, obj, fld);
+}
+
 static void setMember(naContext ctx, naRef obj, naRef fld, naRef value)
 {
     if (IS_GHOST(obj)) {
@@ -501,12 +614,22 @@ int naMember_get(naContext ctx, naRef obj, naRef field, naRef* out)
 
 // OP_EACH works like a vector get, except that it leaves the vector
 // and index on the stack, increments the index after use, and
-// pushes a nil if the index is beyond the end.
+// pushes a nil if the index is beyond the end.  Packed numeric
+// vectors are enumerated the same way.
 static void evalEach(naContext ctx, int useIndex)
 {
     int idx = (int)(ctx->opStack[ctx->opTop-1].num);
     naRef vec = ctx->opStack[ctx->opTop-2];
-    if(!IS_VEC(vec)) ERR(ctx, "foreach enumeration of non-vector");
+    if(!IS_VEC(vec)) {
+        if(!naIsNumVec(vec)) ERR(ctx, "foreach enumeration of non-vector");
+        if(idx >= naNumVec_size(vec)) {
+            PUSH(endToken());
+            return;
+        }
+        ctx->opStack[ctx->opTop-1].num = idx+1;
+        PUSH(useIndex ? naNum(idx) : naNum(naNumVec_get(vec, idx)));
+        return;
+    }
     if(!PTR(vec).vec->rec || idx >= PTR(vec).vec->rec->size) {
         PUSH(endToken());
         return;
@@ -557,12 +680,75 @@ static void evalSlice2(naContext ctx, naRef src, naRef dst,
 #define STK(n) (ctx->opStack[ctx->opTop-(n)])
 #define SETFRAME(F) f = (F); cd = PTR(PTR(f->func).func->code).code;
 #define FIXFRAME() SETFRAME(&(ctx->fStack[ctx->fTop-1]))
+
+// Where the compiler supports it, instructions are dispatched through
+// a table of label addresses, from the end of each instruction.  That
+// skips the switch's range check, and gives every instruction its own
+// indirect branch for the CPU to predict.
+#if defined(__GNUC__) && !defined(NASAL_NO_COMPUTED_GOTO)
+# define COMPUTED_GOTO
+#endif
+
+#ifdef COMPUTED_GOTO
+# define DISPATCH(op) goto *dispatch[op];
+# define OPCASE(op) L_##op
+# define OPDEFAULT L_BAD
+# define NEXT do { ctx->ntemps = 0; DBG(printStackDEBUG(ctx)); \
+                   op = BYTECODE(cd)[f->ip++]; \
+                   DBG(printf("Stack Depth: %d\n", ctx->opTop)); \
+                   DBG(printOpDEBUG(f->ip-1, op)); \
+                   goto *dispatch[op]; } while(0)
+#else
+# define DISPATCH(op) switch(op)
+# define OPCASE(op) case op
+# define OPDEFAULT default
+# define NEXT break
+#endif
+
 static naRef run(naContext ctx)
 {
     struct Frame* f;
     struct naCode* cd;
     int op, arg;
     naRef a, b;
+#ifdef COMPUTED_GOTO
+    static void* dispatch[NUM_OPCODES] = {
+        [0 ... NUM_OPCODES-1] = &&L_BAD,
+        [OP_NOT]=&&L_OP_NOT, [OP_MUL]=&&L_OP_MUL, [OP_PLUS]=&&L_OP_PLUS,
+        [OP_MINUS]=&&L_OP_MINUS, [OP_DIV]=&&L_OP_DIV, [OP_NEG]=&&L_OP_NEG,
+        [OP_CAT]=&&L_OP_CAT, [OP_LT]=&&L_OP_LT, [OP_LTE]=&&L_OP_LTE,
+        [OP_GT]=&&L_OP_GT, [OP_GTE]=&&L_OP_GTE, [OP_EQ]=&&L_OP_EQ,
+        [OP_NEQ]=&&L_OP_NEQ, [OP_EACH]=&&L_OP_EACH, [OP_JMP]=&&L_OP_JMP,
+        [OP_JMPLOOP]=&&L_OP_JMPLOOP, [OP_JIFNOTPOP]=&&L_OP_JIFNOTPOP,
+        [OP_JIFEND]=&&L_OP_JIFEND, [OP_FCALL]=&&L_OP_FCALL,
+        [OP_MCALL]=&&L_OP_MCALL, [OP_RETURN]=&&L_OP_RETURN,
+        [OP_PUSHCONST]=&&L_OP_PUSHCONST, [OP_PUSHONE]=&&L_OP_PUSHONE,
+        [OP_PUSHZERO]=&&L_OP_PUSHZERO, [OP_PUSHNIL]=&&L_OP_PUSHNIL,
+        [OP_POP]=&&L_OP_POP, [OP_DUP]=&&L_OP_DUP, [OP_XCHG]=&&L_OP_XCHG,
+        [OP_INSERT]=&&L_OP_INSERT, [OP_EXTRACT]=&&L_OP_EXTRACT,
+        [OP_MEMBER]=&&L_OP_MEMBER, [OP_SETMEMBER]=&&L_OP_SETMEMBER,
+        [OP_LOCAL]=&&L_OP_LOCAL, [OP_SETLOCAL]=&&L_OP_SETLOCAL,
+        [OP_NEWVEC]=&&L_OP_NEWVEC, [OP_VAPPEND]=&&L_OP_VAPPEND,
+        [OP_NEWHASH]=&&L_OP_NEWHASH, [OP_HAPPEND]=&&L_OP_HAPPEND,
+        [OP_MARK]=&&L_OP_MARK, [OP_UNMARK]=&&L_OP_UNMARK,
+        [OP_BREAK]=&&L_OP_BREAK, [OP_SETSYM]=&&L_OP_SETSYM,
+        [OP_DUP2]=&&L_OP_DUP2, [OP_INDEX]=&&L_OP_INDEX,
+        [OP_BREAK2]=&&L_OP_BREAK2, [OP_PUSHEND]=&&L_OP_PUSHEND,
+        [OP_JIFTRUE]=&&L_OP_JIFTRUE, [OP_JIFNOT]=&&L_OP_JIFNOT,
+        [OP_FCALLH]=&&L_OP_FCALLH, [OP_MCALLH]=&&L_OP_MCALLH,
+        [OP_XCHG2]=&&L_OP_XCHG2, [OP_UNPACK]=&&L_OP_UNPACK,
+        [OP_SLICE]=&&L_OP_SLICE, [OP_SLICE2]=&&L_OP_SLICE2,
+        [OP_BIT_AND]=&&L_OP_BIT_AND, [OP_BIT_OR]=&&L_OP_BIT_OR,
+        [OP_BIT_XOR]=&&L_OP_BIT_XOR, [OP_BIT_NEG]=&&L_OP_BIT_NEG,
+        [OP_LOCALMEMBER]=&&L_OP_LOCALMEMBER, [OP_PLUSC]=&&L_OP_PLUSC,
+        [OP_MINUSC]=&&L_OP_MINUSC, [OP_MULC]=&&L_OP_MULC,
+        [OP_DIVC]=&&L_OP_DIVC, [OP_LTC]=&&L_OP_LTC, [OP_LTEC]=&&L_OP_LTEC,
+        [OP_GTC]=&&L_OP_GTC, [OP_GTEC]=&&L_OP_GTEC,
+        [OP_JIFNOTLT]=&&L_OP_JIFNOTLT, [OP_JIFNOTLTE]=&&L_OP_JIFNOTLTE,
+        [OP_JIFNOTGT]=&&L_OP_JIFNOTGT, [OP_JIFNOTGTE]=&&L_OP_JIFNOTGTE,
+        [OP_JIFNOTEQ]=&&L_OP_JIFNOTEQ, [OP_JIFNOTNEQ]=&&L_OP_JIFNOTNEQ,
+    };
+#endif
 
     ctx->dieArg = naNil();
     ctx->error[0] = 0;
@@ -573,12 +759,12 @@ static naRef run(naContext ctx)
         op = BYTECODE(cd)[f->ip++];
         DBG(printf("Stack Depth: %d\n", ctx->opTop));
         DBG(printOpDEBUG(f->ip-1, op));
-        switch(op) {
-        case OP_POP:  ctx->opTop--; break;
-        case OP_DUP:  PUSH(STK(1)); break;
-        case OP_DUP2: PUSH(STK(2)); PUSH(STK(2)); break;
-        case OP_XCHG:  a=STK(1); STK(1)=STK(2); STK(2)=a; break;
-        case OP_XCHG2: a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; break;
+        DISPATCH(op) {
+        OPCASE(OP_POP):  ctx->opTop--; NEXT;
+        OPCASE(OP_DUP):  PUSH(STK(1)); NEXT;
+        OPCASE(OP_DUP2): PUSH(STK(2)); PUSH(STK(2)); NEXT;
+        OPCASE(OP_XCHG):  a=STK(1); STK(1)=STK(2); STK(2)=a; NEXT;
+        OPCASE(OP_XCHG2): a=STK(1); STK(1)=STK(2); STK(2)=STK(3); STK(3)=a; NEXT;
 
 #define BINOP(expr) do { \
     double l = IS_NUM(STK(2)) ? STK(2).num : numify(ctx, STK(2)); \
@@ -586,146 +772,197 @@ static naRef run(naContext ctx)
     SETNUM(STK(2), expr);                                         \
     ctx->opTop--; } while(0)
 
-        case OP_PLUS:  BINOP(l + r);         break;
-        case OP_MINUS: BINOP(l - r);         break;
-        case OP_MUL:   BINOP(l * r);         break;
-        case OP_DIV:   BINOP(l / r);         break;
-        case OP_LT:    BINOP(l <  r ? 1 : 0); break;
-        case OP_LTE:   BINOP(l <= r ? 1 : 0); break;
-        case OP_GT:    BINOP(l >  r ? 1 : 0); break;
-        case OP_GTE:   BINOP(l >= r ? 1 : 0); break;
-        case OP_BIT_AND: BINOP((int)l & (int)r); break;
-        case OP_BIT_OR:  BINOP((int)l | (int)r); break;
-        case OP_BIT_XOR: BINOP((int)l ^ (int)r); break;
+        OPCASE(OP_PLUS):  BINOP(l + r);         NEXT;
+        OPCASE(OP_MINUS): BINOP(l - r);         NEXT;
+        OPCASE(OP_MUL):   BINOP(l * r);         NEXT;
+        OPCASE(OP_DIV):   BINOP(l / r);         NEXT;
+        OPCASE(OP_LT):    BINOP(l <  r ? 1 : 0); NEXT;
+        OPCASE(OP_LTE):   BINOP(l <= r ? 1 : 0); NEXT;
+        OPCASE(OP_GT):    BINOP(l >  r ? 1 : 0); NEXT;
+        OPCASE(OP_GTE):   BINOP(l >= r ? 1 : 0); NEXT;
+        OPCASE(OP_BIT_AND): BINOP((int)l & (int)r); NEXT;
+        OPCASE(OP_BIT_OR):  BINOP((int)l | (int)r); NEXT;
+        OPCASE(OP_BIT_XOR): BINOP((int)l ^ (int)r); NEXT;
 #undef BINOP
 
-        case OP_EQ: case OP_NEQ:
+        // The same, with a numeric constant for the right hand side
+#define BINOPC(expr) do { \
+    double l = IS_NUM(STK(1)) ? STK(1).num : numify(ctx, STK(1)); \
+    double r = CONSTARG().num; \
+    SETNUM(STK(1), expr); } while(0)
+
+        OPCASE(OP_PLUSC):  BINOPC(l + r);         NEXT;
+        OPCASE(OP_MINUSC): BINOPC(l - r);         NEXT;
+        OPCASE(OP_MULC):   BINOPC(l * r);         NEXT;
+        OPCASE(OP_DIVC):   BINOPC(l / r);         NEXT;
+        OPCASE(OP_LTC):    BINOPC(l <  r ? 1 : 0); NEXT;
+        OPCASE(OP_LTEC):   BINOPC(l <= r ? 1 : 0); NEXT;
+        OPCASE(OP_GTC):    BINOPC(l >  r ? 1 : 0); NEXT;
+        OPCASE(OP_GTEC):   BINOPC(l >= r ? 1 : 0); NEXT;
+#undef BINOPC
+
+        // Comparisons followed by OP_JIFNOTPOP
+#define CMPJMP(expr) do { \
+    double l = IS_NUM(STK(2)) ? STK(2).num : numify(ctx, STK(2)); \
+    double r = IS_NUM(STK(1)) ? STK(1).num : numify(ctx, STK(1)); \
+    ctx->opTop -= 2; \
+    arg = ARG(); \
+    if(!(expr)) f->ip = arg; } while(0)
+
+        OPCASE(OP_JIFNOTLT):  CMPJMP(l <  r); NEXT;
+        OPCASE(OP_JIFNOTLTE): CMPJMP(l <= r); NEXT;
+        OPCASE(OP_JIFNOTGT):  CMPJMP(l >  r); NEXT;
+        OPCASE(OP_JIFNOTGTE): CMPJMP(l >= r); NEXT;
+#undef CMPJMP
+
+        OPCASE(OP_JIFNOTEQ): OPCASE(OP_JIFNOTNEQ):
+            a = evalEquality(op == OP_JIFNOTEQ ? OP_EQ : OP_NEQ, STK(2), STK(1));
+            ctx->opTop -= 2;
+            arg = ARG();
+            if(a.num == 0) f->ip = arg;
+            NEXT;
+
+        OPCASE(OP_EQ): OPCASE(OP_NEQ):
             STK(2) = evalEquality(op, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_CAT:
+            NEXT;
+        OPCASE(OP_CAT):
             STK(2) = evalCat(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEG:
+            NEXT;
+        OPCASE(OP_NEG):
             STK(1) = naNum(-numify(ctx, STK(1)));
-            break;
-        case OP_BIT_NEG:
+            NEXT;
+        OPCASE(OP_BIT_NEG):
             STK(1) = naNum(~(int)numify(ctx, STK(1)));
-            break;
-        case OP_NOT:
+            NEXT;
+        OPCASE(OP_NOT):
             STK(1) = naNum(boolify(ctx, STK(1)) ? 0 : 1);
-            break;
-        case OP_PUSHCONST:
+            NEXT;
+        OPCASE(OP_PUSHCONST):
             a = CONSTARG();
             if(IS_CODE(a)) a = bindFunction(ctx, f, a);
             PUSH(a);
-            break;
-        case OP_PUSHONE:
+            NEXT;
+        OPCASE(OP_PUSHONE):
             PUSH(naNum(1));
-            break;
-        case OP_PUSHZERO:
+            NEXT;
+        OPCASE(OP_PUSHZERO):
             PUSH(naNum(0));
-            break;
-        case OP_PUSHNIL:
+            NEXT;
+        OPCASE(OP_PUSHNIL):
             PUSH(naNil());
-            break;
-        case OP_PUSHEND:
+            NEXT;
+        OPCASE(OP_PUSHEND):
             PUSH(endToken());
-            break;
-        case OP_NEWVEC:
+            NEXT;
+        OPCASE(OP_NEWVEC):
             PUSH(naNewVector(ctx));
-            break;
-        case OP_VAPPEND:
+            NEXT;
+        OPCASE(OP_VAPPEND):
             naVec_append(STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_NEWHASH:
+            NEXT;
+        OPCASE(OP_NEWHASH):
             PUSH(naNewHash(ctx));
-            break;
-        case OP_HAPPEND:
+            NEXT;
+        OPCASE(OP_HAPPEND):
             naHash_set(STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_LOCAL:
+            NEXT;
+        OPCASE(OP_LOCAL):
             a = CONSTARG();
             getLocal(ctx, f, &a, &b);
             PUSH(b);
-            break;
-        case OP_SETSYM:
+            NEXT;
+        OPCASE(OP_SETSYM):
             setSymbol(f, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_SETLOCAL:
+            NEXT;
+        OPCASE(OP_SETLOCAL):
             naHash_set(f->locals, STK(1), STK(2));
             ctx->opTop--;
-            break;
-        case OP_MEMBER:
-            getMember(ctx, STK(1), CONSTARG(), &STK(1), 64);
-            break;
-        case OP_SETMEMBER:
+            NEXT;
+        OPCASE(OP_MEMBER):
+            a = CONSTARG();
+            getCachedMember(ctx, cd, ARG(), STK(1), a, &STK(1));
+            NEXT;
+        OPCASE(OP_LOCALMEMBER): // OP_LOCAL + OP_MEMBER
+            a = CONSTARG();
+            getLocal(ctx, f, &a, &b);
+            PUSH(b);
+            a = CONSTARG();
+            getCachedMember(ctx, cd, ARG(), STK(1), a, &STK(1));
+            NEXT;
+        OPCASE(OP_SETMEMBER):
             setMember(ctx, STK(2), STK(1), STK(3));
-            break;
-        case OP_INSERT:
+            NEXT;
+        OPCASE(OP_INSERT):
             containerSet(ctx, STK(2), STK(1), STK(3));
             ctx->opTop -= 2;
-            break;
-        case OP_EXTRACT:
+            NEXT;
+        OPCASE(OP_EXTRACT):
             STK(2) = containerGet(ctx, STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE:
+            NEXT;
+        OPCASE(OP_SLICE):
             evalSlice(ctx, STK(3), STK(2), STK(1));
             ctx->opTop--;
-            break;
-        case OP_SLICE2:
+            NEXT;
+        OPCASE(OP_SLICE2):
             evalSlice2(ctx, STK(4), STK(3), STK(2), STK(1));
             ctx->opTop -= 2;
-            break;
-        case OP_JMPLOOP:
-            // Identical to JMP, except for locking
-            naCheckBottleneck();
+            NEXT;
+        OPCASE(OP_JMPLOOP):
+            // Identical to JMP, except for locking and profiling
+            CHECK_BOTTLENECK(ctx);
+            PROFILE_TICK(ctx);
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JMP:
+            NEXT;
+        OPCASE(OP_JMP):
             f->ip = BYTECODE(cd)[f->ip];
             DBG(printf("   [Jump to: %d]\n", f->ip));
-            break;
-        case OP_JIFEND:
+            NEXT;
+        OPCASE(OP_JIFEND):
             arg = ARG();
             if(IS_END(STK(1))) {
                 ctx->opTop--; // Pops **ONLY** if it's nil!
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFTRUE:
+            NEXT;
+        OPCASE(OP_JIFTRUE):
             arg = ARG();
             if(boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOT:
+            NEXT;
+        OPCASE(OP_JIFNOT):
             arg = ARG();
             if(!boolify(ctx, STK(1))) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_JIFNOTPOP:
+            NEXT;
+        OPCASE(OP_JIFNOTPOP):
             arg = ARG();
             if(!boolify(ctx, POP())) {
                 f->ip = arg;
                 DBG(printf("   [Jump to: %d]\n", f->ip));
             }
-            break;
-        case OP_FCALL:  SETFRAME(setupFuncall(ctx, ARG(), 0, 0)); break;
-        case OP_MCALL:  SETFRAME(setupFuncall(ctx, ARG(), 1, 0)); break;
-        case OP_FCALLH: SETFRAME(setupFuncall(ctx,     1, 0, 1)); break;
-        case OP_MCALLH: SETFRAME(setupFuncall(ctx,     1, 1, 1)); break;
-        case OP_RETURN:
+            NEXT;
+#define CALL(nargs, mcall, named) do { \
+    SETFRAME(setupFuncall(ctx, nargs, mcall, named)); \
+    PROFILE_TICK(ctx); } while(0)
+
+        OPCASE(OP_FCALL):  CALL(ARG(), 0, 0); NEXT;
+        OPCASE(OP_MCALL):  CALL(ARG(), 1, 0); NEXT;
+        OPCASE(OP_FCALLH): CALL(    1, 0, 1); NEXT;
+        OPCASE(OP_MCALLH): CALL(    1, 1, 1); NEXT;
+#undef CALL
+        OPCASE(OP_RETURN):
             a = STK(1);
             ctx->dieArg = naNil();
             if(ctx->callChild) naFreeContext(ctx->callChild);
@@ -733,31 +970,31 @@ static naRef run(naContext ctx)
             ctx->opTop = f->bp + 1; // restore the correct opstack frame!
             STK(1) = a;
             FIXFRAME();
-            break;
-        case OP_EACH:
+            NEXT;
+        OPCASE(OP_EACH):
             evalEach(ctx, 0);
-            break;
-        case OP_INDEX:
+            NEXT;
+        OPCASE(OP_INDEX):
             evalEach(ctx, 1);
-            break;
-        case OP_MARK: // save stack state (e.g. "setjmp")
+            NEXT;
+        OPCASE(OP_MARK): // save stack state (e.g. "setjmp")
             if(ctx->markTop >= MAX_MARK_DEPTH)
                 ERR(ctx, "mark stack overflow");
             ctx->markStack[ctx->markTop++] = ctx->opTop;
-            break;
-        case OP_UNMARK: // pop stack state set by mark
+            NEXT;
+        OPCASE(OP_UNMARK): // pop stack state set by mark
             ctx->markTop--;
-            break;
-        case OP_BREAK: // restore stack state (FOLLOW WITH JMP!)
+            NEXT;
+        OPCASE(OP_BREAK): // restore stack state (FOLLOW WITH JMP!)
             ctx->opTop = ctx->markStack[ctx->markTop-1];
-            break;
-        case OP_BREAK2: // same, but also pop the mark stack
+            NEXT;
+        OPCASE(OP_BREAK2): // same, but also pop the mark stack
             ctx->opTop = ctx->markStack[--ctx->markTop];
-            break;
-        case OP_UNPACK:
+            NEXT;
+        OPCASE(OP_UNPACK):
             evalUnpack(ctx, ARG());
-            break;
-        default:
+            NEXT;
+        OPDEFAULT:
             ERR(ctx, "BUG: bad opcode");
         }
         ctx->ntemps = 0; // reset GC temp vector
@@ -814,21 +1051,25 @@ static int findFrame(naContext ctx, naContext* out, int fn)
     return ctx->fTop - 1 - (fn - sd);
 }
 
-int naGetLine(naContext ctx, int frame)
+int naiFrameLine(struct Frame* f)
 {
-    struct Frame* f;
-    frame = findFrame(ctx, &ctx, frame);
-    f = &ctx->fStack[frame];
     if(IS_FUNC(f->func) && IS_CODE(PTR(f->func).func->code)) {
         struct naCode* c = PTR(PTR(f->func).func->code).code;
         unsigned short* p = LINEIPS(c) + c->nLines - 2;
-        while(p >= LINEIPS(c) && p[0] > f->ip)
+        if(c->nLines < 2) return -1;
+        while(p > LINEIPS(c) && p[0] > f->ip)
             p -= 2;
         return p[1];
     }
     return -1;
 }
 
+int naGetLine(naContext ctx, int frame)
+{
+    frame = findFrame(ctx, &ctx, frame);
+    return naiFrameLine(&ctx->fStack[frame]);
+}
+
 naRef naGetSourceFile(naContext ctx, int frame)
 {
     naRef f;
@@ -967,6 +1208,12 @@ static void logError(naContext ctx)
 }
 
 static naErrorHandler error_handler = &logError;
+
+void naiReportError(naContext ctx)
+{
+    if(error_handler) error_handler(ctx);
+}
+
 naErrorHandler naSetErrorHandler(naErrorHandler cb)
 {
   naErrorHandler old_handler = error_handler;
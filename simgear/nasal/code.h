@@ -9,6 +9,11 @@
 #define MAX_RECURSION 128
 #define MAX_MARK_DEPTH 128
 
+// The first chunk of the remembered set, and the number of chunks,
+// each twice the size of the one before
+#define REMEMBER_CHUNK 1024
+#define REMEMBER_CHUNKS 20
+
 // Number of objects (per pool per thread) asked for using naGC_get().
 // The idea is that contexts can "cache" allocations to prevent thread
 // contention on the global pools.  But in practice this interacts
@@ -27,9 +32,50 @@ enum {
     OP_NEWHASH, OP_HAPPEND, OP_MARK, OP_UNMARK, OP_BREAK, OP_SETSYM, OP_DUP2,
     OP_INDEX, OP_BREAK2, OP_PUSHEND, OP_JIFTRUE, OP_JIFNOT, OP_FCALLH,
     OP_MCALLH, OP_XCHG2, OP_UNPACK, OP_SLICE, OP_SLICE2, OP_BIT_AND, OP_BIT_OR,
-    OP_BIT_XOR, OP_BIT_NEG
+    OP_BIT_XOR, OP_BIT_NEG,
+    // Superinstructions, generated by the peephole optimizer in codegen.c
+    OP_LOCALMEMBER, OP_PLUSC, OP_MINUSC, OP_MULC, OP_DIVC, OP_LTC, OP_LTEC,
+    OP_GTC, OP_GTEC, OP_JIFNOTLT, OP_JIFNOTLTE, OP_JIFNOTGT, OP_JIFNOTGTE,
+    OP_JIFNOTEQ, OP_JIFNOTNEQ,
+    NUM_OPCODES
+};
+
+// Parents followed by a cacheable member lookup, counting only the
+// first of each hash's parents
+#define MEMBER_CACHE_DEPTH 4
+
+// Refills of a member cache after which it stops being refilled,
+// until the next collection
+#define MEMBER_CACHE_MISSES 8
+
+// The result of a member lookup, and the path it took: path[0].hash
+// is the receiver, path[i+1].hash is parents[0] of path[i].hash, and
+// the value was found in path[depth].hash.  It is still good while
+// none of those hashes and parents vectors changed their version.
+// The collector drops entries which refer to anything it frees.
+struct MemberCacheEntry {
+    naRef value;
+    int depth;
+    struct MemberLink {
+        struct naHash* hash;
+        unsigned int version;
+        struct naVec* parents; // unused at path[depth]
+        unsigned int pversion;
+    } path[];
 };
 
+// Inline cache for an OP_MEMBER instruction.  Other threads may be
+// running the same code, so entries are never modified: a new one
+// replaces the old with a single pointer store (naiGCSetMemberCache).
+struct MemberCache {
+    struct MemberCacheEntry* entry; // 0 when empty
+    int misses;
+};
+
+// Replaces the entry of code->memberCaches[i], like naGC_swapfree()
+void naiGCSetMemberCache(struct naCode* code, int i,
+                         struct MemberCacheEntry* e);
+
 struct Frame {
     naRef func; // naFunc object
     naRef locals; // local per-call namespace
@@ -42,6 +88,34 @@ struct Globals {
     struct naPool pools[NUM_NASAL_TYPES];
     int allocCount;
 
+    // Collector state: objects marked but not yet scanned (large
+    // containers are scanned a piece at a time, from "index"), old
+    // objects which young ones were stored into since the last
+    // collection, the member caches filled since then, and the
+    // generation bookkeeping.  The write barriers add to the
+    // remembered set without the lock: chunk k holds REMEMBER_CHUNK
+    // << k objects, and never moves once allocated (see gc.c).
+    struct GCSlot { struct naObj* obj; int index; } *grayStack;
+    int graysz;
+    int ngray;
+    struct naObj** remembered[REMEMBER_CHUNKS];
+    int nremembered;
+    struct CacheFill { struct naCode* code; int index; } *cacheFills;
+    int fillsz;
+    int nfills;
+    int gcMarking;   // an incremental full collection is marking
+    int gcSweeping;  // ...or sweeping, from this pool on
+    int sweepPool;
+    struct naPool* dryPool; // out of free objects until it is swept
+    int gcMajor;     // marking also traces the old generation
+    int fullGC;      // the next collection must be a full one
+    int incremental; // full collections only from naGCStep()
+    int needStep;
+    double stepBudget;
+    int oldCount;    // old objects after the last full collection
+    int promoted;    // objects promoted since then
+    naGCStats stats;
+
     // Dead blocks waiting to be freed when it is safe
     void** deadBlocks;
     int deadsz;
@@ -71,6 +145,14 @@ struct Globals {
 
     struct Context* freeContexts;
     struct Context* allContexts;
+
+    // String buffers waiting for the next collection (see string.c),
+    // and the string method hash (naInit_string)
+    struct Unshared* unshared;
+    naRef stringMethods;
+
+    // Threads using an isolate heap; the last one frees it
+    int heapRefs;
 };
 
 struct Context {
@@ -103,6 +185,13 @@ struct Context {
     struct Context* callParent;
     struct Context* callChild;
 
+    // Loop iterations and calls left until the next profiler sample
+    int profileTicks;
+
+    // The heap the context belongs to: the same as "globals" (below),
+    // without its thread local lookup, for the interpreter's hot paths
+    struct Globals* heap;
+
     // Linked list pointers in globals
     struct Context* nextFree;
     struct Context* nextAll;
@@ -110,8 +199,24 @@ struct Context {
     void* userData;
 };
 
-#define globals nasal_globals
-extern struct Globals* globals;
+// Threads share the default heap, unless they run an isolate (see
+// threadlib.c): a heap of its own, with separate pools, collector,
+// symbol table and lock.
+#if defined(_MSC_VER)
+# define NA_THREAD_LOCAL __declspec(thread)
+#else
+# define NA_THREAD_LOCAL __thread
+#endif
+extern struct Globals* nasal_globals;
+extern NA_THREAD_LOCAL struct Globals* nasal_heap;
+#define globals (nasal_heap ? nasal_heap : nasal_globals)
+
+// Isolate heaps: naiNewHeap() creates one and makes it the calling
+// thread's heap; naiFreeHeap() frees the current one, which must not
+// be in use by any other thread.
+void naiNewHeap();
+void naiFreeHeap();
+void naiReportError(naContext ctx);
 
 // Threading low-level functions
 void* naNewLock();
@@ -122,10 +227,39 @@ void* naNewSem();
 void naFreeSem(void* sem);
 void naSemDown(void* sem);
 void naSemUp(void* sem, int count);
+void naYield(); // let another thread run
 
 void naCheckBottleneck();
+#define CHECK_BOTTLENECK(ctx) \
+    do { if((ctx)->heap->bottleneck) naCheckBottleneck(); } while(0)
+
+// Source line of the instruction a frame is at, from the line table
+int naiFrameLine(struct Frame* f);
+
+// The sampling profiler (profile.c) is only consulted at loop back
+// edges and calls, and only while it runs: otherwise the interpreter
+// pays for one test of a flag there.
+extern volatile int nasal_profiling;
+void naiProfileTick(naContext ctx);
+#define PROFILE_TICK(ctx) do { if(nasal_profiling) naiProfileTick(ctx); } while(0)
 
 #define LOCK() naLock(globals->lock)
 #define UNLOCK() naUnlock(globals->lock)
 
+// Incremental marking finds everything reachable when it started: a
+// reference removed from (or overwritten in) an object must be shaded
+// first, and a container whose contents move must be rescanned.
+// Objects allocated meanwhile are marked on creation.
+#define GC_SHADE(r) \
+    do { if(globals->gcMarking && !IS_NUM(r) && !IS_NIL(r) \
+            && !(PTR(r).obj->mark & GC_MARK)) naiGCShade(r); } while(0)
+#define GC_RESCAN(o) \
+    do { if(globals->gcMarking) naiGCRescan((struct naObj*)(o)); } while(0)
+
+// Must follow any change to the contents of a hash or vector, for the
+// member lookup caches.  Appending to a vector doesn't count: that
+// cannot change its first element.
+#define HASH_CHANGED(h) do { (h)->version++; } while(0)
+#define VEC_CHANGED(v) do { (v)->version++; } while(0)
+
 #endif // _CODE_H
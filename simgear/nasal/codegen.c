@@ -33,13 +33,78 @@ static void emitImmediate(struct Parser* p, int val, int arg)
     emit(p, arg);
 }
 
+// Notes an instruction just emitted at ip which could be the first
+// half of a superinstruction
+static void fusable(struct Parser* p, int op, int ip)
+{
+    p->cg->lastOp = op;
+    p->cg->lastOpIp = ip;
+    p->cg->lastOpEnd = p->cg->codesz;
+}
+
+// The instruction the next one may be fused with, or -1
+static int lastOp(struct Parser* p)
+{
+    struct CodeGenerator* cg = p->cg;
+    if(cg->lastOpEnd != cg->codesz || cg->barrier == cg->codesz)
+        return -1;
+    return cg->lastOp;
+}
+
+static void emitMember(struct Parser* p, int cidx)
+{
+    if(lastOp(p) == OP_LOCAL) // local variable lookup + member
+        p->cg->byteCode[p->cg->lastOpIp] = OP_LOCALMEMBER;
+    else
+        emit(p, OP_MEMBER);
+    emit(p, cidx);
+    emit(p, p->cg->nMemberCaches++);
+}
+
+static int constOp(int op)
+{
+    switch(op) {
+    case OP_PLUS:  return OP_PLUSC;
+    case OP_MINUS: return OP_MINUSC;
+    case OP_MUL:   return OP_MULC;
+    case OP_DIV:   return OP_DIVC;
+    case OP_LT:    return OP_LTC;
+    case OP_LTE:   return OP_LTEC;
+    case OP_GT:    return OP_GTC;
+    case OP_GTE:   return OP_GTEC;
+    }
+    return -1;
+}
+
+static int internConstant(struct Parser* p, naRef c);
+
+// Emits a binary operator, fusing it with a preceding numeric
+// constant if possible
+static void emitBinOp(struct Parser* p, int op)
+{
+    int cop = constOp(op), last = lastOp(p), ip = p->cg->lastOpIp, idx;
+    if(cop >= 0 && (last == OP_PUSHONE || last == OP_PUSHZERO)) {
+        idx = internConstant(p, naNum(last == OP_PUSHONE ? 1 : 0));
+    } else if(cop >= 0 && last == OP_PUSHCONST
+              && IS_NUM(naVec_get(p->cg->consts, p->cg->byteCode[ip+1]))) {
+        idx = p->cg->byteCode[ip+1];
+    } else {
+        emit(p, op);
+        fusable(p, op, p->cg->codesz - 1);
+        return;
+    }
+    p->cg->codesz = ip;
+    emitImmediate(p, cop, idx);
+    p->cg->lastOpEnd = -1;
+}
+
 static void genBinOp(int op, struct Parser* p, struct Token* t)
 {
     if(!LEFT(t) || !RIGHT(t))
         naParseError(p, "empty subexpression", t->line);
     genExpr(p, LEFT(t));
     genExpr(p, RIGHT(t));
-    emit(p, op);
+    emitBinOp(p, op);
 }
 
 static int newConstant(struct Parser* p, naRef c)
@@ -94,10 +159,20 @@ static int findConstantIndex(struct Parser* p, struct Token* t)
 
 static int genScalarConstant(struct Parser* p, struct Token* t)
 {
-    int idx;
-    if(t->str == 0 && t->num == 1) { emit(p, OP_PUSHONE); return 0; }
-    if(t->str == 0 && t->num == 0) { emit(p, OP_PUSHZERO); return 0; }
-    emitImmediate(p, OP_PUSHCONST, idx = findConstantIndex(p, t));
+    int idx, ip = p->cg->codesz;
+    if(t->str == 0 && t->num == 1) {
+        emit(p, OP_PUSHONE);
+        fusable(p, OP_PUSHONE, ip);
+        return 0;
+    }
+    if(t->str == 0 && t->num == 0) {
+        emit(p, OP_PUSHZERO);
+        fusable(p, OP_PUSHZERO, ip);
+        return 0;
+    }
+    idx = findConstantIndex(p, t);
+    emitImmediate(p, OP_PUSHCONST, idx);
+    fusable(p, OP_PUSHCONST, ip);
     return idx;
 }
 
@@ -132,7 +207,7 @@ static void genEqOp(int op, struct Parser* p, struct Token* t)
     if(setop == OP_SETMEMBER) {
         emit(p, OP_DUP2);
         emit(p, OP_POP);
-        emitImmediate(p, OP_MEMBER, cidx);
+        emitMember(p, cidx);
     } else if(setop == OP_INSERT) {
         emit(p, OP_DUP2);
         emit(p, OP_EXTRACT);
@@ -141,7 +216,7 @@ static void genEqOp(int op, struct Parser* p, struct Token* t)
         n = 1;
     }
     genExpr(p, RIGHT(t));
-    emit(p, op);
+    emitBinOp(p, op);
     emit(p, n == 1 ? OP_XCHG : OP_XCHG2);
     emit(p, setop);
 }
@@ -286,7 +361,7 @@ static void genFuncall(struct Parser* p, struct Token* t)
         method = 1;
         genExpr(p, LEFT(LEFT(t)));
         emit(p, OP_DUP);
-        emitImmediate(p, OP_MEMBER, findConstantIndex(p, RIGHT(LEFT(t))));
+        emitMember(p, findConstantIndex(p, RIGHT(LEFT(t))));
     } else {
         genExpr(p, LEFT(t));
     }
@@ -303,11 +378,12 @@ static void genFuncall(struct Parser* p, struct Token* t)
 static int startLoop(struct Parser* p, struct Token* label)
 {
     int i = p->cg->loopTop;
-    p->cg->loops[i].breakIP = 0xffffff;
+    p->cg->loops[i].breakChain = -1;
     p->cg->loops[i].contIP = 0xffffff;
     p->cg->loops[i].label = label;
     p->cg->loopTop++;
     emit(p, OP_MARK);
+    p->cg->barrier = p->cg->codesz;
     return p->cg->codesz;
 }
 
@@ -315,8 +391,15 @@ static int startLoop(struct Parser* p, struct Token* label)
 // the bytecode for future fixup in fixJumpTarget
 static int emitJump(struct Parser* p, int op)
 {
-    int ip;
-    emit(p, op);
+    int ip, last = lastOp(p);
+    if(op == OP_JIFNOTPOP && last >= OP_LT && last <= OP_NEQ) {
+        // Comparison + jump; OP_LT to OP_NEQ are consecutive
+        static const int fused[] = { OP_JIFNOTLT, OP_JIFNOTLTE, OP_JIFNOTGT,
+                                     OP_JIFNOTGTE, OP_JIFNOTEQ, OP_JIFNOTNEQ };
+        p->cg->byteCode[p->cg->lastOpIp] = fused[last - OP_LT];
+    } else {
+        emit(p, op);
+    }
     ip = p->cg->codesz;
     emit(p, 0xffff); // dummy address
     return ip;
@@ -326,6 +409,17 @@ static int emitJump(struct Parser* p, int op)
 static void fixJumpTarget(struct Parser* p, int spot)
 {
     p->cg->byteCode[spot] = p->cg->codesz;
+    p->cg->barrier = p->cg->codesz;
+}
+
+// Points all the break jumps out of a loop at the end of the bytecode
+static void fixBreaks(struct Parser* p, int chain)
+{
+    while(chain >= 0) {
+        int next = p->cg->byteCode[chain];
+        fixJumpTarget(p, chain);
+        chain = next == 0xffff ? -1 : next;
+    }
 }
 
 static void genShortCircuit(struct Parser* p, struct Token* t)
@@ -388,10 +482,9 @@ static void genLoop(struct Parser* p, struct Token* body,
 {
     int cont, jumpOverContinue;
     
-    p->cg->loops[p->cg->loopTop-1].breakIP = jumpEnd-1;
-
     jumpOverContinue = emitJump(p, OP_JMP);
     p->cg->loops[p->cg->loopTop-1].contIP = p->cg->codesz;
+    p->cg->barrier = p->cg->codesz;
     cont = emitJump(p, OP_JMP);
     fixJumpTarget(p, jumpOverContinue);
 
@@ -401,6 +494,7 @@ static void genLoop(struct Parser* p, struct Token* body,
     if(update) { genExpr(p, update); emit(p, OP_POP); }
     emitImmediate(p, OP_JMPLOOP, loopTop);
     fixJumpTarget(p, jumpEnd);
+    fixBreaks(p, p->cg->loops[p->cg->loopTop-1].breakChain);
     p->cg->loopTop--;
     emit(p, OP_UNMARK);
     emit(p, OP_PUSHNIL); // Leave something on the stack
@@ -494,7 +588,7 @@ static int tokMatch(struct Token* a, struct Token* b)
 
 static void genBreakContinue(struct Parser* p, struct Token* t)
 {
-    int levels = 1, loop = -1, bp, cp, i;
+    int levels = 1, loop = -1, cp, i;
     // http://code.google.com/p/flightgear-bugs/issues/detail?id=587
     // Make sure we are inside of a loop
     if(p->cg->loopTop <= 0)
@@ -510,13 +604,18 @@ static void genBreakContinue(struct Parser* p, struct Token* t)
             naParseError(p, "no match for break/continue label", t->line);
         levels = p->cg->loopTop - loop;
     }
-    bp = p->cg->loops[p->cg->loopTop - levels].breakIP;
-    cp = p->cg->loops[p->cg->loopTop - levels].contIP;
+    loop = p->cg->loopTop - levels;
+    cp = p->cg->loops[loop].contIP;
     for(i=0; i<levels; i++)
         emit(p, (i<levels-1) ? OP_BREAK2 : OP_BREAK);
-    if(t->type == TOK_BREAK)
-        emit(p, OP_PUSHEND); // breakIP is always a JIFNOTPOP/JIFEND!
-    emitImmediate(p, OP_JMP, t->type == TOK_BREAK ? bp : cp);
+    if(t->type == TOK_BREAK) {
+        // Straight to the end of the loop, once that is known
+        i = p->cg->loops[loop].breakChain;
+        emitImmediate(p, OP_JMP, i < 0 ? 0xffff : i);
+        p->cg->loops[loop].breakChain = p->cg->codesz - 1;
+    } else {
+        emitImmediate(p, OP_JMP, cp);
+    }
 }
 
 static void newLineEntry(struct Parser* p, int line)
@@ -532,6 +631,7 @@ static void newLineEntry(struct Parser* p, int line)
     }
     p->cg->lineIps[p->cg->nextLineIp++] = (unsigned short) p->cg->codesz;
     p->cg->lineIps[p->cg->nextLineIp++] = (unsigned short) line;
+    p->cg->barrier = p->cg->codesz;
 }
 
 static int parListLen(struct Token* t)
@@ -670,7 +770,9 @@ static void genExpr(struct Parser* p, struct Token* t)
         emit(p, OP_NOT);
         break;
     case TOK_SYMBOL:
-        emitImmediate(p, OP_LOCAL, findConstantIndex(p, t));
+        i = findConstantIndex(p, t);
+        emitImmediate(p, OP_LOCAL, i);
+        fusable(p, OP_LOCAL, p->cg->codesz - 2);
         break;
     case TOK_MINUS:
         if(BINARY(t)) {
@@ -706,7 +808,7 @@ static void genExpr(struct Parser* p, struct Token* t)
         genExpr(p, LEFT(t));
         if(!RIGHT(t) || RIGHT(t)->type != TOK_SYMBOL)
             naParseError(p, "object field not symbol", RIGHT(t)->line);
-        emitImmediate(p, OP_MEMBER, findConstantIndex(p, RIGHT(t)));
+        emitMember(p, findConstantIndex(p, RIGHT(t)));
         break;
     case TOK_EMPTY: case TOK_NIL:
         emit(p, OP_PUSHNIL);
@@ -765,6 +867,8 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     cg.codesz = 0;
     cg.consts = naNewVector(p->context);
     cg.loopTop = 0;
+    cg.nMemberCaches = 0;
+    cg.lastOpEnd = cg.barrier = -1;
     cg.lineIps = 0;
     cg.nLineIps = 0;
     cg.nextLineIp = 0;
@@ -799,9 +903,16 @@ naRef naCodeGen(struct Parser* p, struct Token* block, struct Token* arglist)
     code->nLines = cg.nextLineIp;
     code->srcFile = p->srcFile;
     code->constants = 0;
+    code->memberCaches = 0;
     code->constants = naAlloc((int)(size_t)(LINEIPS(code)+code->nLines));
-    for(i=0; i<code->nConstants; i++)
+    for(i=0; i<code->nConstants; i++) {
         code->constants[i] = naVec_get(p->cg->consts, i);
+        GC_WRITE_BARRIER(code, code->constants[i]); // may be old by now
+    }
+
+    code->nMemberCaches = cg.nMemberCaches;
+    code->memberCaches = naAlloc(sizeof(struct MemberCache) * cg.nMemberCaches);
+    naBZero(code->memberCaches, sizeof(struct MemberCache) * cg.nMemberCaches);
 
     for(i=0; i<code->nArgs; i++) ARGSYMS(code)[i] = cg.argSyms[i];
     for(i=0; i<code->nOptArgs; i++) OPTARGSYMS(code)[i] = cg.optArgSyms[i];
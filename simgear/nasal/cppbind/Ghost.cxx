@@ -18,6 +18,8 @@
 
 #include "Ghost.hxx"
 
+#include <cassert>
+
 namespace nasal
 {
   namespace internal
@@ -57,9 +59,59 @@ namespace nasal
       _name_strong(name),
       _name_weak(name + " (weak ref)"),
       _ghost_type_strong_ptr(ghost_type_strong),
-      _ghost_type_weak_ptr(ghost_type_weak)
+      _ghost_type_weak_ptr(ghost_type_weak),
+      _num_member_symbols(0)
+    {
+
+    }
+
+    //--------------------------------------------------------------------------
+    void GhostMetadata::addMemberSymbol( const std::string& name,
+                                         const void* member )
     {
+      // Symbols interned on an isolate heap die with the isolate, so ghost
+      // types are set up from threads on the main heap only.  Otherwise the
+      // member is still found by name.
+      assert( !naIsIsolate() );
+      if( naIsIsolate() )
+        return;
+
+      naContext c = naNewContext();
+      naRef sym = naInternSymbol(
+        naStr_fromdata(naNewString(c), name.data(), name.size())
+      );
+      naFreeContext(c);
+
+      const void* id = naObjectId(sym);
+      if( findMemberSymbol(sym) )
+        return;
 
+      // Keep the table at most half full
+      if( 2 * (_num_member_symbols + 1) > _member_symbols.size() )
+      {
+        std::vector<SymbolSlot> old;
+        old.swap(_member_symbols);
+        SymbolSlot empty = {0, 0};
+        _member_symbols.resize(old.empty() ? 16 : 2 * old.size(), empty);
+        _num_member_symbols = 0;
+        for(size_t i = 0; i < old.size(); ++i)
+          if( old[i].id )
+            insertMemberSymbol(old[i]);
+      }
+
+      SymbolSlot slot = {id, member};
+      insertMemberSymbol(slot);
+    }
+
+    //--------------------------------------------------------------------------
+    void GhostMetadata::insertMemberSymbol(const SymbolSlot& slot)
+    {
+      size_t mask = _member_symbols.size() - 1;
+      size_t i = symbolHash(slot.id) & mask;
+      while( _member_symbols[i].id )
+        i = (i + 1) & mask;
+      _member_symbols[i] = slot;
+      ++_num_member_symbols;
     }
 
     //--------------------------------------------------------------------------
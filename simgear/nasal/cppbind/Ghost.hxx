@@ -129,6 +129,45 @@ namespace nasal
         void addDerived(const GhostMetadata* derived);
 
         naRef getParents(naContext c);
+
+        /**
+         * Members by the interned symbol of their name, so that the usual
+         * ghost.member access is found without converting the key to a
+         * string. Symbols are interned in the default heap as members are
+         * registered. Other keys (eg. built at runtime, or symbols of an
+         * isolate heap) miss, and need to be looked up by name.
+         */
+        struct SymbolSlot
+        {
+          const void* id;
+          const void* member;
+        };
+        std::vector<SymbolSlot> _member_symbols;
+        size_t                  _num_member_symbols;
+
+        void addMemberSymbol(const std::string& name, const void* member);
+        void insertMemberSymbol(const SymbolSlot& slot);
+
+        const void* findMemberSymbol(naRef key) const
+        {
+          const void* id = naObjectId(key);
+          if( !id || _member_symbols.empty() )
+            return 0;
+
+          size_t mask = _member_symbols.size() - 1;
+          for( size_t i = symbolHash(id) & mask;; i = (i + 1) & mask )
+          {
+            if( _member_symbols[i].id == id )
+              return _member_symbols[i].member;
+            if( !_member_symbols[i].id )
+              return 0;
+          }
+        }
+
+        static size_t symbolHash(const void* id)
+        {
+          return (reinterpret_cast<size_t>(id) >> 4) * 2654435761u;
+        }
     };
 
     /**
@@ -435,7 +474,7 @@ namespace nasal
              ++member )
         {
           if( _members.find(member->first) == _members.end() )
-            _members[member->first] = member_t
+            addMember(member->first) = member_t
             (
               member->second.getter,
               member->second.setter,
@@ -585,7 +624,7 @@ namespace nasal
                      const setter_t& setter = setter_t() )
       {
         if( !getter.empty() || !setter.empty() )
-          _members[field] = member_t(getter, setter);
+          addMember(field) = member_t(getter, setter);
         else
           SG_LOG
           (
@@ -764,7 +803,7 @@ namespace nasal
        */
       Ghost& method(const std::string& name, const method_t& func)
       {
-        _members[name].func = new MethodHolder(func);
+        addMember(name).func = new MethodHolder(func);
         return *this;
       }
 
@@ -1087,8 +1126,7 @@ namespace nasal
       template<class Ret>
       getter_t to_getter(Ret (raw_type::*getter)() const)
       {
-        typedef typename boost::call_traits<Ret>::param_type param_type;
-        naRef(*to_nasal_)(naContext, param_type) = &to_nasal;
+        typename to_nasal_ptr<Ret>::type to_nasal_ = to_nasal_ptr<Ret>::get();
 
         // Getter signature: naRef(raw_type&, naContext)
         return boost::bind
@@ -1148,7 +1186,10 @@ namespace nasal
         const CallContext& ctx
       )
       {
-        return (*to_nasal_ptr<Ret>::get())(ctx.c, func(obj, ctx));
+        return nasal::to_nasal<typename to_nasal_ptr<Ret>::param_type>
+        (
+          ctx.c, func(obj, ctx)
+        );
       };
 
       /**
@@ -1232,6 +1273,13 @@ namespace nasal
         }
       }
 
+      member_t& addMember(const std::string& name)
+      {
+        member_t& member = _members[name];
+        addMemberSymbol(name, &member);
+        return member;
+      }
+
       static GhostPtr& getSingletonHolder()
       {
         static GhostPtr instance;
@@ -1311,7 +1359,25 @@ namespace nasal
                                         naRef key,
                                         naRef* out )
       {
-        const std::string key_str = nasal::from_nasal<std::string>(c, key);
+        Ghost* ghost = getSingletonPtr();
+        const member_t* member =
+          static_cast<const member_t*>(ghost->findMemberSymbol(key));
+        if( !member )
+        {
+          const std::string key_str = nasal::from_nasal<std::string>(c, key);
+          typename MemberMap::const_iterator it = ghost->_members.find(key_str);
+          if( it != ghost->_members.end() )
+            member = &it->second;
+          else
+          {
+            fallback_getter_t fallback_get = ghost->_fallback_getter;
+            if(    !fallback_get
+                || !fallback_get(obj, c, key_str, *out) )
+              return 0;
+            return "";
+          }
+        }
+
         // TODO merge instance parents with static class parents
 //        if( key_str == "parents" )
 //        {
@@ -1322,20 +1388,10 @@ namespace nasal
 //          return "";
 //        }
 
-        typename MemberMap::iterator member =
-          getSingletonPtr()->_members.find(key_str);
-
-        if( member == getSingletonPtr()->_members.end() )
-        {
-          fallback_getter_t fallback_get = getSingletonPtr()->_fallback_getter;
-          if(    !fallback_get
-              || !fallback_get(obj, c, key_str, *out) )
-            return 0;
-        }
-        else if( member->second.func )
-          *out = member->second.func->get_naRef(c);
-        else if( !member->second.getter.empty() )
-          *out = member->second.getter(obj, c);
+        if( member->func )
+          *out = member->func->get_naRef(c);
+        else if( !member->getter.empty() )
+          *out = member->getter(obj, c);
         else
           return "Read-protected member";
 
@@ -1371,24 +1427,31 @@ namespace nasal
                                  naRef field,
                                  naRef val )
       {
-        const std::string key = nasal::from_nasal<std::string>(c, field);
-        const MemberMap& members = getSingletonPtr()->_members;
+        Ghost* ghost = getSingletonPtr();
+        const member_t* member =
+          static_cast<const member_t*>(ghost->findMemberSymbol(field));
+        if( member && !member->setter.empty() && !member->func )
+        {
+          member->setter(obj, c, val);
+          return;
+        }
 
-        typename MemberMap::const_iterator member = members.find(key);
-        if( member == members.end() )
+        const std::string key = nasal::from_nasal<std::string>(c, field);
+        typename MemberMap::const_iterator it = ghost->_members.find(key);
+        if( it == ghost->_members.end() )
         {
-          fallback_setter_t fallback_set = getSingletonPtr()->_fallback_setter;
+          fallback_setter_t fallback_set = ghost->_fallback_setter;
           if( !fallback_set )
             naRuntimeError(c, "ghost: No such member: %s", key.c_str());
           else if( !fallback_set(obj, c, key, val) )
             naRuntimeError(c, "ghost: Failed to write (_set: %s)", key.c_str());
         }
-        else if( member->second.setter.empty() )
+        else if( it->second.setter.empty() )
           naRuntimeError(c, "ghost: Write protected member: %s", key.c_str());
-        else if( member->second.func )
+        else if( it->second.func )
           naRuntimeError(c, "ghost: Write to function: %s", key.c_str());
         else
-          member->second.setter(obj, c, val);
+          it->second.setter(obj, c, val);
       }
 
       static void
@@ -108,7 +108,7 @@ namespace nasal
       }
 
       template<class T>
-      naRef to_nasal(T arg) const
+      naRef to_nasal(const T& arg) const
       {
         return nasal::to_nasal(c, arg);
       }
@@ -117,7 +117,10 @@ namespace nasal
       typename from_nasal_ptr<T>::return_type
       from_nasal(naRef ref) const
       {
-        return (*from_nasal_ptr<T>::get())(c, ref);
+        return nasal::from_nasal<typename from_nasal_ptr<T>::return_type>
+        (
+          c, ref
+        );
       }
 
       naContext   c;
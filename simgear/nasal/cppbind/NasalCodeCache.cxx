@@ -0,0 +1,152 @@
+// On-disk cache of compiled Nasal code
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#include "NasalCodeCache.hxx"
+
+#include <simgear/debug/logstream.hxx>
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/sg_hash.hxx>
+#include <simgear/misc/strutils.hxx>
+
+#include <sstream>
+
+namespace nasal
+{
+
+  //----------------------------------------------------------------------------
+  CodeCache::CodeCache(const SGPath& dir)
+  {
+    setDirectory(dir);
+  }
+
+  //----------------------------------------------------------------------------
+  void CodeCache::setDirectory(const SGPath& dir)
+  {
+    _dir = dir;
+    if( _dir.isNull() || _dir.isDir() )
+      return;
+
+    if( !simgear::Dir(_dir).create(0755) )
+    {
+      SG_LOG(SG_NASAL, SG_WARN, "Nasal code cache: can not create " << _dir);
+      _dir = SGPath();
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  const SGPath& CodeCache::directory() const
+  {
+    return _dir;
+  }
+
+  //----------------------------------------------------------------------------
+  naRef CodeCache::parse( naContext c,
+                          const std::string& srcFile,
+                          const char* buf,
+                          int len,
+                          int firstLine,
+                          int* errLine )
+  {
+    naRef file = naStr_fromdata(naNewString(c), srcFile.data(), srcFile.size());
+    *errLine = 0;
+
+    SGPath entry;
+    if( !_dir.isNull() )
+    {
+      entry = entryPath(buf, len, firstLine);
+
+      sg_ifstream in(entry);
+      if( in )
+      {
+        std::ostringstream data;
+        data << in.rdbuf();
+        const std::string& bytes = data.str();
+
+        naRef code = naLoadCode(c, file, bytes.data(), bytes.size());
+        if( naIsCode(code) )
+        {
+          ++_stats.hits;
+          return code;
+        }
+
+        SG_LOG(SG_NASAL, SG_INFO, "Nasal code cache: ignoring invalid "
+                                  << entry << " for " << srcFile);
+        ++_stats.invalid;
+      }
+    }
+
+    naRef code = naParseCode(c, file, firstLine, const_cast<char*>(buf), len,
+                             errLine);
+    if( entry.isNull() || !naIsCode(code) )
+      return code;
+
+    ++_stats.misses;
+
+    // Write to a temporary file first, so that other processes sharing
+    // the directory never see a partial entry.
+    naRef data = naSaveCode(c, code);
+    SGPath tmp = entry;
+    tmp.concat(".tmp");
+    {
+      sg_ofstream out(tmp);
+      out.write(naStr_data(data), naStr_len(data));
+      if( !out )
+      {
+        SG_LOG(SG_NASAL, SG_WARN, "Nasal code cache: failed to write " << tmp);
+        out.close();
+        tmp.remove();
+        return code;
+      }
+    }
+
+    if( !tmp.rename(entry) )
+      tmp.remove();
+
+    return code;
+  }
+
+  //----------------------------------------------------------------------------
+  void CodeCache::clear()
+  {
+    if( !_dir.isNull() )
+      simgear::Dir(_dir).removeChildren();
+  }
+
+  //----------------------------------------------------------------------------
+  const CodeCache::Stats& CodeCache::stats() const
+  {
+    return _stats;
+  }
+
+  //----------------------------------------------------------------------------
+  SGPath CodeCache::entryPath(const char* buf, int len, int firstLine) const
+  {
+    int header[2] = { naCodeVersion(), firstLine };
+
+    simgear::sha1nfo info;
+    simgear::sha1_init(&info);
+    simgear::sha1_write(&info, reinterpret_cast<const char*>(header),
+                        sizeof(header));
+    simgear::sha1_write(&info, buf, len);
+
+    SGPath path = _dir;
+    path.append(simgear::strutils::encodeHex(simgear::sha1_result(&info),
+                                             HASH_LENGTH) + ".nasc");
+    return path;
+  }
+
+} // namespace nasal
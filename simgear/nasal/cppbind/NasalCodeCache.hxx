@@ -0,0 +1,101 @@
+///@file
+/// On-disk cache of compiled Nasal code
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_NASAL_CODE_CACHE_HXX_
+#define SG_NASAL_CODE_CACHE_HXX_
+
+#include <simgear/misc/sg_path.hxx>
+#include <simgear/nasal/nasal.h>
+
+#include <string>
+
+namespace nasal
+{
+
+  /**
+   * Cache of compiled code, to skip lexing, parsing and code generation
+   * for sources which have been loaded before.
+   *
+   * Entries are files in a directory, named after a hash of the source
+   * text, the first line number and the bytecode version (naCodeVersion()),
+   * so changed sources and interpreter updates simply miss the cache.
+   */
+  class CodeCache
+  {
+    public:
+
+      struct Stats
+      {
+        size_t hits = 0;
+        size_t misses = 0;  //!< parsed and added to the cache
+        size_t invalid = 0; //!< unreadable cache files (also misses)
+      };
+
+      /**
+       * Cache disabled until a directory is set
+       */
+      CodeCache() = default;
+
+      /**
+       * @param dir   Directory to keep cached code in
+       */
+      explicit CodeCache(const SGPath& dir);
+
+      /**
+       * Set the directory to keep cached code in, creating it if required.
+       * An empty path disables the cache.
+       */
+      void setDirectory(const SGPath& dir);
+      const SGPath& directory() const;
+
+      /**
+       * Replacement for naParseCode(): load the code from the cache, or
+       * parse it and add it to the cache.
+       *
+       * @param c         Nasal context
+       * @param srcFile   Name of the source file, for error messages
+       * @param buf       Source text
+       * @param len       Length of the source text
+       * @param firstLine Line number of the start of the source
+       * @param errLine   Set to the line of a parse error
+       * @return The code object, or nil on parse errors
+       */
+      naRef parse( naContext c,
+                   const std::string& srcFile,
+                   const char* buf,
+                   int len,
+                   int firstLine,
+                   int* errLine );
+
+      /**
+       * Remove all entries from the cache directory
+       */
+      void clear();
+
+      const Stats& stats() const;
+
+    protected:
+
+      SGPath _dir;
+      Stats _stats;
+
+      SGPath entryPath(const char* buf, int len, int firstLine) const;
+  };
+
+} // namespace nasal
+
+#endif /* SG_NASAL_CODE_CACHE_HXX_ */
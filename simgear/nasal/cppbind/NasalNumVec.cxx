@@ -0,0 +1,111 @@
+// Wrapper class for packed numeric Nasal vectors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#include "NasalNumVec.hxx"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace nasal
+{
+
+  //----------------------------------------------------------------------------
+  static int checkSize(size_t size)
+  {
+    if( size > NA_NUMVEC_MAX_SIZE )
+      throw std::length_error("nasal::NumVec: size out of range");
+    return static_cast<int>(size);
+  }
+
+  //----------------------------------------------------------------------------
+  NumVec::NumVec(naContext c, size_t size, int type):
+    _vec( naNewNumVec(c, type, checkSize(size)) )
+  {
+
+  }
+
+  //----------------------------------------------------------------------------
+  NumVec::NumVec(naContext c, const std::vector<double>& vec):
+    _vec( naNewNumVec(c, NA_NUMVEC_DOUBLE, checkSize(vec.size())) )
+  {
+    std::copy(vec.begin(), vec.end(), doubles());
+  }
+
+  //----------------------------------------------------------------------------
+  NumVec::NumVec(naRef ref):
+    _vec(ref)
+  {
+    assert( naIsNumVec(_vec) );
+  }
+
+  //----------------------------------------------------------------------------
+  int NumVec::type() const
+  {
+    return naNumVec_type(_vec);
+  }
+
+  //----------------------------------------------------------------------------
+  size_t NumVec::size() const
+  {
+    return naNumVec_size(_vec);
+  }
+
+  //----------------------------------------------------------------------------
+  bool NumVec::empty() const
+  {
+    return size() == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  double* NumVec::doubles() const
+  {
+    return type() == NA_NUMVEC_DOUBLE
+         ? static_cast<double*>(naNumVec_data(_vec))
+         : 0;
+  }
+
+  //----------------------------------------------------------------------------
+  float* NumVec::floats() const
+  {
+    return type() == NA_NUMVEC_FLOAT
+         ? static_cast<float*>(naNumVec_data(_vec))
+         : 0;
+  }
+
+  //----------------------------------------------------------------------------
+  double NumVec::get(size_t i) const
+  {
+    if( i >= size() )
+      throw std::out_of_range("nasal::NumVec::get");
+    return naNumVec_get(_vec, static_cast<int>(i));
+  }
+
+  //----------------------------------------------------------------------------
+  void NumVec::set(size_t i, double val)
+  {
+    if( i >= size() )
+      throw std::out_of_range("nasal::NumVec::set");
+    naNumVec_set(_vec, static_cast<int>(i), val);
+  }
+
+  //----------------------------------------------------------------------------
+  const naRef NumVec::get_naRef() const
+  {
+    return _vec;
+  }
+
+} // namespace nasal
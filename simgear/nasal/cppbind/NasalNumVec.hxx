@@ -0,0 +1,102 @@
+///@file
+/// Wrapper class for packed numeric Nasal vectors
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_NASAL_NUMVEC_HXX_
+#define SG_NASAL_NUMVEC_HXX_
+
+#include "from_nasal.hxx"
+#include "to_nasal.hxx"
+
+#include <vector>
+
+namespace nasal
+{
+
+  /**
+   * Wrapper class for packed numeric vectors (see naNewNumVec()).
+   *
+   * Gives direct access to the elements, so C++ code can fill or read a
+   * numvec without converting each element to and from a Nasal number.
+   * Like nasal::String it does not keep the vector alive: it has to be
+   * referenced from Nasal (or saved with naSave/naGCSave) while in use.
+   */
+  class NumVec
+  {
+    public:
+
+      /**
+       * Create a new numvec of @a size zeroes
+       *
+       * @param c     Nasal context for creating the vector
+       * @param size  Number of elements
+       * @param type  NA_NUMVEC_DOUBLE or NA_NUMVEC_FLOAT
+       */
+      NumVec(naContext c, size_t size, int type = NA_NUMVEC_DOUBLE);
+
+      /**
+       * Create a new numvec of doubles, holding a copy of @a vec
+       */
+      NumVec(naContext c, const std::vector<double>& vec);
+
+      /**
+       * Initialize from an existing numvec
+       */
+      NumVec(naRef ref);
+
+      int type() const;
+      size_t size() const;
+      bool empty() const;
+
+      /**
+       * The elements, if the type is NA_NUMVEC_DOUBLE (0 otherwise)
+       */
+      double* doubles() const;
+
+      /**
+       * The elements, if the type is NA_NUMVEC_FLOAT (0 otherwise)
+       */
+      float* floats() const;
+
+      double get(size_t i) const;
+      void set(size_t i, double val);
+
+      /**
+       * Copy the elements into a std::vector
+       */
+      template<class T>
+      std::vector<T> to_vector() const
+      {
+        if( const double* d = doubles() )
+          return std::vector<T>(d, d + size());
+        const float* f = floats();
+        return std::vector<T>(f, f + size());
+      }
+
+      /**
+       * Get Nasal representation of the vector
+       */
+      const naRef get_naRef() const;
+
+    protected:
+
+      naRef _vec;
+
+  };
+
+} // namespace nasal
+
+#endif /* SG_NASAL_NUMVEC_HXX_ */
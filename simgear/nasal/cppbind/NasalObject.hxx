@@ -46,19 +46,24 @@ namespace nasal
       bool valid() const;
 
       template<class Ret, class ... Args>
-      Ret callMethod(const std::string& name, Args ... args)
+      Ret callMethod(const std::string& name, const Args& ... args)
       {
         if( !_nasal_impl.valid() )
           return Ret();
 
         Context ctx;
-        auto func = get_member<boost::function<Ret (nasal::Me, Args...)>>(
-          ctx, _nasal_impl.get_naRef(), name
-        );
-        if( func )
-          return func(nasal::to_nasal(ctx, this), args...);
+        naRef func;
+        if(    !naMember_get(ctx, _nasal_impl.get_naRef(),
+                             to_nasal(ctx, name), &func)
+            || naIsNil(func) )
+          return Ret();
+        if( !naIsCode(func) && !naIsCCode(func) && !naIsFunc(func) )
+          throw bad_nasal_cast("not a function");
 
-        return Ret();
+        return detail::callNasalFunction<Ret>
+        (
+          ctx, func, to_nasal(ctx, this), args...
+        );
       }
 
       bool _set(naContext c, const std::string& key, naRef val);
@@ -0,0 +1,67 @@
+// Sampling profiler for Nasal code
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#include "NasalProfiler.hxx"
+
+namespace nasal
+{
+
+  //----------------------------------------------------------------------------
+  void Profiler::start(int interval, int buffer_size)
+  {
+    naProfileStart(interval, buffer_size);
+  }
+
+  //----------------------------------------------------------------------------
+  void Profiler::stop()
+  {
+    naProfileStop();
+  }
+
+  //----------------------------------------------------------------------------
+  void Profiler::sample()
+  {
+    naProfileSample();
+  }
+
+  //----------------------------------------------------------------------------
+  void Profiler::clear()
+  {
+    naProfileClear();
+  }
+
+  //----------------------------------------------------------------------------
+  int Profiler::numSamples()
+  {
+    return naProfileCount(0);
+  }
+
+  //----------------------------------------------------------------------------
+  int Profiler::numDropped()
+  {
+    int dropped = 0;
+    naProfileCount(&dropped);
+    return dropped;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string Profiler::foldedStacks(naContext c)
+  {
+    naRef folded = naProfileFolded(c);
+    return std::string(naStr_data(folded), naStr_len(folded));
+  }
+
+} // namespace nasal
@@ -0,0 +1,77 @@
+///@file
+/// Sampling profiler for Nasal code
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Library General Public
+// License as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Library General Public License for more details.
+//
+// You should have received a copy of the GNU Library General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301, USA
+
+#ifndef SG_NASAL_PROFILER_HXX_
+#define SG_NASAL_PROFILER_HXX_
+
+#include <simgear/nasal/nasal.h>
+
+#include <string>
+
+namespace nasal
+{
+
+  /**
+   * Control of the sampling profiler built into the interpreter (see
+   * naProfileStart()).  There is one profiler per process, sampling all
+   * threads, so all members are static.
+   */
+  class Profiler
+  {
+    public:
+
+      /**
+       * Discard earlier samples and start sampling.
+       *
+       * @param interval    Take a sample every @a interval loop iterations
+       *                    or function calls (0: only on sample()).
+       * @param buffer_size Number of stack frames the sample buffer can
+       *                    hold, allocated up front.
+       */
+      static void start(int interval = 1000, int buffer_size = 1 << 20);
+
+      /**
+       * Stop sampling, keeping the samples taken
+       */
+      static void stop();
+
+      /**
+       * Request a sample at the next loop iteration or call (eg. from a
+       * timer). Safe to call from any thread.
+       */
+      static void sample();
+
+      /**
+       * Stop sampling and free the sample buffer
+       */
+      static void clear();
+
+      static int numSamples();
+      static int numDropped(); //!< samples which didn't fit into the buffer
+
+      /**
+       * The samples in "folded stacks" format, the input of flame graph
+       * tools like flamegraph.pl: one line per distinct call stack, with
+       * the frames ("file:line") from the outermost call in separated by
+       * semicolons, followed by a space and the number of samples.
+       */
+      static std::string foldedStacks(naContext c);
+  };
+
+} // namespace nasal
+
+#endif /* SG_NASAL_PROFILER_HXX_ */
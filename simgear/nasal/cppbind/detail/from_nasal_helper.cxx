@@ -18,6 +18,7 @@
 
 #include "from_nasal_helper.hxx"
 #include <simgear/nasal/cppbind/NasalHash.hxx>
+#include <simgear/nasal/cppbind/NasalNumVec.hxx>
 #include <simgear/nasal/cppbind/NasalString.hxx>
 
 #include <simgear/misc/sg_path.hxx>
@@ -57,6 +58,20 @@ namespace nasal
     return std::string(naStr_data(na_str), naStr_len(na_str));
   }
 
+  //----------------------------------------------------------------------------
+  boost::string_ref
+  from_nasal_helper(naContext c, naRef ref, const boost::string_ref*)
+  {
+    naRef na_str = naIsString(ref) ? ref : naStringValue(c, ref);
+
+    if( naIsNil(na_str) )
+      return boost::string_ref();
+    else if( !naIsString(na_str) )
+      throw bad_nasal_cast("Not convertible to string");
+
+    return boost::string_ref(naStr_data(na_str), naStr_len(na_str));
+  }
+
   //----------------------------------------------------------------------------
   SGPath from_nasal_helper(naContext c, naRef ref, const SGPath*)
   {
@@ -82,6 +97,15 @@ namespace nasal
     return String(ref);
   }
 
+  //----------------------------------------------------------------------------
+  NumVec from_nasal_helper(naContext c, naRef ref, const NumVec*)
+  {
+    if( !naIsNumVec(ref) )
+      throw bad_nasal_cast("Not a numvec");
+
+    return NumVec(ref);
+  }
+
   //----------------------------------------------------------------------------
   bool from_nasal_helper(naContext c, naRef ref, const bool*)
   {
@@ -33,6 +33,8 @@
 #include <boost/bind.hpp>
 #include <boost/call_traits.hpp>
 #include <boost/function.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <boost/preprocessor/control/if.hpp>
 #include <boost/preprocessor/iteration/iterate.hpp>
 #include <boost/preprocessor/repetition/enum_trailing.hpp>
@@ -41,6 +43,7 @@
 #include <boost/type_traits.hpp>
 #include <boost/utility/enable_if.hpp>
 
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -49,6 +52,7 @@ class SGPath;
 namespace nasal
 {
   class Hash;
+  class NumVec;
   class String;
 
   /**
@@ -102,6 +106,15 @@ namespace nasal
    */
   std::string from_nasal_helper(naContext c, naRef ref, const std::string*);
 
+  /**
+   * View the characters of a Nasal string, without copying them. Numbers are
+   * converted to a new Nasal string first. The view is valid as long as the
+   * string is referenced from Nasal (eg. for the duration of a call receiving
+   * it as argument).
+   */
+  boost::string_ref
+  from_nasal_helper(naContext c, naRef ref, const boost::string_ref*);
+
   /**
    * Convert a Nasal string to an SGPath
    */
@@ -117,6 +130,11 @@ namespace nasal
    */
   String from_nasal_helper(naContext c, naRef ref, const String*);
 
+  /**
+   * Convert a packed numeric vector to a nasal::NumVec
+   */
+  NumVec from_nasal_helper(naContext c, naRef ref, const NumVec*);
+
   /**
    * Convert a Nasal object to bool.
    *
@@ -181,12 +199,71 @@ namespace nasal
   }
 
   /**
-   * Convert a Nasal vector to a std::vector
+   * View the elements of a packed numeric vector of matching type (doubles
+   * for double, floats for float), without copying them. Like the vector
+   * itself, the view can be used to modify the elements. It is valid as long
+   * as the numvec is referenced from Nasal.
+   */
+  template<class T>
+  typename boost::enable_if<
+    boost::is_floating_point<typename boost::remove_const<T>::type>,
+    boost::iterator_range<T*>
+  >::type
+  from_nasal_helper(naContext c, naRef ref, const boost::iterator_range<T*>*)
+  {
+    const int type = sizeof(T) == sizeof(float) ? NA_NUMVEC_FLOAT
+                                                : NA_NUMVEC_DOUBLE;
+    if( !naIsNumVec(ref) || naNumVec_type(ref) != type )
+      throw bad_nasal_cast(type == NA_NUMVEC_FLOAT ? "Not a numvec of floats"
+                                                   : "Not a numvec of doubles");
+
+    T* data = static_cast<T*>(naNumVec_data(ref));
+    return boost::iterator_range<T*>(data, data + naNumVec_size(ref));
+  }
+
+  /**
+   * Copy the elements of a packed numeric vector to a std::vector of numbers
+   */
+  template<class T, class Elem>
+  typename boost::enable_if< boost::is_arithmetic<T>, std::vector<T> >::type
+  from_nasal_packed(naContext c, const Elem* begin, const Elem* end)
+  {
+    return std::vector<T>(begin, end);
+  }
+
+  /**
+   * Convert the elements of a packed numeric vector one by one
+   */
+  template<class T, class Elem>
+  typename boost::disable_if< boost::is_arithmetic<T>, std::vector<T> >::type
+  from_nasal_packed(naContext c, const Elem* begin, const Elem* end)
+  {
+    std::vector<T> vec;
+    vec.reserve(end - begin);
+    for(; begin != end; ++begin)
+      vec.push_back(from_nasal_helper(c, naNum(*begin), static_cast<T*>(0)));
+    return vec;
+  }
+
+  /**
+   * Convert a Nasal vector (or packed numeric vector) to a std::vector
    */
   template<class T>
   std::vector<T>
   from_nasal_helper(naContext c, naRef ref, const std::vector<T>*)
   {
+    if( naIsNumVec(ref) )
+    {
+      int size = naNumVec_size(ref);
+      if( naNumVec_type(ref) == NA_NUMVEC_FLOAT )
+      {
+        const float* f = static_cast<const float*>(naNumVec_data(ref));
+        return from_nasal_packed<T>(c, f, f + size);
+      }
+      const double* d = static_cast<const double*>(naNumVec_data(ref));
+      return from_nasal_packed<T>(c, d, d + size);
+    }
+
     if( !naIsVector(ref) )
       throw bad_nasal_cast("Not a vector");
 
@@ -240,6 +317,39 @@ namespace nasal
 #define BOOST_PP_ITERATION_LIMITS (0, 8)
 #define BOOST_PP_FILENAME_1 <simgear/nasal/cppbind/detail/from_nasal_function_templates.hxx>
 #include BOOST_PP_ITERATE()
+
+    template<class Ret>
+    Ret from_nasal_result(naContext c, naRef ref, Ret*)
+    {
+      return from_nasal_helper(c, ref, static_cast<Ret*>(0));
+    }
+
+    inline void from_nasal_result(naContext, naRef, void*)
+    {}
+
+    /**
+     * Call a Nasal function in an existing context. The arguments are
+     * converted into an array on the stack, so apart from the Nasal objects
+     * created by the conversions nothing is allocated.
+     *
+     * @throws std::runtime_error on errors in the called function
+     */
+    template<class Ret, class ... Args>
+    Ret callNasalFunction( naContext c,
+                           naRef func,
+                           naRef me,
+                           const Args& ... args )
+    {
+      naRef argv[sizeof...(Args) + 1] = { to_nasal(c, args)... };
+      naRef result =
+        naCallMethodCtx(c, func, me, sizeof...(Args), argv, naNil());
+
+      const char* error = naGetError(c);
+      if( error )
+        throw std::runtime_error(error);
+
+      return from_nasal_result(c, result, static_cast<Ret*>(0));
+    }
   }
 
 } // namespace nasal
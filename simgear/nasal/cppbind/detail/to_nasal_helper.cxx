@@ -18,6 +18,7 @@
 
 #include "to_nasal_helper.hxx"
 #include <simgear/nasal/cppbind/NasalHash.hxx>
+#include <simgear/nasal/cppbind/NasalNumVec.hxx>
 #include <simgear/nasal/cppbind/Ghost.hxx>
 
 #include <simgear/math/SGMath.hxx>
@@ -25,6 +26,8 @@
 
 #include <boost/function.hpp>
 
+#include <cstring>
+
 namespace nasal
 {
   //----------------------------------------------------------------------------
@@ -38,7 +41,17 @@ namespace nasal
   //----------------------------------------------------------------------------
   naRef to_nasal_helper(naContext c, const char* str)
   {
-    return to_nasal_helper(c, std::string(str));
+    naRef ret = naNewString(c);
+    naStr_fromdata(ret, str, static_cast<int>(strlen(str)));
+    return ret;
+  }
+
+  //----------------------------------------------------------------------------
+  naRef to_nasal_helper(naContext c, const boost::string_ref& str)
+  {
+    naRef ret = naNewString(c);
+    naStr_fromdata(ret, str.data(), static_cast<int>(str.size()));
+    return ret;
   }
 
   //----------------------------------------------------------------------------
@@ -47,6 +60,12 @@ namespace nasal
     return hash.get_naRef();
   }
 
+  //----------------------------------------------------------------------------
+  naRef to_nasal_helper(naContext c, const NumVec& vec)
+  {
+    return vec.get_naRef();
+  }
+
   //----------------------------------------------------------------------------
   naRef to_nasal_helper(naContext c, const naRef& ref)
   {
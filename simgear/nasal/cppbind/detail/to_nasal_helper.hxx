@@ -27,6 +27,8 @@
 #include <simgear/nasal/nasal.h>
 
 #include <boost/function/function_fwd.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <boost/utility/enable_if.hpp>
 #include <boost/call_traits.hpp>
 #include <boost/type_traits.hpp>
@@ -42,6 +44,7 @@ namespace nasal
 {
   class CallContext;
   class Hash;
+  class NumVec;
 
   typedef boost::function<naRef (CallContext)> free_function_t;
 
@@ -56,11 +59,21 @@ namespace nasal
   // We need this to prevent the array overload of to_nasal being called
   naRef to_nasal_helper(naContext c, const char* str);
 
+  /**
+   * Convert a string view to Nasal string
+   */
+  naRef to_nasal_helper(naContext c, const boost::string_ref& str);
+
   /**
    * Convert a nasal::Hash to a Nasal hash
    */
   naRef to_nasal_helper(naContext c, const Hash& hash);
 
+  /**
+   * Convert a nasal::NumVec to a packed numeric vector
+   */
+  naRef to_nasal_helper(naContext c, const NumVec& vec);
+
   /**
    * Simple pass-through of naRef types to allow generic usage of to_nasal
    */
@@ -116,6 +129,12 @@ namespace nasal
   template<class T, size_t N>
   naRef to_nasal_helper(naContext c, const T(&array)[N]);
 
+  /**
+   * Convert a range of elements (eg. a view of an array) to a Nasal vector
+   */
+  template<class Iterator>
+  naRef to_nasal_helper(naContext c, const boost::iterator_range<Iterator>& r);
+
   /**
    * Convert std::vector to Nasal vector
    */
@@ -137,6 +156,18 @@ namespace nasal
     return ret;
   }
 
+  //----------------------------------------------------------------------------
+  template<class Iterator>
+  naRef to_nasal_helper(naContext c, const boost::iterator_range<Iterator>& r)
+  {
+    naRef ret = naNewVector(c);
+    naVec_setsize(c, ret, static_cast<int>(r.size()));
+    int i = 0;
+    for(Iterator it = r.begin(); it != r.end(); ++it, ++i)
+      naVec_set(ret, i, to_nasal_helper(c, *it));
+    return ret;
+  }
+
   //----------------------------------------------------------------------------
   template<class Vec2>
   typename boost::enable_if<is_vec2<Vec2>, naRef>::type
@@ -133,6 +133,16 @@ BOOST_AUTO_TEST_CASE( cppbind_misc_testing )
   BOOST_CHECK( strncmp("Test", naStr_data(r), naStr_len(r)) == 0 );
   BOOST_CHECK_EQUAL(from_nasal<std::string>(c, r), "Test");
 
+  // views of the string data, without copies
+  boost::string_ref str_ref = from_nasal<boost::string_ref>(c, r);
+  BOOST_CHECK_EQUAL(str_ref, "Test");
+  BOOST_CHECK_EQUAL(static_cast<const void*>(str_ref.data()),
+                    static_cast<const void*>(naStr_data(r)));
+  BOOST_CHECK_EQUAL(from_nasal<boost::string_ref>(c, to_nasal(c, 1.5)), "1.5");
+  BOOST_CHECK(from_nasal<boost::string_ref>(c, naNil()).empty());
+  r = to_nasal(c, boost::string_ref("Test-Ref", 4));
+  BOOST_CHECK_EQUAL(from_nasal<std::string>(c, r), "Test");
+
   r = to_nasal(c, 42);
   BOOST_CHECK_EQUAL(naNumValue(r).num, 42);
   BOOST_CHECK_EQUAL(from_nasal<int>(c, r), 42);
@@ -151,6 +161,27 @@ BOOST_AUTO_TEST_CASE( cppbind_misc_testing )
   std::vector<int> std_vec;
   r = to_nasal(c, std_vec);
 
+  // ranges (eg. of arrays) to vectors, and views of numvecs
+  r = to_nasal(c, boost::make_iterator_range(test_data + 1, test_data + 3));
+  BOOST_REQUIRE( naIsVector(r) );
+  BOOST_CHECK_EQUAL(naVec_size(r), 2);
+  BOOST_CHECK_EQUAL(from_nasal<int>(c, naVec_get(r, 0)), 4);
+
+  r = naNewNumVec(c, NA_NUMVEC_DOUBLE, 3);
+  boost::iterator_range<double*> range =
+    from_nasal<boost::iterator_range<double*> >(c, r);
+  BOOST_REQUIRE_EQUAL(range.size(), 3);
+  range[1] = 5;
+  BOOST_CHECK_EQUAL(naNumVec_get(r, 1), 5);
+  BOOST_CHECK_EQUAL(
+    (from_nasal<boost::iterator_range<const double*> >(c, r).begin()),
+    range.begin()
+  );
+  BOOST_CHECK_THROW(from_nasal<boost::iterator_range<float*> >(c, r),
+                    bad_nasal_cast);
+  BOOST_CHECK_THROW(from_nasal<boost::iterator_range<double*> >(c, naNil()),
+                    bad_nasal_cast);
+
   r = to_nasal(c, "string");
   BOOST_CHECK_THROW(from_nasal<int>(c, r), bad_nasal_cast);
 
@@ -4,6 +4,8 @@
 #include <simgear/nasal/cppbind/Ghost.hxx>
 #include <simgear/nasal/cppbind/NasalContext.hxx>
 
+#include "TestContext.hxx"
+
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 
@@ -186,3 +188,62 @@ BOOST_AUTO_TEST_CASE( storage_traits )
 
   nasal::shared_ptr_storage<DerivedWeakPtr>::unref(d_weak);
 }
+
+//------------------------------------------------------------------------------
+class Point:
+  public SGReferenced
+{
+  public:
+    double x = 1, y = 2;
+    std::string name = "p";
+
+    double getX() const { return x; }
+    void setX(double v) { x = v; }
+    double getY() const { return y; }
+    void setY(double v) { y = v; }
+    double len2() const { return x * x + y * y; }
+
+    bool getDynamic(naContext c, const std::string& key, naRef& out)
+    {
+      if( key != "dyn" )
+        return false;
+      out = nasal::to_nasal(c, "dynamic");
+      return true;
+    }
+};
+typedef SGSharedPtr<Point> PointPtr;
+
+BOOST_AUTO_TEST_CASE( ghost_member_symbols )
+{
+  nasal::Ghost<PointPtr>::init("Point")
+    .member("x", &Point::getX, &Point::setX)
+    .member("y", &Point::getY, &Point::setY)
+    .member("read_only", &Point::getX)
+    .method("len2", &Point::len2)
+    ._get(&Point::getDynamic);
+
+  TestContext c;
+  PointPtr p = new Point;
+  naRef ghost = c.to_nasal(p);
+
+  // Member names in code are interned symbols, found by identity
+  std::string result = c.from_nasal<std::string>(c.exec(
+    "me.x = 3;"
+    "me.y = me.y + 2;"
+    "return me.x ~ ' ' ~ me.y ~ ' ' ~ me.len2() ~ ' ' ~ me.read_only"
+    "     ~ ' ' ~ me.dyn;",
+    ghost
+  ));
+  BOOST_CHECK_EQUAL(result, "3 4 25 3 dynamic");
+  BOOST_CHECK_EQUAL(p->y, 4);
+
+  // Other keys (eg. strings built at runtime) are looked up by name
+  naRef out;
+  naRef y = c.to_nasal("y");
+  BOOST_CHECK(!naIsIdentical(y, naInternSymbol(c.to_nasal("y"))));
+  BOOST_REQUIRE(naMember_get(c.c, ghost, y, &out));
+  BOOST_CHECK_EQUAL(c.from_nasal<double>(out), 4);
+  BOOST_REQUIRE(naMember_get(c.c, ghost, c.to_nasal("dyn"), &out));
+  BOOST_CHECK_EQUAL(c.from_nasal<std::string>(out), "dynamic");
+  BOOST_CHECK(!naMember_get(c.c, ghost, c.to_nasal("z"), &out));
+}
@@ -0,0 +1,575 @@
+// Timings for the Nasal VM, its runtime and cppbind.  Not part of the test
+// suite: run with --bench, optionally followed by the names of the
+// benchmarks to run (all of them by default).
+
+#include "TestContext.hxx"
+
+#include <simgear/nasal/cppbind/Ghost.hxx>
+#include <simgear/nasal/cppbind/NasalObject.hxx>
+#include <simgear/nasal/cppbind/NasalProfiler.hxx>
+#include <simgear/timing/timestamp.hxx>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+static bool failed = false;
+
+static void check(bool ok, const char* what)
+{
+  if( ok )
+    return;
+  std::cerr << "  FAILED: " << what << std::endl;
+  failed = true;
+}
+
+static naRef parse(TestContext& c, const std::string& src)
+{
+  int errLine = -1;
+  naRef code = naParseCode(c.c, c.to_nasal("benchmark"), 1,
+                           const_cast<char*>(src.c_str()), src.size(),
+                           &errLine);
+  if( !naIsCode(code) )
+    throw std::runtime_error("Failed to parse code: " + src);
+  return code;
+}
+
+// Run src in the namespace ns (the standard library if nil), returning the
+// time taken in ms
+static double timed(TestContext& c, const std::string& src,
+                    naRef ns = naNil(), naRef* result = 0,
+                    int argc = 0, naRef* args = 0)
+{
+  naRef code = parse(c, src);
+  if( naIsNil(ns) )
+    ns = naInit_std(c.c);
+
+  SGTimeStamp start = SGTimeStamp::now();
+  naRef r = naCallMethodCtx(c.c, code, naNil(), argc, args, ns);
+  double ms = (SGTimeStamp::now() - start).toMSecs();
+  if( naGetError(c.c) )
+    throw std::runtime_error(std::string("Nasal error: ") + naGetError(c.c));
+  if( result )
+    *result = r;
+  return ms;
+}
+
+//------------------------------------------------------------------------------
+static void vm()
+{
+  TestContext c;
+  std::string expectedString;
+  for(int j = 0; j < 1000; ++j)
+    expectedString += "x" + std::to_string(j);
+
+  naRef r;
+  double numeric = timed(c,
+    "var sum = 0;"
+    "for(var i = 0; i < 2000000; i += 1) {"
+    "  if(i * 2 > 1000) sum += i / 2;"
+    "  else sum -= 1;"
+    "}"
+    "var n = 0;"
+    "while(n < 1000000) n += 1;"
+    "return sum + n;",
+    naNil(), &r
+  );
+  check(naNumValue(r).num == 1000000436874.0, "numeric loops");
+
+  double methods = timed(c,
+    "var Vec = {"
+    "  new: func(x, y) { return { parents: [Vec], x: x, y: y } },"
+    "  dot: func(o) me.x * o.x + me.y * o.y,"
+    "  len2: func me.dot(me),"
+    "};"
+    "var a = Vec.new(1, 2);"
+    "var b = Vec.new(3, 4);"
+    "var sum = 0;"
+    "for(var i = 0; i < 200000; i += 1)"
+    "  sum += a.dot(b) + b.len2();"
+    "return sum;",
+    naNil(), &r
+  );
+  check(naNumValue(r).num == 200000.0 * 36, "method calls");
+
+  double strings = timed(c,
+    "var s = '';"
+    "for(var i = 0; i < 100; i += 1) {"
+    "  s = '';"
+    "  for(var j = 0; j < 1000; j += 1)"
+    "    s ~= 'x' ~ j;"
+    "}"
+    "return s;",
+    naNil(), &r
+  );
+  check(c.from_nasal<std::string>(r) == expectedString, "string building");
+
+  std::cout << "Nasal VM:\n"
+            << "  numeric loops: " << numeric << "ms\n"
+            << "  method calls: " << methods << "ms\n"
+            << "  string building: " << strings << "ms" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+static naGCStats gcStats()
+{
+  naGCStats stats;
+  naGCGetStats(&stats);
+  return stats;
+}
+
+static void gc()
+{
+  TestContext c;
+  const int count = 200000;
+  naRef heap;
+  timed(c, "var h = {}; for(var i = 0; i < " + std::to_string(count) +
+           "; i += 1) h[i] = [i, \"s\" ~ i]; return h;", naNil(), &heap);
+  int key = naGCSave(heap);
+
+  // stop-the-world full collections of the whole heap
+  c.runGC();
+  naGCResetStats();
+  for(int i = 0; i < 5; ++i)
+    c.runGC();
+  naGCStats full = gcStats();
+
+  // young collections, while allocating garbage
+  const std::string churn =
+    "for(var i = 0; i < 500000; i += 1) { var v = [i, {}]; }";
+  naGCResetStats();
+  timed(c, churn);
+  naGCStats young = gcStats();
+  check(young.minorCollections > 0, "young collections");
+
+  // a full collection spread over 1ms slices, once the old generation grew
+  naGCSetIncremental(1);
+  std::ostringstream grow;
+  grow << "for(var i = " << count << "; i < " << 3 * count << "; i += 1) "
+          "h[i] = [i];";
+  naRef ns = naInit_std(c.c);
+  naHash_set(ns, c.to_nasal("h"), heap);
+  timed(c, grow.str(), ns);
+  timed(c, churn);
+  naGCResetStats();
+  naGCStats incremental;
+  for(int i = 0; i < 1000000; ++i)
+  {
+    naGCStep(1.0);
+    incremental = gcStats();
+    if( incremental.majorCollections )
+      break;
+  }
+  naGCSetIncremental(0);
+  check(incremental.majorCollections == 1, "incremental collection");
+
+  std::cout << "GC pauses with " << full.liveObjects << " live objects:\n"
+            << "  full collection: "
+            << full.totalPause / full.majorCollections << "ms average, "
+            << full.maxPause << "ms max\n"
+            << "  young collection: "
+            << young.totalPause / young.minorCollections << "ms average, "
+            << young.maxPause << "ms max (" << young.minorCollections << ")\n"
+            << "  incremental slices: "
+            << incremental.totalPause / incremental.incrementalSteps
+            << "ms average, " << incremental.maxPause << "ms max ("
+            << incremental.incrementalSteps << ")" << std::endl;
+
+  naGCRelease(key);
+  c.runGC();
+}
+
+//------------------------------------------------------------------------------
+static void numvec()
+{
+  TestContext c;
+  const int n = 1000000;
+  naRef ns = naInit_std(c.c);
+  naHash_set(ns, c.to_nasal("numvec"), naInit_numvec(c.c));
+  int key = naGCSave(ns);
+  timed(c,
+    "var n = " + std::to_string(n) + ";"
+    "var v = setsize([], n);"
+    "var a = numvec.doubles(n);"
+    "for(var i = 0; i < n; i += 1) v[i] = a[i] = i / n;",
+    ns
+  );
+
+  naRef s1, s2;
+  double boxed = timed(c,
+    "var s = 0;"
+    "foreach(var x; v) s += x;"
+    "forindex(var i; v) v[i] = v[i] * 2.0 + 1;"
+    "return s;",
+    ns, &s1
+  );
+  double packed = timed(c,
+    "var s = numvec.sum(a);"
+    "numvec.scale(a, 2.0, 1);"
+    "return s;",
+    ns, &s2
+  );
+  check(std::abs(naNumValue(s1).num - naNumValue(s2).num) < 1e-6, "sums");
+
+  naRef big;
+  timed(c, "return numvec.doubles(" + std::to_string(n) + ");", ns, &big);
+  std::vector<double> copy;
+  SGTimeStamp start = SGTimeStamp::now();
+  for(int i = 0; i < 10; ++i)
+    copy = c.from_nasal<std::vector<double> >(big);
+  double conversion = (SGTimeStamp::now() - start).toMSecs() / 10;
+  check(copy.size() == size_t(n), "conversion");
+  naGCRelease(key);
+
+  std::cout << "numvec (" << n << " elements, sum and scale): "
+            << "vector " << boxed << "ms, numvec " << packed
+            << "ms; to std::vector " << conversion << "ms" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+static void profiler()
+{
+  TestContext c;
+  const std::string work =
+    "var Vec = {\n"
+    "  new: func(x, y) { return { parents: [Vec], x: x, y: y } },\n"
+    "  dot: func(o) me.x * o.x + me.y * o.y,\n"
+    "};\n"
+    "var a = Vec.new(1, 2);\n"
+    "var sum = 0;\n"
+    "for(var i = 0; i < 300000; i += 1)\n"
+    "  sum += a.dot(a) + i / 2;\n"
+    "return sum;\n";
+
+  double off = timed(c, work);
+
+  nasal::Profiler::start(1000);
+  double on = timed(c, work);
+  nasal::Profiler::stop();
+  int samples = nasal::Profiler::numSamples();
+  check(samples > 0, "samples");
+
+  nasal::Profiler::start(1);
+  double every = timed(c, work);
+  nasal::Profiler::stop();
+  nasal::Profiler::clear();
+
+  std::cout << "profiler: off " << off << "ms, "
+            << "every 1000 ticks " << on << "ms (" << samples << " samples), "
+            << "every tick " << every << "ms" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+class Widget:
+  public SGReferenced
+{
+  public:
+    double x = 1;
+    std::string name = "widget";
+
+    double getX() const { return x; }
+    void setX(double v) { x = v; }
+    const std::string& getName() const { return name; }
+    void setName(const std::string& n) { name = n; }
+
+    void noop() {}
+    double add(double a, double b) const { return a + b; }
+    size_t length(const std::string& s) const { return s.size(); }
+    size_t lengthRef(boost::string_ref s) const { return s.size(); }
+    double sum(const std::vector<double>& v) const
+    {
+      double s = 0;
+      for(double d: v)
+        s += d;
+      return s;
+    }
+    double sumRange(boost::iterator_range<const double*> v) const
+    {
+      double s = 0;
+      for(double d: v)
+        s += d;
+      return s;
+    }
+    std::vector<double> pos() const { return {x, 2 * x, 3 * x}; }
+};
+typedef SGSharedPtr<Widget> WidgetPtr;
+
+static const int num_calls = 200000;
+
+static void initWidget()
+{
+  if( nasal::Ghost<WidgetPtr>::isInit() )
+    return;
+  nasal::Ghost<WidgetPtr>::init("Widget")
+    .member("x", &Widget::getX, &Widget::setX)
+    .member("name", &Widget::getName, &Widget::setName)
+    .method("noop", &Widget::noop)
+    .method("add", &Widget::add)
+    .method("length", &Widget::length)
+    .method("lengthRef", &Widget::lengthRef)
+    .method("sum", &Widget::sum)
+    .method("sumRange", &Widget::sumRange)
+    .method("pos", &Widget::pos);
+}
+
+// Run a loop of num_calls iterations, with the given body, on a widget ghost
+static double loop(TestContext& c, naRef ghost, const std::string& body)
+{
+  naRef ns = naNewHash(c.c);
+  naHash_set(ns, c.to_nasal("numvec"), naInit_numvec(c.c));
+  return timed(c,
+    "var w = arg[0];"
+    "var v = [1, 2, 3];"
+    "var n = numvec.doubles(v);"
+    "for(var i = 0; i < " + std::to_string(num_calls) +
+    "; i += 1) { " + body + "; }",
+    ns, 0, 1, &ghost
+  );
+}
+
+static void report(const std::string& name, double ms, double base_ms)
+{
+  std::cout << "  " << name << ": "
+            << (ms - base_ms) * 1e6 / num_calls << "ns" << std::endl;
+}
+
+// Overhead per call between Nasal and C++ through cppbind, for common
+// signatures: time per call, less that of an empty loop iteration
+static void calls()
+{
+  initWidget();
+  TestContext c;
+  WidgetPtr widget = new Widget;
+  naRef ghost = c.to_nasal(widget);
+  int gc_key = naGCSave(ghost);
+
+  double base = loop(c, ghost, "0");
+  std::cout << "cppbind overhead per call (Nasal -> C++):" << std::endl;
+  report("read member (double)", loop(c, ghost, "w.x"), base);
+  report("write member (double)", loop(c, ghost, "w.x = i"), base);
+  report("read member (string)", loop(c, ghost, "w.name"), base);
+  report("write member (string)", loop(c, ghost, "w.name = 'abc'"), base);
+  report("void()", loop(c, ghost, "w.noop()"), base);
+  report("double(double, double)", loop(c, ghost, "w.add(i, 2)"), base);
+  report("size_t(const string&)", loop(c, ghost, "w.length('abcdef')"), base);
+  report("size_t(string_ref)", loop(c, ghost, "w.lengthRef('abcdef')"), base);
+  report("double(const vector<double>&)", loop(c, ghost, "w.sum(v)"), base);
+  report("double(iterator_range<const double*>)",
+         loop(c, ghost, "w.sumRange(n)"), base);
+  report("vector<double>()", loop(c, ghost, "w.pos()"), base);
+  check(widget->x == num_calls - 1, "member writes");
+  check(widget->name == "abc", "string member writes");
+  naGCRelease(gc_key);
+
+  nasal::Object::setupGhost();
+  naRef impl = c.exec(
+    "return {"
+    "  noop: func {},"
+    "  add: func(a, b) a + b,"
+    "  twice: func(s) s ~ s,"
+    "};",
+    naNil()
+  );
+  nasal::ObjectRef obj = new nasal::Object(impl);
+
+  const int n = num_calls / 4;
+  std::cout << "cppbind overhead per call (C++ -> Nasal):" << std::endl;
+
+  SGTimeStamp start = SGTimeStamp::now();
+  for(int i = 0; i < n; ++i)
+    obj->callMethod<void>("noop");
+  std::cout << "  callMethod void(): "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / n << "ns"
+            << std::endl;
+
+  double sum = 0;
+  start = SGTimeStamp::now();
+  for(int i = 0; i < n; ++i)
+    sum += obj->callMethod<double>("add", i, 1);
+  std::cout << "  callMethod double(int, int): "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / n << "ns"
+            << std::endl;
+  check(sum == n * (n - 1.0) / 2 + n, "callMethod double(int, int)");
+
+  const std::string str = "abc";
+  std::string result;
+  start = SGTimeStamp::now();
+  for(int i = 0; i < n; ++i)
+    result = obj->callMethod<std::string>("twice", str);
+  std::cout << "  callMethod string(string): "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / n << "ns"
+            << std::endl;
+  check(result == "abcabc", "callMethod string(string)");
+
+  boost::function<double (double, double)> add =
+    c.from_nasal<boost::function<double (double, double)> >(
+      c.exec("return func(a, b) a + b;", naNil())
+    );
+  start = SGTimeStamp::now();
+  for(int i = 0; i < n; ++i)
+    sum = add(i, 2);
+  std::cout << "  boost::function double(double, double): "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / n << "ns"
+            << std::endl;
+  check(sum == n + 1, "boost::function double(double, double)");
+}
+
+//------------------------------------------------------------------------------
+static void ghost()
+{
+  initWidget();
+  TestContext c;
+  WidgetPtr widget = new Widget;
+  naRef ghost = c.to_nasal(widget);
+  int gc_key = naGCSave(ghost);
+
+  // Code uses interned symbols, other keys are looked up by name
+  naRef out;
+  double sum = 0;
+  naRef x = naInternSymbol(c.to_nasal("x"));
+  naRef name = c.to_nasal("x");
+  std::cout << "ghost member read (naMember_get):" << std::endl;
+
+  SGTimeStamp start = SGTimeStamp::now();
+  for(int i = 0; i < num_calls; ++i)
+  {
+    naMember_get(c.c, ghost, x, &out);
+    sum += naNumValue(out).num;
+  }
+  std::cout << "  by symbol: "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / num_calls
+            << "ns" << std::endl;
+
+  start = SGTimeStamp::now();
+  for(int i = 0; i < num_calls; ++i)
+  {
+    naMember_get(c.c, ghost, name, &out);
+    sum += naNumValue(out).num;
+  }
+  std::cout << "  by name: "
+            << (SGTimeStamp::now() - start).toMSecs() * 1e6 / num_calls
+            << "ns" << std::endl;
+  check(sum == 2.0 * num_calls * widget->x, "member values");
+  naGCRelease(gc_key);
+}
+
+//------------------------------------------------------------------------------
+static void code()
+{
+  TestContext c;
+  const std::string chunk =
+    "var greet = 'hello';\n"
+    "var Class = {\n"
+    "  new: func(x, y = 3) { return { parents: [Class], x: x, y: y }; },\n"
+    "  sum: func(extra...) {\n"
+    "    var s = me.x + me.y;\n"
+    "    foreach(var e; extra) s += e;\n"
+    "    return s;\n"
+    "  },\n"
+    "};\n"
+    "var f = func { for(var i = 0; i < 10; i += 1) if(i > 5) break; };\n";
+  std::string src;
+  for(int i = 0; i < 200; ++i)
+    src += chunk;
+  src += "return greet;\n";
+
+  const int count = 20;
+  naRef file = c.to_nasal("big.nas");
+  naRef code = naNil();
+  int errLine = -1;
+  SGTimeStamp start = SGTimeStamp::now();
+  for(int i = 0; i < count; ++i)
+    code = naParseCode(c.c, file, 1, const_cast<char*>(src.data()),
+                       src.size(), &errLine);
+  double parseMs = (SGTimeStamp::now() - start).toMSecs();
+  check(naIsCode(code), "parse");
+
+  naRef saved = naSaveCode(c.c, code);
+  check(naIsString(saved), "save");
+  std::string data(naStr_data(saved), naStr_len(saved));
+
+  start = SGTimeStamp::now();
+  for(int i = 0; i < count; ++i)
+    code = naLoadCode(c.c, file, data.data(), data.size());
+  double loadMs = (SGTimeStamp::now() - start).toMSecs();
+  check(naIsCode(code), "load");
+
+  std::cout << "code cache, " << src.size() << " bytes of source ("
+            << data.size() << " bytes compiled): parse " << parseMs / count
+            << "ms, load " << loadMs / count << "ms" << std::endl;
+}
+
+//------------------------------------------------------------------------------
+static void isolate()
+{
+  TestContext c;
+  const std::string work =
+    "func(out, n) {"
+    "  var total = 0;"
+    "  for(var i = 0; i < n; i += 1) {"
+    "    var h = { x: i, name: 'item' ~ i };"
+    "    total += size(h.name) + h.x;"
+    "  }"
+    "  thread.send(out, total);"
+    "}";
+
+  std::cout << "4 workers on 200000 items each, started with:" << std::endl;
+  for(std::string start: {"thread.newthread(func w(out, n));",
+                          "thread.newisolate(w, out, n);"})
+  {
+    naRef ns = naInit_std(c.c);
+    naHash_set(ns, c.to_nasal("thread"), naInit_thread(c.c));
+    double ms = timed(c,
+      "var w = " + work + ";"
+      "var out = thread.newchannel();"
+      "var n = 200000;"
+      "for(var k = 0; k < 4; k += 1) " + start +
+      "var s = 0;"
+      "for(var k = 0; k < 4; k += 1) s += thread.receive(out);"
+      "return s;",
+      ns
+    );
+    std::cout << "  " << start << " " << ms << "ms" << std::endl;
+  }
+}
+
+//------------------------------------------------------------------------------
+static const struct
+{
+  const char* name;
+  void (*run)();
+} benchmarks[] = {
+  {"vm", &vm},
+  {"gc", &gc},
+  {"numvec", &numvec},
+  {"profiler", &profiler},
+  {"calls", &calls},
+  {"ghost", &ghost},
+  {"code", &code},
+  {"isolate", &isolate}
+};
+
+int main(int argc, char* argv[])
+{
+  if( argc < 2 || strcmp(argv[1], "--bench") )
+  {
+    std::cerr << "usage: " << argv[0] << " --bench [benchmark...]\n"
+              << "benchmarks:";
+    for(const auto& b: benchmarks)
+      std::cerr << " " << b.name;
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for(const auto& b: benchmarks)
+  {
+    bool selected = argc == 2;
+    for(int i = 2; i < argc; ++i)
+      selected |= !strcmp(argv[i], b.name);
+    if( selected )
+      b.run();
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,197 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+#include <simgear/io/iostreams/sgstream.hxx>
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/nasal/cppbind/NasalCodeCache.hxx>
+
+static const std::string source =
+  "var greet = 'hello';\n"
+  "var Class = {\n"
+  "  new: func(x, y = 3) { return { parents: [Class], x: x, y: y }; },\n"
+  "  sum: func(extra...) {\n"
+  "    var s = me.x + me.y;\n"
+  "    foreach(var e; extra) s += e;\n"
+  "    return s;\n"
+  "  },\n"
+  "};\n"
+  "var first = func { return arg[0]; };\n"
+  "var f = func { for(var i = 0; i < 10; i += 1) if(i > 5) break; return i; };\n"
+  "return greet ~ ' ' ~ Class.new(1).sum(4, 5) ~ ' ' ~ f() ~ ' '\n"
+  "     ~ first(nil == nil) ~ ' ' ~ 1.5e3;\n";
+
+static const std::string expected = "hello 13 6 1 1500";
+
+static naRef parse(TestContext& c, const std::string& src)
+{
+  int errLine;
+  return naParseCode(c.c, c.to_nasal("test.nas"), 1,
+                     const_cast<char*>(src.data()), src.size(), &errLine);
+}
+
+static std::string run(TestContext& c, naRef code)
+{
+  return c.from_nasal<std::string>(
+    naCallMethod(code, naNil(), 0, 0, naNil())
+  );
+}
+
+static std::string str(naRef s)
+{
+  return std::string(naStr_data(s), naStr_len(s));
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_save_load )
+{
+  TestContext c;
+  naRef code = parse(c, source);
+  BOOST_REQUIRE(naIsCode(code));
+  BOOST_CHECK_EQUAL(run(c, code), expected);
+
+  std::string data = str(naSaveCode(c.c, code));
+  naRef loaded = naLoadCode(c.c, c.to_nasal("test.nas"),
+                            data.data(), data.size());
+  BOOST_REQUIRE(naIsCode(loaded));
+
+  // identical bytecode, constants, arguments and line numbers
+  BOOST_CHECK(str(naSaveCode(c.c, loaded)) == data);
+
+  // and still valid after collecting the original
+  c.runGC();
+  naRef loaded2 = naLoadCode(c.c, c.to_nasal("test.nas"),
+                             data.data(), data.size());
+  BOOST_CHECK_EQUAL(run(c, loaded2), expected);
+  BOOST_CHECK_EQUAL(run(c, loaded2), expected);
+
+  BOOST_CHECK(naIsNil(naSaveCode(c.c, naNil())));
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_load_invalid )
+{
+  TestContext c;
+  std::string data = str(naSaveCode(c.c, parse(c, source)));
+  naRef file = c.to_nasal("test.nas");
+
+  BOOST_CHECK(naIsNil(naLoadCode(c.c, file, data.data(), 0)));
+  BOOST_CHECK(naIsNil(naLoadCode(c.c, file, data.data(), 10)));
+  BOOST_CHECK(naIsNil(naLoadCode(c.c, file, data.data(), data.size() - 1)));
+
+  for(size_t i = 0; i < data.size(); i += 7)
+  {
+    std::string corrupt = data;
+    corrupt[i] ^= 0x10;
+    BOOST_CHECK(naIsNil(naLoadCode(c.c, file, corrupt.data(), corrupt.size())));
+  }
+}
+
+// Offset of a short of the top level code's bytecode, which is at the
+// end of the data
+static size_t bytecodePos(const std::string& data, int ip)
+{
+  unsigned short sizes[8];
+  memcpy(sizes, data.data() + 16, sizeof(sizes));
+  return data.size() - 2 * (sizes[4] + sizes[6]) + 2 * ip;
+}
+
+// Replaces a short of the bytecode, and fixes up the checksum
+static std::string patchBytecode(std::string data, int ip, unsigned short v)
+{
+  memcpy(&data[bytecodePos(data, ip)], &v, sizeof(v));
+
+  unsigned int h = 2166136261u; // FNV-1a, as in bytecode.c
+  for(size_t i = 16; i < data.size(); ++i)
+    h = (h ^ (unsigned char)data[i]) * 16777619u;
+  memcpy(&data[8], &h, sizeof(h));
+  return data;
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_load_bad_bytecode )
+{
+  TestContext c;
+  std::string data = str(naSaveCode(c.c, parse(c, source)));
+  naRef file = c.to_nasal("test.nas");
+  unsigned short sizes[8];
+  memcpy(sizes, data.data() + 16, sizeof(sizes));
+  int codesz = sizes[4];
+  BOOST_REQUIRE(codesz > 10);
+
+  unsigned short first;
+  memcpy(&first, data.data() + bytecodePos(data, 0), sizeof(first));
+  BOOST_CHECK(patchBytecode(data, 0, first) == data);
+
+  // the checksum is right, so only the check of the bytecode itself can
+  // catch a bad opcode, constant, cache index, jump target or count
+  for(int ip = 0; ip < codesz; ++ip)
+  {
+    std::string bad = patchBytecode(data, ip, 0xfff0);
+    BOOST_CHECK(naIsNil(naLoadCode(c.c, file, bad.data(), bad.size())));
+  }
+
+  // running off the end, instead of returning
+  std::string noReturn = patchBytecode(data, codesz - 1, 0);
+  BOOST_CHECK(naIsNil(naLoadCode(c.c, file, noReturn.data(), noReturn.size())));
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( code_cache_directory )
+{
+  TestContext c;
+  simgear::Dir tmp = simgear::Dir::tempDir("nasal_code_cache");
+  tmp.setRemoveOnDestroy();
+
+  nasal::CodeCache cache;
+  int errLine = -1;
+
+  // no directory: plain parsing
+  naRef code = cache.parse(c.c, "test.nas", source.data(), source.size(), 1,
+                           &errLine);
+  BOOST_CHECK_EQUAL(run(c, code), expected);
+  BOOST_CHECK_EQUAL(cache.stats().misses, 0);
+
+  SGPath dir = tmp.file("cache");
+  cache.setDirectory(dir);
+  BOOST_REQUIRE(dir.isDir());
+
+  code = cache.parse(c.c, "test.nas", source.data(), source.size(), 1,
+                     &errLine);
+  BOOST_CHECK_EQUAL(run(c, code), expected);
+  BOOST_CHECK_EQUAL(cache.stats().misses, 1);
+  simgear::PathList entries = simgear::Dir(dir).children(simgear::Dir::TYPE_FILE);
+  BOOST_REQUIRE_EQUAL(entries.size(), 1);
+
+  code = cache.parse(c.c, "other.nas", source.data(), source.size(), 1,
+                     &errLine);
+  BOOST_CHECK_EQUAL(cache.stats().hits, 1);
+  BOOST_CHECK_EQUAL(run(c, code), expected);
+
+  // line numbers are part of the code
+  cache.parse(c.c, "test.nas", source.data(), source.size(), 10, &errLine);
+  BOOST_CHECK_EQUAL(cache.stats().misses, 2);
+
+  // parse errors are reported, and not cached
+  std::string bad = "var x = 1;\nvar y = ;\n";
+  code = cache.parse(c.c, "bad.nas", bad.data(), bad.size(), 1, &errLine);
+  BOOST_CHECK(naIsNil(code));
+  BOOST_CHECK_EQUAL(errLine, 2);
+  BOOST_CHECK_EQUAL(simgear::Dir(dir).children(simgear::Dir::TYPE_FILE).size(), 2);
+
+  // damaged entries are replaced
+  {
+    sg_ofstream out(entries[0]);
+    out << "garbage";
+  }
+  code = cache.parse(c.c, "test.nas", source.data(), source.size(), 1,
+                     &errLine);
+  BOOST_CHECK_EQUAL(run(c, code), expected);
+  BOOST_CHECK_EQUAL(cache.stats().invalid, 1);
+  cache.parse(c.c, "test.nas", source.data(), source.size(), 1, &errLine);
+  BOOST_CHECK_EQUAL(cache.stats().hits, 2);
+
+  cache.clear();
+  BOOST_CHECK(simgear::Dir(dir).isEmpty());
+}
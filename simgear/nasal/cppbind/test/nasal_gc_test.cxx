@@ -5,8 +5,8 @@
 
 #include <simgear/nasal/cppbind/NasalObjectHolder.hxx>
 
-#include <iostream>
 #include <set>
+#include <sstream>
 
 static std::set<intptr_t> active_instances;
 
@@ -138,3 +138,209 @@ BOOST_AUTO_TEST_CASE( object_holder_gc )
   c.runGC();
   BOOST_CHECK_EQUAL(active_instances.size(), 0);
 }
+
+//------------------------------------------------------------------------------
+// Create a ghost referenced from nowhere: no context temporaries keep it alive
+static naRef createDetachedGhost(intptr_t p)
+{
+  naContext tmp = naNewContext();
+  active_instances.insert(p);
+  naRef g = naNewGhost(tmp, &ghost_type, (void*)p);
+  naFreeContext(tmp);
+  return g;
+}
+
+// Allocate lots of short-lived objects, triggering young collections
+static void churn(TestContext& c, int count = 200000)
+{
+  std::ostringstream code;
+  code << "for(var i = 0; i < " << count << "; i += 1) { var v = [i, {}]; }";
+  c.exec(code.str(), nasal::Me(naNil()));
+}
+
+static naGCStats gcStats()
+{
+  naGCStats stats;
+  naGCGetStats(&stats);
+  return stats;
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( generational_gc )
+{
+  TestContext c;
+  BOOST_REQUIRE(active_instances.empty());
+
+  naRef h = naNewHash(c.c),
+        v = naNewVector(c.c),
+        g = createTestGhost(c, 1);
+  int keys[] = { naGCSave(h), naGCSave(v), naGCSave(g) };
+
+  c.runGC(); // now in the old generation
+  naGCResetStats();
+
+  // young objects only referenced from old ones
+  naHash_set(h, naNum(1), createDetachedGhost(2));
+  naVec_append(v, createDetachedGhost(3));
+  naGhost_setData(g, createDetachedGhost(4));
+  createDetachedGhost(5); // garbage
+
+  churn(c);
+
+  naGCStats stats = gcStats();
+  BOOST_CHECK(stats.minorCollections > 0);
+  BOOST_CHECK_EQUAL(stats.majorCollections, 0);
+
+  BOOST_CHECK_EQUAL(active_instances.size(), 4);
+  BOOST_CHECK_EQUAL(active_instances.count(5), 0);
+
+  // now old themselves, they are only freed by a full collection
+  naHash_delete(h, naNum(1));
+  churn(c);
+  BOOST_CHECK_EQUAL(active_instances.count(2), 1);
+  c.runGC();
+  BOOST_CHECK_EQUAL(active_instances.count(2), 0);
+
+  for(int key: keys)
+    naGCRelease(key);
+  c.runGC();
+  BOOST_REQUIRE(active_instances.empty());
+}
+
+//------------------------------------------------------------------------------
+// A heap of 'count' vectors, each holding its index and a string
+static naRef createHeap(TestContext& c, int count)
+{
+  std::ostringstream code;
+  code << "var h = {}; for(var i = 0; i < " << count << "; i += 1) "
+          "h[i] = [i, \"s\" ~ i]; return h;";
+  return c.exec(code.str(), nasal::Me(naNil()));
+}
+
+// Grow the old generation until a full collection is due
+static void promote(TestContext& c, naRef heap, int from, int count)
+{
+  std::ostringstream code;
+  code << "for(var i = " << from << "; i < " << (from + count) << "; i += 1) "
+          "me[i] = [i];";
+  c.exec(code.str(), nasal::Me(heap));
+  churn(c, 50000);
+}
+
+static bool heapIntact(naRef heap, int count)
+{
+  for(int i = 0; i < count; i += 97) {
+    naRef entry;
+    if( !naHash_get(heap, naNum(i), &entry) || naVec_get(entry, 0).num != i )
+      return false;
+  }
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE( incremental_gc )
+{
+  TestContext c;
+  BOOST_REQUIRE(active_instances.empty());
+
+  naRef heap = createHeap(c, 50000);
+  int key = naGCSave(heap);
+  c.runGC();
+
+  naGCSetIncremental(1);
+  promote(c, heap, 50000, 100000);
+  naGCResetStats();
+
+  int steps = 0;
+  naGCStats stats;
+  do {
+    naGCStep(0.01);
+
+    // stored into (probably) scanned objects while marking is underway
+    if( steps == 1 )
+    {
+      naHash_set(heap, naNum(-1), createDetachedGhost(1));
+      naRef entry;
+      naHash_get(heap, naNum(7), &entry);
+      naVec_append(entry, createDetachedGhost(2));
+    }
+
+    ++steps;
+    stats = gcStats();
+  } while( stats.majorCollections == 0 && steps < 1000000 );
+
+  BOOST_CHECK_EQUAL(stats.majorCollections, 1);
+  BOOST_CHECK(stats.incrementalSteps > 10);
+  BOOST_CHECK_EQUAL(active_instances.size(), 2);
+  BOOST_CHECK(heapIntact(heap, 150000));
+
+  // nothing due: no work, no pause
+  naGCStep(0.01);
+  BOOST_CHECK_EQUAL(gcStats().incrementalSteps, stats.incrementalSteps);
+
+  naGCSetIncremental(0);
+  naGCRelease(key);
+  c.runGC();
+  BOOST_REQUIRE(active_instances.empty());
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( incremental_sweep_gc )
+{
+  TestContext c;
+  BOOST_REQUIRE(active_instances.empty());
+
+  // enough old ghosts for the new ones not to run out of room before
+  // the collection is done (see naGC_get())
+  naRef heap = createHeap(c, 50000),
+        old_ghosts = naNewVector(c.c);
+  int key = naGCSave(heap);
+  naHash_set(heap, naNum(-1), old_ghosts);
+  int ghosts = 0;
+  while( ghosts < 20000 )
+    naVec_append(old_ghosts, createDetachedGhost(++ghosts));
+  c.runGC();
+
+  naGCSetIncremental(1);
+  promote(c, heap, 50000, 100000);
+  naGCResetStats();
+
+  // after every slice, both while marking and while sweeping, a young
+  // ghost goes into an old object, and one into each of the vectors
+  // made by the last slices (marked, if that was while marking, but not
+  // old until swept)
+  int steps = 0;
+  std::vector<naRef> vecs;
+  naGCStats stats;
+  do {
+    naGCStep(0.001);
+    ++steps;
+
+    naRef entry;
+    naHash_get(heap, naNum(steps * 101 % 150000), &entry);
+    naVec_append(entry, createDetachedGhost(++ghosts));
+    for(size_t i = vecs.size() < 50 ? 0 : vecs.size() - 50; i < vecs.size(); ++i)
+      naVec_append(vecs[i], createDetachedGhost(++ghosts));
+
+    naContext tmp = naNewContext();
+    vecs.push_back(naNewVector(tmp));
+    naFreeContext(tmp);
+    naHash_set(heap, naNum(-1 - steps), vecs.back());
+
+    stats = gcStats();
+  } while( stats.majorCollections == 0 && steps < 1000000 );
+
+  BOOST_CHECK_EQUAL(stats.majorCollections, 1);
+  BOOST_CHECK(stats.incrementalSteps > 10);
+  BOOST_CHECK_EQUAL(active_instances.size(), ghosts);
+
+  // young collections must find them through the remembered set
+  churn(c);
+  BOOST_CHECK(gcStats().minorCollections > 0);
+  BOOST_CHECK_EQUAL(active_instances.size(), ghosts);
+  BOOST_CHECK(heapIntact(heap, 150000));
+
+  naGCSetIncremental(0);
+  naGCRelease(key);
+  c.runGC();
+  BOOST_REQUIRE(active_instances.empty());
+}
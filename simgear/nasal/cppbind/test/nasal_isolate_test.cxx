@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+// Run code with the standard, thread and numvec libraries in its namespace
+static naRef run(TestContext& c, const std::string& src)
+{
+  int errLine = -1;
+  naRef code = naParseCode(c.c, c.to_nasal("isolate_test.nas"), 1,
+                           const_cast<char*>(src.c_str()), src.size(),
+                           &errLine);
+  BOOST_REQUIRE(naIsCode(code));
+
+  naRef ns = naInit_std(c.c);
+  naHash_set(ns, c.to_nasal("thread"), naInit_thread(c.c));
+  naHash_set(ns, c.to_nasal("numvec"), naInit_numvec(c.c));
+  return naCallMethodCtx(c.c, code, naNil(), 0, 0, ns);
+}
+
+template<class T>
+static T run(TestContext& c, const std::string& src)
+{
+  naRef result = run(c, src);
+  BOOST_REQUIRE(!naGetError(c.c));
+  return c.from_nasal<T>(result);
+}
+
+static std::string error(TestContext& c, const std::string& src)
+{
+  run(c, src);
+  return naGetError(c.c) ? naGetError(c.c) : "";
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( channel_messages )
+{
+  TestContext c;
+  std::string result = run<std::string>(c,
+    "var ch = thread.newchannel();"
+    "var r = '' ~ (thread.tryreceive(ch) == nil);"
+    "var shared = [1, 2];"
+    "var msg = { name: 'abc', list: [1, nil, 'x', shared, shared],"
+    "            n: numvec.floats([0.5, 2]), 3: 4, self: ch };"
+    "thread.send(ch, msg);"
+    "thread.send(ch, 5);"
+    "var m = thread.receive(ch);"
+    "r ~= m.name ~ size(m.list) ~ m.list[0] ~ m.list[2] ~ (m.list[1] == nil)"
+    "   ~ m.list[3][1] ~ ' ' ~ (m.list[3] == m.list[4]) ~ (m == msg)"
+    "   ~ ' ' ~ m.n[0] ~ size(m.n) ~ ' ' ~ m[3];"
+    "thread.send(m.self, 'via copy');"
+    "r ~= ' ' ~ thread.receive(ch) ~ ' ' ~ thread.receive(ch);"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "1abc51x12 00 0.52 4 5 via copy");
+
+  BOOST_CHECK_EQUAL(
+    error(c, "thread.send(thread.newchannel(), [func 1]);"),
+    "only data (no functions or ghosts) can be sent to other heaps"
+  );
+  BOOST_CHECK_EQUAL(
+    error(c, "var v = [];"
+             "v = [v]; v[0] = v;" // cyclic
+             "thread.send(thread.newchannel(), v);"),
+    "message nested too deeply (or cyclic)"
+  );
+  BOOST_CHECK_EQUAL(error(c, "thread.receive(1);"),
+                    "bad/missing channel argument to receive()");
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( isolate_run )
+{
+  TestContext c;
+  std::string result = run<std::string>(c,
+    "var out = thread.newchannel();"
+    "thread.newisolate(func(out, n, v) {"
+    "  var sum = 0;"
+    "  for(var i = 0; i < n; i += 1) sum += i;"
+    "  var inbox = thread.newchannel();"
+    "  thread.send(out, { sum: sum, v: v, math: math.floor(2.5),"
+    "                     inbox: inbox });"
+    "  thread.send(out, 'echo ' ~ thread.receive(inbox));"
+    "}, out, 100, ['a', 'b']);"
+    "var m = thread.receive(out);"
+    "thread.send(m.inbox, 'hello');"
+    "return m.sum ~ ' ' ~ m.v[1] ~ ' ' ~ m.math ~ ' '"
+    "     ~ thread.receive(out);"
+  );
+  BOOST_CHECK_EQUAL(result, "4950 b 2 echo hello");
+
+  // from source text, starting threads of its own in the isolate heap
+  result = run<std::string>(c,
+    "var out = thread.newchannel();"
+    "thread.newisolate("
+    "  'var out = arg[0];"
+    "   var done = thread.newchannel();"
+    "   for(var i = 0; i < 4; i += 1)"
+    "     thread.newthread(func { thread.send(done, 1); });"
+    "   var s = 0;"
+    "   for(var i = 0; i < 4; i += 1) s += thread.receive(done);"
+    "   thread.send(out, s);', out);"
+    "return thread.receive(out);"
+  );
+  BOOST_CHECK_EQUAL(result, "4");
+
+  BOOST_CHECK_EQUAL(error(c, "thread.newisolate('var x = ;');"),
+                    "parse error in isolate code, line 1");
+  BOOST_CHECK_EQUAL(error(c, "thread.newisolate(func 1, func 2);"),
+                    "only data (no functions or ghosts) can be sent to other heaps");
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( isolate_collection )
+{
+  TestContext c;
+
+  // Isolates collect garbage independently of the default heap, and of
+  // each other
+  double result = run<double>(c,
+    "var out = thread.newchannel();"
+    "for(var k = 0; k < 4; k += 1)"
+    "  thread.newisolate(func(out, k) {"
+    "    var keep = [];"
+    "    for(var i = 0; i < 100000; i += 1) {"
+    "      var h = { i: i, s: 'x' ~ i };"
+    "      if(math.fmod(i, 1000) == 0) append(keep, h);"
+    "    }"
+    "    thread.send(out, size(keep) + k);"
+    "  }, out, k);"
+    "var s = 0;"
+    "for(var k = 0; k < 4; k += 1) s += thread.receive(out);"
+    "return s;"
+  );
+  BOOST_CHECK_EQUAL(result, 4 * 100 + 6);
+}
@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+// Each call site is run several times, so the later calls use the
+// member lookup cache filled by the first one.
+
+BOOST_AUTO_TEST_CASE( member_cache_class_changes )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var Base = { name: func 'base' };"
+    "var Mid = { parents: [Base] };"
+    "var Class = { parents: [Mid] };"
+    "var obj = { parents: [Class] };"
+    "var get = func(o) o.name();"
+    "var r = get(obj) ~ get(obj);"
+    "Mid.name = func 'mid';"            // shadows the cached one
+    "r ~= ' ' ~ get(obj) ~ get(obj);"
+    "Base.name = func 'unused';"
+    "r ~= ' ' ~ get(obj);"
+    "Mid.parents = [Base];"
+    "Mid.name = Base.name;"
+    "r ~= ' ' ~ get(obj) ~ get(obj);"
+    "Class.parents[0] = { name: func 'other' };"
+    "r ~= ' ' ~ get(obj) ~ get(obj);"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "basebase midmid mid unusedunused otherother");
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_receiver_changes )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var Class = { x: 'class' };"
+    "var a = { parents: [Class] };"
+    "var b = { parents: [Class] };"
+    "var get = func(o) o.x;"
+    "var r = get(a) ~ get(b) ~ get(a);"
+    "b.x = 'b';"                        // only b shadows it
+    "r ~= ' ' ~ get(a) ~ get(b) ~ get(a);"
+    "a.parents = [{ x: 'other' }];"
+    "r ~= ' ' ~ get(a) ~ get(a) ~ get(b);"
+    "b.parents[0] = { x: 'unused' };"
+    "r ~= ' ' ~ get(b) ~ get({ parents: b.parents });"
+    "r ~= ' ' ~ get({ x: 'own' }) ~ get({ parents: [{ parents: [Class] }] });"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "classclassclass classbclass otherotherb bunused ownclass");
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_mixed_receivers )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var A = { id: func 'A' };"
+    "var B = { id: func 'B' };"
+    "var objs = [{ parents: [A] }, { parents: [B] }, { id: func 'own' },"
+    "            { parents: [{ parents: [B] }] }, { parents: [A] }];"
+    "var r = '';"
+    "for(var i = 0; i < 3; i += 1)"
+    "  foreach(var o; objs) r ~= o.id();"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "ABownBAABownBAABownBA");
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_gc )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var Class = { x: 'class' };"
+    "var get = func(o) o.x;"
+    "var r = '';"
+    "for(var i = 0; i < 100000; i += 1) {"
+    "  var obj = { parents: [i < 50000 ? Class : { x: 'other' }] };"
+    "  var v = get(obj);"
+    "  if(i == 0 or i == 99999) r ~= v;"
+    "}"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "classother");
+}
+
+BOOST_AUTO_TEST_CASE( member_cache_deep_and_megamorphic )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var C = { x: 'deep' };"
+    "for(var i = 0; i < 6; i += 1) C = { parents: [C] };" // too deep to cache
+    "var get = func(o) o.x;"
+    "var r = get(C) ~ get(C);"
+    "C.parents[0].parents[0].x = 'changed';"
+    "r ~= ' ' ~ get(C);"
+    "var objs = [];"                     // more receivers than refills
+    "for(var i = 0; i < 20; i += 1) objs = objs ~ [{ x: i }];"
+    "var sum = 0;"
+    "for(var n = 0; n < 3; n += 1)"
+    "  foreach(var o; objs) sum += get(o);"
+    "objs[5].x = 100;"
+    "foreach(var o; objs) sum += get(o);"
+    "return r ~ ' ' ~ sum;"
+  );
+  BOOST_CHECK_EQUAL(result, "deepdeep changed 855");
+}
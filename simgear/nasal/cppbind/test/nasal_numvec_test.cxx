@@ -0,0 +1,191 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+#include <simgear/nasal/cppbind/NasalNumVec.hxx>
+
+#include <algorithm>
+#include <sstream>
+
+// Namespace with the standard library and the numvec library (as "numvec")
+static naRef newNamespace(TestContext& c)
+{
+  naRef ns = naInit_std(c.c);
+  naHash_set(ns, c.to_nasal("numvec"), naInit_numvec(c.c));
+  return ns;
+}
+
+static naRef run(TestContext& c, const std::string& src, naRef ns = naNil())
+{
+  int errLine = -1;
+  naRef code = naParseCode(c.c, c.to_nasal("numvec_test.nas"), 1,
+                           const_cast<char*>(src.c_str()), src.size(),
+                           &errLine);
+  BOOST_REQUIRE(naIsCode(code));
+
+  if( naIsNil(ns) )
+    ns = newNamespace(c);
+  return naCallMethodCtx(c.c, code, naNil(), 0, 0, ns);
+}
+
+template<class T>
+static T run(TestContext& c, const std::string& src, naRef ns = naNil())
+{
+  naRef result = run(c, src, ns);
+  BOOST_REQUIRE(!naGetError(c.c));
+  return c.from_nasal<T>(result);
+}
+
+static std::string error(TestContext& c, const std::string& src)
+{
+  run(c, src);
+  return naGetError(c.c) ? naGetError(c.c) : "";
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( numvec_access )
+{
+  TestContext c;
+  std::string result = run<std::string>(c,
+    "var a = numvec.doubles(4);"
+    "a[1] = 2.5;"
+    "a[-1] = '7';"
+    "a[2] += a[1] * 2;"
+    "var r = size(a) ~ ':';"
+    "foreach(var x; a) r ~= ' ' ~ x;"
+    "forindex(var i; a) r ~= ' ' ~ i;"
+    "var f = numvec.floats([0.5, 1, 0.1]);"
+    "r ~= ' ' ~ f[0] ~ ' ' ~ (f[2] == 0.1) ~ ' ' ~ (f[2] - 0.1 < 1e-7);"
+    "var v = numvec.vector(numvec.doubles(f));"
+    "r ~= ' ' ~ size(v) ~ ' ' ~ v[1] ~ ' ' ~ typeof(v) ~ ' ' ~ typeof(a);"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "4: 0 2.5 5 7 0 1 2 3 0.5 0 1 3 1 vector ghost");
+
+  BOOST_CHECK_EQUAL(error(c, "numvec.doubles(2)[2];"),
+                    "numvec index 2 out of bounds (size: 2)");
+  BOOST_CHECK_EQUAL(error(c, "numvec.doubles(2)[-3] = 1;"),
+                    "numvec index -1 out of bounds (size: 2)");
+  BOOST_CHECK_EQUAL(error(c, "numvec.floats([1, 'x']);"),
+                    "non numeric element 1 in floats()");
+  BOOST_CHECK_EQUAL(error(c, "numvec.sum([1, 2]);"),
+                    "bad/missing numvec argument to sum()");
+  BOOST_CHECK_EQUAL(error(c, "numvec.doubles(3e8);"),
+                    "bad size for doubles()");
+  BOOST_CHECK_EQUAL(error(c, "numvec.floats(-1);"), "bad size for floats()");
+  BOOST_CHECK_EQUAL(error(c, "numvec.doubles(0 / 0);"),
+                    "bad size for doubles()");
+  BOOST_CHECK_THROW(nasal::NumVec(c.c, size_t(NA_NUMVEC_MAX_SIZE) + 1),
+                    std::length_error);
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( numvec_bulk_ops )
+{
+  TestContext c;
+
+  // Sizes around the SIMD widths, to cover the scalar tails
+  for(int n = 1; n <= 11; ++n)
+  {
+    std::string size = std::to_string(n);
+    for(std::string type: {"doubles", "floats"})
+    {
+      std::string result = run<std::string>(c,
+        "var a = numvec." + type + "(" + size + ");"
+        "forindex(var i; a) a[i] = (i == 3 ? -i : i) + 1;"
+        "var r = numvec.sum(a) ~ ' ' ~ numvec.min(a) ~ ' ' ~ numvec.max(a);"
+        "numvec.scale(a, 2, 1);"
+        "r ~= ' ' ~ numvec.sum(a) ~ ' ' ~ a[0] ~ ' ' ~ a[-1];"
+        "numvec.scale(a, -1);"
+        "r ~= ' ' ~ a[-1];"
+        "return r;"
+      );
+
+      double sum = 0, min = 1e9, max = -1e9;
+      for(int i = 0; i < n; ++i)
+      {
+        double x = (i == 3 ? -i : i) + 1;
+        sum += x;
+        min = std::min(min, x);
+        max = std::max(max, x);
+      }
+      double last = (n == 4 ? -2 : n) * 2 + 1;
+      std::ostringstream expected;
+      expected << sum << ' ' << min << ' ' << max << ' '
+               << sum * 2 + n << ' ' << 3 << ' ' << last << ' ' << -last;
+      BOOST_CHECK_EQUAL(result, expected.str());
+    }
+  }
+
+  BOOST_CHECK(naIsNil(run(c, "return numvec.min(numvec.doubles(0));")));
+  BOOST_CHECK_EQUAL(run<double>(c, "return numvec.sum(numvec.floats(0));"), 0);
+
+  std::string result = run<std::string>(c,
+    "var a = numvec.floats([1, 2, 3]);"
+    "var b = numvec.map(a, func(x) x * x);"
+    "var r = (a == b) ~ ' ' ~ a[0] ~ a[1] ~ a[2];"
+    "var xs = numvec.doubles([0, 10, 20, 40]);"
+    "var ys = numvec.floats([5, 15, -5, -5]);"
+    "foreach(var x; [-1, 0, 5, 10, 12.5, 30, 40, 50])"
+    "  r ~= ' ' ~ numvec.interpolate(xs, ys, x);"
+    "var q = numvec.interpolate(xs, ys, numvec.doubles([35, 2, 3, 15, 45]));"
+    "foreach(var y; q) r ~= ' ' ~ y;"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result,
+                    "1 149 5 5 10 15 10 -5 -5 -5 -5 7 8 5 -5");
+
+  BOOST_CHECK_EQUAL(error(c, "numvec.map(numvec.doubles(1), func 'x');"),
+                    "map() function returned non-number");
+  BOOST_CHECK_EQUAL(error(c, "numvec.map(numvec.doubles(1), func die('in'));"),
+                    "in");
+  BOOST_CHECK_EQUAL(
+    error(c, "numvec.interpolate(numvec.doubles(2), numvec.doubles(3), 1);"),
+    "interpolate() tables empty or of unequal size"
+  );
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( numvec_cppbind )
+{
+  TestContext c;
+  naRef a = run(c, "return numvec.doubles([1.5, 2, 3]);");
+  naRef f = run(c, "return numvec.floats([1.5, 2, 3]);");
+
+  std::vector<double> dv = c.from_nasal<std::vector<double> >(a);
+  BOOST_REQUIRE_EQUAL(dv.size(), 3);
+  BOOST_CHECK_EQUAL(dv[0], 1.5);
+  BOOST_CHECK_EQUAL(dv[2], 3);
+
+  std::vector<int> iv = c.from_nasal<std::vector<int> >(f);
+  BOOST_REQUIRE_EQUAL(iv.size(), 3);
+  BOOST_CHECK_EQUAL(iv[0], 1);
+  BOOST_CHECK_EQUAL(iv[1], 2);
+
+  std::vector<std::string> sv = c.from_nasal<std::vector<std::string> >(f);
+  BOOST_REQUIRE_EQUAL(sv.size(), 3);
+  BOOST_CHECK_EQUAL(sv[0], "1.5");
+
+  nasal::NumVec nv = c.from_nasal<nasal::NumVec>(a);
+  BOOST_CHECK_EQUAL(nv.size(), 3);
+  BOOST_CHECK_EQUAL(nv.type(), NA_NUMVEC_DOUBLE);
+  BOOST_REQUIRE(nv.doubles());
+  BOOST_CHECK(!nv.floats());
+  nv.doubles()[1] = 42;           // shares the elements with Nasal
+  BOOST_CHECK_EQUAL(naNumVec_get(a, 1), 42);
+  BOOST_CHECK_EQUAL(nv.get(2), 3);
+  BOOST_CHECK_THROW(nv.get(3), std::out_of_range);
+  BOOST_CHECK_THROW(c.from_nasal<nasal::NumVec>(c.to_nasal(1)),
+                    nasal::bad_nasal_cast);
+
+  std::vector<double> values(100);
+  for(size_t i = 0; i < values.size(); ++i)
+    values[i] = i;
+  nasal::NumVec created(c.c, values);
+  naRef ref = c.to_nasal(created);
+  BOOST_REQUIRE(naIsNumVec(ref));
+  BOOST_CHECK_EQUAL(naNumVec_size(ref), 100);
+  BOOST_CHECK_EQUAL(naNumVec_get(ref, 99), 99);
+  BOOST_CHECK(c.from_nasal<std::vector<double> >(ref) == values);
+}
@@ -0,0 +1,120 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+#include <simgear/nasal/cppbind/NasalProfiler.hxx>
+
+#include <map>
+#include <sstream>
+
+static naRef run(TestContext& c, const std::string& src)
+{
+  int errLine = -1;
+  naRef code = naParseCode(c.c, c.to_nasal("profile_test.nas"), 1,
+                           const_cast<char*>(src.c_str()), src.size(),
+                           &errLine);
+  BOOST_REQUIRE(naIsCode(code));
+  naRef result = naCallMethodCtx(c.c, code, naNil(), 0, 0, naInit_std(c.c));
+  BOOST_REQUIRE(!naGetError(c.c));
+  return result;
+}
+
+// Folded stacks, parsed back into a map of stack -> count
+static std::map<std::string, int> folded(TestContext& c)
+{
+  std::map<std::string, int> stacks;
+  std::istringstream lines(nasal::Profiler::foldedStacks(c.c));
+  std::string line;
+  while( std::getline(lines, line) )
+  {
+    size_t space = line.rfind(' ');
+    BOOST_REQUIRE(space != std::string::npos);
+    stacks[line.substr(0, space)] += std::stoi(line.substr(space + 1));
+  }
+  return stacks;
+}
+
+static const std::string nested_loops =
+  "var inner = func(n) {\n"
+  "  var s = 0;\n"
+  "  for(var i = 0; i < n; i += 1) s += i;\n"
+  "  return s;\n"
+  "};\n"
+  "var outer = func {\n"
+  "  var t = 0;\n"
+  "  for(var k = 0; k < 100; k += 1) t += inner(1000);\n"
+  "  return t;\n"
+  "};\n"
+  "return outer();\n";
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( profiler_interval )
+{
+  TestContext c;
+  nasal::Profiler::start(100);
+  BOOST_CHECK_EQUAL(c.from_nasal<double>(run(c, nested_loops)),
+                    100 * 499500.0);
+  nasal::Profiler::stop();
+
+  // one sample per 100 loop iterations and calls
+  int n = nasal::Profiler::numSamples();
+  BOOST_CHECK(n >= 1000 && n <= 1020);
+  BOOST_CHECK_EQUAL(nasal::Profiler::numDropped(), 0);
+
+  std::map<std::string, int> stacks = folded(c);
+  int total = 0;
+  for(auto const& stack: stacks)
+  {
+    BOOST_CHECK_EQUAL(stack.first.compare(0, 19, "profile_test.nas:11"), 0);
+    total += stack.second;
+  }
+  BOOST_CHECK_EQUAL(total, n);
+
+  const std::string hot = "profile_test.nas:11;"
+                          "profile_test.nas:8;"
+                          "profile_test.nas:3";
+  BOOST_CHECK(stacks[hot] > n * 9 / 10);
+
+  // nothing recorded once stopped
+  run(c, nested_loops);
+  BOOST_CHECK_EQUAL(nasal::Profiler::numSamples(), n);
+
+  nasal::Profiler::clear();
+  BOOST_CHECK_EQUAL(nasal::Profiler::numSamples(), 0);
+  BOOST_CHECK_EQUAL(nasal::Profiler::foldedStacks(c.c), "");
+}
+
+//------------------------------------------------------------------------------
+BOOST_AUTO_TEST_CASE( profiler_requests )
+{
+  TestContext c;
+
+  // Only sampled on request (as from a timer)
+  nasal::Profiler::start(0);
+  run(c, nested_loops);
+  BOOST_CHECK_EQUAL(nasal::Profiler::numSamples(), 0);
+
+  nasal::Profiler::sample();
+  run(c, nested_loops);
+  BOOST_CHECK_EQUAL(nasal::Profiler::numSamples(), 1);
+  BOOST_CHECK_EQUAL(nasal::Profiler::foldedStacks(c.c),
+                    "profile_test.nas:11;profile_test.nas:7 1\n");
+
+  // Samples which don't fit into the buffer are dropped
+  nasal::Profiler::start(1, 50);
+  run(c,
+    "var f = func(n) n > 0 ? f(n - 1) : 0;\n"
+    "f(3);\n"
+    "f(100);\n"
+  );
+  nasal::Profiler::stop();
+  BOOST_CHECK(nasal::Profiler::numSamples() >= 5);
+  BOOST_CHECK(nasal::Profiler::numDropped() > 0);
+
+  std::map<std::string, int> stacks = folded(c);
+  BOOST_CHECK_EQUAL(stacks["profile_test.nas:2;profile_test.nas:1;"
+                           "profile_test.nas:1;profile_test.nas:1;"
+                           "profile_test.nas:1"], 1);
+  nasal::Profiler::clear();
+}
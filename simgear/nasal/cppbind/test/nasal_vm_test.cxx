@@ -0,0 +1,196 @@
+#define BOOST_TEST_MODULE nasal
+#include <BoostTestTargetConfig.h>
+
+#include "TestContext.hxx"
+
+// The code generator fuses common instruction sequences into
+// superinstructions (see the peephole optimizer in codegen.c).  These
+// check that the fused forms behave like the original sequences.
+
+BOOST_AUTO_TEST_CASE( vm_const_binops )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var x = 7;"
+    "var s = '6';"
+    "var y = 2;"
+    "return (y + (x + 1)) ~ ' ' ~ (x + 1) ~ ' ' ~ (x - 0) ~ ' ' ~ (x * 2.5) ~ ' ' ~ (x / 2) ~ ' '"
+    "     ~ (s + 1) ~ ' ' ~ (x - 1 - 1) ~ ' ' ~ (1 - x) ~ ' '"
+    "     ~ (x < 7) ~ (x <= 7) ~ (x > 7) ~ (x >= 7) ~ (s < 10) ~ ' '"
+    "     ~ ('a' ~ 1);"
+  );
+  BOOST_CHECK_EQUAL(result, "10 8 7 17.5 3.5 7 5 -6 01011 a1");
+
+  // compound assignments to locals, outer scopes and members
+  result = c.exec<std::string>(
+    "var n = 1;"
+    "var o = { v: 10 };"
+    "var f = func { n += 1; n *= 3; o.v -= 1; o.v /= 3 };"
+    "f();"
+    "return n ~ ' ' ~ o.v;"
+  );
+  BOOST_CHECK_EQUAL(result, "6 3");
+}
+
+BOOST_AUTO_TEST_CASE( vm_compare_jumps )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var r = '';"
+    "var v = [1, 2, 3, 'a', nil, 2];"
+    "for(var i = 0; i < 6; i += 1) {"
+    "  var e = v[i];"
+    "  if(e == 2) r ~= 'two';"
+    "  elsif(e != nil and e != 'a' and e > 2) r ~= 'big';"
+    "  elsif(e == nil or e == 'a') r ~= '-';"
+    "  else r ~= e;"
+    "}"
+    "var j = 10;"
+    "while(j >= 0) j -= 3;"
+    "r ~= ' ' ~ j;"
+    "if(j <= -2 or j > 100) r ~= ' yes';"
+    "if(!(j < 0)) r ~= ' no';"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "1twobig--two -2 yes");
+}
+
+BOOST_AUTO_TEST_CASE( vm_loop_exits )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var r = '';"
+    "for(var i = 0; i < 10; i += 1) {"
+    "  if(i == 2) continue;"
+    "  if(i > 4) break;"
+    "  r ~= i;"
+    "}"
+    "r ~= ' ';"
+    "foreach(var e; [1, 2, 3, 4]) {"
+    "  if(e == 3) break;"
+    "  r ~= e;"
+    "}"
+    "r ~= ' ';"
+    "var k = 0;"
+    "while(k < 100) {"
+    "  k += 1;"
+    "  if(k < 5) continue;"
+    "  if(k == 7) break;"
+    "  if(k == 8) break;"
+    "  r ~= k;"
+    "}"
+    "r ~= ' ';"
+    "for(outer; var a = 0; a < 3; a += 1) {"
+    "  forindex(var b; [0, 0, 0]) {"
+    "    if(b == 1) continue;"
+    "    if(a == 1 and b == 2) continue outer;"
+    "    if(a == 2 and b == 2) break outer;"
+    "    r ~= a ~ b;"
+    "  }"
+    "  r ~= '.';"
+    "}"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "0134 12 56 0002.1020");
+
+  // a loop used as an expression, broken out of from inside a call
+  result = c.exec<std::string>(
+    "var r = '';"
+    "var f = func(x) x * 2;"
+    "for(var i = 0; 1; i += 1) {"
+    "  r ~= f(i < 3 ? i : -1);"
+    "  if(f(i) >= 6) break;"
+    "}"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result, "024-2");
+}
+
+BOOST_AUTO_TEST_CASE( vm_local_members )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var Class = {"
+    "  new: func(x) { return { parents: [Class], x: x } },"
+    "  get: func me.x,"
+    "  add: func(o) Class.new(me.x + o.x),"
+    "};"
+    "var a = Class.new(2);"
+    "var b = a.add(Class.new(3));"
+    "var h = { x: 'own' };"
+    "return b.get() ~ ' ' ~ a.x ~ ' ' ~ h.x;"
+  );
+  BOOST_CHECK_EQUAL(result, "5 2 own");
+}
+
+// Concatenation appends in place where it can, sharing the buffer
+// between the old and new strings
+BOOST_AUTO_TEST_CASE( vm_string_building )
+{
+  TestContext c;
+  std::string result = c.exec<std::string>(
+    "var s = 'abcdefghijklmnop';"
+    "var prefixes = [nil, nil, nil, nil, nil];"
+    "for(var i = 0; i < 5; i += 1) {"
+    "  s ~= i;"
+    "  prefixes[i] = s;"
+    "}"
+    "var t = prefixes[2] ~ 'X';"        // extended already: copied
+    "var u = s ~ s;"
+    "var r = s ~ ' ' ~ t ~ ' ' ~ u ~ ' ';"
+    "foreach(var p; prefixes) r ~= p ~ ',';"
+    "r ~= ' ' ~ (s == prefixes[3] ~ 4) ~ (prefixes[3] == prefixes[4]);"
+    "var h = {};"
+    "h[prefixes[2]] = 'found';"
+    "r ~= ' ' ~ h['abcdefghijklmnop012'];"
+    "var n = '0000000000000012' ~ '3';"
+    "r ~= ' ' ~ (n + 1);"
+    "return r;"
+  );
+  BOOST_CHECK_EQUAL(result,
+    "abcdefghijklmnop01234 abcdefghijklmnop012X "
+    "abcdefghijklmnop01234abcdefghijklmnop01234 "
+    "abcdefghijklmnop0,abcdefghijklmnop01,abcdefghijklmnop012,"
+    "abcdefghijklmnop0123,abcdefghijklmnop01234, 10 found 124"
+  );
+
+  // writing to a string does not change the others sharing its buffer
+  result = c.exec<std::string>(
+    "var a = 'abcdefghijklmnop' ~ 'q';"
+    "var b = a ~ 'r';"
+    "var d = b ~ 's';"
+    "b[0] = 90;"
+    "return a ~ ' ' ~ b ~ ' ' ~ d;"
+  );
+  BOOST_CHECK_EQUAL(result,
+    "abcdefghijklmnopq Zbcdefghijklmnopqr abcdefghijklmnopqrs");
+
+  // and a string stays unchanged when collected garbage shared its buffer
+  result = c.exec<std::string>(
+    "var s = '';"
+    "var keep = nil;"
+    "for(var i = 0; i < 20000; i += 1) {"
+    "  s ~= 'x';"
+    "  if(i == 100) keep = s;"
+    "  if(i == 5000 or i == 10000) s = s ~ '';"
+    "}"
+    "return keep;"
+  );
+  BOOST_CHECK_EQUAL(result, std::string(101, 'x'));
+
+  // hashing and comparing strings reads them without unsharing the buffer
+  naRef vec = c.exec(
+    "var a = ('abcdefghijklmnop' ~ 'q') ~ 'r';"
+    "var b = a ~ 's';"
+    "var h = {};"
+    "h[a] = 1;"
+    "h[b] = 2;"
+    "return [a, b, h[a] + h[b], a == 'abcdefghijklmnopqr'];",
+    naNil()
+  );
+  BOOST_REQUIRE(naIsVector(vec));
+  BOOST_CHECK_EQUAL(naStr_cdata(naVec_get(vec, 0)),
+                    naStr_cdata(naVec_get(vec, 1)));
+  BOOST_CHECK_EQUAL(naNumValue(naVec_get(vec, 2)).num, 3);
+  BOOST_CHECK_EQUAL(naNumValue(naVec_get(vec, 3)).num, 1);
+}
@@ -40,7 +40,7 @@ namespace nasal
    *        naRef to_nasal_helper(naContext, Type)
    */
   template<class T>
-  naRef to_nasal(naContext c, T arg)
+  naRef to_nasal(naContext c, const T& arg)
   {
     return to_nasal_helper(c, arg);
   }
@@ -59,7 +59,7 @@ namespace nasal
   struct to_nasal_ptr
   {
     typedef typename boost::call_traits<Var>::param_type param_type;
-    typedef naRef(*type)(naContext, param_type);
+    typedef naRef(*type)(naContext, const param_type&);
 
     static type get()
     {
@@ -93,10 +93,32 @@ struct naObj {
     GC_HEADER;
 };
 
+// Bits of the GC_HEADER mark byte.  Objects surviving a collection
+// become GC_OLD, and are only traced again by full collections.  Old
+// objects in the remembered set are GC_REMEMBERED.
+#define GC_MARK 1
+#define GC_OLD 2
+#define GC_REMEMBERED 4
+
+// Must follow any store of a reference r into an existing object o, so
+// young collections can find the young objects referenced from old
+// ones: o is remembered (once until the next collection), and scanned
+// as a root.  Objects marked by a full collection count as old, as its
+// sweep is going to promote them.  GC_WRITE_BARRIER_ALL() is for when
+// the contents have moved around, without a look at what they are.
+#define GC_NEEDS_REMEMBER(o) \
+    (((o)->mark & (GC_OLD|GC_MARK)) && !((o)->mark & GC_REMEMBERED))
+#define GC_WRITE_BARRIER(o, r) \
+    do { if(GC_NEEDS_REMEMBER(o) && !IS_NUM(r) && !IS_NIL(r) \
+            && !(PTR(r).obj->mark & GC_OLD)) \
+             naiGCRemember((struct naObj*)(o)); } while(0)
+#define GC_WRITE_BARRIER_ALL(o) \
+    do { if(GC_NEEDS_REMEMBER(o)) naiGCRemember((struct naObj*)(o)); } while(0)
+
 #define MAX_STR_EMBLEN 15
 struct naStr {
     GC_HEADER;
-    signed char emblen; /* [0-15], or -1 to indicate "not embedded" */
+    signed char emblen; /* [0-15], -1 "not embedded", -2 shared (string.c) */
     unsigned int hashcode;
     union {
         unsigned char buf[16];
@@ -115,6 +137,7 @@ struct VecRec {
 
 struct naVec {
     GC_HEADER;
+    unsigned int version;  // bumped by changes other than appending
     struct VecRec* rec;
 };
 
@@ -126,6 +149,7 @@ struct HashNode {
 
 struct naHash {
     GC_HEADER;
+    unsigned int version;  // bumped by every change
     struct HashRec* rec;
 };
 
@@ -138,8 +162,10 @@ struct naCode {
     unsigned short codesz;
     unsigned short restArgSym; // The "..." vector name, defaults to "arg"
     unsigned short nLines;
+    unsigned short nMemberCaches; // one per OP_MEMBER
     naRef srcFile;
     naRef* constants;
+    struct MemberCache* memberCaches;
 };
 
 /* naCode objects store their variable length arrays in a single block
@@ -182,11 +208,13 @@ struct naPool {
     int           type;
     int           elemsz;
     struct Block* blocks;
-    void**   free0; // pointer to the alloced buffer
-    int     freesz; // size of the alloced buffer
-    void**    free; // current "free frame"
-    int      nfree; // down-counting index within the free frame
-    int    freetop; // curr. top of the free list
+    void**    free; // stack of free objects
+    int      nfree;
+    void**   young; // objects handed out since the last collection
+    int     nyoung;
+    int     freesz; // size of both, bounding nfree + nyoung
+    struct Block* sweepBlock; // where a full collection's sweep goes on
+    int      sweepElem;
 };
 
 void naFree(void* m);
@@ -215,9 +243,13 @@ struct naObj** naGC_get(struct naPool* p, int n, int* nout);
 void naGC_swapfree(void** target, void* val);
 void naGC_freedead();
 void naiGCMark(naRef r);
-void naiGCMarkHash(naRef h);
+int naiGCMarkHash(naRef h, int from, int n);
+void naiGCRemember(struct naObj* o);
+void naiGCShade(naRef r);
+void naiGCRescan(struct naObj* o);
 
 void naStr_gcclean(struct naStr* s);
+void naStr_gcflush(void);
 void naVec_gcclean(struct naVec* s);
 void naiGCHashClean(struct naHash* h);
 
@@ -1,11 +1,36 @@
+#include <string.h>
+
 #include "nasal.h"
 #include "data.h"
 #include "code.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 #define MIN_BLOCK_SIZE 32
 
-static void reap(struct naPool* p);
+// Slots of a vector or hash scanned at once; larger ones are scanned
+// in pieces, so naGCStep() can stop in the middle of them
+#define SCAN_CHUNK 1024
+
+// Slots scanned between looks at the clock in naGCStep()
+#define STEP_CHECK_INTERVAL 4096
+
+// Remembered objects which make the next allocation collect
+#define MAX_REMEMBERED 100000
+
+// A full collection is due once this many objects, plus half the old
+// generation, have been promoted since the last one
+#define MIN_MAJOR_PROMOTED 10000
+
 static void mark(naRef r);
+static void flushMemberCaches();
+static void freeelem(struct naPool* p, struct naObj* o);
+static void newBlock(struct naPool* p, int need);
+static int poolsize(struct naPool* p);
 
 struct Block {
     int   size;
@@ -13,6 +38,70 @@ struct Block {
     struct Block* next;
 };
 
+// The write barriers remember objects without the lock
+#ifdef _WIN32
+# define CAS8(p, old, val) \
+    (_InterlockedCompareExchange8((volatile char*)(p), (val), (old)) == (old))
+# define ATOMIC_ADD(p, n) InterlockedExchangeAdd((volatile LONG*)(p), (n))
+# define BARRIER() MemoryBarrier()
+#else
+# define CAS8(p, old, val) __sync_bool_compare_and_swap((p), (old), (val))
+# define ATOMIC_ADD(p, n) __sync_fetch_and_add((p), (n))
+# define BARRIER() __sync_synchronize()
+#endif
+
+// Monotonic clock in milliseconds, for the pause statistics
+static double gcTime()
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return 1000.0 * (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000.0 * ts.tv_sec + ts.tv_nsec / 1000000.0;
+#endif
+}
+
+// Doubles the size of a growable array of n elements
+static void* grow(void* array, int n, int* sz, int elemsz)
+{
+    int newsz = *sz ? 2 * *sz : 1024;
+    char* a = naAlloc(newsz * elemsz);
+    if(n) memcpy(a, array, n * elemsz);
+    naFree(array);
+    *sz = newsz;
+    return a;
+}
+
+static void pushgray(struct naObj* o, int next)
+{
+    struct Globals* g = globals;
+    if(g->ngray >= g->graysz)
+        g->grayStack = grow(g->grayStack, g->ngray, &g->graysz,
+                            sizeof(struct GCSlot));
+    g->grayStack[g->ngray].obj = o;
+    g->grayStack[g->ngray].index = next;
+    g->ngray++;
+}
+
+// Queues the rest of a partly scanned container underneath the
+// children just pushed from it (which sit above "base"), so they are
+// scanned first and the gray stack stays short.
+static void requeue(struct naObj* o, int next, int base)
+{
+    struct GCSlot* s;
+    pushgray(o, next);
+    s = globals->grayStack;
+    if(base < globals->ngray - 1) {
+        struct GCSlot tmp = s[base];
+        s[base] = s[globals->ngray - 1];
+        s[globals->ngray - 1] = tmp;
+    }
+}
+
 // Must be called with the giant exclusive lock!
 static void freeDead()
 {
@@ -20,6 +109,7 @@ static void freeDead()
     for(i=0; i<globals->ndead; i++)
         naFree(globals->deadBlocks[i]);
     globals->ndead = 0;
+    naStr_gcflush();
 }
 
 static void marktemps(struct Context* c)
@@ -32,16 +122,11 @@ static void marktemps(struct Context* c)
     }
 }
 
-// Must be called with the big lock!
-static void garbageCollect()
+static void markroots()
 {
     int i;
-    struct Context* c;
-    globals->allocCount = 0;
-    c = globals->allContexts;
+    struct Context* c = globals->allContexts;
     while(c) {
-        for(i=0; i<NUM_NASAL_TYPES; i++)
-            c->nfree[i] = 0;
         for(i=0; i < c->fTop; i++) {
             mark(c->fStack[i].func);
             mark(c->fStack[i].locals);
@@ -59,22 +144,345 @@ static void garbageCollect()
     mark(globals->meRef);
     mark(globals->argRef);
     mark(globals->parentsRef);
+}
+
+static int markvec(struct naVec* v, int from)
+{
+    int i, end, base = globals->ngray;
+    struct VecRec* vr = v->rec;
+    if(!vr || from >= vr->size) return 0;
+    end = from + SCAN_CHUNK < vr->size ? from + SCAN_CHUNK : vr->size;
+    for(i=from; i<end; i++)
+        mark(vr->array[i]);
+    if(end < vr->size)
+        requeue((struct naObj*)v, end, base);
+    return end - from;
+}
+
+static int markhash(naRef r, int from)
+{
+    int base = globals->ngray;
+    int next = naiGCMarkHash(r, from, SCAN_CHUNK);
+    if(next >= 0)
+        requeue(PTR(r).obj, next, base);
+    return SCAN_CHUNK;
+}
+
+// Marks everything an object references (or the next piece of a
+// large container), returning roughly how much work that was
+static int scan(struct naObj* o, int from)
+{
+    int i;
+    naRef r = naNil();
+    SETPTR(r, o);
+    switch(o->type) {
+    case T_VEC: return markvec(PTR(r).vec, from);
+    case T_HASH: return markhash(r, from);
+    case T_CODE:
+        mark(PTR(r).code->srcFile);
+        for(i=0; i<PTR(r).code->nConstants; i++)
+            mark(PTR(r).code->constants[i]);
+        return PTR(r).code->nConstants;
+    case T_FUNC:
+        mark(PTR(r).func->code);
+        mark(PTR(r).func->namespace);
+        mark(PTR(r).func->next);
+        break;
+    case T_GHOST:
+        mark(PTR(r).ghost->data);
+        break;
+    }
+    return 1;
+}
+
+// Empties the remembered set, clearing the remembered bits.  A young
+// collection scans the objects, as whatever young ones they refer to
+// are live as far as it knows.
+static void takeRemembered(int scan)
+{
+    struct Globals* g = globals;
+    int i, k, n = g->nremembered, size = REMEMBER_CHUNK;
+    for(k=0; n > 0; k++, n -= size, size *= 2)
+        for(i=0; i < n && i < size; i++) {
+            struct naObj* o = g->remembered[k][i];
+            o->mark &= ~GC_REMEMBERED;
+            if(scan) pushgray(o, 0);
+        }
+    g->nremembered = 0;
+}
+
+// Scans gray objects until there are none left (returning 1), or the
+// clock passes a positive deadline (returning 0).
+static int drain(double deadline)
+{
+    int work = 0;
+    while(globals->ngray) {
+        struct GCSlot g = globals->grayStack[--globals->ngray];
+        work += scan(g.obj, g.index);
+        if(deadline > 0 && work >= STEP_CHECK_INTERVAL) {
+            work = 0;
+            if(gcTime() > deadline)
+                return 0;
+        }
+    }
+    return 1;
+}
 
-    // Finally collect all the freed objects
-    for(i=0; i<NUM_NASAL_TYPES; i++)
-        reap(&(globals->pools[i]));
+static void resetContextCaches()
+{
+    int i;
+    struct Context* c;
+    for(c = globals->allContexts; c; c = c->nextAll)
+        for(i=0; i<NUM_NASAL_TYPES; i++)
+            c->nfree[i] = 0;
+}
+
+// Sizes the free and young lists of a pool of "total" objects for the
+// next cycle.  They bound what can be handed out until the next
+// collection (see naGC_get()).
+static void resizeLists(struct naPool* p, int total)
+{
+    int freesz = total < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : total;
+    freesz = (3 * freesz / 2) + (globals->nThreads * OBJ_CACHE_SZ);
+    if(p->freesz < freesz) {
+        void** f = naAlloc(sizeof(void*) * freesz);
+        void** y = naAlloc(sizeof(void*) * freesz);
+        if(p->nfree) memcpy(f, p->free, sizeof(void*) * p->nfree);
+        if(p->nyoung) memcpy(y, p->young, sizeof(void*) * p->nyoung);
+        naFree(p->free);
+        naFree(p->young);
+        p->free = f;
+        p->young = y;
+        p->freesz = freesz;
+    }
+}
+
+// Ends a collection: counts what survived, and makes room for the
+// allocations until the next one.
+static void finishPools()
+{
+    int i, young = 0;
+    struct Globals* g = globals;
+    g->allocCount = 0;
+    g->stats.liveObjects = 0;
+    for(i=0; i<NUM_NASAL_TYPES; i++) {
+        struct naPool* p = &g->pools[i];
+        int total = poolsize(p);
+        resizeLists(p, total);
+        g->stats.liveObjects += total - p->nfree;
+        young += p->nyoung;
+
+        // allocs of this type until the next collection
+        g->allocCount += total/2;
+
+        // Allocate more if necessary (try to keep 25-50% of the objects
+        // available)
+        if(p->nfree < total/4) {
+            int need = (total - p->nfree)/2 - p->nfree;
+            if(need > 0)
+                newBlock(p, need);
+        }
+    }
+    g->stats.oldObjects = g->stats.liveObjects - young;
 
     // Make enough space for the dead blocks we need to free during
     // execution.  This works out to 1 spot for every 2 live objects,
     // which should be limit the number of bottleneck operations
     // without imposing an undue burden of extra "freeable" memory.
-    if(globals->deadsz < globals->allocCount) {
-        globals->deadsz = globals->allocCount;
-        if(globals->deadsz < 256) globals->deadsz = 256;
-        naFree(globals->deadBlocks);
-        globals->deadBlocks = naAlloc(sizeof(void*) * globals->deadsz);
+    if(g->deadsz < g->allocCount) {
+        g->deadsz = g->allocCount;
+        if(g->deadsz < 256) g->deadsz = 256;
+        naFree(g->deadBlocks);
+        g->deadBlocks = naAlloc(sizeof(void*) * g->deadsz);
+    }
+}
+
+// A young collection only looks at the objects handed out since the
+// last collection: the unmarked ones are freed, the others promoted.
+static void collectYoung()
+{
+    int i, j;
+    struct Globals* g = globals;
+    markroots();
+    takeRemembered(1);
+    drain(0);
+    flushMemberCaches();
+    resetContextCaches();
+    for(i=0; i<NUM_NASAL_TYPES; i++) {
+        struct naPool* p = &g->pools[i];
+        for(j=0; j<p->nyoung; j++) {
+            struct naObj* o = p->young[j];
+            if(o->mark & GC_MARK) {
+                o->mark = GC_OLD;
+                g->promoted++;
+            } else {
+                freeelem(p, o);
+            }
+        }
+        p->nyoung = 0;
+    }
+    finishPools();
+    g->stats.minorCollections++;
+}
+
+static int majorDue()
+{
+    return globals->promoted > globals->oldCount/2 + MIN_MAJOR_PROMOTED;
+}
+
+// Marking is done, so everything is either marked or garbage.  The
+// free lists are emptied, for the sweep to refill a piece at a time,
+// and what refers to the garbage goes first.  Objects handed out from
+// here on come from the swept part of the heap.
+static void startSweep()
+{
+    int i;
+    struct Globals* g = globals;
+    flushMemberCaches();
+    takeRemembered(0);
+    resetContextCaches();
+    g->allocCount = 0;
+    for(i=0; i<NUM_NASAL_TYPES; i++) {
+        struct naPool* p = &g->pools[i];
+        int total = poolsize(p);
+        p->nfree = p->nyoung = 0;
+        resizeLists(p, total);
+        g->allocCount += total/2;
+    }
+    g->gcMarking = 0;
+    g->gcSweeping = 1;
+    g->sweepPool = 0;
+    for(i=0; i<NUM_NASAL_TYPES; i++) {
+        g->pools[i].sweepBlock = g->pools[i].blocks;
+        g->pools[i].sweepElem = 0;
+    }
+}
+
+// Sweeps on from where the last call for the pool stopped, freeing the
+// unmarked objects and promoting the others.  Blocks added since the
+// sweep began are left alone.  Returns 1 once the pool is swept, or 0
+// when the clock passes a positive deadline, or when the pool has
+// "want" free objects.
+static int sweepPool(struct naPool* p, double deadline, int want)
+{
+    int work = 0;
+    struct Block* b;
+    while((b = p->sweepBlock)) {
+        for(; p->sweepElem < b->size; p->sweepElem++) {
+            struct naObj* o;
+            if(want && p->nfree >= want)
+                return 0;
+            if(deadline > 0 && ++work >= STEP_CHECK_INTERVAL) {
+                work = 0;
+                if(gcTime() > deadline)
+                    return 0;
+            }
+            o = (struct naObj*)(b->block + p->sweepElem * p->elemsz);
+            // Keep the bit of objects remembered since the sweep began
+            if(o->mark & GC_MARK) o->mark = GC_OLD | (o->mark & GC_REMEMBERED);
+            else freeelem(p, o);
+        }
+        p->sweepBlock = b->next;
+        p->sweepElem = 0;
+    }
+    return 1;
+}
+
+// Sweeps the pools in turn.  Returns 1 once the whole heap is swept.
+static int sweep(double deadline)
+{
+    struct Globals* g = globals;
+    for(; g->sweepPool < NUM_NASAL_TYPES; g->sweepPool++)
+        if(!sweepPool(&g->pools[g->sweepPool], deadline, 0))
+            return 0;
+    return 1;
+}
+
+static void endMajor()
+{
+    struct Globals* g = globals;
+    g->gcSweeping = 0;
+    g->gcMajor = 0;
+    finishPools();
+    g->oldCount = g->stats.oldObjects;
+    g->promoted = 0;
+    g->stats.majorCollections++;
+}
+
+// Completes a full collection, from whatever phase it is in
+static void finishMajor()
+{
+    if(!globals->gcSweeping) {
+        drain(0);
+        startSweep();
+    }
+    sweep(0);
+    endMajor();
+}
+
+static void recordPause(double start)
+{
+    naGCStats* s = &globals->stats;
+    s->lastPause = gcTime() - start;
+    s->totalPause += s->lastPause;
+    if(s->lastPause > s->maxPause) s->maxPause = s->lastPause;
+}
+
+// A pool ran out of free objects before the sweep got to it: it is
+// swept ahead, just far enough to go on for a while.  Whatever is left
+// waits for the next slice.
+static void sweepDry()
+{
+    double start = gcTime();
+    struct naPool* p = globals->dryPool;
+    sweepPool(p, 0, poolsize(p)/8);
+    recordPause(start);
+}
+
+// Must be called with the big lock!  Usually only the young objects
+// are collected: the old ones are treated as live, and the remembered
+// set supplies the young objects they reference.  Full collections
+// happen when asked for, when the old generation has grown enough
+// (unless naGCStep() handles that), or when an incremental one is
+// still running.
+static void garbageCollect()
+{
+    double start = gcTime();
+    if(globals->gcMarking || globals->gcSweeping) {
+        finishMajor();
+    } else if(globals->fullGC || (!globals->incremental && majorDue())) {
+        globals->gcMajor = 1;
+        markroots();
+        finishMajor();
+    } else {
+        collectYoung();
     }
+    globals->fullGC = 0;
     globals->needGC = 0;
+    recordPause(start);
+}
+
+// One time-limited slice of an incremental full collection.  The
+// roots are marked when it starts; after that, the barriers keep
+// everything reachable at that point from being missed (see
+// GC_SHADE), so finishing needs no rescan.  The sweep which follows
+// is done in slices as well.
+static void gcStep()
+{
+    double start = gcTime();
+    double deadline = start + globals->stepBudget;
+    globals->needStep = 0;
+    if(!globals->gcMarking && !globals->gcSweeping) {
+        if(!majorDue()) return;
+        globals->gcMarking = globals->gcMajor = 1;
+        markroots();
+    }
+    if(globals->gcMarking && drain(deadline))
+        startSweep();
+    if(globals->gcSweeping && sweep(deadline))
+        endMajor();
+    globals->stats.incrementalSteps++;
+    recordPause(start);
 }
 
 void naModLock()
@@ -113,7 +521,14 @@ static void bottleneck()
     }
     if(g->waitCount >= g->nThreads - 1) {
         freeDead();
-        if(g->needGC) garbageCollect();
+        if(g->needGC) {
+            garbageCollect();
+        } else {
+            if(g->dryPool) sweepDry();
+            if(g->needStep) gcStep();
+        }
+        g->needStep = 0;
+        g->dryPool = 0;
         if(g->waitCount) naSemUp(g->sem, g->waitCount);
         g->bottleneck = 0;
     }
@@ -123,11 +538,98 @@ void naGC()
 {
     LOCK();
     globals->needGC = 1;
+    globals->fullGC = 1;
     bottleneck();
     UNLOCK();
     naCheckBottleneck();
 }
 
+void naGCSetIncremental(int enable)
+{
+    LOCK();
+    globals->incremental = enable;
+    UNLOCK();
+}
+
+void naGCStep(double budgetMsec)
+{
+    LOCK();
+    if(globals->gcMarking || globals->gcSweeping || majorDue()) {
+        globals->stepBudget = budgetMsec;
+        globals->needStep = 1;
+        bottleneck();
+    }
+    UNLOCK();
+    naCheckBottleneck();
+}
+
+void naGCGetStats(naGCStats* stats)
+{
+    LOCK();
+    *stats = globals->stats;
+    UNLOCK();
+}
+
+void naGCResetStats()
+{
+    LOCK();
+    globals->stats.minorCollections = 0;
+    globals->stats.majorCollections = 0;
+    globals->stats.incrementalSteps = 0;
+    globals->stats.lastPause = 0;
+    globals->stats.maxPause = 0;
+    globals->stats.totalPause = 0;
+    UNLOCK();
+}
+
+// Slot n of the remembered set, allocating its chunk if need be
+static struct naObj** rememberSlot(struct Globals* g, int n)
+{
+    int k = 0, size = REMEMBER_CHUNK;
+    struct naObj** volatile* chunk;
+    while(n >= size) { n -= size; size *= 2; k++; }
+    chunk = (struct naObj** volatile*)&g->remembered[k];
+    if(!*chunk) {
+        LOCK();
+        if(!*chunk) {
+            struct naObj** a = naAlloc(sizeof(struct naObj*) * size);
+            BARRIER();
+            *chunk = a;
+        }
+        UNLOCK();
+    }
+    return &(*chunk)[n];
+}
+
+// Called by GC_WRITE_BARRIER() when a young object is first stored
+// into an old one since the last collection.  The remembered bit is
+// set atomically, as other threads may be storing into the same object
+// or shading it, so just one of them adds it to the remembered set.
+void naiGCRemember(struct naObj* o)
+{
+    struct Globals* g = globals;
+    unsigned char m;
+    do {
+        m = o->mark;
+        if(m & GC_REMEMBERED) return;
+    } while(!CAS8(&o->mark, m, m | GC_REMEMBERED));
+    *rememberSlot(g, ATOMIC_ADD(&g->nremembered, 1)) = o;
+}
+
+void naiGCShade(naRef r)
+{
+    LOCK();
+    if(globals->gcMarking) mark(r);
+    UNLOCK();
+}
+
+void naiGCRescan(struct naObj* o)
+{
+    LOCK();
+    if(globals->gcMarking && (o->mark & GC_MARK)) pushgray(o, 0);
+    UNLOCK();
+}
+
 void naCheckBottleneck()
 {
     if(globals->bottleneck) { LOCK(); bottleneck(); UNLOCK(); }
@@ -135,7 +637,11 @@ void naCheckBottleneck()
 
 static void naCode_gcclean(struct naCode* o)
 {
+    int i;
     naFree(o->constants);  o->constants = 0;
+    for(i=0; o->memberCaches && i<o->nMemberCaches; i++)
+        naFree(o->memberCaches[i].entry);
+    naFree(o->memberCaches);  o->memberCaches = 0;
 }
 
 static void naCCode_gcclean(struct naCCode* c)
@@ -150,9 +656,10 @@ static void naGhost_gcclean(struct naGhost* g)
     g->ptr = 0;
 }
 
-static void freeelem(struct naPool* p, struct naObj* o)
+// Cleans up any intrinsic storage the object might have.  Safe to
+// repeat on a free object.
+static void cleanelem(struct naPool* p, struct naObj* o)
 {
-    // Clean up any intrinsic storage the object might have...
     switch(p->type) {
     case T_STR:   naStr_gcclean  ((struct naStr*)  o); break;
     case T_VEC:   naVec_gcclean  ((struct naVec*)  o); break;
@@ -161,9 +668,18 @@ static void freeelem(struct naPool* p, struct naObj* o)
     case T_CCODE: naCCode_gcclean((struct naCCode*)o); break;
     case T_GHOST: naGhost_gcclean((struct naGhost*)o); break;
     }
+}
+
+static void freeelem(struct naPool* p, struct naObj* o)
+{
+    cleanelem(p, o);
+    o->mark = 0;
     p->free[p->nfree++] = o;  // ...and add it to the free list
 }
 
+// Adds a block of at least "need" objects to the pool.  Those which
+// don't fit on the free list (see resizeLists()) are left for the next
+// full collection to find.
 static void newBlock(struct naPool* p, int need)
 {
     int i;
@@ -178,15 +694,49 @@ static void newBlock(struct naPool* p, int need)
     p->blocks = newb;
     naBZero(newb->block, need * p->elemsz);
 
-    if(need > p->freesz - p->freetop) need = p->freesz - p->freetop;
-    p->nfree = 0;
-    p->free = p->free0 + p->freetop;
+    if(need > p->freesz - p->nfree - p->nyoung)
+        need = p->freesz - p->nfree - p->nyoung;
     for(i=0; i < need; i++) {
         struct naObj* o = (struct naObj*)(newb->block + i*p->elemsz);
         o->mark = 0;
         p->free[p->nfree++] = o;
     }
-    p->freetop += need;
+}
+
+// Frees the calling thread's isolate heap, and everything in it
+void naiFreeHeap()
+{
+    int i, elem;
+    struct Globals* g = nasal_heap;
+    struct Context* c;
+    freeDead();
+    for(i=0; i<NUM_NASAL_TYPES; i++) {
+        struct naPool* p = &g->pools[i];
+        while(p->blocks) {
+            struct Block* b = p->blocks;
+            for(elem=0; elem < b->size; elem++)
+                cleanelem(p, (struct naObj*)(b->block + elem * p->elemsz));
+            p->blocks = b->next;
+            naFree(b->block);
+            naFree(b);
+        }
+        naFree(p->free);
+        naFree(p->young);
+    }
+    while((c = g->allContexts)) {
+        g->allContexts = c->nextAll;
+        naFree(c->temps);
+        naFree(c);
+    }
+    naFree(g->grayStack);
+    for(i=0; i<REMEMBER_CHUNKS; i++)
+        naFree(g->remembered[i]);
+    naFree(g->cacheFills);
+    naFree(g->deadBlocks);
+    naFreeSem(g->sem);
+    naFreeLock(g->lock);
+    naFree(g);
+    nasal_heap = 0;
 }
 
 void naGC_init(struct naPool* p, int type)
@@ -195,9 +745,11 @@ void naGC_init(struct naPool* p, int type)
     p->elemsz = naTypeSize(type);
     p->blocks = 0;
 
-    p->free0 = p->free = 0;
-    p->nfree = p->freesz = p->freetop = 0;
-    reap(p);
+    p->free = p->young = 0;
+    p->nfree = p->nyoung = p->freesz = 0;
+    p->sweepBlock = 0;
+    p->sweepElem = 0;
+    resizeLists(p, 0);
 }
 
 static int poolsize(struct naPool* p)
@@ -208,13 +760,23 @@ static int poolsize(struct naPool* p)
     return total;
 }
 
+// Hands out up to n objects, from the young list: unlike the free
+// list, nothing there moves until the next collection.  While a full
+// collection is sweeping, running out of free objects sweeps the pool
+// (see sweepDry()).
 struct naObj** naGC_get(struct naPool* p, int n, int* nout)
 {
     struct naObj** result;
     naCheckBottleneck();
     LOCK();
-    while(globals->allocCount < 0 || (p->nfree == 0 && p->freetop >= p->freesz)) {
-        globals->needGC = 1;
+    while(1) {
+        if(globals->allocCount < 0 || globals->nremembered >= MAX_REMEMBERED
+           || (p->nfree == 0 && p->nyoung >= p->freesz))
+            globals->needGC = 1;
+        else if(p->nfree == 0 && p->sweepBlock)
+            globals->dryPool = p;
+        else
+            break;
         bottleneck();
     }
     if(p->nfree == 0)
@@ -223,50 +785,32 @@ struct naObj** naGC_get(struct naPool* p, int n, int* nout)
     *nout = n;
     p->nfree -= n;
     globals->allocCount -= n;
-    result = (struct naObj**)(p->free + p->nfree);
+    result = (struct naObj**)(p->young + p->nyoung);
+    memcpy(result, p->free + p->nfree, sizeof(void*) * n);
+    p->nyoung += n;
     UNLOCK();
     return result;
 }
 
-static void markvec(naRef r)
-{
-    int i;
-    struct VecRec* vr = PTR(r).vec->rec;
-    if(!vr) return;
-    for(i=0; i<vr->size; i++)
-        mark(vr->array[i]);
-}
-
-// Sets the reference bit on the object, and recursively on all
-// objects reachable from it.  Uses the processor stack for recursion...
+// Marks an object reachable.  Objects which reference others are
+// queued to be scanned later, rather than recursing.  Young
+// collections stop at old objects.
 static void mark(naRef r)
 {
-    int i;
+    struct naObj* o;
 
     if(IS_NUM(r) || IS_NIL(r))
         return;
 
-    if(PTR(r).obj->mark == 1)
+    o = PTR(r).obj;
+    if(o->mark & GC_MARK)
+        return;
+    if((o->mark & GC_OLD) && !globals->gcMajor)
         return;
 
-    PTR(r).obj->mark = 1;
-    switch(PTR(r).obj->type) {
-    case T_VEC: markvec(r); break;
-    case T_HASH: naiGCMarkHash(r); break;
-    case T_CODE:
-        mark(PTR(r).code->srcFile);
-        for(i=0; i<PTR(r).code->nConstants; i++)
-            mark(PTR(r).code->constants[i]);
-        break;
-    case T_FUNC:
-        mark(PTR(r).func->code);
-        mark(PTR(r).func->namespace);
-        mark(PTR(r).func->next);
-        break;
-    case T_GHOST:
-        mark(PTR(r).ghost->data);
-        break;
-    }
+    o->mark |= GC_MARK;
+    if(o->type != T_STR && o->type != T_CCODE)
+        pushgray(o, 0);
 }
 
 void naiGCMark(naRef r)
@@ -274,51 +818,71 @@ void naiGCMark(naRef r)
     mark(r);
 }
 
-// Collects all the unreachable objects into a free list, and
-// allocates more space if needed.
-static void reap(struct naPool* p)
+// Whether the sweep which follows frees an object
+static int dying(void* p)
 {
-    struct Block* b;
-    int elem, freesz, total = poolsize(p);
-    freesz = total < MIN_BLOCK_SIZE ? MIN_BLOCK_SIZE : total;
-    freesz = (3 * freesz / 2) + (globals->nThreads * OBJ_CACHE_SZ);
-    if(p->freesz < freesz) {
-        naFree(p->free0);
-        p->freesz = freesz;
-        p->free = p->free0 = naAlloc(sizeof(void*) * p->freesz);
-    }
-
-    p->nfree = 0;
-    p->free = p->free0;
-
-    for(b = p->blocks; b; b = b->next)
-        for(elem=0; elem < b->size; elem++) {
-            struct naObj* o = (struct naObj*)(b->block + elem * p->elemsz);
-            if(o->mark == 0)
-                freeelem(p, o);
-            o->mark = 0;
-        }
+    struct naObj* o = p;
+    if(o->mark & GC_MARK) return 0;
+    return !(o->mark & GC_OLD) || globals->gcMajor;
+}
 
-    p->freetop = p->nfree;
+static int entryDying(struct MemberCacheEntry* e)
+{
+    int i;
+    if(!IS_NUM(e->value) && !IS_NIL(e->value) && dying(PTR(e->value).obj))
+        return 1;
+    for(i=0; i<e->depth; i++)
+        if(dying(e->path[i].hash) || dying(e->path[i].parents))
+            return 1;
+    return dying(e->path[i].hash);
+}
 
-    // allocs of this type until the next collection
-    globals->allocCount += total/2;
+static void flushMemberCache(struct MemberCache* mc)
+{
+    if(mc->entry && entryDying(mc->entry)) {
+        naFree(mc->entry);
+        mc->entry = 0;
+    }
+    mc->misses = 0;
+}
 
-    // Allocate more if necessary (try to keep 25-50% of the objects
-    // available)
-    if(p->nfree < total/4) {
-        int used = total - p->nfree;
-        int avail = total - used;
-        int need = used/2 - avail;
-        if(need > 0)
-            newBlock(p, need);
+// Member cache entries don't keep what they refer to alive, so they
+// must go with it: a new object at the same address could pass for
+// the old one.  Sites which stopped refilling get another chance.
+// The old generation only dies in full collections, and only the
+// entries made since the last collection can refer to young objects,
+// so young collections look at just those.
+static void flushMemberCaches()
+{
+    struct Globals* g = globals;
+    struct naPool* p = &g->pools[T_CODE];
+    struct Block* b;
+    int elem, i;
+    if(g->gcMajor) {
+        for(b = p->blocks; b; b = b->next)
+            for(elem=0; elem < b->size; elem++) {
+                struct naCode* c =
+                    (struct naCode*)(b->block + elem * p->elemsz);
+                if(dying(c) || !c->memberCaches) continue;
+                for(i=0; i<c->nMemberCaches; i++)
+                    flushMemberCache(&c->memberCaches[i]);
+            }
+    } else {
+        for(i=0; i<g->nfills; i++) {
+            struct CacheFill* f = &g->cacheFills[i];
+            if(!dying(f->code))
+                flushMemberCache(&f->code->memberCaches[f->index]);
+        }
     }
+    g->nfills = 0;
 }
 
-// Does the swap, returning the old value
+// Does the swap, returning the old value.  Whatever val points to
+// must be written before other threads can see it there.
 static void* doswap(void** target, void* val)
 {
     void* old = *target;
+    BARRIER();
     *target = val;
     return old;
 }
@@ -336,3 +900,23 @@ void naGC_swapfree(void** target, void* val)
     globals->deadBlocks[globals->ndead++] = old;
     UNLOCK();
 }
+
+void naiGCSetMemberCache(struct naCode* code, int i,
+                         struct MemberCacheEntry* e)
+{
+    struct Globals* g;
+    void* old;
+    LOCK();
+    g = globals;
+    if(g->nfills >= g->fillsz)
+        g->cacheFills = grow(g->cacheFills, g->nfills, &g->fillsz,
+                             sizeof(struct CacheFill));
+    g->cacheFills[g->nfills].code = code;
+    g->cacheFills[g->nfills].index = i;
+    g->nfills++;
+    old = doswap((void**)&code->memberCaches[i].entry, e);
+    while(g->ndead >= g->deadsz)
+        bottleneck();
+    g->deadBlocks[g->ndead++] = old;
+    UNLOCK();
+}
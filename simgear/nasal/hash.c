@@ -1,6 +1,7 @@
 #include <string.h>
 #include "nasal.h"
 #include "data.h"
+#include "code.h"
 
 /* A HashRec lives in a single allocated block.  The layout is the
  * header struct, then a table of 2^lgsz hash entries (key/value
@@ -54,7 +55,7 @@ static unsigned int refhash(naRef key)
     if(IS_STR(key)) {
         struct naStr* s = PTR(key).str;
         if(s->hashcode) return s->hashcode;
-        return s->hashcode = hash32((void*)naStr_data(key), naStr_len(key));
+        return s->hashcode = hash32((const unsigned char*)naStr_cdata(key), naStr_len(key));
     } else { /* must be a number */
         union { double d; unsigned int u[2]; } n;
         n.d = key.num == -0.0 ? 0.0 : key.num; /* remember negative zero! */ 
@@ -67,7 +68,7 @@ static int equal(naRef a, naRef b)
     if(IS_NUM(a)) return a.num == b.num;
     if(PTR(a).obj == PTR(b).obj) return 1;
     if(naStr_len(a) != naStr_len(b)) return 0;
-    return memcmp(naStr_data(a), naStr_data(b), naStr_len(a)) == 0;
+    return memcmp(naStr_cdata(a), naStr_cdata(b), naStr_len(a)) == 0;
 }
 
 /* Returns the index of a cell that either contains a matching key, or
@@ -81,17 +82,21 @@ static int findcell(struct HashRec *hr, naRef key, unsigned int hash)
     return i;
 }
 
-static void hashset(HashRec* hr, naRef key, naRef val)
+/* Returns the entry used, or -1 if there was no room */
+static int hashset(HashRec* hr, naRef key, naRef val)
 {
     int ent, cell = findcell(hr, key, refhash(key));
     if((ent = TAB(hr)[cell]) == ENT_EMPTY) {
         ent = hr->next++;
-        if(ent >= NCELLS(hr)) return; /* race protection, don't overrun */
+        if(ent >= NCELLS(hr)) return -1; /* race protection, don't overrun */
         TAB(hr)[cell] = ent;
         hr->size++;
         ENTS(hr)[ent].key = key;
+    } else {
+        GC_SHADE(ENTS(hr)[ent].val);
     }
     ENTS(hr)[ent].val = val;
+    return ent;
 }
 
 static int recsize(int lgsz)
@@ -118,6 +123,8 @@ static HashRec* resize(struct naHash* hash)
         if(TAB(hr)[i] >= 0)
             hashset(hr2, ENTS(hr)[TAB(hr)[i]].key, ENTS(hr)[TAB(hr)[i]].val);
     naGC_swapfree((void*)&hash->rec, hr2);
+    GC_WRITE_BARRIER_ALL(hash);
+    GC_RESCAN(hash);
     return hr2;
 }
 
@@ -137,10 +144,16 @@ int naHash_get(naRef hash, naRef key, naRef* out)
 
 void naHash_set(naRef hash, naRef key, naRef val)
 {
+    int ent;
     HashRec* hr = REC(hash);
     if(!hr || hr->next >= POW2(hr->lgsz))
         hr = resize(PTR(hash).hash);
-    hashset(hr, key, val);
+    ent = hashset(hr, key, val);
+    HASH_CHANGED(PTR(hash).hash);
+    if(ent >= 0) {
+        GC_WRITE_BARRIER(PTR(hash).hash, key);
+        GC_WRITE_BARRIER(PTR(hash).hash, val);
+    }
 }
 
 void naHash_delete(naRef hash, naRef key)
@@ -149,7 +162,10 @@ void naHash_delete(naRef hash, naRef key)
     if(hr) {
         int cell = findcell(hr, key, refhash(key));
         if(TAB(hr)[cell] >= 0) {
+            GC_SHADE(ENTS(hr)[TAB(hr)[cell]].key);
+            GC_SHADE(ENTS(hr)[TAB(hr)[cell]].val);
             TAB(hr)[cell] = ENT_DELETED;
+            HASH_CHANGED(PTR(hash).hash);
             if(--hr->size < POW2(hr->lgsz-1))
                 resize(PTR(hash).hash);
         }
@@ -165,15 +181,20 @@ void naHash_keys(naRef dst, naRef hash)
             naVec_append(dst, ENTS(hr)[TAB(hr)[i]].key);
 }
 
-void naiGCMarkHash(naRef hash)
+/* Marks the entries in n cells of the table, returning the next cell
+ * to look at or -1 if the table is done. */
+int naiGCMarkHash(naRef hash, int from, int n)
 {
-    int i;
+    int i, end;
     HashRec* hr = REC(hash);
-    for(i=0; hr && i < NCELLS(hr); i++)
+    if(!hr || from + n >= NCELLS(hr)) end = hr ? NCELLS(hr) : 0;
+    else end = from + n;
+    for(i=from; i < end; i++)
         if(TAB(hr)[i] >= 0) {
             naiGCMark(ENTS(hr)[TAB(hr)[i]].key);
             naiGCMark(ENTS(hr)[TAB(hr)[i]].val);
         }
+    return hr && end < NCELLS(hr) ? end : -1;
 }
 
 static void tmpStr(naRef* out, struct naStr* str, const char* key)
@@ -213,7 +234,13 @@ int naiHash_tryset(naRef hash, naRef key, naRef val)
     HashRec* hr = REC(hash);
     if(hr) {
         int ent, cell = findcell(hr, key, refhash(key));
-        if((ent = TAB(hr)[cell]) >= 0) { ENTS(hr)[ent].val = val; return 1; }
+        if((ent = TAB(hr)[cell]) >= 0) {
+            GC_SHADE(ENTS(hr)[ent].val);
+            ENTS(hr)[ent].val = val;
+            HASH_CHANGED(PTR(hash).hash);
+            GC_WRITE_BARRIER(PTR(hash).hash, val);
+            return 1;
+        }
     }
     return 0;
 }
@@ -268,5 +295,8 @@ void naiHash_newsym(struct naHash* hash, naRef* sym, naRef* val)
     hr->size++;
     ENTS(hr)[TAB(hr)[cell]].key = *sym;
     ENTS(hr)[TAB(hr)[cell]].val = *val;
+    HASH_CHANGED(hash);
+    GC_WRITE_BARRIER(hash, *sym);
+    GC_WRITE_BARRIER(hash, *val);
 }
 
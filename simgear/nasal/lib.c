@@ -26,6 +26,7 @@ static naRef f_size(naContext c, naRef me, int argc, naRef* args)
     if(naIsString(args[0])) return naNum(naStr_len(args[0]));
     if(naIsVector(args[0])) return naNum(naVec_size(args[0]));
     if(naIsHash(args[0])) return naNum(naHash_size(args[0]));
+    if(naIsNumVec(args[0])) return naNum(naNumVec_size(args[0]));
     naRuntimeError(c, "object has no size()");
     return naNil();
 }
@@ -560,8 +561,10 @@ static naRef f_sort(naContext c, naRef me, int argc, naRef* args)
           (int(*)(const void*,const void*))sortcmp);
     out = naNewVector(c);
     naVec_setsize(c, out, sd.n);
-    for(i=0; i<sd.n; i++)
+    for(i=0; i<sd.n; i++) {
         PTR(out).vec->rec->array[i] = sd.elems[sd.recs[i].i];
+        GC_WRITE_BARRIER(PTR(out).vec, PTR(out).vec->rec->array[i]);
+    }
     naFree(sd.recs);
     naFreeContext(sd.subc);
     return out;
@@ -67,9 +67,10 @@ naRef naNew(struct Context* c, int type)
 {
     naRef result;
     if(c->nfree[type] == 0)
-        c->free[type] = naGC_get(&globals->pools[type],
+        c->free[type] = naGC_get(&c->heap->pools[type],
                                  OBJ_CACHE_SZ, &c->nfree[type]);
     result = naObj(type, c->free[type][--c->nfree[type]]);
+    PTR(result).obj->mark = c->heap->gcMarking ? GC_MARK : 0;
     naTempSave(c, result);
     return result;
 }
@@ -87,6 +88,7 @@ naRef naNewString(struct Context* c)
 naRef naNewVector(struct Context* c)
 {
     naRef r = naNew(c, T_VEC);
+    PTR(r).vec->version = 0;
     PTR(r).vec->rec = 0;
     return r;
 }
@@ -94,6 +96,7 @@ naRef naNewVector(struct Context* c)
 naRef naNewHash(struct Context* c)
 {
     naRef r = naNew(c, T_HASH);
+    PTR(r).hash->version = 0;
     PTR(r).hash->rec = 0;
     return r;
 }
@@ -174,8 +177,11 @@ void* naGhost_ptr(naRef ghost)
 
 void naGhost_setData(naRef ghost, naRef data)
 {
-    if(IS_GHOST(ghost))
+    if(IS_GHOST(ghost)) {
+        GC_SHADE(PTR(ghost).ghost->data);
         PTR(ghost).ghost->data = data;
+        GC_WRITE_BARRIER(PTR(ghost).ghost, data);
+    }
 }
 
 naRef naGhost_data(naRef ghost)
@@ -223,11 +229,11 @@ int naEqual(naRef a, naRef b)
 int naStrEqual(naRef a, naRef b)
 {
     int i;
-    char *ap, *bp;
+    const char *ap, *bp;
     if(!IS_STR(a) || !IS_STR(b) || naStr_len(a) != naStr_len(b))
         return 0;
-    ap = naStr_data(a);
-    bp = naStr_data(b);
+    ap = naStr_cdata(a);
+    bp = naStr_cdata(b);
     for(i=0; i<naStr_len(a); i++)
         if(ap[i] != bp[i])
             return 0;
@@ -259,6 +265,9 @@ int naIsCode(naRef r)   { return IS_CODE(r); }
 int naIsCCode(naRef r)  { return IS_CCODE(r); }
 int naIsGhost(naRef r)  { return IS_GHOST(r); }
 int naIsIdentical(naRef l, naRef r) { return IDENTICAL(l, r); }
+const void* naObjectId(naRef r) { return IS_REF(r) ? PTR(r).obj : 0; }
+
+int naIsIsolate(void) { return nasal_heap != 0; }
 
 void naSetUserData(naContext c, void* p) { c->userData = p; }
 void* naGetUserData(naContext c)
@@ -45,6 +45,33 @@ void* naGetUserData(naContext c) GCC_PURE;
 // run GC now (may block)
 void naGC();
 
+// With incremental collection enabled, running out of memory only
+// triggers short collections of the young objects, and full
+// collections are left to naGCStep().
+void naGCSetIncremental(int enable);
+
+// Do a slice of a full collection, if one is due or in progress,
+// marking for roughly budgetMsec milliseconds at most (may block).
+// The slice which finishes marking also sweeps, which is not split
+// up.  Meant to be called once per frame.
+void naGCStep(double budgetMsec);
+
+// Collector statistics.  Pause times are in milliseconds and only
+// count the time the collector runs, not waiting for other threads.
+typedef struct {
+    int minorCollections; // young objects only
+    int majorCollections; // completed full collections
+    int incrementalSteps; // naGCStep() slices that did work
+    double lastPause;
+    double maxPause;
+    double totalPause;
+    int liveObjects; // after the last collection
+    int oldObjects;
+} naGCStats;
+
+void naGCGetStats(naGCStats* stats);
+void naGCResetStats();
+
 // "Save" this object in the context, preventing it (and objects
 // referenced by it) from being garbage collected.
 // TODO do we need a context? It is not used anyhow...
@@ -81,6 +108,20 @@ void naTempSave(naContext c, naRef r);
 naRef naParseCode(naContext c, naRef srcFile, int firstLine,
                   char* buf, int len, int* errLine);
 
+// Serializes a code object returned from naParseCode(), including
+// any functions defined within it, into a string.  Loading that with
+// naLoadCode() is much quicker than parsing the source again.
+naRef naSaveCode(naContext c, naRef code);
+
+// Recreates a code object from the output of naSaveCode(), as though
+// its source had been parsed with the specified srcFile.  Returns nil
+// if the data is corrupt, or was saved by an interpreter with a
+// different naCodeVersion().
+naRef naLoadCode(naContext c, naRef srcFile, const char* buf, int len);
+
+// Identifies the bytecode format used by naSaveCode()
+int naCodeVersion(void);
+
 // Binds a bare code object (as returned from naParseCode) with a
 // closure object (a hash) to act as the outer scope / namespace.
 naRef naBindFunction(naContext ctx, naRef code, naRef closure);
@@ -159,6 +200,7 @@ naRef naInit_regex(naContext c);
 naRef naInit_unix(naContext c);
 naRef naInit_thread(naContext c);
 naRef naInit_utf8(naContext c);
+naRef naInit_numvec(naContext c);
 naRef naInit_sqlite(naContext c);
 naRef naInit_readline(naContext c);
 naRef naInit_gtk(naContext ctx);
@@ -187,6 +229,12 @@ int naIsCCode(naRef r) GCC_PURE;
 // Object equality (check for same instance, aka. pointer equality)
 int naIsIdentical(naRef l, naRef r) GCC_PURE;
 
+// The instance a reference points to, as compared by naIsIdentical()
+// (null for numbers and nil).  Usable as a hash key: it is stable for
+// the lifetime of the object, and interned symbols of the main heap are
+// never freed.
+const void* naObjectId(naRef r) GCC_PURE;
+
 // Allocators/generators:
 naRef naNil() GCC_PURE;
 naRef naNum(double num) GCC_PURE;
@@ -217,11 +265,19 @@ naRef naStringValue(naContext c, naRef n);
 
 // String utilities:
 int naStr_len(naRef s) GCC_PURE;
-char* naStr_data(naRef s) GCC_PURE;
+char* naStr_data(naRef s);
+// The characters of s for reading only, without copying them out of a
+// buffer shared with other strings.  Not nul terminated, use naStr_len().
+const char* naStr_cdata(naRef s) GCC_PURE;
 naRef naStr_fromdata(naRef dst, const char* data, int len);
 naRef naStr_concat(naRef dest, naRef s1, naRef s2);
 naRef naStr_substr(naRef dest, naRef str, int start, int len);
 naRef naInternSymbol(naRef sym);
+
+// Whether the calling thread runs on an isolate heap (see newisolate() in
+// the thread library).  Its objects, interned symbols included, are freed
+// with the isolate.
+int naIsIsolate(void);
 naRef getStringMethods(naContext c);
 
 // Vector utilities:
@@ -297,6 +353,50 @@ void         naGhost_setData(naRef ghost, naRef data);
 naRef        naGhost_data(naRef ghost);
 int          naIsGhost(naRef r);
 
+// Packed numeric vectors: ghosts holding an array of doubles or
+// floats, unboxed.  Nasal code can index them, iterate over them
+// with foreach and get their size() like vectors; the bulk operations
+// are in the "numvec" library (naInit_numvec).  The get/set accessors
+// don't check their index.  naNewNumVec() raises a runtime error for a
+// negative size or one beyond NA_NUMVEC_MAX_SIZE.
+enum { NA_NUMVEC_DOUBLE, NA_NUMVEC_FLOAT };
+#define NA_NUMVEC_MAX_SIZE (1 << 26)
+naRef  naNewNumVec(naContext c, int type, int size);
+int    naIsNumVec(naRef r);
+int    naNumVec_type(naRef v);
+int    naNumVec_size(naRef v);
+void*  naNumVec_data(naRef v); // double* or float*, see naNumVec_type()
+double naNumVec_get(naRef v, int i);
+void   naNumVec_set(naRef v, int i, double val);
+
+// Sampling profiler.  While started, the call stack of running Nasal
+// code is sampled every "interval" loop iterations or function calls
+// (counted per context; 0 samples only on request), and whenever
+// naProfileSample() asks for one.  The stacks are kept as source file
+// and line per frame, in a buffer with room for bufsize frames in all
+// allocated up front: samples which don't fit are dropped, and
+// counted.  All threads and isolates are sampled together.
+// naProfileStart() discards earlier samples.
+void naProfileStart(int interval, int bufsize);
+void naProfileStop(void);
+
+// Asks for a sample at the next loop iteration or call of a running
+// thread.  Only sets a flag, so it is fine to call from a timer
+// thread or signal handler.
+void naProfileSample(void);
+
+// The number of samples recorded, and of those dropped
+int naProfileCount(int* dropped);
+
+// The samples as "folded stacks": one line per distinct stack, with
+// the frames ("file:line") from the outermost call in, separated by
+// semicolons, and the number of samples after a space.  This is the
+// input format of flamegraph.pl and similar tools.
+naRef naProfileFolded(naContext c);
+
+// Stops the profiler and frees the sample buffer
+void naProfileClear(void);
+
 // Acquires a "modification lock" on a context, allowing the C code to
 // modify Nasal data without fear that such data may be "lost" by the
 // garbage collector (nasal data on the C stack is not examined in
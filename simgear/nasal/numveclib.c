@@ -0,0 +1,428 @@
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "data.h"
+#include "code.h"
+
+/* Packed numeric vectors hold their elements unboxed, as one block of
+ * doubles or floats following a small header.  They are ghosts, so
+ * the collector never scans the elements.  The VM indexes them like
+ * vectors (containerGet() and friends in code.c); the library below
+ * does the bulk operations in C, four or two lanes at a time where
+ * SSE2 is available. */
+
+struct NumVec {
+    int type;
+    int size;
+    double data[1]; // size doubles, or size floats
+};
+
+#define NUMVEC(r) ((struct NumVec*)naGhost_ptr(r))
+#define DOUBLES(nv) ((nv)->data)
+#define FLOATS(nv) ((float*)(nv)->data)
+#define GET(nv, i) \
+    ((nv)->type == NA_NUMVEC_FLOAT ? FLOATS(nv)[i] : DOUBLES(nv)[i])
+
+static void numvecDestroy(void* nv)
+{
+    naFree(nv);
+}
+
+static naGhostType NumVecType = { numvecDestroy, "numvec" };
+
+naRef naNewNumVec(naContext c, int type, int size)
+{
+    size_t elemsz = type == NA_NUMVEC_FLOAT ? sizeof(float) : sizeof(double);
+    size_t sz;
+    struct NumVec* nv;
+    if(size < 0 || size > NA_NUMVEC_MAX_SIZE)
+        naRuntimeError(c, "numvec size %d out of range", size);
+    sz = offsetof(struct NumVec, data) + (size_t)size * elemsz;
+    if(sz < sizeof(struct NumVec)) sz = sizeof(struct NumVec);
+    nv = naAlloc((int)sz);
+    naBZero(nv, (int)sz);
+    nv->type = type == NA_NUMVEC_FLOAT ? NA_NUMVEC_FLOAT : NA_NUMVEC_DOUBLE;
+    nv->size = size;
+    return naNewGhost(c, &NumVecType, nv);
+}
+
+int naIsNumVec(naRef r)
+{
+    return naGhost_type(r) == &NumVecType;
+}
+
+int naNumVec_type(naRef v)
+{
+    return naIsNumVec(v) ? NUMVEC(v)->type : -1;
+}
+
+int naNumVec_size(naRef v)
+{
+    return naIsNumVec(v) ? NUMVEC(v)->size : 0;
+}
+
+void* naNumVec_data(naRef v)
+{
+    return naIsNumVec(v) ? NUMVEC(v)->data : 0;
+}
+
+double naNumVec_get(naRef v, int i)
+{
+    return GET(NUMVEC(v), i);
+}
+
+void naNumVec_set(naRef v, int i, double val)
+{
+    struct NumVec* nv = NUMVEC(v);
+    if(nv->type == NA_NUMVEC_FLOAT) FLOATS(nv)[i] = (float)val;
+    else DOUBLES(nv)[i] = val;
+}
+
+//
+// Kernels
+//
+
+static double sumD(const double* d, int n)
+{
+    int i = 0;
+    double s = 0;
+#ifdef __SSE2__
+    double part[2];
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    for(; i+4 <= n; i += 4) {
+        a0 = _mm_add_pd(a0, _mm_loadu_pd(d+i));
+        a1 = _mm_add_pd(a1, _mm_loadu_pd(d+i+2));
+    }
+    _mm_storeu_pd(part, _mm_add_pd(a0, a1));
+    s = part[0] + part[1];
+#endif
+    for(; i<n; i++) s += d[i];
+    return s;
+}
+
+// Float elements are summed in double precision
+static double sumF(const float* d, int n)
+{
+    int i = 0;
+    double s = 0;
+#ifdef __SSE2__
+    double part[2];
+    __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+    for(; i+4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(d+i);
+        a0 = _mm_add_pd(a0, _mm_cvtps_pd(v));
+        a1 = _mm_add_pd(a1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    _mm_storeu_pd(part, _mm_add_pd(a0, a1));
+    s = part[0] + part[1];
+#endif
+    for(; i<n; i++) s += d[i];
+    return s;
+}
+
+static void minmaxD(const double* d, int n, double* lo, double* hi)
+{
+    int i = 1;
+    double mn = d[0], mx = d[0];
+#ifdef __SSE2__
+    if(n >= 4) {
+        double pmn[2], pmx[2];
+        __m128d vmn = _mm_loadu_pd(d), vmx = vmn;
+        for(i=2; i+2 <= n; i += 2) {
+            __m128d v = _mm_loadu_pd(d+i);
+            vmn = _mm_min_pd(vmn, v);
+            vmx = _mm_max_pd(vmx, v);
+        }
+        _mm_storeu_pd(pmn, vmn);
+        _mm_storeu_pd(pmx, vmx);
+        mn = pmn[0] < pmn[1] ? pmn[0] : pmn[1];
+        mx = pmx[0] > pmx[1] ? pmx[0] : pmx[1];
+    }
+#endif
+    for(; i<n; i++) {
+        if(d[i] < mn) mn = d[i];
+        if(d[i] > mx) mx = d[i];
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+static void minmaxF(const float* d, int n, double* lo, double* hi)
+{
+    int i = 1;
+    float mn = d[0], mx = d[0];
+#ifdef __SSE2__
+    if(n >= 8) {
+        float pmn[4], pmx[4];
+        int j;
+        __m128 vmn = _mm_loadu_ps(d), vmx = vmn;
+        for(i=4; i+4 <= n; i += 4) {
+            __m128 v = _mm_loadu_ps(d+i);
+            vmn = _mm_min_ps(vmn, v);
+            vmx = _mm_max_ps(vmx, v);
+        }
+        _mm_storeu_ps(pmn, vmn);
+        _mm_storeu_ps(pmx, vmx);
+        mn = pmn[0];
+        mx = pmx[0];
+        for(j=1; j<4; j++) {
+            if(pmn[j] < mn) mn = pmn[j];
+            if(pmx[j] > mx) mx = pmx[j];
+        }
+    }
+#endif
+    for(; i<n; i++) {
+        if(d[i] < mn) mn = d[i];
+        if(d[i] > mx) mx = d[i];
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+static void scaleD(double* d, int n, double k, double offset)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128d vk = _mm_set1_pd(k), vo = _mm_set1_pd(offset);
+    for(; i+2 <= n; i += 2)
+        _mm_storeu_pd(d+i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(d+i), vk), vo));
+#endif
+    for(; i<n; i++) d[i] = d[i] * k + offset;
+}
+
+static void scaleF(float* d, int n, float k, float offset)
+{
+    int i = 0;
+#ifdef __SSE2__
+    __m128 vk = _mm_set1_ps(k), vo = _mm_set1_ps(offset);
+    for(; i+4 <= n; i += 4)
+        _mm_storeu_ps(d+i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(d+i), vk), vo));
+#endif
+    for(; i<n; i++) d[i] = d[i] * k + offset;
+}
+
+// Piecewise linear interpolation in the table xs (ascending) -> ys,
+// clamped at both ends.  *hint is the segment used by the previous
+// call, so that ascending lookups don't need a binary search.
+static double interp(struct NumVec* xs, struct NumVec* ys, double x,
+                     int* hint)
+{
+    int n = xs->size, j = *hint, lo, hi, mid;
+    double x0, x1;
+    if(!(x > GET(xs, 0))) return GET(ys, 0);
+    if(x >= GET(xs, n-1)) return GET(ys, n-1);
+    if(!(GET(xs, j) <= x && x < GET(xs, j+1)) &&
+       !(j+2 < n && GET(xs, j+1) <= x && x < GET(xs, j+2) && ++j)) {
+        lo = 0; hi = n-1; // xs[lo] <= x < xs[hi]
+        while(hi - lo > 1) {
+            mid = (lo + hi) / 2;
+            if(GET(xs, mid) <= x) lo = mid;
+            else hi = mid;
+        }
+        j = lo;
+    }
+    *hint = j;
+    x0 = GET(xs, j);
+    x1 = GET(xs, j+1);
+    return GET(ys, j) + (GET(ys, j+1) - GET(ys, j)) * (x - x0) / (x1 - x0);
+}
+
+//
+// Library functions
+//
+
+static struct NumVec* arg(naContext c, int argc, naRef* args, int i,
+                          const char* fn)
+{
+    if(i >= argc || !naIsNumVec(args[i]))
+        naRuntimeError(c, "bad/missing numvec argument to %s()", fn);
+    return NUMVEC(args[i]);
+}
+
+static double numArg(naContext c, int argc, naRef* args, int i, double def,
+                     const char* fn)
+{
+    naRef n;
+    if(i >= argc) return def;
+    n = naNumValue(args[i]);
+    if(naIsNil(n))
+        naRuntimeError(c, "non numeric argument to %s()", fn);
+    return n.num;
+}
+
+// Constructors: doubles(n) and floats(n) create n zeroes, doubles(v)
+// and floats(v) convert a vector of numbers or another numvec.
+static naRef create(naContext c, int type, int argc, naRef* args,
+                    const char* fn)
+{
+    naRef src = argc > 0 ? args[0] : naNil(), result, n;
+    int i, size;
+    if(naIsNum(src)) {
+        // also false for NaN
+        if(!(src.num >= 0 && src.num <= NA_NUMVEC_MAX_SIZE))
+            naRuntimeError(c, "bad size for %s()", fn);
+        return naNewNumVec(c, type, (int)src.num);
+    }
+    if(naIsNumVec(src)) {
+        struct NumVec* nv = NUMVEC(src);
+        result = naNewNumVec(c, type, nv->size);
+        if(nv->type == type)
+            memcpy(NUMVEC(result)->data, nv->data, nv->size *
+                   (type == NA_NUMVEC_FLOAT ? sizeof(float) : sizeof(double)));
+        else for(i=0; i<nv->size; i++)
+            naNumVec_set(result, i, GET(nv, i));
+        return result;
+    }
+    if(!naIsVector(src))
+        naRuntimeError(c, "bad/missing argument to %s()", fn);
+    size = naVec_size(src);
+    result = naNewNumVec(c, type, size);
+    for(i=0; i<size; i++) {
+        n = naNumValue(naVec_get(src, i));
+        if(naIsNil(n))
+            naRuntimeError(c, "non numeric element %d in %s()", i, fn);
+        naNumVec_set(result, i, n.num);
+    }
+    return result;
+}
+
+static naRef f_doubles(naContext c, naRef me, int argc, naRef* args)
+{
+    return create(c, NA_NUMVEC_DOUBLE, argc, args, "doubles");
+}
+
+static naRef f_floats(naContext c, naRef me, int argc, naRef* args)
+{
+    return create(c, NA_NUMVEC_FLOAT, argc, args, "floats");
+}
+
+// vector(a): a plain Nasal vector with the elements of a
+static naRef f_vector(naContext c, naRef me, int argc, naRef* args)
+{
+    struct NumVec* nv = arg(c, argc, args, 0, "vector");
+    naRef v = naNewVector(c);
+    int i;
+    naVec_setsize(c, v, nv->size);
+    for(i=0; i<nv->size; i++)
+        naVec_set(v, i, naNum(GET(nv, i)));
+    return v;
+}
+
+static naRef f_sum(naContext c, naRef me, int argc, naRef* args)
+{
+    struct NumVec* nv = arg(c, argc, args, 0, "sum");
+    if(nv->type == NA_NUMVEC_FLOAT) return naNum(sumF(FLOATS(nv), nv->size));
+    return naNum(sumD(DOUBLES(nv), nv->size));
+}
+
+static naRef minmax(naContext c, int argc, naRef* args, int max,
+                    const char* fn)
+{
+    struct NumVec* nv = arg(c, argc, args, 0, fn);
+    double lo, hi;
+    if(!nv->size) return naNil();
+    if(nv->type == NA_NUMVEC_FLOAT) minmaxF(FLOATS(nv), nv->size, &lo, &hi);
+    else minmaxD(DOUBLES(nv), nv->size, &lo, &hi);
+    return naNum(max ? hi : lo);
+}
+
+static naRef f_min(naContext c, naRef me, int argc, naRef* args)
+{
+    return minmax(c, argc, args, 0, "min");
+}
+
+static naRef f_max(naContext c, naRef me, int argc, naRef* args)
+{
+    return minmax(c, argc, args, 1, "max");
+}
+
+// scale(a, k, offset=0): a[i] = a[i] * k + offset, in place.  Returns a.
+static naRef f_scale(naContext c, naRef me, int argc, naRef* args)
+{
+    struct NumVec* nv = arg(c, argc, args, 0, "scale");
+    double k = numArg(c, argc, args, 1, 1, "scale");
+    double offset = numArg(c, argc, args, 2, 0, "scale");
+    if(nv->type == NA_NUMVEC_FLOAT)
+        scaleF(FLOATS(nv), nv->size, (float)k, (float)offset);
+    else
+        scaleD(DOUBLES(nv), nv->size, k, offset);
+    return args[0];
+}
+
+// map(a, f): a[i] = f(a[i]), in place.  Returns a.
+static naRef f_map(naContext c, naRef me, int argc, naRef* args)
+{
+    struct NumVec* nv = arg(c, argc, args, 0, "map");
+    naContext subc;
+    naRef x, y;
+    int i;
+    if(argc < 2 || !naIsFunc(args[1]))
+        naRuntimeError(c, "bad/missing argument to map()");
+    subc = naSubContext(c);
+    for(i=0; i<nv->size; i++) {
+        x = naNum(GET(nv, i));
+        y = naCall(subc, args[1], 1, &x, naNil(), naNil());
+        if(naGetError(subc)) {
+            // as naRethrowError(), but without keeping subc around
+            strncpy(c->error, subc->error, sizeof(c->error));
+            c->dieArg = subc->dieArg;
+            naFreeContext(subc);
+            longjmp(c->jumpHandle, 1);
+        }
+        y = naNumValue(y);
+        if(naIsNil(y))
+            naRuntimeError(c, "map() function returned non-number");
+        naNumVec_set(args[0], i, y.num);
+    }
+    naFreeContext(subc);
+    return args[0];
+}
+
+// interpolate(xs, ys, x): the value at x of the piecewise linear
+// function through the points (xs[i], ys[i]), with xs ascending and
+// constant beyond its ends.  For a numvec of x values, returns a
+// numvec (of doubles) of results.
+static naRef f_interpolate(naContext c, naRef me, int argc, naRef* args)
+{
+    struct NumVec* xs = arg(c, argc, args, 0, "interpolate");
+    struct NumVec* ys = arg(c, argc, args, 1, "interpolate");
+    naRef x = argc > 2 ? args[2] : naNil(), result;
+    int i, hint = 0;
+    if(!xs->size || xs->size != ys->size)
+        naRuntimeError(c, "interpolate() tables empty or of unequal size");
+    if(argc < 3)
+        naRuntimeError(c, "bad/missing argument to interpolate()");
+    if(naIsNumVec(x)) {
+        struct NumVec* in = NUMVEC(x);
+        double* out;
+        result = naNewNumVec(c, NA_NUMVEC_DOUBLE, in->size);
+        out = DOUBLES(NUMVEC(result));
+        for(i=0; i<in->size; i++)
+            out[i] = interp(xs, ys, GET(in, i), &hint);
+        return result;
+    }
+    return naNum(interp(xs, ys, numArg(c, argc, args, 2, 0, "interpolate"),
+                        &hint));
+}
+
+static naCFuncItem funcs[] = {
+    { "doubles", f_doubles },
+    { "floats", f_floats },
+    { "vector", f_vector },
+    { "sum", f_sum },
+    { "min", f_min },
+    { "max", f_max },
+    { "scale", f_scale },
+    { "map", f_map },
+    { "interpolate", f_interpolate },
+    { 0 }
+};
+
+naRef naInit_numvec(naContext c)
+{
+    return naGenLib(c, funcs);
+}
@@ -88,12 +88,23 @@ struct CodeGenerator {
 
     // Stack of "loop" frames for break/continue statements
     struct {
-        int breakIP;
+        int breakChain; // break jumps to fix up, linked through their targets
         int contIP;
         struct Token* label;
     } loops[MAX_MARK_DEPTH];
     int loopTop;
 
+    // OP_MEMBER instructions, each with its own lookup cache
+    int nMemberCaches;
+
+    // Peephole optimizer state: the last instruction which may be
+    // fused with the next one, and the last jump target or line start
+    // (which the next one must not be fused across)
+    int lastOp;
+    int lastOpIp;
+    int lastOpEnd;
+    int barrier;
+
     // Dynamic storage for constants, to be compiled into a static table
     naRef consts;
 };
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "data.h"
+#include "code.h"
+
+// Sampling profiler.  The interpreter calls naiProfileTick() at loop
+// back edges and calls while nasal_profiling is set; a sample walks
+// the frame stacks of the context (and the contexts it was called
+// from, through naCall() in C functions) and appends them to a
+// buffer allocated by naProfileStart(), root frame first:
+//
+//     depth, frame id, frame id, ...
+//
+// Frame ids index a table of the distinct source file / line pairs
+// seen, so the per sample cost is a hash lookup per frame.  The
+// samples are only aggregated into stacks by naProfileFolded().
+
+volatile int nasal_profiling = 0;
+
+struct ProfFrame {
+    char* file;
+    int len;
+    int line;
+    unsigned int hash;
+};
+
+static struct {
+    void* lock;
+    int interval;
+    volatile int pending;
+
+    int* buf;
+    int bufsz;
+    int used;
+    int nsamples;
+    int dropped;
+
+    struct ProfFrame* frames;
+    int nframes;
+    int framesz;
+    int* index; // open addressed hash of frame id + 1
+    int indexsz;
+} prof;
+
+static unsigned int frameHash(const char* file, int len, int line)
+{
+    unsigned int h = 2166136261u;
+    int i;
+    for(i=0; i<len; i++)
+        h = (h ^ (unsigned char)file[i]) * 16777619u;
+    return (h ^ (unsigned int)line) * 16777619u;
+}
+
+static void rehash(int sz)
+{
+    int i;
+    naFree(prof.index);
+    prof.index = naAlloc(sz * sizeof(int));
+    prof.indexsz = sz;
+    naBZero(prof.index, sz * sizeof(int));
+    for(i=0; i<prof.nframes; i++) {
+        int n = prof.frames[i].hash & (sz - 1);
+        while(prof.index[n]) n = (n + 1) & (sz - 1);
+        prof.index[n] = i + 1;
+    }
+}
+
+static int frameId(const char* file, int len, int line)
+{
+    unsigned int h = frameHash(file, len, line);
+    int n, id;
+    struct ProfFrame* pf;
+    if(2 * (prof.nframes + 1) > prof.indexsz)
+        rehash(prof.indexsz ? 2 * prof.indexsz : 256);
+    for(n = h & (prof.indexsz - 1); prof.index[n];
+        n = (n + 1) & (prof.indexsz - 1))
+    {
+        pf = &prof.frames[prof.index[n] - 1];
+        if(pf->hash == h && pf->line == line && pf->len == len
+           && memcmp(pf->file, file, len) == 0)
+            return prof.index[n] - 1;
+    }
+    if(prof.nframes == prof.framesz) {
+        prof.framesz = prof.framesz ? 2 * prof.framesz : 256;
+        prof.frames = naRealloc(prof.frames,
+                                prof.framesz * sizeof(struct ProfFrame));
+    }
+    id = prof.nframes++;
+    pf = &prof.frames[id];
+    pf->file = naAlloc(len + 1);
+    memcpy(pf->file, file, len);
+    pf->file[len] = 0;
+    pf->len = len;
+    pf->line = line;
+    pf->hash = h;
+    prof.index[n] = id + 1;
+    return id;
+}
+
+static int frameOf(struct Frame* f)
+{
+    naRef file = naNil();
+    if(IS_FUNC(f->func) && IS_CODE(PTR(f->func).func->code))
+        file = PTR(PTR(f->func).func->code).code->srcFile;
+    if(!IS_STR(file))
+        return frameId("<unknown>", 9, naiFrameLine(f));
+    return frameId(naStr_cdata(file), naStr_len(file), naiFrameLine(f));
+}
+
+static void record(naContext ctx)
+{
+    int start = prof.used, top = start + 1, i, j, t;
+    naContext c;
+    for(c = ctx; c; c = c->callParent) {
+        for(i = c->fTop - 1; i >= 0; i--) {
+            if(top == prof.bufsz) { prof.dropped++; return; }
+            prof.buf[top++] = frameOf(&c->fStack[i]);
+        }
+    }
+    // Collected leaf first: reverse into root first order
+    for(i = start + 1, j = top - 1; i < j; i++, j--) {
+        t = prof.buf[i]; prof.buf[i] = prof.buf[j]; prof.buf[j] = t;
+    }
+    prof.buf[start] = top - start - 1;
+    prof.used = top;
+    prof.nsamples++;
+}
+
+void naiProfileTick(naContext ctx)
+{
+    if(prof.pending) prof.pending = 0;
+    else if(prof.interval <= 0 || --ctx->profileTicks > 0) return;
+    ctx->profileTicks = prof.interval;
+
+    naLock(prof.lock);
+    if(nasal_profiling && prof.used < prof.bufsz)
+        record(ctx);
+    else if(nasal_profiling)
+        prof.dropped++;
+    naUnlock(prof.lock);
+}
+
+static void clearSamples()
+{
+    int i;
+    for(i=0; i<prof.nframes; i++)
+        naFree(prof.frames[i].file);
+    naFree(prof.frames);
+    naFree(prof.index);
+    naFree(prof.buf);
+    prof.frames = 0;
+    prof.nframes = prof.framesz = 0;
+    prof.index = 0;
+    prof.indexsz = 0;
+    prof.buf = 0;
+    prof.bufsz = prof.used = prof.nsamples = prof.dropped = 0;
+}
+
+void naProfileStart(int interval, int bufsize)
+{
+    if(!prof.lock) prof.lock = naNewLock();
+    naLock(prof.lock);
+    clearSamples();
+    prof.buf = naAlloc((bufsize > 0 ? bufsize : 1) * sizeof(int));
+    prof.bufsz = bufsize > 0 ? bufsize : 1;
+    prof.interval = interval;
+    prof.pending = 0;
+    nasal_profiling = 1;
+    naUnlock(prof.lock);
+}
+
+void naProfileStop(void)
+{
+    if(!prof.lock) return;
+    naLock(prof.lock);
+    nasal_profiling = 0;
+    naUnlock(prof.lock);
+}
+
+void naProfileSample(void)
+{
+    prof.pending = 1;
+}
+
+int naProfileCount(int* dropped)
+{
+    int n;
+    if(!prof.lock) { if(dropped) *dropped = 0; return 0; }
+    naLock(prof.lock);
+    n = prof.nsamples;
+    if(dropped) *dropped = prof.dropped;
+    naUnlock(prof.lock);
+    return n;
+}
+
+void naProfileClear(void)
+{
+    if(!prof.lock) return;
+    naLock(prof.lock);
+    clearSamples();
+    nasal_profiling = 0;
+    naUnlock(prof.lock);
+}
+
+// Orders samples (offsets into the buffer) by their stacks
+static int cmpSamples(const void* a, const void* b)
+{
+    const int* s1 = prof.buf + *(const int*)a;
+    const int* s2 = prof.buf + *(const int*)b;
+    int i, n = s1[0] < s2[0] ? s1[0] : s2[0];
+    for(i=1; i<=n; i++)
+        if(s1[i] != s2[i]) return s1[i] < s2[i] ? -1 : 1;
+    return s1[0] - s2[0];
+}
+
+struct TextBuf { char* data; int len, sz; };
+
+static void append(struct TextBuf* t, const char* s, int len)
+{
+    if(t->len + len > t->sz) {
+        while(t->len + len > t->sz)
+            t->sz = t->sz ? 2 * t->sz : 4096;
+        t->data = naRealloc(t->data, t->sz);
+    }
+    memcpy(t->data + t->len, s, len);
+    t->len += len;
+}
+
+static void appendFrame(struct TextBuf* t, struct ProfFrame* pf)
+{
+    char num[16];
+    int i, start = t->len;
+    append(t, pf->file, pf->len);
+    // separators of the folded format can't appear in frame names
+    for(i = start; i < t->len; i++)
+        if(t->data[i] == ';' || t->data[i] == '\n') t->data[i] = '_';
+    append(t, num, sprintf(num, ":%d", pf->line));
+}
+
+naRef naProfileFolded(naContext c)
+{
+    struct TextBuf t = { 0, 0, 0 };
+    int* order;
+    int i, j, n, off;
+    char num[16];
+    naRef result;
+    if(!prof.lock) return naStr_fromdata(naNewString(c), "", 0);
+
+    naLock(prof.lock);
+    order = naAlloc((prof.nsamples + 1) * sizeof(int));
+    for(i = 0, off = 0; i < prof.nsamples; i++) {
+        order[i] = off;
+        off += prof.buf[off] + 1;
+    }
+    qsort(order, prof.nsamples, sizeof(int), cmpSamples);
+
+    for(i = 0; i < prof.nsamples; i = j) {
+        int* s = prof.buf + order[i];
+        for(j = i + 1; j < prof.nsamples; j++)
+            if(cmpSamples(order + i, order + j)) break;
+        for(n = 1; n <= s[0]; n++) {
+            if(n > 1) append(&t, ";", 1);
+            appendFrame(&t, &prof.frames[s[n]]);
+        }
+        append(&t, num, sprintf(num, " %d\n", j - i));
+    }
+    naFree(order);
+    naUnlock(prof.lock);
+
+    result = naStr_fromdata(naNewString(c), t.data ? t.data : "", t.len);
+    naFree(t.data);
+    return result;
+}
@@ -1,8 +1,14 @@
 #include <math.h>
+#include <stddef.h>
 #include <string.h>
 
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
 #include "nasal.h"
 #include "data.h"
+#include "code.h"
 
 // The maximum number of significant (decimal!) figures in an IEEE
 // double.
@@ -11,22 +17,133 @@
 static int tonum(unsigned char* s, int len, double* result);
 static int fromnum(double val, unsigned char* s);
 
-#define LEN(s) ((s)->emblen != -1 ? (s)->emblen : (s)->data.ref.len)
-#define DATA(s) ((s)->emblen != -1 ? (s)->data.buf : (s)->data.ref.ptr)
+#define LEN(s) ((s)->emblen >= 0 ? (s)->emblen : (s)->data.ref.len)
+#define DATA(s) ((s)->emblen >= 0 ? (s)->data.buf : (s)->data.ref.ptr)
+
+/* Concatenation results keep their characters in a StrBuf, which can
+ * have spare capacity.  Appending to the string which ends at the
+ * buffer's high water mark fills that space in place, and the new
+ * string shares the buffer: so "s ~= x" in a loop is amortized O(1)
+ * per character instead of copying all of s every time.  The shorter
+ * strings sharing the buffer only ever look at their own prefix of
+ * it, which never changes.  They are not nul terminated, though, and
+ * must not be written to, so naStr_data() first moves a string out
+ * to a private copy.  naStr_cdata() is for readers which need neither. */
+#define SHARED -2    // emblen of a string in a StrBuf
+#define UNSHARING -3 // ...while naStr_data() moves it out
+#define STRBUF(p) ((struct StrBuf*)((p) - offsetof(struct StrBuf, data)))
+
+struct StrBuf {
+    int refs; // strings using the buffer
+    int used; // length of the longest of them
+    int cap;
+    unsigned char data[];
+};
+
+// Strings are shared between threads, so the buffers need atomic updates
+#ifdef _WIN32
+# define CAS(p, old, val) \
+    (InterlockedCompareExchange((volatile LONG*)(p), (val), (old)) == (old))
+# define CAS8(p, old, val) \
+    (_InterlockedCompareExchange8((volatile char*)(p), (val), (old)) == (old))
+# define CAS_PTR(p, old, val) \
+    (InterlockedCompareExchangePointer((PVOID volatile*)(p), (val), (old)) == (old))
+# define ATOMIC_ADD(p, n) InterlockedExchangeAdd((volatile LONG*)(p), (n))
+# define BARRIER() MemoryBarrier()
+# define CPU_PAUSE() YieldProcessor()
+#else
+# define CAS(p, old, val) __sync_bool_compare_and_swap((p), (old), (val))
+# define CAS8(p, old, val) __sync_bool_compare_and_swap((p), (old), (val))
+# define CAS_PTR(p, old, val) __sync_bool_compare_and_swap((p), (old), (val))
+# define ATOMIC_ADD(p, n) __sync_fetch_and_add((p), (n))
+# define BARRIER() __sync_synchronize()
+# if defined(__i386__) || defined(__x86_64__)
+#  define CPU_PAUSE() __builtin_ia32_pause()
+# else
+#  define CPU_PAUSE() BARRIER()
+# endif
+#endif
+
+// Spins before giving up the CPU, while another thread finishes unshare()
+#define UNSHARE_SPINS 64
+
+// Buffers left by unshare(), which other threads may still be reading
+// from until the next garbage collection (listed in globals->unshared)
+struct Unshared { struct StrBuf* buf; struct Unshared* next; };
+
+static void unref(struct StrBuf* buf)
+{
+    if(ATOMIC_ADD(&buf->refs, -1) == 1) naFree(buf);
+}
+
+static void release(struct naStr* s)
+{
+    if(s->emblen == -1 && s->data.ref.ptr) naFree(s->data.ref.ptr);
+    else if(s->emblen == SHARED) unref(STRBUF(s->data.ref.ptr));
+}
+
+// Moves a string out of a shared buffer, into its own storage
+static void unshare(struct naStr* s)
+{
+    struct Globals* g = globals;
+    struct Unshared* u;
+    unsigned char* p;
+    int len = s->data.ref.len;
+    if(!CAS8(&s->emblen, SHARED, UNSHARING)) {
+        // Another thread is doing it: that is a copy of the string, but
+        // the thread can be preempted in the middle of it
+        int spins = 0;
+        while(((volatile struct naStr*)s)->emblen == UNSHARING) {
+            if(++spins < UNSHARE_SPINS) CPU_PAUSE();
+            else naYield();
+        }
+        return;
+    }
+    u = naAlloc(sizeof(struct Unshared));
+    u->buf = STRBUF(s->data.ref.ptr);
+    p = naAlloc(len+1);
+    memcpy(p, s->data.ref.ptr, len);
+    p[len] = 0;
+    s->data.ref.ptr = p;
+    BARRIER();
+    s->emblen = -1;
+    do { u->next = g->unshared; } while(!CAS_PTR(&g->unshared, u->next, u));
+}
+
+// Called by the collector, with all other threads stopped
+void naStr_gcflush(void)
+{
+    struct Globals* g = globals;
+    while(g->unshared) {
+        struct Unshared* u = g->unshared;
+        g->unshared = u->next;
+        unref(u->buf);
+        naFree(u);
+    }
+}
 
 int naStr_len(naRef s)
 {
     return IS_STR(s) ? LEN(PTR(s).str) : 0;
 }
 
+const char* naStr_cdata(naRef s)
+{
+    // A string being unshared still points into the old buffer, or
+    // already to a copy: both stay valid until the next collection
+    return IS_STR(s) ? (const char*)DATA(PTR(s).str) : 0;
+}
+
 char* naStr_data(naRef s)
 {
-    return IS_STR(s) ? (char*)DATA(PTR(s).str) : 0;
+    if(!IS_STR(s)) return 0;
+    if(PTR(s).str->emblen == SHARED) unshare(PTR(s).str);
+    return (char*)DATA(PTR(s).str);
 }
 
 static void setlen(struct naStr* s, int sz)
 {
-    if(s->emblen == -1 && DATA(s)) naFree(s->data.ref.ptr);
+    release(s);
     if(sz > MAX_STR_EMBLEN) {
         s->emblen = -1;
         s->data.ref.len = sz;
@@ -57,10 +174,44 @@ naRef naStr_concat(naRef dest, naRef s1, naRef s2)
     struct naStr* dst = PTR(dest).str;
     struct naStr* a = PTR(s1).str;
     struct naStr* b = PTR(s2).str;
+    struct StrBuf* buf;
+    unsigned char* pa;
+    int la, lb, len, cap;
     if(!(IS_STR(s1)&&IS_STR(s2)&&IS_STR(dest))) return naNil();
-    setlen(dst, LEN(a) + LEN(b));
-    memcpy(DATA(dst), DATA(a), LEN(a));
-    memcpy(DATA(dst) + LEN(a), DATA(b), LEN(b));
+    la = LEN(a);
+    lb = LEN(b);
+    len = la + lb;
+    if(len <= MAX_STR_EMBLEN || dst == a || dst == b) {
+        setlen(dst, len);
+        memcpy(DATA(dst), DATA(a), la);
+        memcpy(DATA(dst) + la, DATA(b), lb);
+        return dest;
+    }
+
+    // Read the pointer first: unshare() changes it after emblen
+    pa = a->data.ref.ptr;
+    BARRIER();
+    if(a->emblen == SHARED && (buf = STRBUF(pa))->cap >= len
+       && CAS(&buf->used, la, len)) {
+        // Nothing was appended to a yet, and there is room: do it in
+        // place.  If b is in the same buffer, it is before la.
+        memcpy(buf->data + la, DATA(b), lb);
+        ATOMIC_ADD(&buf->refs, 1);
+    } else {
+        // Only leave room to grow when a was built by concatenation
+        cap = a->emblen == SHARED ? 2*len : len;
+        buf = naAlloc(sizeof(struct StrBuf) + cap + 1);
+        buf->refs = 1;
+        buf->used = len;
+        buf->cap = cap;
+        memcpy(buf->data, DATA(a), la);
+        memcpy(buf->data + la, DATA(b), lb);
+    }
+    buf->data[len] = 0;
+    release(dst);
+    dst->emblen = SHARED;
+    dst->data.ref.len = len;
+    dst->data.ref.ptr = buf->data;
     return dest;
 }
 
@@ -79,8 +230,8 @@ int naStr_equal(naRef s1, naRef s2)
 {
     struct naStr* a = PTR(s1).str;
     struct naStr* b = PTR(s2).str;
-    if(DATA(a) == DATA(b)) return 1;
     if(LEN(a) != LEN(b)) return 0;
+    if(DATA(a) == DATA(b)) return 1;
     if(memcmp(DATA(a), DATA(b), LEN(a)) == 0) return 1;
     return 0;
 }
@@ -112,7 +263,7 @@ int naStr_numeric(naRef str)
 
 void naStr_gcclean(struct naStr* str)
 {
-    if(str->emblen == -1) naFree(str->data.ref.ptr);
+    release(str);
     str->data.ref.ptr = 0;
     str->data.ref.len = 0;
     str->emblen = -1;
@@ -336,25 +487,15 @@ static int fromnum(double val, unsigned char* s)
 }
 
 
-//------------------------------------------------------------------------------
-static naRef string_methods;
-static int init = 0; // As we can't use naNil() for static initialization we
-                     // need a separate variable for saving whether we have
-                     // already initialized.
-
 //------------------------------------------------------------------------------
 naRef naInit_string(naContext c)
 {
-  string_methods = naNewHash(c);
-  init = 1;
-  return string_methods;
+  globals->stringMethods = naNewHash(c);
+  return globals->stringMethods;
 }
 
 //------------------------------------------------------------------------------
 naRef getStringMethods(naContext c)
 {
-  if( !init )
-    return naNil();
-
-  return string_methods;
+  return globals->stringMethods;
 }
@@ -1,6 +1,7 @@
 #ifndef _WIN32
 
 #include <pthread.h>
+#include <sched.h>
 #include "code.h"
 
 void* naNewLock()
@@ -68,6 +69,11 @@ void naSemUp(void* sh, int count)
     pthread_mutex_unlock(&sem->lock);
 }
 
+void naYield()
+{
+    sched_yield();
+}
+
 #endif
 
 extern int GccWarningWorkaround_IsoCForbidsAnEmptySourceFile;
@@ -14,11 +14,60 @@ static naGhostType LockType = { lockDestroy };
 static void semDestroy(void* sem) { naFreeSem(sem); }
 static naGhostType SemType = { semDestroy };
 
+static void channelDestroy(void* ch);
+static naGhostType ChannelType = { channelDestroy, "channel" };
+
 typedef struct {
     naContext ctx;
     naRef func;
+    struct Globals* heap;
 } ThreadData;
 
+#ifdef _WIN32
+typedef DWORD (WINAPI *ThreadFunc)(LPVOID);
+#else
+typedef void* (*ThreadFunc)(void*);
+#endif
+
+// Returns 0, or an error code for threadError().  The caller still
+// owns param when this fails, and must free it before raising the
+// error.
+static int startThread(ThreadFunc fn, void* param)
+{
+#ifdef _WIN32
+    HANDLE t = CreateThread(0, 0, fn, param, 0, 0);
+    if(!t) return (int)GetLastError();
+    CloseHandle(t);
+#else
+    pthread_t t; int err;
+    if((err = pthread_create(&t, 0, fn, param))) return err;
+    pthread_detach(t);
+#endif
+    return 0;
+}
+
+static void threadError(naContext c, const char* fn, int err)
+{
+#ifdef _WIN32
+    naRuntimeError(c, "%s failed: error %d", fn, err);
+#else
+    naRuntimeError(c, "%s failed: %s", fn, strerror(err));
+#endif
+}
+
+// Drops the calling thread's reference to its isolate heap (if it
+// runs in one), freeing the heap after the last thread is done.
+static void releaseHeap()
+{
+    int last;
+    if(!nasal_heap) return;
+    LOCK();
+    last = --globals->heapRefs == 0;
+    UNLOCK();
+    if(last) naiFreeHeap();
+    else nasal_heap = 0;
+}
+
 #ifdef _WIN32
 static DWORD WINAPI threadtop(LPVOID param)
 #else
@@ -26,31 +75,40 @@ static void* threadtop(void* param)
 #endif
 {
     ThreadData* td = param;
+    nasal_heap = td->heap;
     naCall(td->ctx, td->func, 0, 0, naNil(), naNil());
     naFreeContext(td->ctx);
     naFree(td);
+    releaseHeap();
     return 0;
 }
 
 static naRef f_newthread(naContext c, naRef me, int argc, naRef* args)
 {
     ThreadData *td;
+    int err;
     if(argc < 1 || !naIsFunc(args[0]))
         naRuntimeError(c, "bad/missing argument to newthread");
     td = naAlloc(sizeof(*td));
     td->ctx = naNewContext();
     td->func = args[0];
+    td->heap = nasal_heap;
     naTempSave(td->ctx, td->func);
-#ifdef _WIN32
-    CreateThread(0, 0, threadtop, td, 0, 0);
-#else
-    {
-        pthread_t t; int err;
-        if((err = pthread_create(&t, 0, threadtop, td)))
-            naRuntimeError(c, "newthread failed: %s", strerror(err));
-        pthread_detach(t);
+    if(td->heap) {
+        LOCK();
+        td->heap->heapRefs++;
+        UNLOCK();
+    }
+    if((err = startThread(threadtop, td))) {
+        if(td->heap) {
+            LOCK();
+            td->heap->heapRefs--;
+            UNLOCK();
+        }
+        naFreeContext(td->ctx);
+        naFree(td);
+        threadError(c, "newthread", err);
     }
-#endif
     return naNil();
 }
 
@@ -98,6 +156,424 @@ static naRef f_semup(naContext c, naRef me, int argc, naRef* args)
     return naNil();
 }
 
+//
+// Messages.  Objects can't be shared between heaps, so values are
+// sent as copies: serialized into a plain buffer by the sender, and
+// rebuilt in the receiver's heap.  Only data can be sent (nil,
+// numbers, strings, vectors, hashes, numvecs and channels), and
+// substructures referenced twice arrive as two copies.
+//
+
+enum { MSG_NIL, MSG_NUM, MSG_STR, MSG_VEC, MSG_HASH, MSG_NUMVEC, MSG_CHANNEL };
+
+#define MAX_MSG_DEPTH 64
+
+struct Msg {
+    char* buf;
+    int len;
+    int alloced;
+    struct Msg* next;
+};
+
+struct Reader { const char* p; const char* end; };
+
+struct Channel {
+    int refs;    // ghosts, and messages holding the channel
+    int waiting; // receivers blocked on the semaphore
+    void* lock;
+    void* sem;
+    struct Msg* head;
+    struct Msg* tail;
+};
+
+static void put(struct Msg* m, const void* data, int len)
+{
+    if(m->len + len > m->alloced) {
+        m->alloced = 2 * (m->len + len);
+        m->buf = naRealloc(m->buf, m->alloced);
+    }
+    memcpy(m->buf + m->len, data, len);
+    m->len += len;
+}
+
+static void putTag(struct Msg* m, int tag, int n)
+{
+    unsigned char t = tag;
+    put(m, &t, 1);
+    put(m, &n, sizeof(n));
+}
+
+static void refChannel(struct Channel* ch)
+{
+    naLock(ch->lock);
+    ch->refs++;
+    naUnlock(ch->lock);
+}
+
+// Returns an error message, or zero on success
+static const char* encode(naContext c, struct Msg* m, naRef r, int depth)
+{
+    const char* err = 0;
+    int i, n;
+    if(depth > MAX_MSG_DEPTH)
+        return "message nested too deeply (or cyclic)";
+    if(IS_NIL(r)) {
+        putTag(m, MSG_NIL, 0);
+    } else if(IS_NUM(r)) {
+        putTag(m, MSG_NUM, 0);
+        put(m, &r.num, sizeof(r.num));
+    } else if(IS_STR(r)) {
+        putTag(m, MSG_STR, naStr_len(r));
+        put(m, naStr_data(r), naStr_len(r));
+    } else if(IS_VEC(r)) {
+        putTag(m, MSG_VEC, n = naVec_size(r));
+        for(i=0; i<n && !err; i++)
+            err = encode(c, m, naVec_get(r, i), depth+1);
+    } else if(IS_HASH(r)) {
+        naRef keys = naNewVector(c), val;
+        naHash_keys(keys, r);
+        putTag(m, MSG_HASH, n = naVec_size(keys));
+        for(i=0; i<n && !err; i++) {
+            naHash_get(r, naVec_get(keys, i), &val);
+            if(!(err = encode(c, m, naVec_get(keys, i), depth+1)))
+                err = encode(c, m, val, depth+1);
+        }
+    } else if(naIsNumVec(r)) {
+        n = naNumVec_size(r);
+        putTag(m, MSG_NUMVEC, n);
+        putTag(m, naNumVec_type(r), 0);
+        put(m, naNumVec_data(r), n * (naNumVec_type(r) == NA_NUMVEC_FLOAT
+                                      ? sizeof(float) : sizeof(double)));
+    } else if(naGhost_type(r) == &ChannelType) {
+        struct Channel* ch = naGhost_ptr(r);
+        putTag(m, MSG_CHANNEL, 0);
+        put(m, &ch, sizeof(ch));
+        refChannel(ch);
+    } else {
+        err = "only data (no functions or ghosts) can be sent to other heaps";
+    }
+    return err;
+}
+
+static const char* get(struct Reader* r, int len)
+{
+    const char* p = r->p;
+    if(len < 0 || r->end - r->p < len) {
+        r->p = r->end;
+        return 0;
+    }
+    r->p += len;
+    return p;
+}
+
+static naRef newChannelGhost(naContext c, struct Channel* ch)
+{
+    return naNewGhost(c, &ChannelType, ch);
+}
+
+// Rebuilds a value in the heap of the context, taking over the
+// channel references held by the message.  With no context, the
+// references are just dropped.
+static naRef decode(naContext c, struct Reader* r)
+{
+    const char* p = get(r, 1 + sizeof(int));
+    naRef result = naNil(), k, v;
+    int i, n, type;
+    if(!p) return naNil();
+    memcpy(&n, p + 1, sizeof(n));
+    switch(*p) {
+    case MSG_NUM:
+        if((p = get(r, sizeof(double)))) {
+            double d;
+            memcpy(&d, p, sizeof(d));
+            result = naNum(d);
+        }
+        break;
+    case MSG_STR:
+        if((p = get(r, n)) && c)
+            result = naStr_fromdata(naNewString(c), p, n);
+        break;
+    case MSG_VEC:
+        if(c) {
+            result = naNewVector(c);
+            naVec_setsize(c, result, n);
+        }
+        for(i=0; i<n; i++) {
+            v = decode(c, r);
+            if(c) naVec_set(result, i, v);
+        }
+        break;
+    case MSG_HASH:
+        if(c) result = naNewHash(c);
+        for(i=0; i<n; i++) {
+            k = decode(c, r);
+            v = decode(c, r);
+            if(c) naHash_set(result, k, v);
+        }
+        break;
+    case MSG_NUMVEC:
+        if(!(p = get(r, 1 + sizeof(int)))) break;
+        type = *p;
+        p = get(r, n * (type == NA_NUMVEC_FLOAT ? sizeof(float)
+                                                : sizeof(double)));
+        if(p && c) {
+            result = naNewNumVec(c, type, n);
+            memcpy(naNumVec_data(result), p, r->p - p);
+        }
+        break;
+    case MSG_CHANNEL:
+        if((p = get(r, sizeof(struct Channel*)))) {
+            struct Channel* ch;
+            memcpy(&ch, p, sizeof(ch));
+            if(c) result = newChannelGhost(c, ch);
+            else channelDestroy(ch);
+        }
+        break;
+    }
+    return result;
+}
+
+static void msgFree(struct Msg* m)
+{
+    naFree(m->buf);
+    naFree(m);
+}
+
+// Frees a message which won't be received
+static void msgDrop(struct Msg* m)
+{
+    struct Reader r;
+    r.p = m->buf;
+    r.end = m->buf + m->len;
+    while(r.p < r.end)
+        decode(0, &r);
+    msgFree(m);
+}
+
+static struct Msg* newMsg(naContext c, int argc, naRef* args)
+{
+    const char* err = 0;
+    struct Msg* m = naAlloc(sizeof(struct Msg));
+    int i;
+    m->buf = 0;
+    m->len = m->alloced = 0;
+    m->next = 0;
+    for(i=0; i<argc && !err; i++)
+        err = encode(c, m, args[i], 0);
+    if(err) {
+        msgDrop(m);
+        naRuntimeError(c, "%s", err);
+    }
+    return m;
+}
+
+//
+// Channels: message queues between threads, in any heaps.  A channel
+// stays alive while messages queued on it hold it, so one which is
+// sent to itself and never received is leaked.
+//
+
+static void channelDestroy(void* p)
+{
+    struct Channel* ch = p;
+    int last;
+    naLock(ch->lock);
+    last = --ch->refs == 0;
+    naUnlock(ch->lock);
+    if(!last) return;
+    while(ch->head) {
+        struct Msg* m = ch->head;
+        ch->head = m->next;
+        msgDrop(m);
+    }
+    naFreeLock(ch->lock);
+    naFreeSem(ch->sem);
+    naFree(ch);
+}
+
+static struct Channel* channelArg(naContext c, int argc, naRef* args,
+                                  const char* fn)
+{
+    if(argc < 1 || naGhost_type(args[0]) != &ChannelType)
+        naRuntimeError(c, "bad/missing channel argument to %s()", fn);
+    return naGhost_ptr(args[0]);
+}
+
+static naRef receive(naContext c, struct Channel* ch, int block)
+{
+    struct Msg* m;
+    struct Reader r;
+    naRef result;
+    if(block) naModUnlock();
+    naLock(ch->lock);
+    while(block && !ch->head) {
+        ch->waiting++;
+        naUnlock(ch->lock);
+        naSemDown(ch->sem);
+        naLock(ch->lock);
+    }
+    if((m = ch->head) && !(ch->head = m->next))
+        ch->tail = 0;
+    naUnlock(ch->lock);
+    if(block) naModLock();
+    if(!m) return naNil();
+
+    r.p = m->buf;
+    r.end = m->buf + m->len;
+    result = decode(c, &r);
+    msgFree(m);
+    return result;
+}
+
+static naRef f_newchannel(naContext c, naRef me, int argc, naRef* args)
+{
+    struct Channel* ch = naAlloc(sizeof(struct Channel));
+    ch->refs = 1;
+    ch->waiting = 0;
+    ch->lock = naNewLock();
+    ch->sem = naNewSem();
+    ch->head = ch->tail = 0;
+    return newChannelGhost(c, ch);
+}
+
+static naRef f_send(naContext c, naRef me, int argc, naRef* args)
+{
+    struct Channel* ch = channelArg(c, argc, args, "send");
+    struct Msg* m;
+    if(argc != 2)
+        naRuntimeError(c, "bad/missing argument to send()");
+    m = newMsg(c, 1, args + 1);
+    naLock(ch->lock);
+    if(ch->tail) ch->tail->next = m;
+    else ch->head = m;
+    ch->tail = m;
+    if(ch->waiting) {
+        ch->waiting--;
+        naSemUp(ch->sem, 1);
+    }
+    naUnlock(ch->lock);
+    return naNil();
+}
+
+static naRef f_receive(naContext c, naRef me, int argc, naRef* args)
+{
+    return receive(c, channelArg(c, argc, args, "receive"), 1);
+}
+
+static naRef f_tryreceive(naContext c, naRef me, int argc, naRef* args)
+{
+    return receive(c, channelArg(c, argc, args, "tryreceive"), 0);
+}
+
+//
+// Isolates: code running in a new thread, in a heap of its own.
+// They don't contend for the modlock or collector of any other heap,
+// and talk to the rest of the program through channels.
+//
+
+struct IsolateStart {
+    char* code;  // naSaveCode() output
+    int codelen;
+    char* file;
+    struct Msg* args;
+};
+
+static naRef isolateNamespace(naContext c)
+{
+    naRef ns = naInit_std(c);
+    naAddSym(c, ns, "math", naInit_math(c));
+    naAddSym(c, ns, "bits", naInit_bits(c));
+    naAddSym(c, ns, "io", naInit_io(c));
+    naAddSym(c, ns, "utf8", naInit_utf8(c));
+    naAddSym(c, ns, "thread", naInit_thread(c));
+    naAddSym(c, ns, "numvec", naInit_numvec(c));
+    return ns;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI isolatetop(LPVOID param)
+#else
+static void* isolatetop(void* param)
+#endif
+{
+    struct IsolateStart* is = param;
+    struct Reader r;
+    naContext ctx;
+    naRef code, args;
+
+    naiNewHeap();
+    ctx = naNewContext();
+    code = naLoadCode(ctx, naStr_fromdata(naNewString(ctx), is->file,
+                                          strlen(is->file)),
+                      is->code, is->codelen);
+    args = naNewVector(ctx);
+    r.p = is->args->buf;
+    r.end = is->args->buf + is->args->len;
+    while(r.p < r.end)
+        naVec_append(args, decode(ctx, &r));
+    msgFree(is->args);
+    naFree(is->code);
+    naFree(is->file);
+    naFree(is);
+
+    if(IS_CODE(code)) {
+        naCall(ctx, code, naVec_size(args), PTR(args).vec->rec
+               ? PTR(args).vec->rec->array : 0, naNil(),
+               isolateNamespace(ctx));
+        if(naGetError(ctx))
+            naiReportError(ctx);
+    }
+    naFreeContext(ctx);
+    releaseHeap();
+    return 0;
+}
+
+// newisolate(code, args...) runs code (a function, or source text)
+// with copies of the arguments, in a new thread and heap.  Functions
+// lose their closure: they see the isolate's own namespace, with the
+// core libraries only.
+static naRef f_newisolate(naContext c, naRef me, int argc, naRef* args)
+{
+    struct IsolateStart* is;
+    struct Msg* msg;
+    naRef code = argc > 0 ? args[0] : naNil(), file, saved;
+    int err;
+    if(IS_STR(code)) {
+        int errLine;
+        file = naStr_fromdata(naNewString(c), "<isolate>", 9);
+        code = naParseCode(c, file, 1, naStr_data(code), naStr_len(code),
+                           &errLine);
+        if(!IS_CODE(code))
+            naRuntimeError(c, "parse error in isolate code, line %d",
+                           errLine);
+    } else if(IS_FUNC(code) && IS_CODE(PTR(code).func->code)) {
+        code = PTR(code).func->code;
+        file = PTR(code).code->srcFile;
+    } else {
+        naRuntimeError(c, "bad/missing argument to newisolate()");
+    }
+
+    // Everything which can raise an error comes before the allocations
+    saved = naSaveCode(c, code);
+    msg = newMsg(c, argc-1, args+1);
+
+    is = naAlloc(sizeof(struct IsolateStart));
+    is->args = msg;
+    is->codelen = naStr_len(saved);
+    is->code = naAlloc(is->codelen);
+    memcpy(is->code, naStr_data(saved), is->codelen);
+    is->file = naAlloc(naStr_len(file) + 1);
+    memcpy(is->file, naStr_data(file), naStr_len(file) + 1);
+    if((err = startThread(isolatetop, is))) {
+        msgDrop(is->args);
+        naFree(is->code);
+        naFree(is->file);
+        naFree(is);
+        threadError(c, "newisolate", err);
+    }
+    return naNil();
+}
+
 static naCFuncItem funcs[] = {
     { "newthread", f_newthread },
     { "newlock", f_newlock },
@@ -106,6 +582,11 @@ static naCFuncItem funcs[] = {
     { "newsem", f_newsem },
     { "semdown", f_semdown },
     { "semup", f_semup },
+    { "newisolate", f_newisolate },
+    { "newchannel", f_newchannel },
+    { "send", f_send },
+    { "receive", f_receive },
+    { "tryreceive", f_tryreceive },
     { 0 }
 };
 
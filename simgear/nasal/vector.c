@@ -1,5 +1,6 @@
 #include "nasal.h"
 #include "data.h"
+#include "code.h"
 
 static struct VecRec* newvecrec(struct VecRec* old)
 {
@@ -42,7 +43,10 @@ void naVec_set(naRef vec, int i, naRef o)
     if(IS_VEC(vec)) {
         struct VecRec* r = PTR(vec).vec->rec;
         if(r && i >= r->size) return;
+        GC_SHADE(r->array[i]);
         r->array[i] = o;
+        VEC_CHANGED(PTR(vec).vec);
+        GC_WRITE_BARRIER(PTR(vec).vec, o);
     }
 }
 
@@ -64,6 +68,7 @@ int naVec_append(naRef vec, naRef o)
             r = PTR(vec).vec->rec;
         }
         r->array[r->size] = o;
+        GC_WRITE_BARRIER(PTR(vec).vec, o);
         return r->size++;
     }
     return 0;
@@ -83,7 +88,10 @@ void naVec_setsize(naContext c, naRef vec, int sz)
         nv->alloced = sz;
         for(i=0; i<sz; i++)
             nv->array[i] = (v && i < v->size) ? v->array[i] : naNil();
+        for(; v && i<v->size; i++)
+            GC_SHADE(v->array[i]);
         naGC_swapfree((void*)&(PTR(vec).vec->rec), nv);
+        VEC_CHANGED(PTR(vec).vec);
     }
 }
 
@@ -96,9 +104,13 @@ naRef naVec_removefirst(naRef vec)
         struct VecRec* v = PTR(vec).vec->rec;
         if(!v || v->size == 0) return naNil();
         o = v->array[0];
+        GC_SHADE(o);
         for (i=1; i<v->size; i++)
             v->array[i-1] = v->array[i];
         v->size--;
+        VEC_CHANGED(PTR(vec).vec);
+        GC_WRITE_BARRIER_ALL(PTR(vec).vec);
+        GC_RESCAN(PTR(vec).vec);
         if(v->size < (v->alloced >> 1))
             resize(PTR(vec).vec);
         return o;
@@ -114,7 +126,9 @@ naRef naVec_removelast(naRef vec)
         struct VecRec* v = PTR(vec).vec->rec;
         if(!v || v->size == 0) return naNil();
         o = v->array[v->size - 1];
+        GC_SHADE(o);
         v->size--;
+        VEC_CHANGED(PTR(vec).vec);
         if(v->size < (v->alloced >> 1))
             resize(PTR(vec).vec);
         return o;
@@ -35,9 +35,12 @@
 #include <simgear/timing/timestamp.hxx>
 
 #include <simgear/io/test_HTTP.hxx>
+#include <simgear/io/test_zip.hxx>
 #include <simgear/io/HTTPClient.hxx>
 #include <simgear/io/sg_file.hxx>
 #include <simgear/structure/exception.hxx>
+#include <simgear/misc/strutils.hxx>
+#include <simgear/package/md5.h>
 
 using namespace simgear;
 
@@ -540,6 +543,72 @@ void testInstallTarPackage(HTTP::Client* cl)
     SG_VERIFY(p.exists());
 }
 
+// A package written by a streaming zip tool, with data descriptors and
+// Zip64 sizes, served from its own catalog through the test server
+void testInstallStreamedZip(HTTP::Client* cl)
+{
+    simgear::Dir serverDir = simgear::Dir::tempDir("catalogStream");
+    serverDir.setRemoveOnDestroy();
+    simgear::Dir(serverDir.path() / "catalogStream").create(0755);
+
+    std::string text;
+    for (int i = 0; i < 500; ++i) {
+        text += "streamed line " + std::to_string(i) + "\n";
+    }
+    std::vector<TestZipWriter::Entry> entries;
+    entries.push_back(TestZipWriter::Entry("streamed/", ""));
+    entries.push_back(TestZipWriter::Entry("streamed/streamed-set.xml",
+                                           "<PropertyList/>\n"));
+    entries.push_back(TestZipWriter::Entry("streamed/data..txt", text));
+    std::string zip = TestZipWriter::streamed(entries, true);
+
+    SG_MD5_CTX md5;
+    SG_MD5Init(&md5);
+    SG_MD5Update(&md5, (unsigned char*) zip.data(), zip.size());
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    SG_MD5Final(digest, &md5);
+
+    std::ofstream(SGPath(serverDir.path() / "catalogStream/streamed.zip").local8BitStr().c_str(),
+                  std::ios::binary) << zip;
+    std::ofstream(SGPath(serverDir.path() / "catalogStream/catalog.xml").local8BitStr().c_str())
+        << "<?xml version=\"1.0\"?>\n<PropertyList>\n"
+        << "<id>org.flightgear.test.stream</id>\n"
+        << "<url>http://localhost:2000/catalogStream/catalog.xml</url>\n"
+        << "<catalog-version>4</catalog-version>\n"
+        << "<version>8.1.*</version>\n"
+        << "<package>\n<id>streamed</id>\n<name>Streamed</name>\n"
+        << "<revision type=\"int\">1</revision>\n"
+        << "<file-size-bytes type=\"int\">" << zip.size() << "</file-size-bytes>\n"
+        << "<md5>" << strutils::encodeHex(digest, MD5_DIGEST_LENGTH) << "</md5>\n"
+        << "<url>http://localhost:2000/catalogStream/streamed.zip</url>\n"
+        << "<dir>streamed</dir>\n</package>\n</PropertyList>\n";
+
+    SGPath previousRoot = global_serverFilesRoot;
+    global_serverFilesRoot = serverDir.path();
+
+    SGPath rootPath(simgear::Dir::current().path());
+    rootPath.append("pkg_install_streamed");
+    simgear::Dir pd(rootPath);
+    pd.removeChildren();
+
+    pkg::RootRef root(new pkg::Root(rootPath, "8.1.2"));
+    root->setHTTPClient(cl);
+
+    pkg::CatalogRef c = pkg::Catalog::createFromUrl(root.ptr(), "http://localhost:2000/catalogStream/catalog.xml");
+    waitForUpdateComplete(cl, root);
+
+    pkg::PackageRef p1 = root->getPackageById("org.flightgear.test.stream.streamed");
+    SG_VERIFY(p1);
+    pkg::InstallRef ins = p1->install();
+    waitForUpdateComplete(cl, root);
+    SG_VERIFY(p1->isInstalled());
+
+    SGPath p(ins->path());
+    SG_VERIFY((p / "streamed-set.xml").exists());
+    SG_CHECK_EQUAL((p / "data..txt").sizeInBytes(), text.size());
+
+    global_serverFilesRoot = previousRoot;
+}
 
 int main(int argc, char* argv[])
 {
@@ -564,6 +633,8 @@ int main(int argc, char* argv[])
 
     testInstallTarPackage(&cl);
 
+    testInstallStreamedZip(&cl);
+
     std::cout << "Successfully passed all tests!" << std::endl;
     return EXIT_SUCCESS;
 }
@@ -20,8 +20,8 @@
 
 #include <boost/foreach.hpp>
 #include <fstream>
+#include <memory>
 
-#include <simgear/package/unzip.h>
 #include <simgear/package/md5.h>
 
 #include <simgear/io/untar.hxx>
@@ -36,10 +36,6 @@
 #include <simgear/misc/strutils.hxx>
 #include <simgear/io/iostreams/sgstream.hxx>
 
-extern "C" {
-    void fill_memory_filefunc (zlib_filefunc_def*);
-}
-
 namespace simgear {
 
 namespace pkg {
@@ -108,15 +104,24 @@ protected:
 
         memset(&m_md5, 0, sizeof(SG_MD5_CTX));
         SG_MD5Init(&m_md5);
+
+        // archives are extracted as the bytes arrive, rather than buffering
+        // the whole (potentially very large) download in memory
+        m_extractor.reset();
+        if (responseCode() == 200) {
+            m_extractor = createExtractor();
+        }
     }
 
     virtual void gotBodyData(const char* s, int n)
     {
-        m_buffer += std::string(s, n);
         SG_MD5Update(&m_md5, (unsigned char*) s, n);
+        if (m_extractor) {
+            m_extractor->extractBytes(s, n);
+        }
 
-        m_downloaded = m_buffer.size();
-        m_owner->installProgress(m_buffer.size(), responseLength());
+        m_downloaded += n;
+        m_owner->installProgress(m_downloaded, responseLength());
     }
 
     virtual void onDone()
@@ -147,7 +152,7 @@ protected:
             return;
         }
 
-        if (!extract()) {
+        if (!m_extractor || m_extractor->hasError() || !m_extractor->isAtEndOfArchive()) {
             SG_LOG(SG_GENERAL, SG_WARN, "archive extraction failed");
             doFailure(Delegate::FAIL_EXTRACT);
             return;
@@ -197,125 +202,20 @@ protected:
 
 private:
 
-    void extractCurrentFile(unzFile zip, char* buffer, size_t bufferSize)
-    {
-        unz_file_info fileInfo;
-        unzGetCurrentFileInfo(zip, &fileInfo,
-            buffer, bufferSize,
-            NULL, 0,  /* extra field */
-            NULL, 0 /* comment field */);
-
-        std::string name(buffer);
-    // no absolute paths, no 'up' traversals
-    // we could also look for suspicious file extensions here (forbid .dll, .exe, .so)
-        if ((name[0] == '/') || (name.find("../") != std::string::npos) || (name.find("..\\") != std::string::npos)) {
-            throw sg_format_exception("Bad zip path", name);
-        }
-
-        if (fileInfo.uncompressed_size == 0) {
-            // assume it's a directory for now
-            // since we create parent directories when extracting
-            // a path, we're done here
-            return;
-        }
-
-        int result = unzOpenCurrentFile(zip);
-        if (result != UNZ_OK) {
-            throw sg_io_exception("opening current zip file failed", sg_location(name));
-        }
-
-        sg_ofstream outFile;
-        bool eof = false;
-        SGPath path(m_extractPath);
-        path.append(name);
-
-    // create enclosing directory heirarchy as required
-        Dir parentDir(path.dir());
-        if (!parentDir.exists()) {
-            bool ok = parentDir.create(0755);
-            if (!ok) {
-                throw sg_io_exception("failed to create directory heirarchy for extraction", path);
-            }
-        }
-
-        outFile.open(path, std::ios::binary | std::ios::trunc | std::ios::out);
-        if (outFile.fail()) {
-            throw sg_io_exception("failed to open output file for writing", path);
-        }
-
-        while (!eof) {
-            int bytes = unzReadCurrentFile(zip, buffer, bufferSize);
-            if (bytes < 0) {
-                throw sg_io_exception("unzip failure reading curent archive", sg_location(name));
-            } else if (bytes == 0) {
-                eof = true;
-            } else {
-                outFile.write(buffer, bytes);
-            }
-        }
-
-        outFile.close();
-        unzCloseCurrentFile(zip);
-    }
-
-    bool extract()
+    std::unique_ptr<ArchiveExtractor> createExtractor() const
     {
         const std::string u(url());
         const size_t ul(u.length());
         if (u.rfind(".zip") == (ul - 4)) {
-            return extractUnzip();
+            return std::unique_ptr<ArchiveExtractor>(new ZipExtractor(m_extractPath));
         }
 
         if (u.rfind(".tar.gz") == (ul - 7)) {
-            return extractTar();
+            return std::unique_ptr<ArchiveExtractor>(new TarExtractor(m_extractPath));
         }
 
         SG_LOG(SG_IO, SG_WARN, "unsupported archive format:" << u);
-        return false;
-    }
-
-    bool extractUnzip()
-    {
-        bool result = true;
-        zlib_filefunc_def memoryAccessFuncs;
-        fill_memory_filefunc(&memoryAccessFuncs);
-
-        char bufferName[128];
-        snprintf(bufferName, 128, "%p+%lx", m_buffer.data(), m_buffer.size());
-        unzFile zip = unzOpen2(bufferName, &memoryAccessFuncs);
-
-        const size_t BUFFER_SIZE = 32 * 1024;
-        void* buf = malloc(BUFFER_SIZE);
-
-        try {
-            int result = unzGoToFirstFile(zip);
-            if (result != UNZ_OK) {
-                throw sg_exception("failed to go to first file in archive");
-            }
-
-            while (true) {
-                extractCurrentFile(zip, (char*) buf, BUFFER_SIZE);
-                result = unzGoToNextFile(zip);
-                if (result == UNZ_END_OF_LIST_OF_FILE) {
-                    break;
-                } else if (result != UNZ_OK) {
-                    throw sg_io_exception("failed to go to next file in the archive");
-                }
-            }
-        } catch (sg_exception& ) {
-            result = false;
-        }
-
-        free(buf);
-        unzClose(zip);
-        return result;
-    }
-
-    bool extractTar()
-    {
-        TarExtractor tx(m_extractPath);
-        tx.extractBytes(m_buffer.data(), m_buffer.size());
-        return !tx.hasError() && tx.isAtEndOfArchive();
+        return std::unique_ptr<ArchiveExtractor>();
     }
 
     void doFailure(Delegate::StatusCode aReason)
@@ -333,7 +233,7 @@ private:
     InstallRef m_owner;
     string_list m_urls;
     SG_MD5_CTX m_md5;
-    std::string m_buffer;
+    std::unique_ptr<ArchiveExtractor> m_extractor;
     SGPath m_extractPath;
     size_t m_downloaded;
 };
@@ -369,6 +369,7 @@ private:
     string _sceneryVersion;
     string _protocol;
     string _dnsdn;
+    DNS::Client _dnsClient; // keeps resolved servers across findServer() calls
 
     TerrasyncThreadState _state;
     SGMutex _stateLock;
@@ -465,11 +466,10 @@ bool SGTerraSync::WorkerThread::findServer()
     naptrRequest->qflags = "U";
     DNS::Request_ptr r(naptrRequest);
 
-    DNS::Client dnsClient;
-    dnsClient.makeRequest(r);
+    _dnsClient.makeRequest(r);
     SG_LOG(SG_TERRASYNC,SG_DEBUG,"DNS NAPTR query for '" << _dnsdn << "' '" << naptrRequest->qservice << "'" );
     while( !r->isComplete() && !r->isTimeout() )
-      dnsClient.update(0);
+      _dnsClient.update(0);
 
     if( naptrRequest->entries.empty() ) {
         SG_LOG(SG_TERRASYNC, SG_ALERT, "Warning: no DNS entry found for '" << _dnsdn << "' '" << naptrRequest->qservice << "'" );
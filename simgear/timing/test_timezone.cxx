@@ -0,0 +1,225 @@
+/**************************************************************************
+ * test_timezone.cxx -- unit-tests for SGTimeZoneContainer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ **************************************************************************/
+
+#include <simgear/compiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <simgear/misc/sg_dir.hxx>
+#include <simgear/misc/test_macros.hxx>
+#include <simgear/timing/timestamp.hxx>
+#include <simgear/timing/timezone.h>
+
+using std::cout;
+using std::endl;
+
+static double random01()
+{
+    return rand() / double(RAND_MAX);
+}
+
+// A zone.tab line, with the coordinates in degrees and minutes, or
+// degrees, minutes and seconds
+static std::string zoneLine(int n, double lon, double lat, bool seconds)
+{
+    char buffer[128];
+    int latSec = int(fabs(lat) * 3600 + 0.5);
+    int lonSec = int(fabs(lon) * 3600 + 0.5);
+    char latSign = lat < 0 ? '-' : '+';
+    char lonSign = lon < 0 ? '-' : '+';
+    if (seconds) {
+        snprintf(buffer, sizeof(buffer),
+                 "XX\t%c%02d%02d%02d%c%03d%02d%02d\tZone/%d\n",
+                 latSign, latSec / 3600, latSec / 60 % 60, latSec % 60,
+                 lonSign, lonSec / 3600, lonSec / 60 % 60, lonSec % 60, n);
+    } else {
+        snprintf(buffer, sizeof(buffer), "XX\t%c%02d%02d%c%03d%02d\tZone/%d\n",
+                 latSign, latSec / 3600, latSec / 60 % 60,
+                 lonSign, lonSec / 3600, lonSec / 60 % 60, n);
+    }
+    return buffer;
+}
+
+// The linear search the container used before it had the k-d tree
+static SGTimeZone* linearNearest(std::vector<SGTimeZone>& zones,
+                                 const SGGeod& ref)
+{
+    SGVec3d refCart(SGVec3d::fromGeod(ref));
+    SGTimeZone* match = NULL;
+    double minDist2 = HUGE_VAL;
+    for (size_t i = 0; i < zones.size(); ++i) {
+        double d2 = distSqr(zones[i].cartCenterpoint(), refCart);
+        if (d2 < minDist2) {
+            match = &zones[i];
+            minDist2 = d2;
+        }
+    }
+    return match;
+}
+
+static std::string description(SGTimeZone* zone)
+{
+    return zone ? zone->getDescription() : "(none)";
+}
+
+// About as many zones as in the real zone.tab, clustered like the zones of
+// Europe, plus some at the same place and at the poles.  Writes them to
+// zone.tab in temp and returns its path.
+static SGPath writeZones(simgear::Dir& temp, std::vector<SGTimeZone>& zones)
+{
+    srand(49);
+    std::vector<std::string> lines;
+    for (int i = 0; i < 300; ++i) {
+        double lat = SGMiscd::rad2deg(asin(2*random01() - 1));
+        lines.push_back(zoneLine(i, 360*random01() - 180, lat, i % 3 == 0));
+    }
+    for (int i = 300; i < 420; ++i) {
+        lines.push_back(zoneLine(i, 30*random01() - 10, 25*random01() + 35,
+                                 i % 2 == 0));
+    }
+    lines.push_back(zoneLine(420, 2, 48, false));
+    lines.push_back(zoneLine(421, 2, 48, false));
+    lines.push_back(zoneLine(422, 179.5, 0, true));
+    lines.push_back(zoneLine(423, -179.5, 0, true));
+    lines.push_back(zoneLine(424, 0, 89.5, false));
+    lines.push_back(zoneLine(425, 0, -89.5, false));
+
+    SGPath path = temp.file("zone.tab");
+    FILE* file = fopen(path.local8BitStr().c_str(), "w");
+    SG_VERIFY(file);
+    fputs("# tz zone descriptions\n", file);
+    for (size_t i = 0; i < lines.size(); ++i)
+        fputs(lines[i].c_str(), file);
+    fclose(file);
+
+    for (size_t i = 0; i < lines.size(); ++i)
+        zones.push_back(SGTimeZone(lines[i].c_str()));
+    return path;
+}
+
+// random positions, positions on and next to the centerpoints, and a track
+// as from an aircraft for the batch lookup
+static std::vector<SGGeod> lookupPositions(std::vector<SGTimeZone>& zones,
+                                           int n)
+{
+    std::vector<SGGeod> refs;
+    for (int i = 0; i < n; ++i) {
+        double lat = SGMiscd::rad2deg(asin(2*random01() - 1));
+        refs.push_back(SGGeod::fromDeg(360*random01() - 180, lat));
+    }
+    for (size_t i = 0; i < zones.size(); ++i) {
+        SGGeod geod = SGGeod::fromCart(zones[i].cartCenterpoint());
+        refs.push_back(geod);
+        refs.push_back(SGGeod::fromDegM(geod.getLongitudeDeg() + 1e-6,
+                                        geod.getLatitudeDeg(), 10000));
+    }
+    for (int i = 0; i < n; ++i)
+        refs.push_back(SGGeod::fromDeg(-10 + 0.002*i, 35 + 0.001*i));
+    return refs;
+}
+
+void testNearest()
+{
+    simgear::Dir temp = simgear::Dir::tempDir("timezone");
+    temp.setRemoveOnDestroy();
+    std::vector<SGTimeZone> zones;
+    SGPath path = writeZones(temp, zones);
+    SGTimeZoneContainer container(path.local8BitStr().c_str());
+    std::vector<SGGeod> refs = lookupPositions(zones, 20000);
+
+    for (size_t i = 0; i < refs.size(); ++i) {
+        SG_CHECK_EQUAL(description(container.getNearest(refs[i])),
+                       description(linearNearest(zones, refs[i])));
+    }
+    SG_CHECK_EQUAL(description(container.getNearest(SGGeod::fromDeg(2, 48))),
+                   "Zone/420");
+
+    std::vector<SGTimeZone*> batch;
+    container.getNearest(refs, batch);
+    SG_CHECK_EQUAL(batch.size(), refs.size());
+    for (size_t i = 0; i < refs.size(); ++i) {
+        SG_CHECK_EQUAL(description(batch[i]),
+                       description(linearNearest(zones, refs[i])));
+    }
+}
+
+void benchmark()
+{
+    simgear::Dir temp = simgear::Dir::tempDir("timezone");
+    temp.setRemoveOnDestroy();
+    std::vector<SGTimeZone> zones;
+    SGPath path = writeZones(temp, zones);
+    SGTimeZoneContainer container(path.local8BitStr().c_str());
+    std::vector<SGGeod> refs = lookupPositions(zones, 20000);
+    std::vector<SGTimeZone*> batch;
+
+    SGTimeStamp start = SGTimeStamp::now();
+    for (size_t i = 0; i < refs.size(); ++i)
+        linearNearest(zones, refs[i]);
+    double linearUs = (SGTimeStamp::now() - start).toUSecs();
+    start = SGTimeStamp::now();
+    for (size_t i = 0; i < refs.size(); ++i)
+        container.getNearest(refs[i]);
+    double treeUs = (SGTimeStamp::now() - start).toUSecs();
+    start = SGTimeStamp::now();
+    container.getNearest(refs, batch);
+    double batchUs = (SGTimeStamp::now() - start).toUSecs();
+    cout << zones.size() << " zones, per lookup: linear "
+         << linearUs / refs.size() << "us, k-d tree "
+         << treeUs / refs.size() << "us, batch "
+         << batchUs / refs.size() << "us" << endl;
+}
+
+void testEmpty()
+{
+    simgear::Dir temp = simgear::Dir::tempDir("timezone");
+    temp.setRemoveOnDestroy();
+    SGPath path = temp.file("zone.tab");
+    FILE* file = fopen(path.local8BitStr().c_str(), "w");
+    SG_VERIFY(file);
+    fputs("# no zones\n", file);
+    fclose(file);
+
+    SGTimeZoneContainer container(path.local8BitStr().c_str());
+    SG_CHECK_IS_NULL(container.getNearest(SGGeod::fromDeg(2, 48)));
+    std::vector<SGGeod> refs(2, SGGeod::fromDeg(2, 48));
+    std::vector<SGTimeZone*> result;
+    container.getNearest(refs, result);
+    SG_CHECK_EQUAL(result.size(), 2u);
+    SG_CHECK_IS_NULL(result[0]);
+}
+
+int main(int argc, char* argv[])
+{
+    if ((argc > 1) && !strcmp(argv[1], "--bench")) {
+        benchmark();
+        return EXIT_SUCCESS;
+    }
+
+    testNearest();
+    testEmpty();
+
+    cout << "all tests passed OK" << endl;
+    return 0; // passed
+}
@@ -34,7 +34,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <cstdlib>
+#include <algorithm>
 
+#include <simgear/math/SGGeometry.hxx>
 #include <simgear/structure/exception.hxx>
 
 #include "timezone.h"
@@ -164,6 +166,14 @@ SGTimeZoneContainer::SGTimeZoneContainer(const char *filename)
     }
     
     fclose(infile);
+
+    tree.resize(zones.size());
+    for (unsigned i = 0; i < zones.size(); ++i) {
+        tree[i].point = zones[i]->cartCenterpoint();
+        tree[i].index = i;
+        tree[i].axis = 0;
+    }
+    buildTree(0, tree.size());
 }
 
 SGTimeZoneContainer::~SGTimeZoneContainer()
@@ -174,21 +184,93 @@ SGTimeZoneContainer::~SGTimeZoneContainer()
   }
 }
 
-SGTimeZone* SGTimeZoneContainer::getNearest(const SGGeod& ref) const
+namespace {
+
+struct AxisLess {
+  AxisLess(int axis) : _axis(axis) {}
+  template<typename T>
+  bool operator()(const T& a, const T& b) const
+  { return a.point[_axis] < b.point[_axis]; }
+  int _axis;
+};
+
+}
+
+void SGTimeZoneContainer::buildTree(size_t begin, size_t end)
 {
-  SGVec3d refCart(SGVec3d::fromGeod(ref));
-  SGTimeZone* match = NULL;
-  double minDist2 = HUGE_VAL;
-  
-  TZVec::const_iterator it = zones.begin();
-  for (; it != zones.end(); ++it) {
-    double d2 = distSqr((*it)->cartCenterpoint(), refCart);
-    if (d2 < minDist2) {
-      match = *it;
-      minDist2 = d2;
+  if (end - begin < 2)
+    return;
+
+  // split along the axis with the largest extent
+  SGBoxd box;
+  for (size_t i = begin; i < end; ++i)
+    box.expandBy(tree[i].point);
+  int axis = box.getBroadestAxis();
+
+  size_t mid = begin + (end - begin)/2;
+  std::nth_element(tree.begin() + begin, tree.begin() + mid,
+                   tree.begin() + end, AxisLess(axis));
+  tree[mid].axis = axis;
+  buildTree(begin, mid);
+  buildTree(mid + 1, end);
+}
+
+// The nearest timezone found so far, equally near timezones are resolved
+// to the first one in the file, as the linear search did.
+struct SGTimeZoneContainer::Nearest {
+  Nearest() : index(~0u), dist2(HUGE_VAL) {}
+  void consider(unsigned i, double d2)
+  {
+    if (d2 < dist2 || (d2 == dist2 && i < index)) {
+      index = i;
+      dist2 = d2;
     }
   }
+  unsigned index;
+  double dist2;
+};
 
-  return match;
+void SGTimeZoneContainer::findNearest(size_t begin, size_t end,
+                                      const SGVec3d& point,
+                                      Nearest& nearest) const
+{
+  while (begin < end) {
+    size_t mid = begin + (end - begin)/2;
+    const KdNode& node = tree[mid];
+    nearest.consider(node.index, distSqr(node.point, point));
+    if (end - begin == 1)
+      return;
+
+    // descend into the half containing the point first, the other half
+    // only if it can contain a point which is at least as near
+    double d = point[node.axis] - node.point[node.axis];
+    if (d < 0) {
+      findNearest(begin, mid, point, nearest);
+      if (nearest.dist2 < d*d)
+        return;
+      begin = mid + 1;
+    } else {
+      findNearest(mid + 1, end, point, nearest);
+      if (nearest.dist2 < d*d)
+        return;
+      end = mid;
+    }
+  }
 }
 
+SGTimeZone* SGTimeZoneContainer::getNearest(const SGGeod& ref) const
+{
+  Nearest nearest;
+  findNearest(0, tree.size(), SGVec3d::fromGeod(ref), nearest);
+  if (nearest.index == ~0u)
+    return NULL;
+  return zones[nearest.index];
+}
+
+void SGTimeZoneContainer::getNearest(const std::vector<SGGeod>& refs,
+                                     std::vector<SGTimeZone*>& result) const
+{
+  result.resize(refs.size());
+  for (size_t i = 0; i < refs.size(); ++i)
+    result[i] = getNearest(refs[i]);
+}
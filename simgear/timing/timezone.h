@@ -86,6 +86,10 @@ public:
 
 /**
  * SGTimeZoneContainer 
+ *
+ * Holds the timezones of a zone.tab file. The centerpoints are indexed in
+ * a k-d tree when the file is loaded, so looking up the nearest timezone
+ * takes some ten distance computations instead of one per timezone.
  */
 
 class SGTimeZoneContainer
@@ -94,11 +98,41 @@ public:
   SGTimeZoneContainer(const char *filename);
   ~SGTimeZoneContainer();
   
+  /**
+   * Return the timezone with the centerpoint nearest to ref, the one
+   * listed first in the file if several are equally near, or NULL if
+   * there are no timezones.
+   */
   SGTimeZone* getNearest(const SGGeod& ref) const;
+
+  /**
+   * Lookup the nearest timezones of many positions at once, as for the
+   * aircraft of a multiplayer session.
+   * @param refs the positions
+   * @param result the nearest timezone of each position
+   */
+  void getNearest(const std::vector<SGGeod>& refs,
+                  std::vector<SGTimeZone*>& result) const;
   
 private:
   typedef std::vector<SGTimeZone*> TZVec;
   TZVec zones;
+
+  // A node of the k-d tree. The tree is stored implicitly: the node of a
+  // range of the vector is at its middle, the subtrees are the ranges
+  // before and after it.
+  struct KdNode {
+    SGVec3d point;
+    unsigned index; // into zones
+    int axis;
+  };
+  struct Nearest;
+
+  void buildTree(size_t begin, size_t end);
+  void findNearest(size_t begin, size_t end, const SGVec3d& point,
+                   Nearest& nearest) const;
+
+  std::vector<KdNode> tree;
 };
 
 